@@ -26,6 +26,9 @@
 #include <errno.h>
 #include <math.h>
 #include <time.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #define GSM_TA_M 553.85
 #define PI 3.1415926536
@@ -47,7 +50,7 @@ struct sysinfo sysinfo;
 static struct node_power *node_power_first = NULL;
 static struct node_power **node_power_last_p = &node_power_first;
 struct node_mcc *node_mcc_first = NULL;
-int log_lines = 0, log_debug = 0;
+int log_lines = 0, log_debug = 0, log_stream = 0;
 
 
 static void nomem(void)
@@ -137,9 +140,15 @@ static void add_sysinfo()
 	cell = get_node_cell(lac, s.cell_id);
 	if (!cell)
 		nomem();
-	meas = add_node_meas(cell);
-	if (!meas)
-		nomem();
+	if (log_stream) {
+		/* aggregate, so memory does not grow with the log */
+		if (add_node_bin(cell))
+			nomem();
+	} else {
+		meas = add_node_meas(cell);
+		if (!meas)
+			nomem();
+	}
 	if (!cell->content) {
 		cell->content = 1;
 		memcpy(&cell->sysinfo, &sysinfo, sizeof(sysinfo));
@@ -339,10 +348,54 @@ void kml_meas(FILE *outfp, struct node_meas *meas, int n, uint16_t mcc,
 	fprintf(outfp, "\t\t\t\t\t</Placemark>\n");
 }
 
+void kml_bin(FILE *outfp, struct node_bin *bin, int n, uint16_t mcc,
+	uint16_t mnc, uint16_t lac, uint16_t cellid)
+{
+	struct tm *tm = localtime(&bin->gmt);
+	double longitude = bin->sum_longitude / bin->count;
+	double latitude = bin->sum_latitude / bin->count;
+	int rxlev = bin->sum_rxlev / (int64_t)bin->count;
+
+	fprintf(outfp, "\t\t\t\t\t<Placemark>\n");
+	fprintf(outfp, "\t\t\t\t\t\t<name>%d: %d</name>\n", n, rxlev);
+	fprintf(outfp, "\t\t\t\t\t\t<description>\n");
+	fprintf(outfp, "MCC=%s MNC=%s\nLAC=%04x CELL-ID=%04x\n(%s %s)\n",
+		gsm_print_mcc(mcc), gsm_print_mnc(mnc), lac, cellid,
+		gsm_get_mcc(mcc), gsm_get_mnc(mcc, mnc));
+	fprintf(outfp, "\n%u measurements since %s", bin->count, asctime(tm));
+	fprintf(outfp, "RX-LEV %d dBm (average)\n", rxlev);
+	if (bin->ta_valid)
+		fprintf(outfp, "TA=%d (%d-%d meter)\n", bin->ta,
+			(int)(GSM_TA_M * bin->ta),
+			(int)(GSM_TA_M * (bin->ta + 1)));
+	fprintf(outfp, "\t\t\t\t\t\t</description>\n");
+	fprintf(outfp, "\t\t\t\t\t\t<LookAt>\n");
+	fprintf(outfp, "\t\t\t\t\t\t\t<longitude>%.8f</longitude>\n",
+		longitude);
+	fprintf(outfp, "\t\t\t\t\t\t\t<latitude>%.8f</latitude>\n",
+		latitude);
+	fprintf(outfp, "\t\t\t\t\t\t\t<altitude>0</altitude>\n");
+	fprintf(outfp, "\t\t\t\t\t\t\t<tilt>0</tilt>\n");
+	fprintf(outfp, "\t\t\t\t\t\t\t<altitudeMode>relativeToGround"
+		"</altitudeMode>\n");
+	fprintf(outfp, "\t\t\t\t\t\t\t<gx:altitudeMode>relativeToSeaFloor"
+		"</gx:altitudeMode>\n");
+	fprintf(outfp, "\t\t\t\t\t\t</LookAt>\n");
+	fprintf(outfp, "\t\t\t\t\t\t<styleUrl>#msn_placemark_circle"
+		"</styleUrl>\n");
+	fprintf(outfp, "\t\t\t\t\t\t<Point>\n");
+	fprintf(outfp, "\t\t\t\t\t\t\t<coordinates>%.8f,%.8f</coordinates>\n",
+		longitude, latitude);
+	fprintf(outfp, "\t\t\t\t\t\t</Point>\n");
+	fprintf(outfp, "\t\t\t\t\t</Placemark>\n");
+}
+
 double debug_long, debug_lat, debug_x_scale;
 FILE *debug_fp;
 
-void kml_cell(FILE *outfp, struct node_cell *cell)
+/* locate the cell from its list of measurements */
+static int locate_meas(FILE *outfp, struct node_cell *cell,
+	double *longitude_p, double *latitude_p)
 {
 	struct node_meas *meas;
 	double x, y, z, sum_x = 0, sum_y = 0, sum_z = 0, longitude, latitude;
@@ -361,7 +414,7 @@ void kml_cell(FILE *outfp, struct node_cell *cell)
 		meas = meas->next;
 	}
 	if (!n)
-		return;
+		return 0;
 	if (n < 3) {
 		x = sum_x / n;
 		y = sum_y / n;
@@ -377,10 +430,12 @@ void kml_cell(FILE *outfp, struct node_cell *cell)
 		x_scale = 1.0 / cos(meas->latitude / 180.0 * PI);
 		longitude = meas->longitude;
 		latitude = meas->latitude;
-		debug_x_scale = x_scale;
-		debug_long = longitude;
-		debug_lat = latitude;
-		debug_fp = outfp;
+		if (log_debug) {
+			debug_x_scale = x_scale;
+			debug_long = longitude;
+			debug_lat = latitude;
+			debug_fp = outfp;
+		}
 		while (meas) {
 			if (meas->gps_valid && meas->ta_valid) {
 				probe = calloc(1, sizeof(struct probe));
@@ -396,6 +451,7 @@ void kml_cell(FILE *outfp, struct node_cell *cell)
 				probe->dist = GSM_TA_M * (0.5 +
 					(double)meas->ta) /
 					(EQUATOR_RADIUS * PI / 180.0);
+				probe->weight = 1;
 				*probe_last_p = probe;
 				probe_last_p = &probe->next;
 			}
@@ -423,8 +479,199 @@ void kml_cell(FILE *outfp, struct node_cell *cell)
 		known = 1;
 	}
 
-	if (!known)
+	*longitude_p = longitude;
+	*latitude_p = latitude;
+	return known;
+}
+
+/* locate the cell from its aggregated measurements, each bin with TA
+ * becomes one probe, weighted by the number of its measurements */
+static int locate_bins(FILE *outfp, struct node_cell *cell,
+	double *longitude_p, double *latitude_p)
+{
+	struct probe *probe_first = NULL, *probe,
+		     **probe_last_p = &probe_first;
+	struct node_bin *bin;
+	double x, y, x_scale, longitude, latitude;
+	int i, n = 0;
+
+	for (i = 0; i < cell->bin_num; i++) {
+		if (cell->bin[i].ta_valid)
+			n++;
+	}
+	if (n < 3)
+		return 0;
+
+	/* translate to flat surface */
+	bin = cell->bin;
+	longitude = bin->sum_longitude / bin->count;
+	latitude = bin->sum_latitude / bin->count;
+	x_scale = 1.0 / cos(latitude / 180.0 * PI);
+	if (log_debug) {
+		debug_x_scale = x_scale;
+		debug_long = longitude;
+		debug_lat = latitude;
+		debug_fp = outfp;
+	}
+	for (i = 0; i < cell->bin_num; i++) {
+		bin = &cell->bin[i];
+		if (!bin->ta_valid)
+			continue;
+		probe = calloc(1, sizeof(struct probe));
+		if (!probe)
+			nomem();
+		probe->x = (bin->sum_longitude / bin->count - longitude) /
+				x_scale;
+		probe->y = bin->sum_latitude / bin->count - latitude;
+		probe->dist = GSM_TA_M * (0.5 + (double)bin->ta) /
+			(EQUATOR_RADIUS * PI / 180.0);
+		probe->weight = bin->count;
+		*probe_last_p = probe;
+		probe_last_p = &probe->next;
+	}
+
+	/* locate */
+	locate_cell(probe_first, &x, &y);
+
+	/* translate from flat surface */
+	longitude += x * x_scale;
+	if (longitude < 0)
+		longitude += 360;
+	else if (longitude >= 360)
+		longitude -= 360;
+	latitude += y;
+
+	/* remove probes */
+	while (probe_first) {
+		probe = probe_first;
+		probe_first = probe->next;
+		free(probe);
+	}
+
+	*longitude_p = longitude;
+	*latitude_p = latitude;
+	return 1;
+}
+
+/* locate the cell once, the result is kept for the output */
+static void locate_node_cell(FILE *outfp, struct node_cell *cell)
+{
+	if (cell->located)
+		return;
+	if (log_stream)
+		cell->known = locate_bins(outfp, cell, &cell->longitude,
+			&cell->latitude);
+	else
+		cell->known = locate_meas(outfp, cell, &cell->longitude,
+			&cell->latitude);
+	cell->located = 1;
+}
+
+#ifdef HAVE_PTHREAD
+struct locate_pool {
+	struct node_cell **cell;
+	int num;
+	int next; /* next cell to locate, taken by the workers */
+};
+
+static void *locate_worker(void *arg)
+{
+	struct locate_pool *pool = arg;
+	int i;
+
+	while ((i = __sync_fetch_and_add(&pool->next, 1)) < pool->num)
+		locate_node_cell(NULL, pool->cell[i]);
+
+	return NULL;
+}
+#endif
+
+/* count the cells of all LACs, and store them, if an array is given */
+static int collect_cells(struct node_cell **cells)
+{
+	struct node_mcc *mcc;
+	struct node_mnc *mnc;
+	struct node_lac *lac;
+	struct node_cell *cell;
+	int num = 0;
+
+	for (mcc = node_mcc_first; mcc; mcc = mcc->next) {
+		for (mnc = mcc->mnc; mnc; mnc = mnc->next) {
+			for (lac = mnc->lac; lac; lac = lac->next) {
+				for (cell = lac->cell; cell; cell = cell->next) {
+					if (cells)
+						cells[num] = cell;
+					num++;
+				}
+			}
+		}
+	}
+
+	return num;
+}
+
+/* locate all cells before the output, using the given number of threads.
+ * returns the number of cells */
+static int locate_all(int jobs)
+{
+	struct node_cell **cells;
+	int num, i;
+
+	num = collect_cells(NULL);
+	cells = calloc(num + 1, sizeof(*cells));
+	if (!cells)
+		nomem();
+	collect_cells(cells);
+
+#ifdef HAVE_PTHREAD
+	if (jobs > 1) {
+		struct locate_pool pool = { cells, num, 0 };
+		pthread_t *thread;
+
+		thread = calloc(jobs - 1, sizeof(*thread));
+		if (!thread)
+			nomem();
+		for (i = 0; i < jobs - 1; i++) {
+			if (pthread_create(&thread[i], NULL, locate_worker,
+					&pool))
+				break;
+		}
+		jobs = i;
+		/* this thread is a worker too */
+		locate_worker(&pool);
+		for (i = 0; i < jobs; i++)
+			pthread_join(thread[i], NULL);
+		free(thread);
+		free(cells);
+		return num;
+	}
+#endif
+	for (i = 0; i < num; i++)
+		locate_node_cell(NULL, cells[i]);
+	free(cells);
+
+	return num;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void kml_cell(FILE *outfp, struct node_cell *cell)
+{
+	struct node_meas *meas;
+	double x, y, z, longitude, latitude;
+	int i;
+
+	locate_node_cell(outfp, cell);
+	if (!cell->known)
 		return;
+	longitude = cell->longitude;
+	latitude = cell->latitude;
 
 	fprintf(outfp, "\t\t\t\t\t<Placemark>\n");
 	fprintf(outfp, "\t\t\t\t\t\t<name>MCC=%s MNC=%s\nLAC=%04x "
@@ -447,7 +694,7 @@ void kml_cell(FILE *outfp, struct node_cell *cell)
 	fprintf(outfp, "\t\t\t\t\t\t\t<gx:altitudeMode>relativeToSeaFloor"
 		"</gx:altitudeMode>\n");
 	fprintf(outfp, "\t\t\t\t\t\t</LookAt>\n");
-	if (known)
+	if (cell->known)
 		fprintf(outfp, "\t\t\t\t\t\t<styleUrl>#msn_placemark_grn_"
 			"pushpin</styleUrl>\n");
 	else
@@ -468,8 +715,35 @@ void kml_cell(FILE *outfp, struct node_cell *cell)
 	fprintf(outfp, "\t\t<visibility>0</visibility>\n");
 
 	geo2space(&x, &y, &z, longitude, latitude);
+	for (i = 0; log_stream && i < cell->bin_num; i++) {
+		struct node_bin *bin = &cell->bin[i];
+		double mx, my, mz, dist, mlong, mlat;
+
+		mlong = bin->sum_longitude / bin->count;
+		mlat = bin->sum_latitude / bin->count;
+		geo2space(&mx, &my, &mz, mlong, mlat);
+		dist = distinspace(x, y, z, mx, my, mz);
+		fprintf(outfp, "\t\t<Placemark>\n");
+		fprintf(outfp, "\t\t\t<name>Range</name>\n");
+		fprintf(outfp, "\t\t\t<description>\n");
+		fprintf(outfp, "Distance: %d\n", (int)dist);
+		fprintf(outfp, "Measurements: %u\n", bin->count);
+		if (bin->ta_valid)
+			fprintf(outfp, "TA=%d (%d-%d meter)\n", bin->ta,
+				(int)(GSM_TA_M * bin->ta),
+				(int)(GSM_TA_M * (bin->ta + 1)));
+		fprintf(outfp, "\t\t\t</description>\n");
+		fprintf(outfp, "\t\t\t<visibility>0</visibility>\n");
+		fprintf(outfp, "\t\t\t<LineString>\n");
+		fprintf(outfp, "\t\t\t\t<tessellate>1</tessellate>\n");
+		fprintf(outfp, "\t\t\t\t<coordinates>\n");
+		fprintf(outfp, "%.8f,%.8f\n", longitude, latitude);
+		fprintf(outfp, "%.8f,%.8f\n", mlong, mlat);
+		fprintf(outfp, "\t\t\t\t</coordinates>\n");
+		fprintf(outfp, "\t\t\t</LineString>\n");
+		fprintf(outfp, "\t\t</Placemark>\n");
+	}
 	meas = cell->meas;
-	n = 0;
 	while (meas) {
 		if (meas->gps_valid) {
 			double mx, my, mz, dist;
@@ -506,7 +780,8 @@ struct log_target *stderr_target;
 int main(int argc, char *argv[])
 {
 	FILE *infp, *outfp;
-	int type, n, i;
+	int type, n, i, binary, jobs = 1, cells = 0;
+	double t_start, t_read, t_locate;
 	char *p;
 	struct node_mcc *mcc;
 	struct node_mnc *mnc;
@@ -524,11 +799,16 @@ int main(int argc, char *argv[])
 	if (argc <= 2) {
 usage:
 		fprintf(stderr, "Usage: %s <file.log> <file.kml> "
-			"[lines] [debug]\n", argv[0]);
+			"[lines] [debug] [stream] [-j N]\n", argv[0]);
 		fprintf(stderr, "lines: Add lines between cell and "
 			"Measurement point\n");
 		fprintf(stderr, "debug: Add debugging of location algorithm.\n"
 			);
+		fprintf(stderr, "stream: Aggregate measurements of each cell "
+			"in bounded memory.\n");
+		fprintf(stderr, "-j N: Locate the cells on N threads.\n");
+		fprintf(stderr, "The log may be a text log or a binary log "
+			"of cell_log.\n");
 		return 0;
 	}
 
@@ -537,6 +817,13 @@ usage:
 			log_lines = 1;
 		else if (!strcmp(argv[i], "debug"))
 			log_debug = 1;
+		else if (!strcmp(argv[i], "stream"))
+			log_stream = 1;
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+			if (jobs < 1)
+				goto usage;
+		}
 		else goto usage;
 	}
 
@@ -546,18 +833,29 @@ usage:
 		return -EIO;
 	}
 
-	while ((type = read_log(infp))) {
+	t_start = now_sec();
+	binary = log_is_binary(infp);
+	while ((type = (binary) ? read_log_bin(infp) : read_log(infp))) {
 		switch (type) {
 		case LOG_TYPE_SYSINFO:
 			add_sysinfo();
 			break;
 		case LOG_TYPE_POWER:
-			add_power();
+			/* power is not written to the KML file yet */
+			if (!log_stream)
+				add_power();
 			break;
 		}
 	}
 
 	fclose(infp);
+	t_read = now_sec();
+
+	/* the debug output of the locator goes into the KML file, so the
+	 * cells are located while writing it */
+	if (!log_debug)
+		cells = locate_all(jobs);
+	t_locate = now_sec();
 
 	if (!strcmp(argv[2], "-"))
 		outfp = stdout;
@@ -603,6 +901,9 @@ usage:
 		fprintf(outfp, "\t\t\t\t<Folder>\n");
 		fprintf(outfp, "\t\t\t\t\t<name>CELL-ID %04x</name>\n", cell->cellid);
 		fprintf(outfp, "\t\t\t\t\t<open>0</open>\n");
+		for (i = 0; log_stream && i < cell->bin_num; i++)
+			kml_bin(outfp, &cell->bin[i], i + 1, mcc->mcc,
+				mnc->mnc, lac->lac, cell->cellid);
 		meas = cell->meas;
 		n = 0;
 		while (meas) {
@@ -654,5 +955,15 @@ usage:
 
 	fclose(outfp);
 
+	if (log_debug)
+		fprintf(stderr, "Read log in %.3f s, located cells and wrote "
+			"KML in %.3f s\n", t_read - t_start,
+			now_sec() - t_locate);
+	else
+		fprintf(stderr, "Read log in %.3f s, located %d cells on %d "
+			"thread%s in %.3f s, wrote KML in %.3f s\n",
+			t_read - t_start, cells, jobs, (jobs == 1) ? "" : "s",
+			t_locate - t_read, now_sec() - t_locate);
+
 	return 0;
 }
@@ -2,6 +2,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <math.h>
 
@@ -15,13 +17,299 @@ extern double debug_long, debug_lat, debug_x_scale;
 extern FILE *debug_fp;
 extern int log_debug;
 
-static double finetune_x[6], finetune_y[6], finetune_dist[6];
+/*
+ * Spatial index of the probes
+ *
+ * The probes are sorted into groups of the same distance (TA) within the
+ * same square of a grid. For a candidate point, the bounding box of a group
+ * gives lower and upper bounds of the distance to the radius of all its
+ * probes. These bounds allow to drop a candidate before all probes are
+ * evaluated, without changing the result of the search. The probes of a
+ * group are stored in arrays, so that the evaluation is vectorized.
+ */
+
+#define GROUP_PROBES	16	/* average number of probes per grid square */
+
+struct probe_group {
+	double x0, y0, x1, y1; /* bounding box */
+	double dist, weight;
+	int first, num;
+};
+
+struct probe_index {
+	double *x, *y, *dist, *weight;
+	struct probe_group *group;
+	double *bound;
+	int num_groups;
+	int last_max; /* group that had the maximum at the last candidate */
+};
+
+struct probe_key {
+	struct probe *probe;
+	int gx, gy;
+};
+
+static int probe_key_cmp(const void *_a, const void *_b)
+{
+	const struct probe_key *a = _a, *b = _b;
+
+	if (a->probe->dist != b->probe->dist)
+		return (a->probe->dist < b->probe->dist) ? -1 : 1;
+	if (a->gx != b->gx)
+		return a->gx - b->gx;
+	return a->gy - b->gy;
+}
+
+static void probe_index_free(struct probe_index *pi)
+{
+	free(pi->x);
+	free(pi->y);
+	free(pi->dist);
+	free(pi->weight);
+	free(pi->group);
+	free(pi->bound);
+}
+
+/* build the index, the excluded probe gets a group of its own, which is
+ * the last one */
+static int probe_index_build(struct probe_index *pi,
+	struct probe *probe_first, struct probe *exclude)
+{
+	struct probe_key *key;
+	struct probe_group *g = NULL;
+	struct probe *probe;
+	double x0 = 0, y0 = 0, x1 = 0, y1 = 0, size;
+	int n = 0, grid, i;
+
+	memset(pi, 0, sizeof(*pi));
+	for (probe = probe_first; probe; probe = probe->next) {
+		if (!n || probe->x < x0)
+			x0 = probe->x;
+		if (!n || probe->x > x1)
+			x1 = probe->x;
+		if (!n || probe->y < y0)
+			y0 = probe->y;
+		if (!n || probe->y > y1)
+			y1 = probe->y;
+		n++;
+	}
+
+	key = calloc(n, sizeof(*key));
+	pi->x = malloc(n * sizeof(double));
+	pi->y = malloc(n * sizeof(double));
+	pi->dist = malloc(n * sizeof(double));
+	pi->weight = malloc(n * sizeof(double));
+	pi->group = calloc(n, sizeof(*pi->group));
+	pi->bound = calloc(n, sizeof(double));
+	if (!key || !pi->x || !pi->y || !pi->dist || !pi->weight || !pi->group
+	 || !pi->bound) {
+		free(key);
+		probe_index_free(pi);
+		return -ENOMEM;
+	}
+
+	/* sort probes by distance and grid square */
+	grid = sqrt(n / GROUP_PROBES) + 1;
+	size = ((x1 - x0 > y1 - y0) ? x1 - x0 : y1 - y0) / grid;
+	if (size <= 0)
+		size = 1;
+	i = 0;
+	for (probe = probe_first; probe; probe = probe->next) {
+		if (probe == exclude)
+			continue;
+		key[i].probe = probe;
+		key[i].gx = (probe->x - x0) / size;
+		key[i].gy = (probe->y - y0) / size;
+		i++;
+	}
+	qsort(key, i, sizeof(*key), probe_key_cmp);
+	key[i].probe = exclude;
+
+	/* store probes and form groups */
+	for (i = 0; i < n; i++) {
+		probe = key[i].probe;
+		if (!g || i == n - 1 || probe->dist != g->dist
+		 || key[i].gx != key[i - 1].gx || key[i].gy != key[i - 1].gy) {
+			g = &pi->group[pi->num_groups++];
+			g->x0 = g->x1 = probe->x;
+			g->y0 = g->y1 = probe->y;
+			g->dist = probe->dist;
+			g->first = i;
+		}
+		if (probe->x < g->x0)
+			g->x0 = probe->x;
+		if (probe->x > g->x1)
+			g->x1 = probe->x;
+		if (probe->y < g->y0)
+			g->y0 = probe->y;
+		if (probe->y > g->y1)
+			g->y1 = probe->y;
+		g->weight += probe->weight;
+		g->num++;
+		pi->x[i] = probe->x;
+		pi->y[i] = probe->y;
+		pi->dist[i] = probe->dist;
+		pi->weight[i] = probe->weight;
+	}
+	free(key);
+
+	return 0;
+}
+
+/* lower and upper bound of the distance to the radius for all probes of
+ * the group */
+static void group_bounds(const struct probe_group *g, double x, double y,
+	double *lb, double *ub)
+{
+	double dx, dy, dmin, dmax, a, b;
+
+	/* nearest point of the bounding box */
+	dx = (x < g->x0) ? g->x0 - x : ((x > g->x1) ? x - g->x1 : 0);
+	dy = (y < g->y0) ? g->y0 - y : ((y > g->y1) ? y - g->y1 : 0);
+	dmin = sqrt(dx * dx + dy * dy);
+	/* farthest corner of the bounding box */
+	dx = (x - g->x0 > g->x1 - x) ? x - g->x0 : g->x1 - x;
+	dy = (y - g->y0 > g->y1 - y) ? y - g->y0 : g->y1 - y;
+	dmax = sqrt(dx * dx + dy * dy);
+
+	a = dmin - g->dist;
+	b = g->dist - dmax;
+	*lb = (a > b) ? a : b;
+	if (*lb < 0)
+		*lb = 0;
+	a = dmax - g->dist;
+	b = g->dist - dmin;
+	*ub = (a > b) ? a : b;
+}
+
+/* The loops below use four independent lanes, so the compiler can use
+ * vector instructions. The maximum does not depend on the order, but the
+ * sum is added up per group and per lane, not in the order of the probe
+ * list. It may differ from a serial sum in the last bits, so two fine
+ * tuning points of nearly equal sum may be chosen differently. */
+
+static double group_max(const struct probe_index *pi,
+	const struct probe_group *g, double x, double y)
+{
+	const double *px = pi->x + g->first, *py = pi->y + g->first,
+		*pd = pi->dist + g->first;
+	double m[4] = { 0, 0, 0, 0 }, dx, dy, temp;
+	int i, j, n = g->num;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		for (j = 0; j < 4; j++) {
+			dx = px[i + j] - x;
+			dy = py[i + j] - y;
+			temp = fabs(sqrt(dx * dx + dy * dy) - pd[i + j]);
+			m[j] = (temp > m[j]) ? temp : m[j];
+		}
+	}
+	for (; i < n; i++) {
+		dx = px[i] - x;
+		dy = py[i] - y;
+		temp = fabs(sqrt(dx * dx + dy * dy) - pd[i]);
+		m[0] = (temp > m[0]) ? temp : m[0];
+	}
+	m[0] = (m[1] > m[0]) ? m[1] : m[0];
+	m[2] = (m[3] > m[2]) ? m[3] : m[2];
+	return (m[2] > m[0]) ? m[2] : m[0];
+}
+
+static double group_sum(const struct probe_index *pi,
+	const struct probe_group *g, double x, double y)
+{
+	const double *px = pi->x + g->first, *py = pi->y + g->first,
+		*pd = pi->dist + g->first, *pw = pi->weight + g->first;
+	double s[4] = { 0, 0, 0, 0 }, dx, dy;
+	int i, j, n = g->num;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		for (j = 0; j < 4; j++) {
+			dx = px[i + j] - x;
+			dy = py[i + j] - y;
+			s[j] += fabs(sqrt(dx * dx + dy * dy) - pd[i + j])
+				* pw[i + j];
+		}
+	}
+	for (; i < n; i++) {
+		dx = px[i] - x;
+		dy = py[i] - y;
+		s[0] += fabs(sqrt(dx * dx + dy * dy) - pd[i]) * pw[i];
+	}
+	return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+/* greatest distance to the radius of all probes, except the excluded one.
+ * if the result reaches the given bound, the search is stopped and a value
+ * not below the bound is returned */
+static double probe_index_max(struct probe_index *pi, double x, double y,
+	double bound)
+{
+	int num = pi->num_groups - 1; /* without the excluded probe */
+	int first = pi->last_max;
+	double max, lb, temp;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		group_bounds(&pi->group[i], x, y, &lb, &pi->bound[i]);
+		if (lb >= bound)
+			return lb;
+	}
+
+	/* neighbour candidates have their maximum at the same group */
+	max = group_max(pi, &pi->group[first], x, y);
+	if (max >= bound)
+		return max;
+	for (i = 0; i < num; i++) {
+		/* the group cannot exceed the current maximum */
+		if (i == first || pi->bound[i] <= max)
+			continue;
+		temp = group_max(pi, &pi->group[i], x, y);
+		if (temp > max) {
+			max = temp;
+			pi->last_max = i;
+			if (max >= bound)
+				return max;
+		}
+	}
+
+	return max;
+}
+
+/* sum of the distances to the radius of all probes, weighted. if the
+ * result reaches the given bound, the search is stopped and a value not
+ * below the bound is returned */
+static double probe_index_sum(struct probe_index *pi, double x, double y,
+	double bound)
+{
+	double sum = 0, rest = 0, lb, ub;
+	int i;
+
+	/* lower bound of the remaining groups */
+	for (i = pi->num_groups - 1; i >= 0; i--) {
+		group_bounds(&pi->group[i], x, y, &lb, &ub);
+		rest += lb * pi->group[i].weight;
+		pi->bound[i] = rest;
+	}
+	if (rest >= bound)
+		return rest;
+
+	for (i = 0; i < pi->num_groups; i++) {
+		sum += group_sum(pi, &pi->group[i], x, y);
+		rest = (i + 1 < pi->num_groups) ? pi->bound[i + 1] : 0;
+		if (sum + rest >= bound)
+			return sum + rest;
+	}
+
+	return sum;
+}
 
 int locate_cell(struct probe *probe_first, double *min_x, double *min_y)
 {
+	struct probe_index pi;
 	struct probe *probe, *min_probe;
 	int i, test_steps, optimized;
-	double min_dist, dist, x, y, rad, temp;
+	double min_dist, dist, x, y, rad;
 	double circle_probe, finetune_radius;
 
 	/* convert meters into degrees */
@@ -73,6 +361,9 @@ int locate_cell(struct probe *probe_first, double *min_x, double *min_y)
 		return -EINVAL;
 	}
 
+	if (probe_index_build(&pi, probe_first, min_probe))
+		return -ENOMEM;
+
 	/* calculate the number of steps to search for destination point */
 	test_steps = 2.0 * 3.1415927 * min_probe->dist / circle_probe;
 	rad = 2.0 * 3.1415927 / test_steps;
@@ -97,20 +388,8 @@ int locate_cell(struct probe *probe_first, double *min_x, double *min_y)
 			fprintf(debug_fp, "%.8f,%.8f\n", debug_long +
 				x * debug_x_scale, debug_lat + y);
 		/* look for greatest distance */
-		dist = 0;
-		probe = probe_first;
-		while (probe) {
-			if (probe != min_probe) {
-				/* distance to the radius */
-				temp = distonplane(probe->x, probe->y, x, y);
-				temp -= probe->dist;
-				if (temp < 0)
-					temp = -temp;
-				if (temp > dist)
-					dist = temp;
-			}
-			probe = probe->next;
-		}
+		dist = probe_index_max(&pi, x, y, (i == 0) ? HUGE_VAL
+			: min_dist);
 		if (i == 0 || dist < min_dist) {
 			min_dist = dist;
 			*min_x = x;
@@ -139,38 +418,27 @@ tune_again:
 
 	/* finetune the point */
 	rad = 2.0 * 3.1415927 / 6;
-	for (i = 0; i < 6; i++) {
-		x = *min_x + finetune_radius * sin(rad * i);
-		y = *min_y + finetune_radius * cos(rad * i);
-		/* search for the point with the lowest sum of distances */
-		dist = 0;
-		probe = probe_first;
-		while (probe) {
-			/* distance to the radius */
-			temp = distonplane(probe->x, probe->y, x, y);
-			temp -= probe->dist;
-			if (temp < 0)
-				temp = -temp;
-			dist += temp;
-			probe = probe->next;
-		}
-		finetune_dist[i] = dist;
-		finetune_x[i] = x;
-		finetune_y[i] = y;
-	}
-
 	optimized = 0;
+	x = *min_x;
+	y = *min_y;
 	for (i = 0; i < 6; i++) {
-		if (finetune_dist[i] < min_dist) {
-			min_dist = finetune_dist[i];
-			*min_x = finetune_x[i];
-			*min_y = finetune_y[i];
+		double tx = x + finetune_radius * sin(rad * i);
+		double ty = y + finetune_radius * cos(rad * i);
+
+		/* search for the point with the lowest sum of distances */
+		dist = probe_index_sum(&pi, tx, ty, min_dist);
+		if (dist < min_dist) {
+			min_dist = dist;
+			*min_x = tx;
+			*min_y = ty;
 			optimized = 1;
 		}
 	}
 	if (optimized)
 		goto tune_again;
 
+	probe_index_free(&pi);
+
 	if (log_debug) {
 		fprintf(debug_fp, "\t\t\t</coordinates>\n");
 		fprintf(debug_fp, "\t\t</LineString>\n");
@@ -2,6 +2,7 @@
 struct probe {
 	struct probe *next;
 	double x, y, dist;
+	double weight; /* number of measurements this probe stands for */
 };
 
 int locate_cell(struct probe *probe_first, double *min_x, double *min_y);
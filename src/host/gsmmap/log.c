@@ -22,8 +22,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
 
 #include <osmocom/bb/common/osmocom_data.h>
+#include <osmocom/bb/misc/cell_log_bin.h>
 
 #include "log.h"
 
@@ -33,6 +38,58 @@ extern struct node_power *node_power_first;
 extern struct node_power **node_power_last_p;
 extern struct node_mcc *node_mcc_first;
 
+/* Index of all cell nodes by their LAC node and cell ID, so that finding
+ * the cell of a measurement does not walk the cell list of its LAC. The
+ * index uses open addressing, a slot without cell is free. */
+struct cell_slot {
+	struct node_lac *lac;
+	struct node_cell *cell;
+};
+
+static struct cell_slot *cell_index;
+static unsigned int cell_index_size, cell_index_used;
+
+static struct cell_slot *cell_slot(struct cell_slot *index, unsigned int size,
+	struct node_lac *lac, uint16_t cellid)
+{
+	uint32_t h;
+
+	h = ((uint32_t)((uintptr_t)lac >> 4) ^ (cellid << 16) ^ cellid)
+		* 0x9e3779b1;
+	h ^= h >> 16;
+	while (1) {
+		h &= size - 1;
+		if (!index[h].cell)
+			return &index[h];
+		if (index[h].lac == lac && index[h].cell->cellid == cellid)
+			return &index[h];
+		h++;
+	}
+}
+
+static int cell_index_grow(void)
+{
+	struct cell_slot *index, *slot;
+	unsigned int size, i;
+
+	size = (cell_index_size) ? cell_index_size * 2 : 1024;
+	index = calloc(size, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+	for (i = 0; i < cell_index_size; i++) {
+		if (!cell_index[i].cell)
+			continue;
+		slot = cell_slot(index, size, cell_index[i].lac,
+			cell_index[i].cell->cellid);
+		*slot = cell_index[i];
+	}
+	free(cell_index);
+	cell_index = index;
+	cell_index_size = size;
+
+	return 0;
+}
+
 struct node_mcc *get_node_mcc(uint16_t mcc)
 {
 	struct node_mcc *node_mcc;
@@ -114,12 +171,19 @@ struct node_cell *get_node_cell(struct node_lac *lac, uint16_t cellid)
 {
 	struct node_cell *node_cell;
 	struct node_cell **node_cell_p = &lac->cell;
+	struct cell_slot *slot;
+
+	/* keep the index at most half full */
+	if (cell_index_used * 2 >= cell_index_size && cell_index_grow())
+		return NULL;
+
+	/* found in index */
+	slot = cell_slot(cell_index, cell_index_size, lac, cellid);
+	if (slot->cell)
+		return slot->cell;
 
+	/* insert into list, only done once per cell */
 	while (*node_cell_p) {
-		/* found in list */
-		if ((*node_cell_p)->cellid == cellid)
-			return *node_cell_p;
-		/* insert into list */
 		if ((*node_cell_p)->cellid > cellid)
 			break;
 		node_cell_p = &((*node_cell_p)->next);
@@ -133,6 +197,9 @@ struct node_cell *get_node_cell(struct node_lac *lac, uint16_t cellid)
 	node_cell->cellid = cellid;
 	node_cell->next = *node_cell_p;
 	*node_cell_p = node_cell;
+	slot->lac = lac;
+	slot->cell = node_cell;
+	cell_index_used++;
 	return node_cell;
 }
 
@@ -160,6 +227,104 @@ struct node_meas *add_node_meas(struct node_cell *cell)
 	return node_meas;
 }
 
+/* get grid square of a position, positions are made positive first, so
+ * that all positions fall into one square if the grid gets coarse */
+static void bin_key(struct node_cell *cell, double longitude, double latitude,
+	int32_t *qlon, int32_t *qlat)
+{
+	double quantum = ldexp(LOG_BIN_QUANTUM, cell->bin_shift);
+
+	*qlon = floor((longitude + 360.0) / quantum);
+	*qlat = floor((latitude + 90.0) / quantum);
+}
+
+/* double the grid size and merge the bins that fall together */
+static void coarsen_bins(struct node_cell *cell)
+{
+	struct node_bin *bin = cell->bin;
+	int i, j, n = 0;
+
+	cell->bin_shift++;
+	for (i = 0; i < cell->bin_num; i++) {
+		bin_key(cell, bin[i].sum_longitude / bin[i].count,
+			bin[i].sum_latitude / bin[i].count, &bin[i].qlon,
+			&bin[i].qlat);
+		for (j = 0; j < n; j++) {
+			if (bin[j].qlon != bin[i].qlon
+			 || bin[j].qlat != bin[i].qlat
+			 || bin[j].ta_valid != bin[i].ta_valid
+			 || bin[j].ta != bin[i].ta)
+				continue;
+			bin[j].count += bin[i].count;
+			bin[j].sum_rxlev += bin[i].sum_rxlev;
+			bin[j].sum_longitude += bin[i].sum_longitude;
+			bin[j].sum_latitude += bin[i].sum_latitude;
+			if (bin[i].gmt < bin[j].gmt)
+				bin[j].gmt = bin[i].gmt;
+			break;
+		}
+		if (j == n)
+			bin[n++] = bin[i];
+	}
+	cell->bin_num = n;
+}
+
+/* add the current measurement to the bins of the cell */
+int add_node_bin(struct node_cell *cell)
+{
+	struct node_bin *bin;
+	int32_t qlon, qlat;
+	uint8_t ta = (sysinfo.ta_valid) ? sysinfo.ta : 0;
+	int i;
+
+	cell->meas_count++;
+	if (!sysinfo.gps_valid)
+		return 0;
+
+again:
+	bin_key(cell, sysinfo.longitude, sysinfo.latitude, &qlon, &qlat);
+	for (i = 0; i < cell->bin_num; i++) {
+		bin = &cell->bin[i];
+		if (bin->qlon == qlon && bin->qlat == qlat
+		 && bin->ta_valid == sysinfo.ta_valid && bin->ta == ta)
+			goto add;
+	}
+
+	/* no bin left, the grid must become coarser */
+	if (cell->bin_num == LOG_BIN_MAX) {
+		while (cell->bin_num == LOG_BIN_MAX)
+			coarsen_bins(cell);
+		goto again;
+	}
+
+	if (cell->bin_num == cell->bin_alloc) {
+		int alloc = (cell->bin_alloc) ? cell->bin_alloc * 2 : 4;
+
+		if (alloc > LOG_BIN_MAX)
+			alloc = LOG_BIN_MAX;
+		bin = realloc(cell->bin, alloc * sizeof(*bin));
+		if (!bin)
+			return -ENOMEM;
+		cell->bin = bin;
+		cell->bin_alloc = alloc;
+	}
+	bin = &cell->bin[cell->bin_num++];
+	memset(bin, 0, sizeof(*bin));
+	bin->qlon = qlon;
+	bin->qlat = qlat;
+	bin->ta_valid = sysinfo.ta_valid;
+	bin->ta = ta;
+	bin->gmt = sysinfo.gmt;
+
+add:
+	bin->count++;
+	bin->sum_rxlev += sysinfo.rxlev;
+	bin->sum_longitude += sysinfo.longitude;
+	bin->sum_latitude += sysinfo.latitude;
+
+	return 0;
+}
+
 /* read "<ncc>,<bcc>" */
 static void read_log_bsic(char *buffer)
 {
@@ -375,3 +540,119 @@ int read_log(FILE *infp)
 	return type;
 }
 
+
+/* check for the magic of a binary log, rewind if there is none */
+int log_is_binary(FILE *infp)
+{
+	char magic[CELL_LOG_BIN_MAGIC_LEN];
+
+	if (fread(magic, sizeof(magic), 1, infp) == 1
+	 && !memcmp(magic, CELL_LOG_BIN_MAGIC, sizeof(magic)))
+		return 1;
+
+	rewind(infp);
+	return 0;
+}
+
+/* read time and position, common to all binary records */
+static void read_log_bin_common(const uint8_t *p, uint8_t flags,
+	time_t *gmt, double *longitude, double *latitude, uint8_t *valid)
+{
+	*gmt = cell_log_bin_get64(p);
+	if (!(flags & CELL_LOG_BIN_F_GPS))
+		return;
+	*longitude = (int32_t)cell_log_bin_get32(p + 8) /
+		CELL_LOG_BIN_POS_SCALE;
+	*latitude = (int32_t)cell_log_bin_get32(p + 12) /
+		CELL_LOG_BIN_POS_SCALE;
+	*valid = 1;
+}
+
+static int read_log_bin_sysinfo(uint8_t flags, const uint8_t *p, int len)
+{
+	uint8_t *si[6] = { sysinfo.si1, sysinfo.si2, sysinfo.si2bis,
+		sysinfo.si2ter, sysinfo.si3, sysinfo.si4 };
+	const uint8_t *end = p + len;
+	uint8_t mask;
+	int i;
+
+	memset(&sysinfo, 0, sizeof(sysinfo));
+	if (len < CELL_LOG_BIN_COMMON_LEN + 6)
+		return -EINVAL;
+	read_log_bin_common(p, flags, &sysinfo.gmt, &sysinfo.longitude,
+		&sysinfo.latitude, &sysinfo.gps_valid);
+	p += CELL_LOG_BIN_COMMON_LEN;
+
+	sysinfo.arfcn = cell_log_bin_get16(p);
+	sysinfo.rxlev = p[2];
+	sysinfo.bsic = p[3];
+	if ((flags & CELL_LOG_BIN_F_TA)) {
+		sysinfo.ta_valid = 1;
+		sysinfo.ta = p[4];
+	}
+	mask = p[5];
+	p += 6;
+
+	for (i = 0; i < 6; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+		if (p + 23 > end)
+			return -EINVAL;
+		memcpy(si[i], p, 23);
+		p += 23;
+	}
+
+	return 0;
+}
+
+static void read_log_bin_power(uint8_t flags, const uint8_t *p, int len)
+{
+	const uint8_t *end = p + len;
+	int arfcn, count;
+
+	read_log_bin_common(p, flags, &power.gmt, &power.longitude,
+		&power.latitude, &power.gps_valid);
+	p += CELL_LOG_BIN_COMMON_LEN;
+
+	while (p + 4 <= end) {
+		arfcn = cell_log_bin_get16(p);
+		count = cell_log_bin_get16(p + 2);
+		p += 4;
+		if (arfcn + count > 1024 || p + count > end)
+			break;
+		memcpy(power.rxlev + arfcn, p, count);
+		p += count;
+	}
+}
+
+/* read next record from binary log file */
+int read_log_bin(FILE *infp)
+{
+	uint8_t hdr[CELL_LOG_BIN_HDR_LEN], payload[CELL_LOG_BIN_MAX_LEN];
+	int len;
+
+	memset(&sysinfo, 0, sizeof(sysinfo));
+	memset(&power, 0, sizeof(power));
+	memset(&power.rxlev, -128, sizeof(power.rxlev));
+
+	while (fread(hdr, sizeof(hdr), 1, infp) == 1) {
+		len = cell_log_bin_get16(hdr + 2);
+		if (len > sizeof(payload))
+			break; /* corrupt */
+		if (len && fread(payload, len, 1, infp) != 1)
+			break; /* truncated */
+		if (len < CELL_LOG_BIN_COMMON_LEN)
+			continue;
+		switch (hdr[0]) {
+		case CELL_LOG_BIN_SYSINFO:
+			if (read_log_bin_sysinfo(hdr[1], payload, len))
+				break;
+			return LOG_TYPE_SYSINFO;
+		case CELL_LOG_BIN_POWER:
+			read_log_bin_power(hdr[1], payload, len);
+			return LOG_TYPE_POWER;
+		}
+	}
+
+	return LOG_TYPE_NONE;
+}
@@ -57,6 +57,13 @@ struct node_cell {
 	uint16_t cellid;
 	uint8_t content; /* indicates, if sysinfo is already applied */
 	struct node_meas *meas, **meas_last_p;
+	/* aggregated measurements, used instead of meas in stream mode */
+	struct node_bin *bin;
+	int bin_num, bin_alloc, bin_shift;
+	unsigned long meas_count;
+	/* location, kept from locating until the output */
+	uint8_t located, known;
+	double longitude, latitude;
 	struct sysinfo sysinfo;
 	struct gsm48_sysinfo s;
 };
@@ -71,10 +78,30 @@ struct node_meas {
 	uint8_t ta;
 };
 
+/* Measurements of a cell, aggregated on a grid of positions. Measurements
+ * in the same grid square with the same TA fall into the same bin. If a
+ * cell has more than LOG_BIN_MAX bins, the grid is made coarser, so the
+ * memory used per cell is bounded. */
+#define LOG_BIN_MAX	128
+#define LOG_BIN_QUANTUM	0.0001 /* degrees, grid size at bin_shift 0 */
+
+struct node_bin {
+	int32_t qlon, qlat; /* grid square */
+	uint8_t ta_valid;
+	uint8_t ta;
+	uint32_t count;
+	int64_t sum_rxlev;
+	double sum_longitude, sum_latitude;
+	time_t gmt; /* first measurement */
+};
+
 struct node_mcc *get_node_mcc(uint16_t mcc);
 struct node_mnc *get_node_mnc(struct node_mcc *mcc, uint16_t mnc);
 struct node_lac *get_node_lac(struct node_mnc *mnc, uint16_t lac);
 struct node_cell *get_node_cell(struct node_lac *lac, uint16_t cellid);
 struct node_meas *add_node_meas(struct node_cell *cell);
+int add_node_bin(struct node_cell *cell);
 int read_log(FILE *infp);
+int log_is_binary(FILE *infp);
+int read_log_bin(FILE *infp);
 
@@ -57,6 +57,9 @@ struct osmocom_ms {
 	struct llist_head entity;
 	char name[32];
 	struct osmo_wqueue l2_wq, sap_wq;
+	/* L1CTL stream read from l2_wq, not yet split into frames */
+	uint8_t *l2_rbuf;
+	unsigned int l2_rbuf_len;
 	uint16_t test_arfcn;
 	struct osmol1_entity l1_entity;
 
@@ -1,6 +1,9 @@
 #ifndef _SYSINFO_H
 #define _SYSINFO_H
 
+#include <stdint.h>
+#include <string.h>
+
 #include <osmocom/gsm/gsm48_ie.h>
 
 /* collection of system information of the current cell */
@@ -17,6 +20,87 @@
 #define	FREQ_TYPE_REP_5bis	0x40 /* sub channel of SI 5bis */
 #define	FREQ_TYPE_REP_5ter	0x80 /* sub channel of SI 5ter */
 
+/* set of frequencies (ARFCN 0..1023), one bit for each frequency */
+struct gsm_freq_set {
+	uint64_t			w[16];
+};
+
+static inline void gsm_freq_set_clear(struct gsm_freq_set *fs)
+{
+	memset(fs, 0, sizeof(*fs));
+}
+
+static inline void gsm_freq_set_add(struct gsm_freq_set *fs, uint16_t arfcn)
+{
+	fs->w[(arfcn >> 6) & 15] |= 1ULL << (arfcn & 63);
+}
+
+static inline int gsm_freq_set_has(const struct gsm_freq_set *fs,
+	uint16_t arfcn)
+{
+	return (fs->w[(arfcn >> 6) & 15] >> (arfcn & 63)) & 1;
+}
+
+static inline void gsm_freq_set_or(struct gsm_freq_set *fs,
+	const struct gsm_freq_set *other)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		fs->w[i] |= other->w[i];
+}
+
+static inline int gsm_freq_set_count(const struct gsm_freq_set *fs)
+{
+	int i, n = 0;
+
+	for (i = 0; i < 16; i++)
+		n += __builtin_popcountll(fs->w[i]);
+
+	return n;
+}
+
+/* return the first frequency >= arfcn in the set, -1 if there is none */
+static inline int gsm_freq_set_next(const struct gsm_freq_set *fs, int arfcn)
+{
+	int i = arfcn >> 6;
+	uint64_t w;
+
+	if (arfcn >= 1024)
+		return -1;
+	w = fs->w[i] & (~0ULL << (arfcn & 63));
+	while (!w) {
+		if (++i == 16)
+			return -1;
+		w = fs->w[i];
+	}
+
+	return (i << 6) + __builtin_ctzll(w);
+}
+
+/* same, but in the order of frequency lists: 1..1023, then 0 as 1024 */
+static inline int gsm_freq_set_list_next(const struct gsm_freq_set *fs,
+	int i)
+{
+	int n = (i <= 1023) ? gsm_freq_set_next(fs, i) : -1;
+
+	if (n >= 0)
+		return n;
+	if (i <= 1024 && gsm_freq_set_has(fs, 0))
+		return 1024;
+
+	return -1;
+}
+
+#define gsm_freq_set_for_each(arfcn, fs) \
+	for (arfcn = gsm_freq_set_next(fs, 0); arfcn >= 0; \
+	     arfcn = gsm_freq_set_next(fs, arfcn + 1))
+
+/* 'i' runs 1..1024, use 'i & 1023' as ARFCN */
+#define gsm_freq_set_for_each_list(i, fs) \
+	for (i = gsm_freq_set_list_next(fs, 1); i >= 0; \
+	     i = gsm_freq_set_list_next(fs, i + 1))
+
 /* structure of all received system informations */
 struct gsm48_sysinfo {
 	/* flags of available information */
@@ -35,7 +119,8 @@ struct gsm48_sysinfo {
 	uint8_t				si5t_msg[18];
 	uint8_t				si6_msg[18];
 
-	struct	gsm_sysinfo_freq	freq[1024]; /* all frequencies */
+	struct gsm_freq_set		freq[8]; /* one set for each
+							FREQ_TYPE_* bit */
 	uint16_t			hopping[64]; /* hopping arfcn */
 	uint8_t				hopp_len;
 
@@ -120,6 +205,22 @@ struct gsm48_sysinfo {
 	uint16_t			nb_class_barr; /* bit 10 is emergency */
 };
 
+/* set of frequencies of a single FREQ_TYPE_* bit */
+#define FREQ_SET(s, type)	(&(s)->freq[__builtin_ctz(type)])
+
+/* get the union of the sets of all FREQ_TYPE_* bits in mask */
+static inline void gsm48_sysinfo_freq_get(struct gsm_freq_set *fs,
+	const struct gsm48_sysinfo *s, uint8_t mask)
+{
+	int t;
+
+	gsm_freq_set_clear(fs);
+	for (t = 0; t < 8; t++) {
+		if ((mask & (1 << t)))
+			gsm_freq_set_or(fs, &s->freq[t]);
+	}
+}
+
 char *gsm_print_arfcn(uint16_t arfcn);
 uint8_t gsm_refer_pcs(uint16_t arfcn, struct gsm48_sysinfo *s);
 int gsm48_sysinfo_dump(struct gsm48_sysinfo *s, uint16_t arfcn,
@@ -151,7 +252,9 @@ int gsm48_decode_sysinfo5ter(struct gsm48_sysinfo *s,
 		struct gsm48_system_information_type_5ter *si, int len);
 int gsm48_decode_sysinfo6(struct gsm48_sysinfo *s,
 		struct gsm48_system_information_type_6 *si, int len);
-int gsm48_decode_mobile_alloc(struct gsm_sysinfo_freq *freq,
+int gsm48_decode_freq_set(struct gsm_freq_set *fs, uint8_t *cd,
+	uint8_t len, uint8_t mask);
+int gsm48_decode_mobile_alloc(struct gsm48_sysinfo *s,
 	uint8_t *ma, uint8_t len, uint16_t *hopping, uint8_t *hopp_len,
 	int si4);
 int gsm48_encode_lai_hex(struct gsm48_loc_area_id *lai, uint16_t mcc,
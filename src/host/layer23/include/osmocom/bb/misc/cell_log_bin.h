@@ -0,0 +1,85 @@
+#ifndef _CELL_LOG_BIN_H
+#define _CELL_LOG_BIN_H
+
+/* Binary format of the cell log, as written by cell_log --binary and
+ * read by gsmmap.
+ *
+ * The file starts with CELL_LOG_BIN_MAGIC, followed by records. Each
+ * record has a 4 byte header (type, flags, payload length) and a
+ * payload. Readers skip records of unknown type. All fields are little
+ * endian, positions are stored in units of 1e-7 degrees.
+ *
+ * Common payload part of all records (16 bytes):
+ *	uint64 time, int32 longitude, int32 latitude
+ *
+ * CELL_LOG_BIN_SYSINFO payload after the common part (6 bytes):
+ *	uint16 arfcn, int8 rxlev, uint8 bsic, uint8 ta, uint8 si mask
+ * followed by one 23 byte message for each bit set in the si mask.
+ *
+ * CELL_LOG_BIN_POWER payload after the common part:
+ *	runs of uint16 arfcn, uint16 count, int8 rxlev[count]
+ */
+
+#include <stdint.h>
+
+#define CELL_LOG_BIN_MAGIC	"OBBCLOG1"
+#define CELL_LOG_BIN_MAGIC_LEN	8
+
+#define CELL_LOG_BIN_HDR_LEN	4
+#define CELL_LOG_BIN_COMMON_LEN	16
+#define CELL_LOG_BIN_MAX_LEN	4096
+
+enum cell_log_bin_type {
+	CELL_LOG_BIN_SYSINFO	= 1,
+	CELL_LOG_BIN_POWER	= 2,
+};
+
+/* record flags */
+#define CELL_LOG_BIN_F_GPS	0x01	/* position is valid */
+#define CELL_LOG_BIN_F_TA	0x02	/* timing advance is valid */
+
+/* bits of the si mask, also the order of the messages */
+#define CELL_LOG_BIN_SI1	0x01
+#define CELL_LOG_BIN_SI2	0x02
+#define CELL_LOG_BIN_SI2bis	0x04
+#define CELL_LOG_BIN_SI2ter	0x08
+#define CELL_LOG_BIN_SI3	0x10
+#define CELL_LOG_BIN_SI4	0x20
+
+#define CELL_LOG_BIN_POS_SCALE	10000000.0
+
+static inline uint8_t *cell_log_bin_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static inline uint8_t *cell_log_bin_put32(uint8_t *p, uint32_t v)
+{
+	p = cell_log_bin_put16(p, v);
+	return cell_log_bin_put16(p, v >> 16);
+}
+
+static inline uint8_t *cell_log_bin_put64(uint8_t *p, uint64_t v)
+{
+	p = cell_log_bin_put32(p, v);
+	return cell_log_bin_put32(p, v >> 32);
+}
+
+static inline uint16_t cell_log_bin_get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t cell_log_bin_get32(const uint8_t *p)
+{
+	return cell_log_bin_get16(p) | ((uint32_t)cell_log_bin_get16(p + 2) << 16);
+}
+
+static inline uint64_t cell_log_bin_get64(const uint8_t *p)
+{
+	return cell_log_bin_get32(p) | ((uint64_t)cell_log_bin_get32(p + 4) << 32);
+}
+
+#endif /* _CELL_LOG_BIN_H */
@@ -100,11 +100,35 @@ struct gsm322_ba_list {
 #define GSM322_CS_FLAG_FORBIDD	0x40 /* cell in list of forbidden LAs */
 #define GSM322_CS_FLAG_TEMP_AA	0x80 /* if temporary available and allowable */
 
+#define GSM322_CACHE_SI1	0x01
+#define GSM322_CACHE_SI2	0x02
+#define GSM322_CACHE_SI2bis	0x04
+#define GSM322_CACHE_SI2ter	0x08
+#define GSM322_CACHE_SI3	0x10
+#define GSM322_CACHE_SI4	0x20
+
+/* Cached cell, as stored in the cell cache file after a header. The record
+ * has a fixed size and is written in host byte order, so the file can be
+ * mapped and read directly.
+ */
+struct gsm322_cell_cache {
+	uint16_t		arfcn; /* with ARFCN_PCS flag */
+	uint8_t			bsic;
+	uint8_t			rxlev; /* rx level range format */
+	uint8_t			si_mask; /* see GSM322_CACHE_SI* */
+	uint8_t			spare[3];
+	uint64_t		time; /* when the sysinfo was last received */
+	uint8_t			si1[23], si2[23], si2bis[23], si2ter[23];
+	uint8_t			si3[23], si4[23];
+	uint8_t			spare2[6];
+};
+
 /* Cell selection list */
 struct gsm322_cs_list {
 	uint8_t			flags; /* see GSM322_CS_FLAG_* */
 	uint8_t			rxlev; /* rx level range format */
 	struct gsm48_sysinfo	*sysinfo;
+	struct gsm322_cell_cache *cache; /* sysinfo cached by last run */
 };
 
 /* PLMN search process */
@@ -170,6 +194,10 @@ struct gsm322_cellsel {
 	uint8_t			powerscan; /* currently scanning for power */
 	uint8_t			ccch_state; /* special state of current ccch */
 	uint32_t		scan_state; /* special state of current scan */
+	uint16_t		scan_list[1024+299]; /* frequencies with signal,
+						strongest first */
+	uint16_t		scan_num, scan_pos; /* entries / next entry */
+	uint8_t			cache_used; /* cached sysinfo was checked */
 	uint16_t		arfcn; /* current tuned idle mode arfcn */
 	int			arfci; /* list index of frequency above */
 	uint8_t			ccch_mode; /* curren CCCH_MODE_* */
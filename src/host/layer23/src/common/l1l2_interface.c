@@ -27,8 +27,10 @@
 #include <osmocom/bb/common/l1l2_interface.h>
 
 #include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 #include <arpa/inet.h>
@@ -42,61 +44,135 @@
 #define GSM_L2_LENGTH 256
 #define GSM_L2_HEADROOM 32
 
+/* room for many frames, so a single read() drains a burst from L1 */
+#define GSM_L2_RBUF_SIZE 16384
+/* maximum number of queued frames written with one writev() */
+#define GSM_L2_WRITE_IOV 32
+
 static int layer2_read(struct osmo_fd *fd)
 {
+	struct osmocom_ms *ms = fd->data;
+	uint8_t *buf = ms->l2_rbuf;
+	unsigned int pos = 0;
 	struct msgb *msg;
 	uint16_t len;
 	int rc;
 
-	msg = msgb_alloc_headroom(GSM_L2_LENGTH+GSM_L2_HEADROOM, GSM_L2_HEADROOM, "Layer2");
-	if (!msg) {
-		LOGP(DL1C, LOGL_ERROR, "Failed to allocate msg.\n");
-		return -ENOMEM;
-	}
-
-	rc = read(fd->fd, &len, sizeof(len));
-	if (rc < sizeof(len)) {
+	rc = read(fd->fd, buf + ms->l2_rbuf_len,
+		  GSM_L2_RBUF_SIZE - ms->l2_rbuf_len);
+	if (rc <= 0) {
+		if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+			return 0;
 		fprintf(stderr, "Layer2 socket failed\n");
-		msgb_free(msg);
-		if (rc >= 0)
+		if (rc == 0)
 			rc = -EIO;
-		layer2_close((struct osmocom_ms *) fd->data);
+		layer2_close(ms);
 		return rc;
 	}
+	ms->l2_rbuf_len += rc;
+	rc = 0;
+
+	/* pass on all complete frames, keep a partial one for later */
+	while (ms->l2_rbuf_len - pos >= sizeof(len)) {
+		len = buf[pos] << 8 | buf[pos + 1];
+		if (len > GSM_L2_LENGTH) {
+			LOGP(DL1C, LOGL_ERROR, "Length is too big: %u\n", len);
+			/* there is no way to find the next frame */
+			layer2_close(ms);
+			return -EINVAL;
+		}
+		if (ms->l2_rbuf_len - pos < sizeof(len) + len)
+			break;
+
+		msg = msgb_alloc_headroom(GSM_L2_LENGTH+GSM_L2_HEADROOM,
+					  GSM_L2_HEADROOM, "Layer2");
+		if (!msg) {
+			LOGP(DL1C, LOGL_ERROR, "Failed to allocate msg.\n");
+			rc = -ENOMEM;
+			break;
+		}
+		msg->l1h = msgb_put(msg, len);
+		memcpy(msg->l1h, buf + pos + sizeof(len), len);
+		pos += sizeof(len) + len;
+
+		l1ctl_recv(ms, msg);
+
+		/* the socket may have been closed by the upper layers */
+		if (fd->fd < 0)
+			return 0;
+	}
 
-	len = ntohs(len);
-	if (len > GSM_L2_LENGTH) {
-		LOGP(DL1C, LOGL_ERROR, "Length is too big: %u\n", len);
-		msgb_free(msg);
+	ms->l2_rbuf_len -= pos;
+	if (ms->l2_rbuf_len)
+		memmove(buf, buf + pos, ms->l2_rbuf_len);
+
+	return rc;
+}
+
+/* write as many queued frames as possible with a single syscall */
+static int layer2_write(struct osmo_fd *fd)
+{
+	struct osmo_wqueue *wq = container_of(fd, struct osmo_wqueue, bfd);
+	struct iovec iov[GSM_L2_WRITE_IOV];
+	struct msgb *msg, *msg2;
+	int n = 0;
+	ssize_t rc;
+
+	if (fd->fd <= 0)
 		return -EINVAL;
-	}
 
+	llist_for_each_entry(msg, &wq->msg_queue, list) {
+		iov[n].iov_base = msg->data;
+		iov[n].iov_len = msg->len;
+		if (++n == GSM_L2_WRITE_IOV)
+			break;
+	}
+	if (!n)
+		return 0;
 
-	msg->l1h = msgb_put(msg, len);
-	rc = read(fd->fd, msg->l1h, msgb_l1len(msg));
-	if (rc != msgb_l1len(msg)) {
-		LOGP(DL1C, LOGL_ERROR, "Can not read data: len=%d rc=%d "
-		     "errno=%d\n", len, rc, errno);
+	rc = writev(fd->fd, iov, n);
+	if (rc < 0) {
+		rc = -errno;
+		if (rc == -EAGAIN || rc == -EINTR)
+			return 0;
+		LOGP(DL1C, LOGL_ERROR, "Failed to write data: rc: %d\n",
+		     (int) rc);
+		/* drop the frame, as a single write() did before */
+		msg = msgb_dequeue(&wq->msg_queue);
+		wq->current_length--;
 		msgb_free(msg);
 		return rc;
 	}
 
-	l1ctl_recv((struct osmocom_ms *) fd->data, msg);
+	/* release what went out completely, a partial frame stays queued */
+	llist_for_each_entry_safe(msg, msg2, &wq->msg_queue, list) {
+		if (rc < msg->len) {
+			msgb_pull(msg, rc);
+			break;
+		}
+		rc -= msg->len;
+		llist_del(&msg->list);
+		wq->current_length--;
+		msgb_free(msg);
+	}
 
 	return 0;
 }
 
-static int layer2_write(struct osmo_fd *fd, struct msgb *msg)
+static int layer2_cb(struct osmo_fd *fd, unsigned int what)
 {
-	int rc;
+	struct osmo_wqueue *wq = container_of(fd, struct osmo_wqueue, bfd);
 
-	if (fd->fd <= 0)
-		return -EINVAL;
+	if (what & BSC_FD_READ) {
+		layer2_read(fd);
+		if (fd->fd < 0)
+			return 0;
+	}
 
-	rc = write(fd->fd, msg->data, msg->len);
-	if (rc != msg->len) {
-		LOGP(DL1C, LOGL_ERROR, "Failed to write data: rc: %d\n", rc);
-		return rc;
+	if (what & BSC_FD_WRITE) {
+		layer2_write(fd);
+		if (llist_empty(&wq->msg_queue))
+			osmo_fd_update_when(fd, fd->when & ~BSC_FD_WRITE);
 	}
 
 	return 0;
@@ -126,11 +202,20 @@ int layer2_open(struct osmocom_ms *ms, const char *socket_path)
 		return rc;
 	}
 
+	if (!ms->l2_rbuf)
+		ms->l2_rbuf = talloc_size(ms, GSM_L2_RBUF_SIZE);
+	if (!ms->l2_rbuf) {
+		close(ms->l2_wq.bfd.fd);
+		return -ENOMEM;
+	}
+	ms->l2_rbuf_len = 0;
+
 	osmo_wqueue_init(&ms->l2_wq, 100);
 	ms->l2_wq.bfd.data = ms;
 	ms->l2_wq.bfd.when = BSC_FD_READ;
 	ms->l2_wq.read_cb = layer2_read;
-	ms->l2_wq.write_cb = layer2_write;
+	/* frames are written in batches by layer2_cb(), not one by one */
+	ms->l2_wq.bfd.cb = layer2_cb;
 
 	rc = osmo_fd_register(&ms->l2_wq.bfd);
 	if (rc != 0) {
@@ -147,9 +232,9 @@ int layer2_close(struct osmocom_ms *ms)
 	if (ms->l2_wq.bfd.fd <= 0)
 		return -EINVAL;
 
+	osmo_fd_unregister(&ms->l2_wq.bfd);
 	close(ms->l2_wq.bfd.fd);
 	ms->l2_wq.bfd.fd = -1;
-	osmo_fd_unregister(&ms->l2_wq.bfd);
 	osmo_wqueue_clear(&ms->l2_wq);
 
 	return 0;
@@ -211,8 +211,11 @@ void sighandler(int sigset)
 	if (l23_app_exit)
 		rc = l23_app_exit(ms);
 
-	if (rc != -EBUSY)
+	if (rc != -EBUSY) {
+		if (gsmtap_inst)
+			gsmtap_flush(gsmtap_inst);
 		exit (0);
+	}
 }
 
 static void print_copyright()
@@ -274,7 +277,8 @@ int main(int argc, char **argv)
 		exit(1);
 
 	if (gsmtap_ip) {
-		gsmtap_inst = gsmtap_source_init(gsmtap_ip, GSMTAP_UDP_PORT, 1);
+		gsmtap_inst = gsmtap_source_init(gsmtap_ip, GSMTAP_UDP_PORT,
+						 GSMTAP_MODE_BATCH);
 		if (!gsmtap_inst) {
 			fprintf(stderr, "Failed during gsmtap_init()\n");
 			exit(1);
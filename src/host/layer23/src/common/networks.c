@@ -1,6 +1,9 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include <osmocom/bb/common/networks.h>
 
@@ -1774,6 +1777,191 @@ struct gsm_networks gsm_networks[] = {
 	{ 0, 0, NULL }
 };
 
+/*
+ * index of the network list
+ *
+ * An open addressing hash table, built on first use, maps (MCC, MNC) to
+ * the first matching entry of the list. Country entries are found with
+ * MNC 0xffff (-1), the first entry of an MCC at all with MNC 0xfffe.
+ */
+
+#define NET_MNC_COUNTRY		0xffff
+#define NET_MNC_ANY		0xfffe
+
+struct net_slot {
+	uint32_t	key;
+	uint16_t	idx;	/* first entry with this key */
+	uint16_t	count;	/* number of entries with this key, 0 = free */
+};
+
+/* current list, the compiled in one or one read by gsm_networks_load() */
+static const struct gsm_networks *networks = gsm_networks;
+static struct gsm_networks *networks_loaded;
+static int networks_loaded_num;
+
+static struct net_slot *net_hash;
+static int net_hash_bits;
+
+static inline struct net_slot *net_slot(uint16_t mcc, uint16_t mnc)
+{
+	uint32_t key = ((uint32_t)mcc << 16) | mnc;
+	uint32_t mask = (1 << net_hash_bits) - 1;
+	uint32_t i = (key * 0x9e3779b1) >> (32 - net_hash_bits);
+
+	while (net_hash[i].count && net_hash[i].key != key)
+		i = (i + 1) & mask;
+
+	return &net_hash[i];
+}
+
+static void net_index_add(uint16_t mcc, uint16_t mnc, int idx)
+{
+	struct net_slot *slot = net_slot(mcc, mnc);
+
+	if (!slot->count) {
+		slot->key = ((uint32_t)mcc << 16) | mnc;
+		slot->idx = idx;
+	}
+	slot->count++;
+}
+
+static int net_index_build(void)
+{
+	int i, num, bits;
+
+	for (num = 0; networks[num].name; num++)
+		;
+
+	/* two keys per entry, keep the load below 1/2 */
+	for (bits = 4; (1 << bits) < num * 2 * 2; bits++)
+		;
+
+	free(net_hash);
+	net_hash = calloc(1 << bits, sizeof(*net_hash));
+	if (!net_hash)
+		return -ENOMEM;
+	net_hash_bits = bits;
+
+	for (i = 0; i < num; i++) {
+		net_index_add(networks[i].mcc, NET_MNC_ANY, i);
+		/* a country entry has mnc -1, so it gets NET_MNC_COUNTRY */
+		net_index_add(networks[i].mcc, networks[i].mnc, i);
+	}
+
+	return 0;
+}
+
+static const struct net_slot *net_lookup(uint16_t mcc, uint16_t mnc)
+{
+	struct net_slot *slot;
+
+	if (!net_hash && net_index_build() < 0)
+		return NULL;
+
+	slot = net_slot(mcc, mnc);
+	if (!slot->count)
+		return NULL;
+
+	return slot;
+}
+
+/* read a network list, replacing the compiled in one
+ *
+ * Each line holds "<mcc> <mnc> <name>", where <mnc> is "-" for the name
+ * of the country. Empty lines and lines starting with '#' are ignored.
+ * Returns the number of entries read or a negative error code.
+ */
+int gsm_networks_load(const char *path)
+{
+	struct gsm_networks *list = NULL, *tmp;
+	char line[256], mcc_str[8], mnc_str[8];
+	int num = 0, alloc = 0, lineno = 0, n, i, rc;
+	uint16_t mcc, mnc;
+	char *p, *name;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return -errno;
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		for (p = line; isspace(*p); p++)
+			;
+		if (!*p || *p == '#')
+			continue;
+		if (sscanf(p, "%7s %7s %n", mcc_str, mnc_str, &n) < 2)
+			goto inval;
+		name = p + n;
+		name[strcspn(name, "\r\n")] = '\0';
+		if (!*name)
+			goto inval;
+
+		mcc = gsm_input_mcc(mcc_str);
+		if (mcc == GSM_INPUT_INVALID)
+			goto inval;
+		if (!strcmp(mnc_str, "-"))
+			mnc = NET_MNC_COUNTRY;
+		else {
+			mnc = gsm_input_mnc(mnc_str);
+			if (mnc == GSM_INPUT_INVALID || !mnc)
+				goto inval;
+		}
+
+		/* keep room for the terminating entry */
+		if (num + 1 >= alloc) {
+			alloc = alloc ? alloc * 2 : 256;
+			tmp = realloc(list, alloc * sizeof(*list));
+			if (!tmp) {
+				rc = -ENOMEM;
+				goto error;
+			}
+			list = tmp;
+		}
+		list[num].mcc = mcc;
+		list[num].mnc = mnc;
+		list[num].name = strdup(name);
+		if (!list[num].name) {
+			rc = -ENOMEM;
+			goto error;
+		}
+		num++;
+	}
+	fclose(fp);
+
+	if (!num) {
+		free(list);
+		return -EINVAL;
+	}
+	list[num].mcc = 0;
+	list[num].mnc = 0;
+	list[num].name = NULL;
+
+	/* replace the current list */
+	for (i = 0; i < networks_loaded_num; i++)
+		free((char *)networks_loaded[i].name);
+	free(networks_loaded);
+	networks_loaded = list;
+	networks_loaded_num = num;
+	networks = list;
+
+	rc = net_index_build();
+	if (rc < 0)
+		return rc;
+
+	return num;
+
+inval:
+	fprintf(stderr, "%s:%d: invalid network entry\n", path, lineno);
+	rc = -EINVAL;
+error:
+	fclose(fp);
+	for (i = 0; i < num; i++)
+		free((char *)list[i].name);
+	free(list);
+	return rc;
+}
+
 /* GSM 03.22 Annex A */
 int gsm_match_mcc(uint16_t mcc, char *imsi)
 {
@@ -1902,22 +2090,25 @@ const uint16_t gsm_input_mnc(char *string)
 
 const char *gsm_get_mcc(uint16_t mcc)
 {
-	int i;
+	const struct net_slot *slot;
 
-	for (i = 0; gsm_networks[i].name; i++)
-		if (gsm_networks[i].mnc < 0 && gsm_networks[i].mcc == mcc)
-			return gsm_networks[i].name;
+	slot = net_lookup(mcc, NET_MNC_COUNTRY);
+	if (slot)
+		return networks[slot->idx].name;
 
 	return gsm_print_mcc(mcc);
 }
 
 const char *gsm_get_mnc(uint16_t mcc, uint16_t mnc)
 {
-	int i;
+	const struct net_slot *slot;
 
-	for (i = 0; gsm_networks[i].name; i++)
-		if (gsm_networks[i].mcc == mcc && gsm_networks[i].mnc == mnc)
-			return gsm_networks[i].name;
+	/* neither a country entry nor the first entry of the MCC */
+	if (mnc < NET_MNC_ANY) {
+		slot = net_lookup(mcc, mnc);
+		if (slot)
+			return networks[slot->idx].name;
+	}
 
 	return gsm_print_mnc(mnc);
 }
@@ -1925,29 +2116,25 @@ const char *gsm_get_mnc(uint16_t mcc, uint16_t mnc)
 /* get MCC from IMSI */
 const char *gsm_imsi_mcc(char *imsi)
 {
-	int i, found = 0;
+	const struct net_slot *slot;
 	uint16_t mcc;
 
 	mcc = ((imsi[0] - '0') << 8)
 	    | ((imsi[1] - '0') << 4)
 	    | ((imsi[2] - '0'));
 
-	for (i = 0; gsm_networks[i].name; i++) {
-		if (gsm_networks[i].mcc == mcc) {
-			found = 1;
-			break;
-		}
-	}
-	if (found == 0)
+	slot = net_lookup(mcc, NET_MNC_ANY);
+	if (!slot)
 		return "Unknown";
 
-	return gsm_networks[i].name;
+	return networks[slot->idx].name;
 }
 
 /* get MNC from IMSI */
 const char *gsm_imsi_mnc(char *imsi)
 {
-	int i, found = 0, position = 0;
+	const struct net_slot *slot2 = NULL, *slot3 = NULL;
+	int found = 0;
 	uint16_t mcc, mnc2, mnc3;
 
 	mcc = ((imsi[0] - '0') << 8)
@@ -1960,27 +2147,24 @@ const char *gsm_imsi_mnc(char *imsi)
 	     + ((imsi[4] - '0') << 4)
 	     + imsi[5] - '0';
 
-	for (i = 0; gsm_networks[i].name; i++) {
-		if (gsm_networks[i].mcc != mcc)
-			continue;
-		if ((gsm_networks[i].mnc & 0x00f) == 0x00f) {
-			if (mnc2 == gsm_networks[i].mnc) {
-				found++;
-				position = i;
-			}
-		} else {
-			if (mnc3 == gsm_networks[i].mnc) {
-				found++;
-				position = i;
-			}
-		}
+	/* two digit MNCs match the first two digits only */
+	if (mnc2 < NET_MNC_ANY) {
+		slot2 = net_lookup(mcc, mnc2);
+		if (slot2)
+			found += slot2->count;
+	}
+	if ((mnc3 & 0x00f) != 0x00f && mnc3 < NET_MNC_ANY) {
+		slot3 = net_lookup(mcc, mnc3);
+		if (slot3)
+			found += slot3->count;
 	}
 
 	if (found == 0)
 		return "Unknown";
 	if (found > 1)
 		return "Ambiguous";
-	return gsm_networks[position].name;
+	if (slot2)
+		return networks[slot2->idx].name;
+	return networks[slot3->idx].name;
 }
 
-
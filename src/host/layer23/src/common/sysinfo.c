@@ -73,6 +73,10 @@ int gsm48_sysinfo_dump(struct gsm48_sysinfo *s, uint16_t arfcn,
 	char buffer[81];
 	int i, j, k, index;
 	int refer_pcs = gsm_refer_pcs(arfcn, s);
+	struct gsm_freq_set ncell, rep;
+
+	gsm48_sysinfo_freq_get(&ncell, s, FREQ_TYPE_NCELL);
+	gsm48_sysinfo_freq_get(&rep, s, FREQ_TYPE_REP);
 
 	/* available sysinfos */
 	print(priv, "ARFCN = %s  channels 512+ refer to %s\n",
@@ -104,68 +108,62 @@ int gsm48_sysinfo_dump(struct gsm48_sysinfo *s, uint16_t arfcn,
 
 	/* frequency list */
 	j = 0; k = 0;
-	for (i = 0; i < 1024; i++) {
-		if ((s->freq[i].mask & FREQ_TYPE_SERV)) {
-			if (!k) {
-				sprintf(buffer, "serv. cell  : ");
-				j = strlen(buffer);
-			}
-			if (j >= 75) {
-				buffer[j - 1] = '\0';
-				print(priv, "%s\n", buffer);
-				sprintf(buffer, "              ");
-				j = strlen(buffer);
-			}
-			sprintf(buffer + j, "%d,", i);
+	gsm_freq_set_for_each(i, FREQ_SET(s, FREQ_TYPE_SERV)) {
+		if (!k) {
+			sprintf(buffer, "serv. cell  : ");
 			j = strlen(buffer);
-			k++;
 		}
+		if (j >= 75) {
+			buffer[j - 1] = '\0';
+			print(priv, "%s\n", buffer);
+			sprintf(buffer, "              ");
+			j = strlen(buffer);
+		}
+		sprintf(buffer + j, "%d,", i);
+		j = strlen(buffer);
+		k++;
 	}
 	if (j) {
 		buffer[j - 1] = '\0';
 		print(priv, "%s\n", buffer);
 	}
 	j = 0; k = 0;
-	for (i = 0; i < 1024; i++) {
-		if ((s->freq[i].mask & FREQ_TYPE_NCELL)) {
-			if (!k) {
-				sprintf(buffer, "SI2 (neigh.) BA=%d: ",
-					s->nb_ba_ind_si2);
-				j = strlen(buffer);
-			}
-			if (j >= 70) {
-				buffer[j - 1] = '\0';
-				print(priv, "%s\n", buffer);
-				sprintf(buffer, "                   ");
-				j = strlen(buffer);
-			}
-			sprintf(buffer + j, "%d,", i);
+	gsm_freq_set_for_each(i, &ncell) {
+		if (!k) {
+			sprintf(buffer, "SI2 (neigh.) BA=%d: ",
+				s->nb_ba_ind_si2);
+			j = strlen(buffer);
+		}
+		if (j >= 70) {
+			buffer[j - 1] = '\0';
+			print(priv, "%s\n", buffer);
+			sprintf(buffer, "                   ");
 			j = strlen(buffer);
-			k++;
 		}
+		sprintf(buffer + j, "%d,", i);
+		j = strlen(buffer);
+		k++;
 	}
 	if (j) {
 		buffer[j - 1] = '\0';
 		print(priv, "%s\n", buffer);
 	}
 	j = 0; k = 0;
-	for (i = 0; i < 1024; i++) {
-		if ((s->freq[i].mask & FREQ_TYPE_REP)) {
-			if (!k) {
-				sprintf(buffer, "SI5 (report) BA=%d: ",
-					s->nb_ba_ind_si5);
-				j = strlen(buffer);
-			}
-			if (j >= 70) {
-				buffer[j - 1] = '\0';
-				print(priv, "%s\n", buffer);
-				sprintf(buffer, "                   ");
-				j = strlen(buffer);
-			}
-			sprintf(buffer + j, "%d,", i);
+	gsm_freq_set_for_each(i, &rep) {
+		if (!k) {
+			sprintf(buffer, "SI5 (report) BA=%d: ",
+				s->nb_ba_ind_si5);
 			j = strlen(buffer);
-			k++;
 		}
+		if (j >= 70) {
+			buffer[j - 1] = '\0';
+			print(priv, "%s\n", buffer);
+			sprintf(buffer, "                   ");
+			j = strlen(buffer);
+		}
+		sprintf(buffer + j, "%d,", i);
+		j = strlen(buffer);
+		k++;
 	}
 	if (j) {
 		buffer[j - 1] = '\0';
@@ -180,14 +178,14 @@ int gsm48_sysinfo_dump(struct gsm48_sysinfo *s, uint16_t arfcn,
 			index = i+j;
 			if (refer_pcs && index >= 512 && index <= 885)
 				index = index-512+1024;
-			if ((s->freq[i+j].mask & FREQ_TYPE_SERV))
+			if (gsm_freq_set_has(FREQ_SET(s, FREQ_TYPE_SERV), i+j))
 				buffer[j + 5] = 'S';
-			else if ((s->freq[i+j].mask & FREQ_TYPE_NCELL)
-			      && (s->freq[i+j].mask & FREQ_TYPE_REP))
+			else if (gsm_freq_set_has(&ncell, i+j)
+			      && gsm_freq_set_has(&rep, i+j))
 				buffer[j + 5] = 'b';
-			else if ((s->freq[i+j].mask & FREQ_TYPE_NCELL))
+			else if (gsm_freq_set_has(&ncell, i+j))
 				buffer[j + 5] = 'n';
-			else if ((s->freq[i+j].mask & FREQ_TYPE_REP))
+			else if (gsm_freq_set_has(&rep, i+j))
 				buffer[j + 5] = 'r';
 			else if (!freq_map || (freq_map[index >> 3]
 						& (1 << (index & 7))))
@@ -325,9 +323,28 @@ int gsm48_decode_chan_h1(struct gsm48_chan_desc *cd, uint8_t *tsc,
 	return 0;
 }
 
-/* decode "Cell Channel Description" (10.5.2.1b) and other frequency lists */
-static int decode_freq_list(struct gsm_sysinfo_freq *f, uint8_t *cd,
-	uint8_t len, uint8_t mask, uint8_t frqt)
+/* decode "Cell Channel Description" (10.5.2.1b) and other frequency lists
+ * into a set of frequencies */
+int gsm48_decode_freq_set(struct gsm_freq_set *fs, uint8_t *cd,
+	uint8_t len, uint8_t mask)
+{
+	struct gsm_sysinfo_freq f[1024];
+	int i, rc;
+
+	memset(f, 0, sizeof(f));
+	rc = gsm48_decode_freq_list(f, cd, len, mask, 1);
+
+	gsm_freq_set_clear(fs);
+	for (i = 0; i < 1024; i++) {
+		if (f[i].mask)
+			gsm_freq_set_add(fs, i);
+	}
+
+	return rc;
+}
+
+static int decode_freq_list(struct gsm_freq_set *fs, uint8_t *cd,
+	uint8_t len, uint8_t mask)
 {
 #if 0
 	/* only Bit map 0 format for P-GSM */
@@ -336,7 +353,7 @@ static int decode_freq_list(struct gsm_sysinfo_freq *f, uint8_t *cd,
 		return 0;
 #endif
 
-	return gsm48_decode_freq_list(f, cd, len, mask, frqt);
+	return gsm48_decode_freq_set(fs, cd, len, mask);
 }
 
 /* decode "Cell Selection Parameters" (10.5.2.4) */
@@ -388,7 +405,7 @@ static int gsm48_decode_ccd(struct gsm48_sysinfo *s,
 }
 
 /* decode "Mobile Allocation" (10.5.2.21) */
-int gsm48_decode_mobile_alloc(struct gsm_sysinfo_freq *freq,
+int gsm48_decode_mobile_alloc(struct gsm48_sysinfo *s,
 	uint8_t *ma, uint8_t len, uint16_t *hopping, uint8_t *hopp_len, int si4)
 {
 	int i, j = 0;
@@ -400,20 +417,16 @@ int gsm48_decode_mobile_alloc(struct gsm_sysinfo_freq *freq,
 
 	/* tabula rasa */
 	*hopp_len = 0;
-	if (si4) {
-		for (i = 0; i < 1024; i++)
-			freq[i].mask &= ~FREQ_TYPE_HOPP;
-	}
+	if (si4)
+		gsm_freq_set_clear(FREQ_SET(s, FREQ_TYPE_HOPP));
 
 	/* generating list of all frequencies (1..1023,0) */
-	for (i = 1; i <= 1024; i++) {
-		if ((freq[i & 1023].mask & FREQ_TYPE_SERV)) {
-			LOGP(DRR, LOGL_INFO, "Serving cell ARFCN #%d: %d\n",
-				j, i & 1023);
-			f[j++] = i & 1023;
-			if (j == (len << 3))
-				break;
-		}
+	gsm_freq_set_for_each_list(i, FREQ_SET(s, FREQ_TYPE_SERV)) {
+		LOGP(DRR, LOGL_INFO, "Serving cell ARFCN #%d: %d\n",
+			j, i & 1023);
+		f[j++] = i & 1023;
+		if (j == (len << 3))
+			break;
 	}
 
 	/* fill hopping table with frequency index given by IE
@@ -434,7 +447,8 @@ int gsm48_decode_mobile_alloc(struct gsm_sysinfo_freq *freq,
 			}
 			hopping[(*hopp_len)++] = f[i];
 			if (si4)
-				freq[f[i]].mask |= FREQ_TYPE_HOPP;
+				gsm_freq_set_add(FREQ_SET(s, FREQ_TYPE_HOPP),
+					f[i]);
 		}
 	}
 
@@ -601,8 +615,9 @@ int gsm48_decode_sysinfo1(struct gsm48_sysinfo *s,
 	memcpy(s->si1_msg, si, MIN(len, sizeof(s->si1_msg)));
 
 	/* Cell Channel Description */
-	decode_freq_list(s->freq, si->cell_channel_description,
-		sizeof(si->cell_channel_description), 0xce, FREQ_TYPE_SERV);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_SERV),
+		si->cell_channel_description,
+		sizeof(si->cell_channel_description), 0xce);
 	/* RACH Control Parameter */
 	gsm48_decode_rach_ctl_param(s, &si->rach_control);
 	/* SI 1 Rest Octets */
@@ -630,8 +645,9 @@ int gsm48_decode_sysinfo2(struct gsm48_sysinfo *s,
 	/* Neighbor Cell Description */
 	s->nb_ext_ind_si2 = (si->bcch_frequency_list[0] >> 6) & 1;
 	s->nb_ba_ind_si2 = (si->bcch_frequency_list[0] >> 5) & 1;
-	decode_freq_list(s->freq, si->bcch_frequency_list,
-		sizeof(si->bcch_frequency_list), 0xce, FREQ_TYPE_NCELL_2);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_NCELL_2),
+		si->bcch_frequency_list,
+		sizeof(si->bcch_frequency_list), 0xce);
 	/* NCC Permitted */
 	s->nb_ncc_permitted_si2 = si->ncc_permitted;
 	/* RACH Control Parameter */
@@ -650,8 +666,9 @@ int gsm48_decode_sysinfo2bis(struct gsm48_sysinfo *s,
 	/* Neighbor Cell Description */
 	s->nb_ext_ind_si2bis = (si->bcch_frequency_list[0] >> 6) & 1;
 	s->nb_ba_ind_si2bis = (si->bcch_frequency_list[0] >> 5) & 1;
-	decode_freq_list(s->freq, si->bcch_frequency_list,
-		sizeof(si->bcch_frequency_list), 0xce, FREQ_TYPE_NCELL_2bis);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_NCELL_2bis),
+		si->bcch_frequency_list,
+		sizeof(si->bcch_frequency_list), 0xce);
 	/* RACH Control Parameter */
 	gsm48_decode_rach_ctl_neigh(s, &si->rach_control);
 
@@ -668,9 +685,9 @@ int gsm48_decode_sysinfo2ter(struct gsm48_sysinfo *s,
 	/* Neighbor Cell Description 2 */
 	s->nb_multi_rep_si2ter = (si->ext_bcch_frequency_list[0] >> 6) & 3;
 	s->nb_ba_ind_si2ter = (si->ext_bcch_frequency_list[0] >> 5) & 1;
-	decode_freq_list(s->freq, si->ext_bcch_frequency_list,
-		sizeof(si->ext_bcch_frequency_list), 0x8e,
-			FREQ_TYPE_NCELL_2ter);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_NCELL_2ter),
+		si->ext_bcch_frequency_list,
+		sizeof(si->ext_bcch_frequency_list), 0x8e);
 
 	s->si2ter = 1;
 
@@ -754,7 +771,7 @@ short_read:
 				"SYSTEM INFORMATION 4 until SI 1 is "
 				"received.\n");
 		} else {
-			gsm48_decode_mobile_alloc(s->freq, data + 2, data[1],
+			gsm48_decode_mobile_alloc(s, data + 2, data[1],
 				s->hopping, &s->hopp_len, 1);
 		}
 		payload_len -= 2 + data[1];
@@ -777,8 +794,9 @@ int gsm48_decode_sysinfo5(struct gsm48_sysinfo *s,
 	/* Neighbor Cell Description */
 	s->nb_ext_ind_si5 = (si->bcch_frequency_list[0] >> 6) & 1;
 	s->nb_ba_ind_si5 = (si->bcch_frequency_list[0] >> 5) & 1;
-	decode_freq_list(s->freq, si->bcch_frequency_list,
-		sizeof(si->bcch_frequency_list), 0xce, FREQ_TYPE_REP_5);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_REP_5),
+		si->bcch_frequency_list,
+		sizeof(si->bcch_frequency_list), 0xce);
 
 	s->si5 = 1;
 
@@ -793,8 +811,9 @@ int gsm48_decode_sysinfo5bis(struct gsm48_sysinfo *s,
 	/* Neighbor Cell Description */
 	s->nb_ext_ind_si5bis = (si->bcch_frequency_list[0] >> 6) & 1;
 	s->nb_ba_ind_si5bis = (si->bcch_frequency_list[0] >> 5) & 1;
-	decode_freq_list(s->freq, si->bcch_frequency_list,
-		sizeof(si->bcch_frequency_list), 0xce, FREQ_TYPE_REP_5bis);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_REP_5bis),
+		si->bcch_frequency_list,
+		sizeof(si->bcch_frequency_list), 0xce);
 
 	s->si5bis = 1;
 
@@ -809,8 +828,9 @@ int gsm48_decode_sysinfo5ter(struct gsm48_sysinfo *s,
 	/* Neighbor Cell Description */
 	s->nb_multi_rep_si5ter = (si->bcch_frequency_list[0] >> 6) & 3;
 	s->nb_ba_ind_si5ter = (si->bcch_frequency_list[0] >> 5) & 1;
-	decode_freq_list(s->freq, si->bcch_frequency_list,
-		sizeof(si->bcch_frequency_list), 0x8e, FREQ_TYPE_REP_5ter);
+	decode_freq_list(FREQ_SET(s, FREQ_TYPE_REP_5ter),
+		si->bcch_frequency_list,
+		sizeof(si->bcch_frequency_list), 0x8e);
 
 	s->si5ter = 1;
 
@@ -44,6 +44,7 @@ extern uint16_t basic_band_range[][2];
 extern uint16_t (*band_range)[][2];
 
 char *logname = "/var/log/osmocom.log";
+int log_binary = 0;
 int RACH_MAX = 2;
 
 int _scan_work(struct osmocom_ms *ms)
@@ -95,6 +96,7 @@ static int l23_getopt_options(struct option **options)
 {
 	static struct option opts [] = {
 		{"logfile", 1, 0, 'l'},
+		{"binary", 0, 0, 'B'},
 		{"rach", 1, 0, 'r'},
 		{"no-rach", 1, 0, 'n'},
 #ifdef _HAVE_GPSD
@@ -155,6 +157,7 @@ static int l23_cfg_print_help()
 {
 	printf("\nApplication specific\n");
 	printf("  -l --logfile LOGFILE	Logfile for the cell log.\n");
+	printf("  -B --binary		Write the cell log in binary format.\n");
 	printf("  -r --rach RACH	Nr. of RACH bursts to send.\n");
 	printf("  -n --no-rach		Send no rach bursts.\n");
 	printf("  -g --gpsd-host HOST	127.0.0.1. gpsd host.\n");
@@ -174,6 +177,9 @@ static int l23_cfg_handle(int c, const char *optarg)
 	case 'l':
 		logname = talloc_strdup(l23_ctx, optarg);
 		break;
+	case 'B':
+		log_binary = 1;
+		break;
 	case 'r':
 		RACH_MAX = atoi(optarg);
 		break;
@@ -234,7 +240,7 @@ cmd_line_error:
 
 static struct l23_app_info info = {
 	.copyright	= "Copyright (C) 2010 Andreas Eversberg\n",
-	.getopt_string	= "g:p:l:r:nf:b:A:",
+	.getopt_string	= "g:p:l:Br:nf:b:A:",
 	.cfg_supported	= l23_cfg_supported,
 	.cfg_getopt_opt = l23_getopt_options,
 	.cfg_handle_opt	= l23_cfg_handle,
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <errno.h>
+#include <math.h>
 
 #include <l1ctl_proto.h>
 
@@ -43,6 +44,7 @@
 #include <osmocom/bb/common/networks.h>
 #include <osmocom/bb/common/gps.h>
 #include <osmocom/bb/misc/cell_log.h>
+#include <osmocom/bb/misc/cell_log_bin.h>
 #include "../../../gsmmap/geo.h"
 
 #define READ_WAIT	2, 0
@@ -88,6 +90,7 @@ static int arfcn;
 static int rach_count;
 static FILE *logfp = NULL;
 extern char *logname;
+extern int log_binary;
 extern int RACH_MAX;
 
 
@@ -145,10 +148,127 @@ static void log_frame(char *tag, uint8_t *data)
 	LOGFILE("\n");
 }
 
+/* write one record of the binary log, the common part of the payload
+ * (time and position) is filled in here */
+static void log_bin_record(uint8_t type, uint8_t flags, uint8_t *payload,
+	int len)
+{
+	uint8_t hdr[CELL_LOG_BIN_HDR_LEN];
+	uint8_t *p = payload;
+	time_t now;
+
+	if (g.enable && g.valid) {
+		now = g.gmt;
+		flags |= CELL_LOG_BIN_F_GPS;
+	} else
+		time(&now);
+	p = cell_log_bin_put64(p, now);
+	if ((flags & CELL_LOG_BIN_F_GPS)) {
+		p = cell_log_bin_put32(p,
+			lround(g.longitude * CELL_LOG_BIN_POS_SCALE));
+		p = cell_log_bin_put32(p,
+			lround(g.latitude * CELL_LOG_BIN_POS_SCALE));
+	} else {
+		p = cell_log_bin_put32(p, 0);
+		p = cell_log_bin_put32(p, 0);
+	}
+
+	hdr[0] = type;
+	hdr[1] = flags;
+	cell_log_bin_put16(hdr + 2, len);
+	fwrite(hdr, sizeof(hdr), 1, logfp);
+	fwrite(payload, len, 1, logfp);
+	LOGFLUSH();
+}
+
+static void log_pm_bin(void)
+{
+	uint8_t payload[CELL_LOG_BIN_MAX_LEN];
+	uint8_t *p = payload + CELL_LOG_BIN_COMMON_LEN, *run = NULL;
+	int count = 0, i;
+
+	for (i = 0; i <= 1023; i++) {
+		if (!(pm[i].flags & INFO_FLG_PM)) {
+			if (run)
+				cell_log_bin_put16(run + 2, count);
+			run = NULL;
+			continue;
+		}
+		if (!run) {
+			run = p;
+			p = cell_log_bin_put16(p, i);
+			p += 2;
+			count = 0;
+		}
+		*p++ = pm[i].rxlev_dbm;
+		count++;
+	}
+	if (run)
+		cell_log_bin_put16(run + 2, count);
+
+	log_bin_record(CELL_LOG_BIN_POWER, 0, payload, p - payload);
+}
+
+static void log_sysinfo_bin(int8_t rxlev_dbm)
+{
+	struct gsm48_sysinfo *s = &sysinfo;
+	uint8_t payload[CELL_LOG_BIN_MAX_LEN];
+	uint8_t *p = payload + CELL_LOG_BIN_COMMON_LEN, *mask;
+	uint8_t flags = 0;
+
+	p = cell_log_bin_put16(p, s->arfcn);
+	*p++ = rxlev_dbm;
+	*p++ = s->bsic;
+	if (log_si.ta != 0xff) {
+		flags |= CELL_LOG_BIN_F_TA;
+		*p++ = log_si.ta;
+	} else
+		*p++ = 0;
+	mask = p++;
+	*mask = 0;
+	if (s->si1) {
+		*mask |= CELL_LOG_BIN_SI1;
+		memcpy(p, s->si1_msg, 23);
+		p += 23;
+	}
+	if (s->si2) {
+		*mask |= CELL_LOG_BIN_SI2;
+		memcpy(p, s->si2_msg, 23);
+		p += 23;
+	}
+	if (s->si2bis) {
+		*mask |= CELL_LOG_BIN_SI2bis;
+		memcpy(p, s->si2b_msg, 23);
+		p += 23;
+	}
+	if (s->si2ter) {
+		*mask |= CELL_LOG_BIN_SI2ter;
+		memcpy(p, s->si2t_msg, 23);
+		p += 23;
+	}
+	if (s->si3) {
+		*mask |= CELL_LOG_BIN_SI3;
+		memcpy(p, s->si3_msg, 23);
+		p += 23;
+	}
+	if (s->si4) {
+		*mask |= CELL_LOG_BIN_SI4;
+		memcpy(p, s->si4_msg, 23);
+		p += 23;
+	}
+
+	log_bin_record(CELL_LOG_BIN_SYSINFO, flags, payload, p - payload);
+}
+
 static void log_pm(void)
 {
 	int count = 0, i;
 
+	if (log_binary) {
+		log_pm_bin();
+		return;
+	}
+
 	LOGFILE("[power]\n");
 	log_time();
 	log_gps();
@@ -190,12 +310,17 @@ static void log_sysinfo(void)
 		arfcn, gsm_print_mcc(s->mcc), gsm_print_mnc(s->mnc),
 		gsm_get_mcc(s->mcc), gsm_get_mnc(s->mcc, s->mnc), ta_str);
 
+	rxlev_dbm = meas->rxlev / meas->frames - 110;
+	if (log_binary) {
+		log_sysinfo_bin(rxlev_dbm);
+		return;
+	}
+
 	LOGFILE("[sysinfo]\n");
 	LOGFILE("arfcn %d\n", s->arfcn);
 	log_time();
 	log_gps();
 	LOGFILE("bsic %d,%d\n", s->bsic >> 3, s->bsic & 7);
-	rxlev_dbm = meas->rxlev / meas->frames - 110;
 	LOGFILE("rxlev %d\n", rxlev_dbm);
 	if (s->si1)
 		log_frame("si1", s->si1_msg);
@@ -781,6 +906,25 @@ static int rcv_rsl(struct msgb *msg, struct lapdm_entity *le, void *l3ctx)
 	return rc;
 }
 
+/* write the magic to a new binary log, or check it when appending */
+static int log_bin_start(void)
+{
+	char magic[CELL_LOG_BIN_MAGIC_LEN];
+
+	if (logfp == stdout || fseek(logfp, 0, SEEK_END) || !ftell(logfp)) {
+		fwrite(CELL_LOG_BIN_MAGIC, CELL_LOG_BIN_MAGIC_LEN, 1, logfp);
+		LOGFLUSH();
+		return 0;
+	}
+
+	rewind(logfp);
+	if (fread(magic, sizeof(magic), 1, logfp) != 1
+	 || memcmp(magic, CELL_LOG_BIN_MAGIC, sizeof(magic)))
+		return -EINVAL;
+
+	return 0;
+}
+
 int scan_init(struct osmocom_ms *_ms)
 {
 	ms = _ms;
@@ -795,12 +939,18 @@ int scan_init(struct osmocom_ms *_ms)
 	if (!strcmp(logname, "-"))
 		logfp = stdout;
 	else
-		logfp = fopen(logname, "a");
+		logfp = fopen(logname, log_binary ? "a+b" : "a");
 	if (!logfp) {
 		fprintf(stderr, "Failed to open logfile '%s'\n", logname);
 		scan_exit();
 		return -errno;
 	}
+	if (log_binary && log_bin_start()) {
+		fprintf(stderr, "Logfile '%s' is not a binary cell log\n",
+			logname);
+		scan_exit();
+		return -EINVAL;
+	}
 	LOGP(DSUM, LOGL_INFO, "Scanner initialized\n");
 
 	return 0;
@@ -0,0 +1,245 @@
+/* L1CTL socket throughput against a fake L1 in the same process */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+
+#include <l1ctl_proto.h>
+
+#include <osmocom/bb/common/osmocom_data.h>
+#include <osmocom/bb/common/l1l2_interface.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+
+#define NUM_FRAMES	1000000
+#define NUM_QUEUED	64
+/* L1CTL_DATA_IND with one 23 octet block */
+#define FRAME_LEN	(sizeof(struct l1ctl_hdr) + \
+			 sizeof(struct l1ctl_info_dl) + 23)
+
+void *l23_ctx = NULL;
+
+/* the fake L1 end of the socket */
+static struct {
+	struct osmo_fd bfd;
+	uint8_t buf[65536];
+	unsigned int len, pos;
+	unsigned int sent, received;
+	int errors;
+} peer;
+
+static unsigned int received;
+static int errors;
+
+/* stands in for the L1CTL dispatcher of the layer23 apps */
+int l1ctl_recv(struct osmocom_ms *ms, struct msgb *msg)
+{
+	struct l1ctl_hdr *l1h = (struct l1ctl_hdr *) msg->l1h;
+	struct l1ctl_info_dl *dl = (struct l1ctl_info_dl *) l1h->data;
+
+	if (msgb_l1len(msg) != FRAME_LEN
+	 || l1h->msg_type != L1CTL_DATA_IND
+	 || ntohl(dl->frame_nr) != received)
+		errors++;
+	received++;
+	msgb_free(msg);
+
+	return 0;
+}
+
+static unsigned int put_frame(uint8_t *buf, unsigned int nr)
+{
+	struct l1ctl_hdr *l1h;
+	struct l1ctl_info_dl *dl;
+
+	buf[0] = FRAME_LEN >> 8;
+	buf[1] = FRAME_LEN & 0xff;
+	l1h = (struct l1ctl_hdr *) (buf + 2);
+	memset(l1h, 0, FRAME_LEN);
+	l1h->msg_type = L1CTL_DATA_IND;
+	dl = (struct l1ctl_info_dl *) l1h->data;
+	dl->frame_nr = htonl(nr);
+	memset(dl->payload, 0x2b, 23);
+
+	return 2 + FRAME_LEN;
+}
+
+/* stream DATA_IND frames as fast as the socket takes them */
+static int peer_write(void)
+{
+	int rc;
+
+	if (peer.pos == peer.len) {
+		peer.pos = peer.len = 0;
+		while (peer.sent < NUM_FRAMES
+		    && peer.len + 2 + FRAME_LEN <= sizeof(peer.buf))
+			peer.len += put_frame(peer.buf + peer.len, peer.sent++);
+		if (!peer.len) {
+			osmo_fd_update_when(&peer.bfd,
+					    peer.bfd.when & ~BSC_FD_WRITE);
+			return 0;
+		}
+	}
+
+	rc = write(peer.bfd.fd, peer.buf + peer.pos, peer.len - peer.pos);
+	if (rc < 0)
+		return errno == EAGAIN ? 0 : -errno;
+	peer.pos += rc;
+	return 0;
+}
+
+/* count the frames coming from layer2_write() */
+static int peer_read(void)
+{
+	unsigned int pos = 0, len;
+	int rc;
+
+	rc = read(peer.bfd.fd, peer.buf + peer.len,
+		  sizeof(peer.buf) - peer.len);
+	if (rc <= 0)
+		return rc < 0 && errno == EAGAIN ? 0 : -EIO;
+	peer.len += rc;
+
+	while (peer.len - pos >= 2) {
+		len = peer.buf[pos] << 8 | peer.buf[pos + 1];
+		if (peer.len - pos < 2 + len)
+			break;
+		if (len != FRAME_LEN || peer.buf[pos + 2] != L1CTL_DATA_REQ)
+			peer.errors++;
+		peer.received++;
+		pos += 2 + len;
+	}
+	peer.len -= pos;
+	memmove(peer.buf, peer.buf + pos, peer.len);
+
+	return 0;
+}
+
+static int peer_cb(struct osmo_fd *fd, unsigned int what)
+{
+	int rc = 0;
+
+	if (what & BSC_FD_WRITE)
+		rc = peer_write();
+	if (rc == 0 && (what & BSC_FD_READ))
+		rc = peer_read();
+	if (rc < 0) {
+		fprintf(stderr, "fake L1 socket failed: %s\n", strerror(-rc));
+		exit(EXIT_FAILURE);
+	}
+	return 0;
+}
+
+static struct msgb *data_req(void)
+{
+	struct msgb *msg;
+	struct l1ctl_hdr *l1h;
+
+	msg = msgb_alloc_headroom(256, 32, "l1ctl_loopback");
+	l1h = (struct l1ctl_hdr *) msgb_put(msg, FRAME_LEN);
+	memset(l1h, 0, FRAME_LEN);
+	l1h->msg_type = L1CTL_DATA_REQ;
+	msg->l1h = msg->data;
+
+	return msg;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_un local;
+	struct osmocom_ms *ms;
+	double start, t;
+	int lfd;
+
+	l23_ctx = talloc_named_const(NULL, 1, "l1ctl_loopback");
+	ms = talloc_zero(l23_ctx, struct osmocom_ms);
+
+	memset(&local, 0, sizeof(local));
+	local.sun_family = AF_UNIX;
+	snprintf(local.sun_path, sizeof(local.sun_path),
+		 "/tmp/l1ctl_loopback.%d", getpid());
+	unlink(local.sun_path);
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *) &local,
+			    sizeof(local)) < 0 || listen(lfd, 1) < 0) {
+		perror("fake L1 socket");
+		return EXIT_FAILURE;
+	}
+
+	if (layer2_open(ms, local.sun_path) < 0)
+		return EXIT_FAILURE;
+	peer.bfd.fd = accept(lfd, NULL, NULL);
+	close(lfd);
+	unlink(local.sun_path);
+	if (peer.bfd.fd < 0) {
+		perror("accept");
+		return EXIT_FAILURE;
+	}
+	fcntl(peer.bfd.fd, F_SETFL, O_NONBLOCK);
+	peer.bfd.cb = peer_cb;
+	peer.bfd.when = BSC_FD_WRITE;
+	osmo_fd_register(&peer.bfd);
+
+	/* downlink: L1 -> layer2_read() -> l1ctl_recv() */
+	start = now_sec();
+	while (received < NUM_FRAMES)
+		osmo_select_main(0);
+	t = now_sec() - start;
+	printf("L1 -> L2 %10.0f frames/s  (%5.1f ns/frame, %d errors)\n",
+		NUM_FRAMES / t, t * 1e9 / NUM_FRAMES, errors);
+
+	/* uplink: osmo_send_l1() -> layer2_write() -> L1 */
+	osmo_fd_update_when(&peer.bfd, BSC_FD_READ);
+	peer.len = 0;
+	start = now_sec();
+	while (peer.received < NUM_FRAMES) {
+		while (peer.sent < 2 * NUM_FRAMES
+		    && ms->l2_wq.current_length < NUM_QUEUED) {
+			osmo_send_l1(ms, data_req());
+			peer.sent++;
+		}
+		osmo_select_main(0);
+	}
+	t = now_sec() - start;
+	printf("L2 -> L1 %10.0f frames/s  (%5.1f ns/frame, %d errors)\n",
+		NUM_FRAMES / t, t * 1e9 / NUM_FRAMES, peer.errors);
+
+	layer2_close(ms);
+	close(peer.bfd.fd);
+
+	return errors || peer.errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,997 @@
+/* Virtual layer 1: serves L1CTL to the layer23 apps without a phone */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * virt_l1 listens on the socket that layer2_open() connects to and plays
+ * the part of the phone firmware.  The radio environment is either a
+ * scenario file or a GSMTAP trace recorded with wireshark/tcpdump:
+ *
+ *	# ARFCN 871 is received with RxLev 40, BSIC 7
+ *	cell 871 rxlev 40 bsic 7
+ *	# System Information sent on its BCCH, in turn
+ *	si 871 55 06 19 ...
+ *	si 871 49 06 1b ...
+ *
+ * PM_REQ is answered from the cell list, FBSB_REQ succeeds on every ARFCN
+ * that has a cell.  Once synchronized, the downlink of that ARFCN is
+ * delivered as DATA_IND/TRAFFIC_IND.  Scenario cells transmit their SI on
+ * the BCCH and empty paging on the CCCH, a trace is replayed as recorded.
+ * With -x 0 blocks are sent as fast as the client reads them, so a replay
+ * is deterministic and the time it takes measures the layer23 side.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+
+#define _GNU_SOURCE
+#include <getopt.h>
+
+#include <l1ctl_proto.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+/* duration of a TDMA frame in seconds */
+#define FN_DURATION	(120e-3 / 26)
+/* don't generate downlink blocks while less than this is free */
+#define OBUF_HEADROOM	8192
+#define PM_PER_MSG	50
+#define MAX_SI		8
+
+struct vl1_cell {
+	uint8_t rxlev;
+	uint8_t bsic;
+	uint8_t snr;
+	int num_si;
+	uint8_t si[MAX_SI][23];
+};
+
+struct vl1_block {
+	double t;		/* seconds since the start of the source */
+	uint32_t fn;
+	uint16_t arfcn;
+	uint8_t chan_nr;
+	uint8_t link_id;
+	uint8_t rxlev;
+	uint8_t snr;
+	uint8_t traffic;	/* TRAFFIC_IND instead of DATA_IND */
+	uint8_t len;
+	uint8_t data[TRAFFIC_DATA_LEN];
+};
+
+/* a source of downlink blocks */
+struct vl1_source {
+	const char *name;
+	/* restart from the beginning after FBSB */
+	void (*rewind)(void);
+	/* next block on the given ARFCN, 0 when there are no more */
+	int (*next)(struct vl1_block *blk, uint16_t arfcn);
+};
+
+void *l23_ctx = NULL;
+
+static struct vl1_cell *cells[1024];
+static const struct vl1_source *source;
+static double speed = 1.0;
+static unsigned long max_blocks = 0;
+static int loop_trace = 0;
+
+/* the layer23 client */
+static struct {
+	struct osmo_fd bfd;
+	uint8_t rbuf[16384];
+	unsigned int rlen;
+	uint8_t obuf[65536];
+	unsigned int olen, opos;
+
+	int synced;
+	uint16_t arfcn;
+	uint8_t ccch_mode;
+	uint32_t fn;
+
+	struct vl1_block pending;
+	int have_pending;
+	int done;
+	double t0, b0;
+
+	/* statistics of the current FBSB, reported once all are read */
+	unsigned long blocks;
+	double start;
+	int reported;
+} cl;
+
+static struct osmo_fd listen_bfd;
+static struct osmo_timer_list pace_timer;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct vl1_cell *cell_get(uint16_t arfcn, int create)
+{
+	arfcn &= 0x3ff;
+	if (!cells[arfcn] && create)
+		cells[arfcn] = talloc_zero(l23_ctx, struct vl1_cell);
+	return cells[arfcn];
+}
+
+/*
+ * scenario source: SI on the BCCH, empty paging on the CCCH
+ */
+
+static const uint8_t paging_empty[23] = {
+	0x15, 0x06, 0x21, 0x00, 0x01, 0xf0, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b,
+};
+
+/* first frames of the CCCH blocks in the 51-multiframe */
+static const uint8_t ccch_fn51[] = { 6, 12, 16, 22, 26, 32, 36, 42, 46 };
+
+static uint32_t scn_fn;
+
+static void scn_rewind(void)
+{
+	scn_fn = 0;
+}
+
+static int scn_next(struct vl1_block *blk, uint16_t arfcn)
+{
+	struct vl1_cell *cell = cell_get(arfcn, 0);
+	unsigned int fn51, i;
+	const uint8_t *data;
+
+	if (!cell || (!cell->num_si && cl.ccch_mode == CCCH_MODE_NONE))
+		return 0;
+
+	for (;; scn_fn = (scn_fn + 1) % GSM_MAX_FN) {
+		fn51 = scn_fn % 51;
+		data = NULL;
+		if (fn51 == 2 && cell->num_si) {
+			/* rotate the SI with TC = (FN / 51) % 8 */
+			data = cell->si[((scn_fn / 51) % 8) % cell->num_si];
+			blk->chan_nr = RSL_CHAN_BCCH;
+		} else if (cl.ccch_mode != CCCH_MODE_NONE) {
+			for (i = 0; i < ARRAY_SIZE(ccch_fn51); i++) {
+				if (ccch_fn51[i] != fn51)
+					continue;
+				/* combined CCCH leaves room for SDCCH/4 */
+				if (cl.ccch_mode == CCCH_MODE_COMBINED && i > 2)
+					break;
+				data = paging_empty;
+				blk->chan_nr = RSL_CHAN_PCH_AGCH;
+			}
+		}
+		if (data)
+			break;
+	}
+
+	blk->t = scn_fn * FN_DURATION;
+	blk->fn = scn_fn;
+	blk->arfcn = arfcn;
+	blk->link_id = 0;
+	blk->rxlev = cell->rxlev;
+	blk->snr = cell->snr;
+	blk->traffic = 0;
+	blk->len = 23;
+	memcpy(blk->data, data, 23);
+	scn_fn = (scn_fn + 1) % GSM_MAX_FN;
+
+	return 1;
+}
+
+static const struct vl1_source scenario_source = {
+	.name = "scenario",
+	.rewind = scn_rewind,
+	.next = scn_next,
+};
+
+static int scenario_load(const char *path)
+{
+	struct vl1_cell *cell;
+	char line[512], hex[256], *s;
+	unsigned int arfcn, val, nr = 0;
+	int n, len;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open '%s': %s\n", path,
+			strerror(errno));
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		nr++;
+		if ((s = strchr(line, '#')))
+			*s = '\0';
+		if (sscanf(line, " cell %u%n", &arfcn, &n) == 1) {
+			if (arfcn > 1023)
+				goto error;
+			cell = cell_get(arfcn, 1);
+			cell->rxlev = 40;
+			cell->snr = 16;
+			s = line + n;
+			while (sscanf(s, " %255s %u%n", hex, &val, &n) == 2) {
+				if (!strcmp(hex, "rxlev") && val < 64)
+					cell->rxlev = val;
+				else if (!strcmp(hex, "bsic") && val < 64)
+					cell->bsic = val;
+				else if (!strcmp(hex, "snr") && val < 256)
+					cell->snr = val;
+				else
+					goto error;
+				s += n;
+			}
+		} else if (sscanf(line, " si %u%n", &arfcn, &n) == 1) {
+			cell = arfcn < 1024 ? cell_get(arfcn, 0) : NULL;
+			if (!cell || cell->num_si == MAX_SI)
+				goto error;
+			/* the hex octets may be separated by blanks */
+			for (s = line + n, len = 0; *s && len < sizeof(hex) - 1;
+			     s++) {
+				if (*s != ' ' && *s != '\t' && *s != '\n')
+					hex[len++] = *s;
+			}
+			hex[len] = '\0';
+			memset(cell->si[cell->num_si], 0x2b, 23);
+			if (osmo_hexparse(hex, cell->si[cell->num_si], 23) < 0)
+				goto error;
+			cell->num_si++;
+		} else if (sscanf(line, " %1s", hex) == 1)
+			goto error;
+	}
+
+	fclose(f);
+	return 0;
+
+error:
+	fprintf(stderr, "%s:%u: invalid line\n", path, nr);
+	fclose(f);
+	return -EINVAL;
+}
+
+/*
+ * trace source: GSMTAP Um frames from a pcap file
+ */
+
+static struct vl1_block *trace;
+static unsigned int trace_len, trace_pos;
+static double trace_ofs;
+
+static void trace_rewind(void)
+{
+	trace_pos = 0;
+	trace_ofs = 0;
+}
+
+static int trace_next(struct vl1_block *blk, uint16_t arfcn)
+{
+	unsigned int scanned = 0;
+
+	while (scanned++ <= trace_len) {
+		if (trace_pos == trace_len) {
+			if (!loop_trace)
+				return 0;
+			/* continue one frame after the end of the trace */
+			trace_ofs += trace[trace_len - 1].t + FN_DURATION;
+			trace_pos = 0;
+		}
+		if (trace[trace_pos].arfcn == arfcn) {
+			*blk = trace[trace_pos++];
+			blk->t += trace_ofs;
+			return 1;
+		}
+		trace_pos++;
+	}
+
+	return 0;
+}
+
+static const struct vl1_source trace_source = {
+	.name = "trace",
+	.rewind = trace_rewind,
+	.next = trace_next,
+};
+
+static int pcap_swap;
+
+static uint32_t pcap_u32(const uint8_t *p)
+{
+	if (pcap_swap)
+		return p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+	return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* RSL channel number of a GSMTAP Um frame, 0 if we don't serve it */
+static uint8_t gsmtap_chan_nr(const struct gsmtap_hdr *gh)
+{
+	uint8_t ts = gh->timeslot & 7, ss = gh->sub_slot & 7;
+
+	switch (gh->sub_type & ~GSMTAP_CHANNEL_ACCH) {
+	case GSMTAP_CHANNEL_BCCH:
+		return RSL_CHAN_BCCH;
+	case GSMTAP_CHANNEL_CCCH:
+	case GSMTAP_CHANNEL_AGCH:
+	case GSMTAP_CHANNEL_PCH:
+		return RSL_CHAN_PCH_AGCH;
+	case GSMTAP_CHANNEL_SDCCH4:
+		return RSL_CHAN_SDCCH4_ACCH | (ss & 3) << 3;
+	case GSMTAP_CHANNEL_SDCCH:
+	case GSMTAP_CHANNEL_SDCCH8:
+		return RSL_CHAN_SDCCH8_ACCH | ss << 3 | ts;
+	case GSMTAP_CHANNEL_TCH_F:
+		return RSL_CHAN_Bm_ACCHs | ts;
+	case GSMTAP_CHANNEL_TCH_H:
+		return RSL_CHAN_Lm_ACCHs | (ss & 1) << 3 | ts;
+	}
+
+	return 0;
+}
+
+/* add the GSMTAP frame at the start of a UDP payload to the trace */
+static void trace_add(const uint8_t *data, unsigned int len, double t)
+{
+	const struct gsmtap_hdr *gh = (const struct gsmtap_hdr *) data;
+	struct vl1_block *blk;
+	struct vl1_cell *cell;
+	unsigned int hl;
+	int rxlev;
+
+	if (len < sizeof(*gh) || gh->type != GSMTAP_TYPE_UM)
+		return;
+	hl = gh->hdr_len * 4;
+	if (hl < sizeof(*gh) || hl > len || len - hl > TRAFFIC_DATA_LEN)
+		return;
+	if (ntohs(gh->arfcn) & GSMTAP_ARFCN_F_UPLINK || !gsmtap_chan_nr(gh))
+		return;
+
+	if (!(trace_len & 1023)) {
+		trace = talloc_realloc(l23_ctx, trace, struct vl1_block,
+				       trace_len + 1024);
+		if (!trace)
+			exit(EXIT_FAILURE);
+	}
+	blk = &trace[trace_len++];
+	memset(blk, 0, sizeof(*blk));
+
+	rxlev = gh->signal_dbm + 110;
+	if (rxlev < 0 || !gh->signal_dbm)
+		rxlev = 0;
+	if (rxlev > 63)
+		rxlev = 63;
+
+	blk->t = t;
+	blk->fn = ntohl(gh->frame_number);
+	blk->arfcn = ntohs(gh->arfcn) & GSMTAP_ARFCN_MASK;
+	blk->chan_nr = gsmtap_chan_nr(gh);
+	blk->link_id = gh->sub_type & GSMTAP_CHANNEL_ACCH ? 0x40 : 0;
+	blk->rxlev = rxlev;
+	blk->snr = gh->snr_db;
+	/* FACCH is a 23 octet block on a TCH, speech frames are not */
+	blk->traffic = (blk->chan_nr & 0xe0) == 0 && len - hl != 23;
+	blk->len = len - hl;
+	memcpy(blk->data, data + hl, blk->len);
+	if (!blk->traffic && blk->len < 23)
+		memset(blk->data + blk->len, 0x2b, 23 - blk->len);
+
+	/* the trace tells us where the cells are, not their BSIC */
+	cell = cell_get(blk->arfcn, 0);
+	if (!cell) {
+		cell = cell_get(blk->arfcn, 1);
+		cell->snr = blk->snr;
+		cell->rxlev = rxlev;
+	}
+}
+
+static int pcap_load(const char *path)
+{
+	uint8_t ghdr[24], rhdr[16], pkt[65536];
+	const uint8_t *ip;
+	unsigned int link, incl, ihl, ofs;
+	double t, t0 = -1, tsub;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open '%s': %s\n", path,
+			strerror(errno));
+		return -errno;
+	}
+
+	if (fread(ghdr, sizeof(ghdr), 1, f) != 1)
+		goto error;
+	pcap_swap = 0;
+	switch (pcap_u32(ghdr)) {
+	case 0xd4c3b2a1:
+		pcap_swap = 1;
+		/* fall through */
+	case 0xa1b2c3d4:
+		tsub = 1e-6;
+		break;
+	case 0x4d3cb2a1:
+		pcap_swap = 1;
+		/* fall through */
+	case 0xa1b23c4d:
+		tsub = 1e-9;
+		break;
+	default:
+		goto error;
+	}
+	link = pcap_u32(ghdr + 20);
+
+	while (fread(rhdr, sizeof(rhdr), 1, f) == 1) {
+		incl = pcap_u32(rhdr + 8);
+		if (incl > sizeof(pkt) || fread(pkt, incl, 1, f) != 1)
+			goto error;
+		t = pcap_u32(rhdr) + pcap_u32(rhdr + 4) * tsub;
+		if (t0 < 0)
+			t0 = t;
+
+		/* find the IPv4 header */
+		switch (link) {
+		case 1:		/* Ethernet */
+			if (incl < 14 || pkt[12] != 0x08 || pkt[13] != 0x00)
+				continue;
+			ofs = 14;
+			break;
+		case 113:	/* Linux cooked capture */
+			if (incl < 16 || pkt[14] != 0x08 || pkt[15] != 0x00)
+				continue;
+			ofs = 16;
+			break;
+		case 101:	/* raw IP */
+		case 228:	/* IPv4 */
+			ofs = 0;
+			break;
+		default:
+			fprintf(stderr, "Unsupported pcap link type %u\n",
+				link);
+			fclose(f);
+			return -EINVAL;
+		}
+
+		ip = pkt + ofs;
+		if (incl < ofs + 20 || ip[0] >> 4 != 4 || ip[9] != 17)
+			continue;
+		/* fragments are not GSMTAP frames we could use */
+		if ((ip[6] & 0x3f) || ip[7])
+			continue;
+		ihl = (ip[0] & 0xf) * 4;
+		if (incl < ofs + ihl + 8)
+			continue;
+		ip += ihl;
+		if ((ip[2] << 8 | ip[3]) != GSMTAP_UDP_PORT)
+			continue;
+		trace_add(ip + 8, incl - ofs - ihl - 8, t - t0);
+	}
+
+	fclose(f);
+	return 0;
+
+error:
+	fprintf(stderr, "'%s' is not a valid pcap file\n", path);
+	fclose(f);
+	return -EINVAL;
+}
+
+/*
+ * L1CTL server
+ */
+
+/* append a message to the output buffer, returns its payload */
+static void *l1ctl_put(uint8_t msg_type, uint8_t flags, unsigned int len)
+{
+	struct l1ctl_hdr *l1h;
+	unsigned int total = sizeof(*l1h) + len;
+
+	if (cl.opos && cl.olen + 2 + total > sizeof(cl.obuf)) {
+		memmove(cl.obuf, cl.obuf + cl.opos, cl.olen - cl.opos);
+		cl.olen -= cl.opos;
+		cl.opos = 0;
+	}
+	if (cl.olen + 2 + total > sizeof(cl.obuf)) {
+		fprintf(stderr, "Client does not read, dropping L1CTL "
+			"message %u\n", msg_type);
+		return NULL;
+	}
+
+	cl.obuf[cl.olen] = total >> 8;
+	cl.obuf[cl.olen + 1] = total & 0xff;
+	l1h = (struct l1ctl_hdr *) (cl.obuf + cl.olen + 2);
+	memset(l1h, 0, total);
+	l1h->msg_type = msg_type;
+	l1h->flags = flags;
+	cl.olen += 2 + total;
+	osmo_fd_update_when(&cl.bfd, cl.bfd.when | BSC_FD_WRITE);
+
+	return l1h->data;
+}
+
+static struct l1ctl_info_dl *l1ctl_put_dl(uint8_t msg_type, unsigned int len,
+	uint16_t arfcn, uint32_t fn)
+{
+	struct l1ctl_info_dl *dl;
+
+	dl = l1ctl_put(msg_type, 0, sizeof(*dl) + len);
+	if (!dl)
+		return NULL;
+	dl->band_arfcn = htons(arfcn);
+	dl->frame_nr = htonl(fn);
+
+	return dl;
+}
+
+static void tx_block(const struct vl1_block *blk)
+{
+	struct l1ctl_info_dl *dl;
+
+	if (blk->traffic)
+		dl = l1ctl_put_dl(L1CTL_TRAFFIC_IND, TRAFFIC_DATA_LEN,
+				  blk->arfcn, blk->fn);
+	else
+		dl = l1ctl_put_dl(L1CTL_DATA_IND, 23, blk->arfcn, blk->fn);
+	if (!dl)
+		return;
+	dl->chan_nr = blk->chan_nr;
+	dl->link_id = blk->link_id;
+	dl->rx_level = blk->rxlev;
+	dl->snr = blk->snr;
+	memcpy(dl->payload, blk->data, blk->len);
+	cl.fn = blk->fn;
+}
+
+static void print_stats(void)
+{
+	double t = now_sec() - cl.start;
+
+	if (!cl.blocks || cl.reported)
+		return;
+	cl.reported = 1;
+	printf("%lu downlink blocks in %.3f s (%.0f blocks/s)\n",
+		cl.blocks, t, cl.blocks / t);
+}
+
+/* send the downlink blocks that are due */
+static void vl1_pump(void)
+{
+	double due, now;
+
+	if (cl.bfd.fd < 0 || !cl.synced || cl.done)
+		return;
+
+	while (sizeof(cl.obuf) - (cl.olen - cl.opos) > OBUF_HEADROOM) {
+		if (!cl.have_pending) {
+			if (max_blocks && cl.blocks == max_blocks)
+				goto done;
+			if (!source->next(&cl.pending, cl.arfcn))
+				goto done;
+			cl.have_pending = 1;
+			if (!cl.blocks) {
+				cl.start = cl.t0 = now_sec();
+				cl.b0 = cl.pending.t;
+			}
+		}
+		if (speed > 0) {
+			due = cl.t0 + (cl.pending.t - cl.b0) / speed;
+			now = now_sec();
+			if (due > now) {
+				due -= now;
+				osmo_timer_schedule(&pace_timer, (int) due,
+					(int) ((due - (int) due) * 1e6));
+				return;
+			}
+		}
+		tx_block(&cl.pending);
+		cl.have_pending = 0;
+		cl.blocks++;
+	}
+	return;
+
+done:
+	cl.done = 1;
+	if (cl.opos == cl.olen)
+		print_stats();
+}
+
+static void pace_timer_cb(void *data)
+{
+	vl1_pump();
+}
+
+static void rx_pm_req(struct l1ctl_pm_req *pm)
+{
+	struct l1ctl_pm_conf *pmr = NULL;
+	struct vl1_cell *cell;
+	uint16_t from = ntohs(pm->range.band_arfcn_from);
+	uint16_t to = ntohs(pm->range.band_arfcn_to);
+	uint16_t arfcn;
+	unsigned int n = 0, num;
+
+	if (from > to)
+		to = from;
+	for (arfcn = from; ; arfcn++) {
+		if (!n) {
+			num = to - arfcn + 1;
+			if (num > PM_PER_MSG)
+				num = PM_PER_MSG;
+			pmr = l1ctl_put(L1CTL_PM_CONF,
+				arfcn + num - 1 == to ? L1CTL_F_DONE : 0,
+				num * sizeof(*pmr));
+			if (!pmr)
+				return;
+			n = num;
+		}
+		cell = cell_get(arfcn, 0);
+		pmr->band_arfcn = htons(arfcn);
+		pmr->pm[0] = pmr->pm[1] = cell ? cell->rxlev : 0;
+		pmr++;
+		n--;
+		if (arfcn == to)
+			break;
+	}
+}
+
+static void rx_fbsb_req(struct l1ctl_fbsb_req *req)
+{
+	uint16_t arfcn = ntohs(req->band_arfcn);
+	struct vl1_cell *cell = cell_get(arfcn, 0);
+	struct l1ctl_info_dl *dl;
+	struct l1ctl_fbsb_conf *conf;
+
+	cl.synced = cell != NULL;
+	cl.arfcn = arfcn;
+	cl.ccch_mode = req->ccch_mode;
+	cl.have_pending = 0;
+	cl.done = 0;
+	print_stats();
+	cl.blocks = 0;
+	cl.reported = 0;
+	osmo_timer_del(&pace_timer);
+	if (cell)
+		source->rewind();
+
+	dl = l1ctl_put_dl(L1CTL_FBSB_CONF, sizeof(*conf), arfcn, 0);
+	if (!dl)
+		return;
+	conf = (struct l1ctl_fbsb_conf *) dl->payload;
+	if (cell) {
+		dl->rx_level = cell->rxlev;
+		dl->snr = cell->snr;
+		conf->result = 0;
+		conf->bsic = cell->bsic;
+	} else
+		conf->result = 255;
+}
+
+static void rx_l1ctl(struct l1ctl_hdr *l1h, unsigned int len)
+{
+	struct l1ctl_info_ul *ul = (struct l1ctl_info_ul *) l1h->data;
+	struct l1ctl_info_dl *dl;
+	struct l1ctl_reset *res;
+	uint8_t *data;
+
+	if (len < sizeof(*l1h) + sizeof(*res)) {
+		fprintf(stderr, "Short L1CTL message %u\n", l1h->msg_type);
+		return;
+	}
+	len -= sizeof(*l1h);
+
+	switch (l1h->msg_type) {
+	case L1CTL_RESET_REQ:
+		res = (struct l1ctl_reset *) l1h->data;
+		if (res->type == L1CTL_RES_T_FULL) {
+			cl.synced = 0;
+			osmo_timer_del(&pace_timer);
+		}
+		data = l1ctl_put(L1CTL_RESET_CONF, 0, sizeof(*res));
+		if (data)
+			memcpy(data, res, sizeof(*res));
+		break;
+	case L1CTL_ECHO_REQ:
+		data = l1ctl_put(L1CTL_ECHO_CONF, 0, len);
+		if (data)
+			memcpy(data, l1h->data, len);
+		break;
+	case L1CTL_PM_REQ:
+		if (len >= sizeof(struct l1ctl_pm_req))
+			rx_pm_req((struct l1ctl_pm_req *) l1h->data);
+		break;
+	case L1CTL_FBSB_REQ:
+		if (len >= sizeof(struct l1ctl_fbsb_req))
+			rx_fbsb_req((struct l1ctl_fbsb_req *) l1h->data);
+		break;
+	case L1CTL_CCCH_MODE_REQ:
+		cl.ccch_mode = l1h->data[0];
+		data = l1ctl_put(L1CTL_CCCH_MODE_CONF, 0,
+				 sizeof(struct l1ctl_ccch_mode_conf));
+		if (data)
+			data[0] = cl.ccch_mode;
+		break;
+	case L1CTL_TCH_MODE_REQ:
+		data = l1ctl_put(L1CTL_TCH_MODE_CONF, 0,
+				 sizeof(struct l1ctl_tch_mode_conf));
+		if (data) {
+			data[0] = l1h->data[0];
+			data[1] = l1h->data[1];
+		}
+		break;
+	case L1CTL_RACH_REQ:
+		l1ctl_put_dl(L1CTL_RACH_CONF, 0, cl.arfcn, cl.fn);
+		break;
+	case L1CTL_DATA_REQ:
+		dl = l1ctl_put_dl(L1CTL_DATA_CONF, 0, cl.arfcn, cl.fn);
+		if (dl) {
+			dl->chan_nr = ul->chan_nr;
+			dl->link_id = ul->link_id;
+		}
+		break;
+	case L1CTL_TRAFFIC_REQ:
+		l1ctl_put_dl(L1CTL_TRAFFIC_CONF, 0, cl.arfcn, cl.fn);
+		break;
+	default:
+		/* dedicated mode, crypto, neighbour PM: nothing to answer */
+		break;
+	}
+}
+
+static void client_close(void)
+{
+	print_stats();
+	osmo_timer_del(&pace_timer);
+	osmo_fd_unregister(&cl.bfd);
+	close(cl.bfd.fd);
+	cl.bfd.fd = -1;
+	osmo_fd_update_when(&listen_bfd, BSC_FD_READ);
+}
+
+static int client_read(void)
+{
+	unsigned int pos = 0, len;
+	int rc;
+
+	rc = read(cl.bfd.fd, cl.rbuf + cl.rlen, sizeof(cl.rbuf) - cl.rlen);
+	if (rc <= 0)
+		return rc < 0 && errno == EAGAIN ? 0 : -EIO;
+	cl.rlen += rc;
+
+	while (cl.rlen - pos >= 2) {
+		len = cl.rbuf[pos] << 8 | cl.rbuf[pos + 1];
+		if (len > sizeof(cl.rbuf) - 2)
+			return -EMSGSIZE;
+		if (cl.rlen - pos < 2 + len)
+			break;
+		rx_l1ctl((struct l1ctl_hdr *) (cl.rbuf + pos + 2), len);
+		pos += 2 + len;
+	}
+	cl.rlen -= pos;
+	memmove(cl.rbuf, cl.rbuf + pos, cl.rlen);
+
+	return 0;
+}
+
+static int client_write(void)
+{
+	int rc;
+
+	rc = write(cl.bfd.fd, cl.obuf + cl.opos, cl.olen - cl.opos);
+	if (rc < 0)
+		return errno == EAGAIN ? 0 : -errno;
+	cl.opos += rc;
+	if (cl.opos == cl.olen) {
+		cl.opos = cl.olen = 0;
+		osmo_fd_update_when(&cl.bfd, cl.bfd.when & ~BSC_FD_WRITE);
+		if (cl.done)
+			print_stats();
+	}
+
+	return 0;
+}
+
+static int client_cb(struct osmo_fd *bfd, unsigned int what)
+{
+	int rc = 0;
+
+	if (what & BSC_FD_READ)
+		rc = client_read();
+	if (rc == 0 && (what & BSC_FD_WRITE))
+		rc = client_write();
+	if (rc < 0) {
+		client_close();
+		return 0;
+	}
+	vl1_pump();
+
+	return 0;
+}
+
+static int listen_cb(struct osmo_fd *bfd, unsigned int what)
+{
+	int fd;
+
+	fd = accept(bfd->fd, NULL, NULL);
+	if (fd < 0)
+		return 0;
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	memset(&cl, 0, sizeof(cl));
+	cl.bfd.fd = fd;
+	cl.bfd.cb = client_cb;
+	cl.bfd.when = BSC_FD_READ;
+	osmo_fd_register(&cl.bfd);
+	/* one client at a time, like the phone */
+	osmo_fd_update_when(&listen_bfd, 0);
+
+	printf("Client connected\n");
+	return 0;
+}
+
+static void sighandler(int sigset)
+{
+	fprintf(stderr, "Signal %d received.\n", sigset);
+	if (cl.bfd.fd >= 0)
+		print_stats();
+	exit(0);
+}
+
+static void print_help(const char *app)
+{
+	printf("Usage: %s [-r scenario] [-p trace.pcap] [options]\n", app);
+	printf(" Some help...\n");
+	printf("  -h --help		this text\n");
+	printf("  -s --socket		/tmp/osmocom_l2. Path to the unix "
+		"domain socket\n");
+	printf("  -r --scenario		Cells and their System Information\n");
+	printf("  -p --pcap		Replay the GSMTAP frames of a pcap "
+		"file\n");
+	printf("  -x --speed		1. Speed relative to real time, 0 "
+		"sends as fast as possible\n");
+	printf("  -n --blocks		Stop after this many downlink blocks\n");
+	printf("  -l --loop		Loop the trace\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_un local;
+	const char *socket_path = "/tmp/osmocom_l2";
+	const char *scenario = NULL, *pcap = NULL;
+	int rc;
+
+	l23_ctx = talloc_named_const(NULL, 1, "virt_l1");
+
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"socket", 1, 0, 's'},
+			{"scenario", 1, 0, 'r'},
+			{"pcap", 1, 0, 'p'},
+			{"speed", 1, 0, 'x'},
+			{"blocks", 1, 0, 'n'},
+			{"loop", 0, 0, 'l'},
+			{0, 0, 0, 0},
+		};
+
+		c = getopt_long(argc, argv, "hs:r:p:x:n:l",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help(argv[0]);
+			exit(0);
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'r':
+			scenario = optarg;
+			break;
+		case 'p':
+			pcap = optarg;
+			break;
+		case 'x':
+			speed = atof(optarg);
+			break;
+		case 'n':
+			max_blocks = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			loop_trace = 1;
+			break;
+		default:
+			print_help(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!scenario && !pcap) {
+		print_help(argv[0]);
+		exit(1);
+	}
+	/* scenario cells take precedence over the ones seen in the trace */
+	if (scenario && scenario_load(scenario) < 0)
+		exit(1);
+	if (pcap) {
+		if (pcap_load(pcap) < 0)
+			exit(1);
+		if (!trace_len) {
+			fprintf(stderr, "No GSMTAP frames in '%s'\n", pcap);
+			exit(1);
+		}
+		printf("Loaded %u GSMTAP frames\n", trace_len);
+		source = &trace_source;
+	} else
+		source = &scenario_source;
+
+	signal(SIGINT, sighandler);
+	signal(SIGTERM, sighandler);
+	signal(SIGPIPE, SIG_IGN);
+	pace_timer.cb = pace_timer_cb;
+	cl.bfd.fd = -1;
+
+	memset(&local, 0, sizeof(local));
+	local.sun_family = AF_UNIX;
+	strncpy(local.sun_path, socket_path, sizeof(local.sun_path) - 1);
+	unlink(local.sun_path);
+	listen_bfd.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_bfd.fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+	rc = bind(listen_bfd.fd, (struct sockaddr *) &local, sizeof(local));
+	if (rc == 0)
+		rc = listen(listen_bfd.fd, 1);
+	if (rc < 0) {
+		fprintf(stderr, "Failed to listen on '%s': %s\n",
+			local.sun_path, strerror(errno));
+		exit(1);
+	}
+	listen_bfd.cb = listen_cb;
+	listen_bfd.when = BSC_FD_READ;
+	osmo_fd_register(&listen_bfd);
+
+	printf("Virtual L1 (%s) listening on %s\n", source->name,
+		local.sun_path);
+
+	while (1) {
+		vl1_pump();
+		osmo_select_main(0);
+	}
+
+	return 0;
+}
@@ -26,6 +26,10 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/talloc.h>
@@ -45,6 +49,20 @@
 
 const char *ba_version = "osmocom BA V1\n";
 
+/* header of the cell cache file, followed by struct gsm322_cell_cache */
+struct gsm322_cache_hdr {
+	char			magic[16];
+	uint32_t		version;
+	uint32_t		rec_size;
+	uint32_t		num;
+	uint32_t		spare;
+};
+
+static const char cache_magic[16] = "osmocom CELLS\n";
+#define GSM322_CACHE_VERSION	1
+/* cached cells older than this are not used anymore */
+#define GSM322_CACHE_MAX_AGE	(24 * 3600)
+
 extern void *l23_ctx;
 
 static void gsm322_cs_timeout(void *arg);
@@ -2175,14 +2193,309 @@ static int gsm322_search_end(struct osmocom_ms *ms)
 }
 
 
+/*
+ * cell cache
+ *
+ * The sysinfo messages of cells found during the last run are kept in the
+ * cell cache. When the same cell is tuned again, the first received
+ * message is compared with the cached one. If it matches, the other cached
+ * messages are used, instead of waiting for them to be broadcast again.
+ */
+
+/* store the sysinfo messages of the current cell in the cache */
+static void gsm322_cache_update(struct gsm322_cellsel *cs)
+{
+	struct gsm322_cs_list *l = &cs->list[cs->arfci];
+	struct gsm48_sysinfo *s = cs->si;
+	struct gsm322_cell_cache *c = l->cache;
+
+	if (!s->si3)
+		return;
+	if (!c) {
+		c = talloc_zero(l23_ctx, struct gsm322_cell_cache);
+		if (!c)
+			return;
+		l->cache = c;
+	}
+	c->arfcn = index2arfcn(cs->arfci);
+	c->bsic = s->bsic;
+	c->rxlev = l->rxlev;
+	c->si_mask = 0;
+	if (s->si1) {
+		c->si_mask |= GSM322_CACHE_SI1;
+		memcpy(c->si1, s->si1_msg, sizeof(c->si1));
+	}
+	if (s->si2) {
+		c->si_mask |= GSM322_CACHE_SI2;
+		memcpy(c->si2, s->si2_msg, sizeof(c->si2));
+	}
+	if (s->si2bis) {
+		c->si_mask |= GSM322_CACHE_SI2bis;
+		memcpy(c->si2bis, s->si2b_msg, sizeof(c->si2bis));
+	}
+	if (s->si2ter) {
+		c->si_mask |= GSM322_CACHE_SI2ter;
+		memcpy(c->si2ter, s->si2t_msg, sizeof(c->si2ter));
+	}
+	if (s->si3) {
+		c->si_mask |= GSM322_CACHE_SI3;
+		memcpy(c->si3, s->si3_msg, sizeof(c->si3));
+	}
+	if (s->si4) {
+		c->si_mask |= GSM322_CACHE_SI4;
+		memcpy(c->si4, s->si4_msg, sizeof(c->si4));
+	}
+	c->time = time(NULL);
+}
+
+/* compare received sysinfo with the cache
+ * return 1 if it matches, -1 if it differs, 0 if it is not cached */
+static int gsm322_cache_check(struct gsm322_cellsel *cs, uint8_t type)
+{
+	struct gsm322_cell_cache *c = cs->list[cs->arfci].cache;
+	struct gsm48_sysinfo *s = cs->si;
+	uint8_t *cached, *msg;
+	uint8_t flag;
+
+	switch (type) {
+	case GSM48_MT_RR_SYSINFO_1:
+		flag = GSM322_CACHE_SI1;
+		cached = c->si1;
+		msg = s->si1_msg;
+		break;
+	case GSM48_MT_RR_SYSINFO_2:
+		flag = GSM322_CACHE_SI2;
+		cached = c->si2;
+		msg = s->si2_msg;
+		break;
+	case GSM48_MT_RR_SYSINFO_2bis:
+		flag = GSM322_CACHE_SI2bis;
+		cached = c->si2bis;
+		msg = s->si2b_msg;
+		break;
+	case GSM48_MT_RR_SYSINFO_2ter:
+		flag = GSM322_CACHE_SI2ter;
+		cached = c->si2ter;
+		msg = s->si2t_msg;
+		break;
+	case GSM48_MT_RR_SYSINFO_3:
+		flag = GSM322_CACHE_SI3;
+		cached = c->si3;
+		msg = s->si3_msg;
+		break;
+	case GSM48_MT_RR_SYSINFO_4:
+		flag = GSM322_CACHE_SI4;
+		cached = c->si4;
+		msg = s->si4_msg;
+		break;
+	default:
+		return 0;
+	}
+	if (!(c->si_mask & flag))
+		return 0;
+	if (c->bsic != s->bsic || memcmp(cached, msg, 23))
+		return -1;
+
+	return 1;
+}
+
+/* decode the cached sysinfo messages that have not been received yet */
+static void gsm322_cache_apply(struct gsm48_sysinfo *s,
+	struct gsm322_cell_cache *c)
+{
+	if ((c->si_mask & GSM322_CACHE_SI1) && !s->si1)
+		gsm48_decode_sysinfo1(s,
+			(struct gsm48_system_information_type_1 *) c->si1,
+			sizeof(c->si1));
+	if ((c->si_mask & GSM322_CACHE_SI2) && !s->si2)
+		gsm48_decode_sysinfo2(s,
+			(struct gsm48_system_information_type_2 *) c->si2,
+			sizeof(c->si2));
+	if ((c->si_mask & GSM322_CACHE_SI2bis) && !s->si2bis)
+		gsm48_decode_sysinfo2bis(s,
+			(struct gsm48_system_information_type_2bis *) c->si2bis,
+			sizeof(c->si2bis));
+	if ((c->si_mask & GSM322_CACHE_SI2ter) && !s->si2ter)
+		gsm48_decode_sysinfo2ter(s,
+			(struct gsm48_system_information_type_2ter *) c->si2ter,
+			sizeof(c->si2ter));
+	if ((c->si_mask & GSM322_CACHE_SI3) && !s->si3)
+		gsm48_decode_sysinfo3(s,
+			(struct gsm48_system_information_type_3 *) c->si3,
+			sizeof(c->si3));
+	if ((c->si_mask & GSM322_CACHE_SI4) && !s->si4)
+		gsm48_decode_sysinfo4(s,
+			(struct gsm48_system_information_type_4 *) c->si4,
+			sizeof(c->si4));
+}
+
+static void gsm322_cache_read(struct osmocom_ms *ms)
+{
+	struct gsm322_cellsel *cs = &ms->cellsel;
+	char filename[PATH_MAX];
+	struct gsm322_cache_hdr *hdr;
+	struct gsm322_cell_cache *rec, *c;
+	struct stat st;
+	void *map = MAP_FAILED;
+	time_t now = time(NULL);
+	uint32_t n;
+	int fd, i, num = 0;
+
+	sprintf(filename, "%s/%s.cells", config_dir, ms->name);
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		LOGP(DCS, LOGL_INFO, "No stored cell cache\n");
+		return;
+	}
+	if (fstat(fd, &st) == 0 && st.st_size >= sizeof(*hdr))
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		LOGP(DCS, LOGL_NOTICE, "Failed to read cell cache\n");
+		return;
+	}
+
+	hdr = map;
+	if (memcmp(hdr->magic, cache_magic, sizeof(hdr->magic))
+	 || hdr->version != GSM322_CACHE_VERSION
+	 || hdr->rec_size != sizeof(*rec)
+	 || hdr->num > (st.st_size - sizeof(*hdr)) / sizeof(*rec)) {
+		LOGP(DCS, LOGL_NOTICE, "Cell cache version missmatch, "
+			"stored cells become obsolete.\n");
+		goto out;
+	}
+
+	rec = (struct gsm322_cell_cache *) (hdr + 1);
+	for (n = 0; n < hdr->num; n++, rec++) {
+		i = arfcn2index(rec->arfcn);
+		if (!(cs->list[i].flags & GSM322_CS_FLAG_SUPPORT)
+		 || cs->list[i].cache
+		 || !(rec->si_mask & GSM322_CACHE_SI3))
+			continue;
+		if (rec->time > now || now - rec->time > GSM322_CACHE_MAX_AGE)
+			continue;
+		c = talloc_zero(l23_ctx, struct gsm322_cell_cache);
+		if (!c)
+			break;
+		memcpy(c, rec, sizeof(*c));
+		cs->list[i].cache = c;
+		num++;
+	}
+	LOGP(DCS, LOGL_INFO, "Read %d cells from cell cache\n", num);
+
+out:
+	munmap(map, st.st_size);
+}
+
+static void gsm322_cache_write(struct osmocom_ms *ms)
+{
+	struct gsm322_cellsel *cs = &ms->cellsel;
+	char filename[PATH_MAX];
+	struct gsm322_cache_hdr hdr;
+	FILE *fp;
+	int i, rc = 1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, cache_magic, sizeof(hdr.magic));
+	hdr.version = GSM322_CACHE_VERSION;
+	hdr.rec_size = sizeof(struct gsm322_cell_cache);
+	for (i = 0; i <= 1023+299; i++) {
+		if (cs->list[i].cache)
+			hdr.num++;
+	}
+
+	sprintf(filename, "%s/%s.cells", config_dir, ms->name);
+	fp = fopen(filename, "w");
+	if (!fp) {
+		LOGP(DCS, LOGL_ERROR, "Failed to write cell cache\n");
+		return;
+	}
+	rc = fwrite(&hdr, sizeof(hdr), 1, fp);
+	for (i = 0; rc && i <= 1023+299; i++) {
+		if (cs->list[i].cache)
+			rc = fwrite(cs->list[i].cache,
+				sizeof(struct gsm322_cell_cache), 1, fp);
+	}
+	fclose(fp);
+	if (!rc)
+		LOGP(DCS, LOGL_ERROR, "Failed to write cell cache\n");
+	else
+		LOGP(DCS, LOGL_INFO, "Write %u cells to cell cache\n",
+			hdr.num);
+}
+
+/* index of the scan range (gsm_sup_smax) of each list index, the index of
+ * the terminating entry if the frequency is not covered by any range */
+static uint8_t gsm322_smax_band[1024+299];
+static uint8_t gsm322_smax_band_init;
+
+static void gsm322_init_smax_band(void)
+{
+	int i, j;
+
+	for (i = 0; i <= 1023+299; i++) {
+		for (j = 0; gsm_sup_smax[j].max; j++) {
+			if (gsm_sup_smax[j].end > gsm_sup_smax[j].start) {
+				if (gsm_sup_smax[j].start <= i
+				 && gsm_sup_smax[j].end >= i)
+					break;
+			} else {
+				if (gsm_sup_smax[j].start <= i && 1023 >= i)
+					break;
+				if (0 <= i && gsm_sup_smax[j].end >= i)
+					break;
+			}
+		}
+		gsm322_smax_band[i] = j;
+	}
+	gsm322_smax_band_init = 1;
+}
+
+/* Build the list of frequencies to scan after the power scan. The list is
+ * sorted by the same weight gsm322_cs_scan() uses: strongest rxlev first,
+ * higher index first on equal level. Levels and signal flags do not change
+ * until the next power scan, so gsm322_cs_scan() only needs to walk the list
+ * and check the flags and band limits of each entry as it comes by.
+ */
+static void gsm322_cs_scan_init(struct gsm322_cellsel *cs)
+{
+	uint8_t mask = GSM322_CS_FLAG_SUPPORT | GSM322_CS_FLAG_POWER
+		| GSM322_CS_FLAG_SIGNAL;
+	uint16_t pos[256];
+	int i, n = 0;
+
+	if (!gsm322_smax_band_init)
+		gsm322_init_smax_band();
+
+	/* counting sort by rxlev */
+	memset(pos, 0, sizeof(pos));
+	for (i = 0; i <= 1023+299; i++) {
+		if ((cs->list[i].flags & mask) == mask)
+			pos[cs->list[i].rxlev]++;
+	}
+	for (i = 255; i >= 0; i--) {
+		uint16_t num = pos[i];
+
+		pos[i] = n;
+		n += num;
+	}
+	for (i = 1023+299; i >= 0; i--) {
+		if ((cs->list[i].flags & mask) == mask)
+			cs->scan_list[pos[cs->list[i].rxlev]++] = i;
+	}
+	cs->scan_num = n;
+	cs->scan_pos = 0;
+	cs->scan_state = 0xffffffff; /* higher than high */
+}
+
 /* tune to first/next unscanned frequency and search for PLMN */
 static int gsm322_cs_scan(struct osmocom_ms *ms)
 {
 	struct gsm322_cellsel *cs = &ms->cellsel;
 	int i;
-	int j, band = 0;
+	int band = 0;
 	uint8_t mask, flags;
-	uint32_t weight = 0, test = cs->scan_state;
+	uint32_t weight = 0;
 
 	/* search for strongest unscanned cell */
 	mask = GSM322_CS_FLAG_SUPPORT | GSM322_CS_FLAG_POWER
@@ -2191,45 +2504,27 @@ static int gsm322_cs_scan(struct osmocom_ms *ms)
 	 || cs->state == GSM322_C5_CHOOSE_CELL)
 		mask |= GSM322_CS_FLAG_BA;
 	flags = mask; /* all masked flags are requied */
-	for (i = 0; i <= 1023+299; i++) {
-		j = 0; /* make gcc happy */
+	while (cs->scan_pos < cs->scan_num) {
+		/* the list is sorted by weight, so an entry that is skipped
+		 * now would also be skipped by any later search */
+		i = cs->scan_list[cs->scan_pos++];
+		band = gsm322_smax_band[i];
 		if (!ms->settings.skip_max_per_band) {
 			/* skip if band has enough freqs. scanned (3.2.1) */
-			for (j = 0; gsm_sup_smax[j].max; j++) {
-				if (gsm_sup_smax[j].end >
-						gsm_sup_smax[j].start) {
-					if (gsm_sup_smax[j].start <= i
-					 && gsm_sup_smax[j].end >= i)
-						break;
-				} else {
-					if (gsm_sup_smax[j].start <= i
-					 && 1023 >= i)
-						break;
-					if (0 <= i
-					 && gsm_sup_smax[j].end >= i)
-						break;
-				}
-			}
-			if (gsm_sup_smax[j].max) {
-				if (gsm_sup_smax[j].temp == gsm_sup_smax[j].max)
-					continue;
-			}
-		}
+			if (gsm_sup_smax[band].max
+			 && gsm_sup_smax[band].temp == gsm_sup_smax[band].max)
+				continue;
+		} else
+			band = 0;
 
 		/* search for unscanned frequency */
 		if ((cs->list[i].flags & mask) == flags) {
 			/* weight depends on the power level
 			 * if it is the same, it depends on arfcn
 			 */
-			test = cs->list[i].rxlev + 1;
-			test = (test << 16) | i;
-			if (test >= cs->scan_state)
-				continue;
-			if (test > weight) {
-				weight = test;
-				band = j;
-			}
-
+			weight = cs->list[i].rxlev + 1;
+			weight = (weight << 16) | i;
+			break;
 		}
 	}
 	cs->scan_state = weight;
@@ -2265,6 +2560,7 @@ static int gsm322_cs_scan(struct osmocom_ms *ms)
 	if (!cs->list[cs->arfci].sysinfo)
 		exit(-ENOMEM);
 	cs->si = cs->list[cs->arfci].sysinfo;
+	cs->cache_used = 0;
 	cs->sync_retries = 0;
 	gsm322_sync_to_cell(cs, NULL, 0);
 
@@ -2306,6 +2602,7 @@ static int gsm322_cs_store(struct osmocom_ms *ms)
 
 	/* store sysinfo */
 	cs->list[cs->arfci].flags |= GSM322_CS_FLAG_SYSINFO;
+	gsm322_cache_update(cs);
 	if (s->cell_barr && !(s->sp && s->sp_cbq))
 		cs->list[cs->arfci].flags |= GSM322_CS_FLAG_BARRED;
 	else
@@ -2457,13 +2754,34 @@ indicate_plmn_avail:
 	return 0;
 }
 
+/* add serving, neighbour and report frequencies of sysinfo to BA bitmap */
+static void gsm322_ba_add_sysinfo(uint8_t *freq, struct gsm48_sysinfo *s,
+	int refer_pcs)
+{
+	struct gsm_freq_set fs;
+	int i;
+
+	gsm48_sysinfo_freq_get(&fs, s,
+		FREQ_TYPE_SERV | FREQ_TYPE_NCELL | FREQ_TYPE_REP);
+	/* move 512..810 to the PCS range, if the cell refers to PCS */
+	if (refer_pcs) {
+		for (i = gsm_freq_set_next(&fs, 512); i >= 0 && i <= 810;
+		     i = gsm_freq_set_next(&fs, i + 1)) {
+			freq[(i-512+1024) >> 3] |= (1 << (i & 7));
+			fs.w[i >> 6] &= ~(1ULL << (i & 63));
+		}
+	}
+	for (i = 0; i < 128; i++)
+		freq[i] |= fs.w[i >> 3] >> ((i & 7) << 3);
+}
+
 /* process system information when returing to idle mode */
 struct gsm322_ba_list *gsm322_cs_sysinfo_sacch(struct osmocom_ms *ms)
 {
 	struct gsm322_cellsel *cs = &ms->cellsel;
 	struct gsm48_sysinfo *s;
 	struct gsm322_ba_list *ba = NULL;
-	int i, refer_pcs;
+	int refer_pcs;
 	uint8_t freq[128+38];
 
 	if (!cs) {
@@ -2491,15 +2809,7 @@ struct gsm322_ba_list *gsm322_cs_sysinfo_sacch(struct osmocom_ms *ms)
 		/* update (add) ba list */
 		refer_pcs = gsm_refer_pcs(cs->arfcn, s);
 		memset(freq, 0, sizeof(freq));
-		for (i = 0; i <= 1023; i++) {
-			if ((s->freq[i].mask & (FREQ_TYPE_SERV
-				| FREQ_TYPE_NCELL | FREQ_TYPE_REP))) {
-				if (refer_pcs && i >= 512 && i <= 810)
-					freq[(i-512+1024) >> 3] |= (1 << (i&7));
-				else
-					freq[i >> 3] |= (1 << (i & 7));
-			}
-		}
+		gsm322_ba_add_sysinfo(freq, s, refer_pcs);
 		if (!!memcmp(freq, ba->freq, sizeof(freq))) {
 			LOGP(DCS, LOGL_INFO, "New BA list (mcc=%s mnc=%s  "
 				"%s, %s).\n", gsm_print_mcc(ba->mcc),
@@ -2517,7 +2827,7 @@ static int gsm322_store_ba_list(struct gsm322_cellsel *cs,
 	struct gsm48_sysinfo *s)
 {
 	struct gsm322_ba_list *ba;
-	int i, refer_pcs;
+	int refer_pcs;
 	uint8_t freq[128+38];
 
 	/* find or create ba list */
@@ -2534,15 +2844,7 @@ static int gsm322_store_ba_list(struct gsm322_cellsel *cs,
 	refer_pcs = gsm_refer_pcs(cs->arfcn, s);
 	memset(freq, 0, sizeof(freq));
 	freq[(cs->arfci) >> 3] |= (1 << (cs->arfci & 7));
-	for (i = 0; i <= 1023; i++) {
-		if ((s->freq[i].mask &
-		    (FREQ_TYPE_SERV | FREQ_TYPE_NCELL | FREQ_TYPE_REP))) {
-			if (refer_pcs && i >= 512 && i <= 810)
-				freq[(i-512+1024) >> 3] |= (1 << (i & 7));
-			else
-				freq[i >> 3] |= (1 << (i & 7));
-		}
-	}
+	gsm322_ba_add_sysinfo(freq, s, refer_pcs);
 	if (!!memcmp(freq, ba->freq, sizeof(freq))) {
 		LOGP(DCS, LOGL_INFO, "New BA list (mcc=%s mnc=%s  "
 			"%s, %s).\n", gsm_print_mcc(ba->mcc),
@@ -2691,6 +2993,31 @@ static int gsm322_c_scan_sysinfo_bcch(struct osmocom_ms *ms, struct msgb *msg)
 		return -EINVAL;
 	}
 
+	/* use cached sysinfo, if the first received message matches */
+	if (cs->list[cs->arfci].cache && !cs->cache_used) {
+		struct gsm322_cell_cache *c = cs->list[cs->arfci].cache;
+		int rc = gsm322_cache_check(cs, gm->sysinfo);
+
+		if (rc > 0) {
+			LOGP(DCS, LOGL_INFO, "Sysinfo matches cell cache, "
+				"using cached sysinfo.\n");
+			cs->cache_used = 1;
+			gsm322_cache_apply(s, c);
+			if (s->si3 && cs->ccch_mode == CCCH_MODE_NONE) {
+				cs->ccch_mode = (s->ccch_conf == 1) ?
+					CCCH_MODE_COMBINED :
+					CCCH_MODE_NON_COMBINED;
+				l1ctl_tx_ccch_mode_req(ms, cs->ccch_mode);
+			}
+		} else if (rc < 0) {
+			LOGP(DCS, LOGL_INFO, "Sysinfo differs from cell "
+				"cache, reading all sysinfo.\n");
+			cs->cache_used = 1;
+			talloc_free(c);
+			cs->list[cs->arfci].cache = NULL;
+		}
+	}
+
 	/* Store BA if we have full system info about cells and neigbor cells.
 	 * Depending on the extended bit in the channel description,
 	 * we require more or less system informations about neighbor cells
@@ -2834,7 +3161,7 @@ static int gsm322_cs_powerscan(struct osmocom_ms *ms)
 			return gsm322_search_end(ms);
 		}
 		LOGP(DCS, LOGL_INFO, "Found %d frequencies.\n", found);
-		cs->scan_state = 0xffffffff; /* higher than high */
+		gsm322_cs_scan_init(cs);
 		/* clear counter of scanned frequencies of each range */
 		for (i = 0; gsm_sup_smax[i].max; i++)
 			gsm_sup_smax[i].temp = 0;
@@ -4440,7 +4767,7 @@ static int gsm322_nb_start(struct osmocom_ms *ms, int synced)
 	struct gsm48_sysinfo *s = &cs->sel_si;
 	struct gsm322_neighbour *nb, *nb2;
 	int i, num;
-	uint8_t map[128];
+	struct gsm_freq_set map, ncell;
 	uint16_t nc[32];
 	uint8_t changed = 0;
 	int refer_pcs, index;
@@ -4454,16 +4781,18 @@ static int gsm322_nb_start(struct osmocom_ms *ms, int synced)
 
 	refer_pcs = gsm_refer_pcs(cs->sel_arfcn, s);
 
-	/* remove all neighbours that are not in list anymore */
-	memset(map, 0, sizeof(map));
-	llist_for_each_entry_safe(nb, nb2, &cs->nb_list, entry) {
-		i = nb->arfcn & 1023;
-		map[i >> 3] |= (1 << (i & 7));
 #ifndef TEST_INCLUDE_SERV
-		if (!(s->freq[i].mask & FREQ_TYPE_NCELL)) {
+	gsm48_sysinfo_freq_get(&ncell, s, FREQ_TYPE_NCELL);
 #else
-		if (!(s->freq[i].mask & (FREQ_TYPE_NCELL | FREQ_TYPE_SERV))) {
+	gsm48_sysinfo_freq_get(&ncell, s, FREQ_TYPE_NCELL | FREQ_TYPE_SERV);
 #endif
+
+	/* remove all neighbours that are not in list anymore */
+	gsm_freq_set_clear(&map);
+	llist_for_each_entry_safe(nb, nb2, &cs->nb_list, entry) {
+		i = nb->arfcn & 1023;
+		gsm_freq_set_add(&map, i);
+		if (!gsm_freq_set_has(&ncell, i)) {
 			LOGP(DNB, LOGL_INFO, "Removing neighbour cell %s from "
 				"list.\n", gsm_print_arfcn(nb->arfcn));
 			gsm322_nb_free(nb);
@@ -4483,14 +4812,8 @@ static int gsm322_nb_start(struct osmocom_ms *ms, int synced)
 	}
 
 	/* add missing entries to list */
-	for (i = 0; i <= 1023; i++) {
-#ifndef TEST_INCLUDE_SERV
-		if ((s->freq[i].mask & FREQ_TYPE_NCELL) &&
-		  !(map[i >> 3] & (1 << (i & 7)))) {
-#else
-		if ((s->freq[i].mask & (FREQ_TYPE_NCELL | FREQ_TYPE_SERV)) &&
-		  !(map[i >> 3] & (1 << (i & 7)))) {
-#endif
+	gsm_freq_set_for_each(i, &ncell) {
+		if (!gsm_freq_set_has(&map, i)) {
 			index = i;
 			if (refer_pcs && i >= 512 && i <= 810)
 				index = i-512+1024;
@@ -5098,6 +5421,9 @@ int gsm322_init(struct osmocom_ms *ms)
 	} else
 		LOGP(DCS, LOGL_INFO, "No stored BA list\n");
 
+	/* read cell cache */
+	gsm322_cache_read(ms);
+
 	return 0;
 }
 
@@ -5124,6 +5450,9 @@ int gsm322_exit(struct osmocom_ms *ms)
 	stop_any_timer(cs);
 	stop_plmn_timer(plmn);
 
+	/* store cell cache */
+	gsm322_cache_write(ms);
+
 	/* flush sysinfo */
 	for (i = 0; i <= 1023+299; i++) {
 		if (cs->list[i].sysinfo) {
@@ -5132,6 +5461,8 @@ int gsm322_exit(struct osmocom_ms *ms)
 			talloc_free(cs->list[i].sysinfo);
 			cs->list[i].sysinfo = NULL;
 		}
+		talloc_free(cs->list[i].cache);
+		cs->list[i].cache = NULL;
 		cs->list[i].flags = 0;
 	}
 
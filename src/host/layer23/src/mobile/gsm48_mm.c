@@ -2088,19 +2088,19 @@ static int gsm48_mm_sysinfo(struct osmocom_ms *ms, struct msgb *msg)
 	if (s->t3212 && s->t3212 != mm->t3212_value) {
 		if (osmo_timer_pending(&mm->t3212)) {
 			int t;
-			struct timeval current_time;
+			struct timeval rest;
 
-			/* get rest time */
-			gettimeofday(&current_time, NULL);
-			t = mm->t3212.timeout.tv_sec - current_time.tv_sec;
-			if (t < 0)
+			/* get rest time, the timer engine may not run on
+			 * gettimeofday(), so don't touch the timeout */
+			if (osmo_timer_remaining(&mm->t3212, NULL, &rest) < 0)
 				t = 0;
+			else
+				t = rest.tv_sec;
 			LOGP(DMM, LOGL_INFO, "New T3212 while timer is running "
 				"(value %d rest %d)\n", s->t3212, t);
 
 			/* rest time modulo given value */
-			mm->t3212.timeout.tv_sec = current_time.tv_sec
-				+ (t % s->t3212);
+			osmo_timer_schedule(&mm->t3212, t % s->t3212, 0);
 		} else {
 			uint32_t rand = random();
 
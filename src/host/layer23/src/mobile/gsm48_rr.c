@@ -1717,6 +1717,7 @@ static int gsm48_new_sysinfo(struct osmocom_ms *ms, uint8_t type)
 	 && s->si5
 	 && (!s->nb_ext_ind_si5 || s->si5bis)) {
 		struct gsm48_rr_meas *rrmeas = &ms->rrlayer.meas;
+		struct gsm_freq_set rep;
 		int n = 0, i, refer_pcs;
 
 		LOGP(DRR, LOGL_NOTICE, "Complete set of SI5* for BA(%d)\n",
@@ -1725,22 +1726,21 @@ static int gsm48_new_sysinfo(struct osmocom_ms *ms, uint8_t type)
 		refer_pcs = gsm_refer_pcs(cs->arfcn, s);
 
 		/* collect channels from freq list (1..1023,0) */
-		for (i = 1; i <= 1024; i++) {
-			if ((s->freq[i & 1023].mask & FREQ_TYPE_REP)) {
-				if (n == 32) {
-					LOGP(DRR, LOGL_NOTICE, "SI5* report "
-						"exceeds 32 BCCHs\n");
-					break;
-				}
-				if (refer_pcs && i >= 512 && i <= 810)
-					rrmeas->nc_arfcn[n] = i | ARFCN_PCS;
-				else
-					rrmeas->nc_arfcn[n] = i & 1023;
-				rrmeas->nc_rxlev_dbm[n] = -128;
-				LOGP(DRR, LOGL_NOTICE, "SI5* report arfcn %s\n",
-					gsm_print_arfcn(rrmeas->nc_arfcn[n]));
-				n++;
+		gsm48_sysinfo_freq_get(&rep, s, FREQ_TYPE_REP);
+		gsm_freq_set_for_each_list(i, &rep) {
+			if (n == 32) {
+				LOGP(DRR, LOGL_NOTICE, "SI5* report "
+					"exceeds 32 BCCHs\n");
+				break;
 			}
+			if (refer_pcs && i >= 512 && i <= 810)
+				rrmeas->nc_arfcn[n] = i | ARFCN_PCS;
+			else
+				rrmeas->nc_arfcn[n] = i & 1023;
+			rrmeas->nc_rxlev_dbm[n] = -128;
+			LOGP(DRR, LOGL_NOTICE, "SI5* report arfcn %s\n",
+				gsm_print_arfcn(rrmeas->nc_arfcn[n]));
+			n++;
 		}
 		rrmeas->nc_num = n;
 	}
@@ -3058,8 +3058,6 @@ static int gsm48_rr_render_ma(struct osmocom_ms *ms, struct gsm48_rr_cd *cd,
 
 	/* decode mobile allocation */
 	if (cd->mob_alloc_lv[0]) {
-		struct gsm_sysinfo_freq *freq = s->freq;
-
 		LOGP(DRR, LOGL_INFO, "decoding mobile allocation\n");
 
 		if (cd->cell_desc_lv[0]) {
@@ -3069,11 +3067,11 @@ static int gsm48_rr_render_ma(struct osmocom_ms *ms, struct gsm48_rr_cd *cd,
 					"has invalid lenght\n");
 				return GSM48_RR_CAUSE_ABNORMAL_UNSPEC;
 			}
-			gsm48_decode_freq_list(freq, cd->cell_desc_lv + 1, 16,
-				0xce, FREQ_TYPE_SERV);
+			gsm48_decode_freq_set(FREQ_SET(s, FREQ_TYPE_SERV),
+				cd->cell_desc_lv + 1, 16, 0xce);
 		}
 
-		gsm48_decode_mobile_alloc(freq, cd->mob_alloc_lv + 1,
+		gsm48_decode_mobile_alloc(s, cd->mob_alloc_lv + 1,
 			cd->mob_alloc_lv[0], ma, ma_len, 0);
 		if (*ma_len < 1) {
 			LOGP(DRR, LOGL_NOTICE, "mobile allocation with no "
@@ -3084,30 +3082,28 @@ static int gsm48_rr_render_ma(struct osmocom_ms *ms, struct gsm48_rr_cd *cd,
 	} else
 	/* decode frequency list */
 	if (cd->freq_list_lv[0]) {
-		struct gsm_sysinfo_freq f[1024];
+		struct gsm_freq_set f;
 		int j = 0;
 
 		LOGP(DRR, LOGL_INFO, "decoding frequency list\n");
 
 		/* get bitmap */
-		if (gsm48_decode_freq_list(f, cd->freq_list_lv + 1,
-			cd->freq_list_lv[0], 0xce, FREQ_TYPE_SERV)) {
+		if (gsm48_decode_freq_set(&f, cd->freq_list_lv + 1,
+			cd->freq_list_lv[0], 0xce)) {
 			LOGP(DRR, LOGL_NOTICE, "frequency list invalid\n");
 			return GSM48_RR_CAUSE_ABNORMAL_UNSPEC;
 		}
 
 		/* collect channels from bitmap (1..1023,0) */
-		for (i = 1; i <= 1024; i++) {
-			if ((f[i & 1023].mask & FREQ_TYPE_SERV)) {
-				LOGP(DRR, LOGL_INFO, "Listed ARFCN #%d: %s\n",
-					j, gsm_print_arfcn((i & 1023) | pcs));
-				if (j == 64) {
-					LOGP(DRR, LOGL_NOTICE, "frequency list "
-						"exceeds 64 entries!\n");
-					return GSM48_RR_CAUSE_ABNORMAL_UNSPEC;
-				}
-				ma[j++] = i & 1023;
+		gsm_freq_set_for_each_list(i, &f) {
+			LOGP(DRR, LOGL_INFO, "Listed ARFCN #%d: %s\n",
+				j, gsm_print_arfcn((i & 1023) | pcs));
+			if (j == 64) {
+				LOGP(DRR, LOGL_NOTICE, "frequency list "
+					"exceeds 64 entries!\n");
+				return GSM48_RR_CAUSE_ABNORMAL_UNSPEC;
 			}
+			ma[j++] = i & 1023;
 		}
 		*ma_len = j;
 	} else
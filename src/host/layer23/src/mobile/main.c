@@ -23,6 +23,7 @@
 
 #include <osmocom/bb/common/osmocom_data.h>
 #include <osmocom/bb/common/logging.h>
+#include <osmocom/bb/common/networks.h>
 #include <osmocom/bb/mobile/app_mobile.h>
 
 #include <osmocom/core/talloc.h>
@@ -58,6 +59,7 @@ int debug_set = 0;
 char *config_dir = NULL;
 int use_mncc_sock = 0;
 int daemonize = 0;
+static char *networks_file = NULL;
 
 int mncc_recv_socket(struct osmocom_ms *ms, int msg_type, void *arg);
 
@@ -98,6 +100,8 @@ static void print_help()
 	printf("  -D --daemonize	Run as daemon\n");
 	printf("  -m --mncc-sock	Disable built-in MNCC handler and "
 		"offer socket\n");
+	printf("  -n --networks		Read the network names from this "
+		"file\n");
 }
 
 static void handle_options(int argc, char **argv)
@@ -112,10 +116,11 @@ static void handle_options(int argc, char **argv)
 			{"debug", 1, 0, 'd'},
 			{"daemonize", 0, 0, 'D'},
 			{"mncc-sock", 0, 0, 'm'},
+			{"networks", 1, 0, 'n'},
 			{0, 0, 0, 0},
 		};
 
-		c = getopt_long(argc, argv, "hi:u:v:d:Dm",
+		c = getopt_long(argc, argv, "hi:u:v:d:Dmn:",
 				long_options, &option_index);
 		if (c == -1)
 			break;
@@ -145,6 +150,9 @@ static void handle_options(int argc, char **argv)
 		case 'm':
 			use_mncc_sock = 1;
 			break;
+		case 'n':
+			networks_file = optarg;
+			break;
 		default:
 			break;
 		}
@@ -225,8 +233,19 @@ int main(int argc, char **argv)
 		log_parse_category_mask(stderr_target, debug_default);
 	log_set_log_level(stderr_target, LOGL_DEBUG);
 
+	if (networks_file) {
+		rc = gsm_networks_load(networks_file);
+		if (rc < 0) {
+			fprintf(stderr, "Failed to read networks from '%s': "
+				"%s\n", networks_file, strerror(-rc));
+			exit(1);
+		}
+		printf("Read %d networks from '%s'\n", rc, networks_file);
+	}
+
 	if (gsmtap_ip) {
-		gsmtap_inst = gsmtap_source_init(gsmtap_ip, GSMTAP_UDP_PORT, 1);
+		gsmtap_inst = gsmtap_source_init(gsmtap_ip, GSMTAP_UDP_PORT,
+						 GSMTAP_MODE_BATCH);
 		if (!gsmtap_inst) {
 			fprintf(stderr, "Failed during gsmtap_init()\n");
 			exit(1);
@@ -275,6 +294,10 @@ int main(int argc, char **argv)
 		osmo_select_main(0);
 	}
 
+	/* batch mode holds back the last packets, the detach among them */
+	if (gsmtap_inst)
+		gsmtap_flush(gsmtap_inst);
+
 	l23_app_exit();
 
 	talloc_free(config_file);
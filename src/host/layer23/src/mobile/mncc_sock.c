@@ -71,13 +71,15 @@ int mncc_sock_from_cc(struct mncc_sock_state *state, struct msgb *msg)
 
 	/* Actually enqueue the message and mark socket write need */
 	msgb_enqueue(&state->upqueue, msg);
-	state->conn_bfd.when |= BSC_FD_WRITE;
+	osmo_fd_update_when(&state->conn_bfd,
+			    state->conn_bfd.when | BSC_FD_WRITE);
 	return 0;
 }
 
 void mncc_sock_write_pending(struct mncc_sock_state *state)
 {
-	state->conn_bfd.when |= BSC_FD_WRITE;
+	osmo_fd_update_when(&state->conn_bfd,
+			    state->conn_bfd.when | BSC_FD_WRITE);
 }
 
 /* FIXME: move this to libosmocore */
@@ -89,12 +91,13 @@ static void mncc_sock_close(struct mncc_sock_state *state)
 
 	LOGP(DMNCC, LOGL_NOTICE, "MNCC Socket has closed connection\n");
 
+	osmo_fd_unregister(bfd);
 	close(bfd->fd);
 	bfd->fd = -1;
-	osmo_fd_unregister(bfd);
 
 	/* re-enable the generation of ACCEPT for new connections */
-	state->listen_bfd.when |= BSC_FD_READ;
+	osmo_fd_update_when(&state->listen_bfd,
+			    state->listen_bfd.when | BSC_FD_READ);
 
 	/* FIXME: make sure we don't enqueue anymore */
 
@@ -158,7 +161,7 @@ static int mncc_sock_write(struct osmo_fd *bfd)
 		msg = llist_entry(state->upqueue.next, struct msgb, list);
 		mncc_prim = (struct gsm_mncc *)msg->data;
 
-		bfd->when &= ~BSC_FD_WRITE;
+		osmo_fd_update_when(bfd, bfd->when & ~BSC_FD_WRITE);
 
 		/* bug hunter 8-): maybe someone forgot msgb_put(...) ? */
 		if (!msgb_length(msg)) {
@@ -173,7 +176,7 @@ static int mncc_sock_write(struct osmo_fd *bfd)
 			goto close;
 		if (rc < 0) {
 			if (errno == EAGAIN) {
-				bfd->when |= BSC_FD_WRITE;
+				osmo_fd_update_when(bfd, bfd->when | BSC_FD_WRITE);
 				break;
 			}
 			goto close;
@@ -228,7 +231,8 @@ static int mncc_sock_accept(struct osmo_fd *bfd, unsigned int flags)
 		LOGP(DMNCC, LOGL_NOTICE, "MNCC app connects but we already have "
 			"another active connection ?!?\n");
 		/* We already have one MNCC app connected, this is all we support */
-		state->listen_bfd.when &= ~BSC_FD_READ;
+		osmo_fd_update_when(&state->listen_bfd,
+				    state->listen_bfd.when & ~BSC_FD_READ);
 		close(rc);
 		return 0;
 	}
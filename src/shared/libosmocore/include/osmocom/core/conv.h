@@ -106,6 +106,8 @@ int  osmo_conv_encode(const struct osmo_conv_code *code,
 
 	/* Low level API */
 
+struct osmo_conv_trellis;
+
 /*! \brief convolutional decoder state */
 struct osmo_conv_decoder {
 	const struct osmo_conv_code *code; /*!< \brief for which code? */
@@ -120,6 +122,8 @@ struct osmo_conv_decoder {
 	unsigned int *ae;	/*!< \brief accumulated error */
 	unsigned int *ae_next;	/*!< \brief next accumulated error (tmp in scan) */
 	uint8_t *state_history;	/*!< \brief state history [len][n_states] */
+
+	struct osmo_conv_trellis *trellis; /*!< \brief precomputed transitions */
 };
 
 void osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
@@ -44,6 +44,17 @@ struct osmo_crcXXgen_code {
 	uintXX_t remainder; /*!< \brief Remainder of the CRC (final XOR) */
 };
 
+/*! \brief lookup tables for the byte wise computation of a CRC code
+ *
+ * Built once per code with osmo_crcXXgen_table_init().
+ */
+struct osmo_crcXXgen_table {
+	const struct osmo_crcXXgen_code *code; /*!< \brief Code of the tables */
+	uintXX_t slice[8][256]; /*!< \brief Slice-by-8 tables (left aligned) */
+	uint64_t fold[2];   /*!< \brief x^192 and x^128 mod P, for folding */
+	int clmul;          /*!< \brief Use carry-less multiplication */
+};
+
 uintXX_t osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
                                     const ubit_t *in, int len);
 int osmo_crcXXgen_check_bits(const struct osmo_crcXXgen_code *code,
@@ -51,6 +62,11 @@ int osmo_crcXXgen_check_bits(const struct osmo_crcXXgen_code *code,
 void osmo_crcXXgen_set_bits(const struct osmo_crcXXgen_code *code,
                             const ubit_t *in, int len, ubit_t *crc_bits);
 
+void osmo_crcXXgen_table_init(struct osmo_crcXXgen_table *tbl,
+                              const struct osmo_crcXXgen_code *code);
+uintXX_t osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_table *tbl,
+                                     const pbit_t *in, int len);
+
 
 /*! @} */
 
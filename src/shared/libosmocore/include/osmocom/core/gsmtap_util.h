@@ -20,11 +20,26 @@ struct msgb *gsmtap_makemsg(uint16_t arfcn, uint8_t ts, uint8_t chan_type,
 			    uint8_t ss, uint32_t fn, int8_t signal_dbm,
 			    uint8_t snr, const uint8_t *data, unsigned int len);
 
+/*! \brief how a gsmtap instance hands messages to its socket */
+enum gsmtap_inst_mode {
+	GSMTAP_MODE_DIRECT = 0,	/*!< \brief write() each message */
+	GSMTAP_MODE_WQ = 1,	/*!< \brief \ref osmo_wqueue, one write() each */
+	GSMTAP_MODE_BATCH = 2,	/*!< \brief packet ring, flushed by sendmmsg() */
+};
+
+/*! \brief packets the ring of a \ref GSMTAP_MODE_BATCH instance holds */
+#define GSMTAP_BATCH_SLOTS	64
+
+struct gsmtap_batch;
+
 /*! \brief one gsmtap instance */
 struct gsmtap_inst {
-	int ofd_wq_mode;	/*!< \brief wait queue mode? */
+	int ofd_wq_mode;	/*!< \brief \ref gsmtap_inst_mode */
 	struct osmo_wqueue wq;	/*!< \brief the wait queue */
 	struct osmo_fd sink_ofd;/*!< \brief file descriptor */
+	struct gsmtap_batch *batch; /*!< \brief packet ring (batch mode) */
+	unsigned long tx_packets; /*!< \brief packets sent */
+	unsigned long tx_dropped; /*!< \brief packets lost (full, error) */
 };
 
 /*! \brief obtain the file descriptor associated with a gsmtap instance */
@@ -42,6 +57,10 @@ struct gsmtap_inst *gsmtap_source_init(const char *host, uint16_t port,
 
 int gsmtap_source_add_sink(struct gsmtap_inst *gti);
 
+int gsmtap_set_batch_len(struct gsmtap_inst *gti, unsigned int len);
+
+int gsmtap_flush(struct gsmtap_inst *gti);
+
 int gsmtap_sendmsg(struct gsmtap_inst *gti, struct msgb *msg);
 
 int gsmtap_send_ex(struct gsmtap_inst *gti, uint8_t type, uint16_t arfcn, uint8_t ts,
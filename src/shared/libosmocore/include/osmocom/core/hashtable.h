@@ -0,0 +1,121 @@
+#ifndef _OSMO_HASHTABLE_H
+#define _OSMO_HASHTABLE_H
+
+/*! \defgroup hashtable Hash tables
+ *  @{
+ */
+
+/*! \file hashtable.h
+ *  \brief Resizable hash table of nodes embedded in the hashed objects
+ *
+ * The caller computes a 32 bit hash value of the key and keeps the key
+ * itself in its object. The table only compares hash values, so a lookup
+ * has to compare the key of each object it returns. The number of buckets
+ * grows with the number of entries. A zero-initialized table is empty and
+ * ready to use.
+ */
+
+#include <stdint.h>
+
+#include <osmocom/core/linuxlist.h>
+
+/*! \brief node of a hash table, embedded in the hashed object */
+struct osmo_hash_node {
+	struct llist_head list;	/*!< \brief entry in the bucket */
+	uint32_t hash;		/*!< \brief hash value of the key */
+};
+
+/*! \brief hash table */
+struct osmo_hashtable {
+	struct llist_head *bucket;	/*!< \brief array of buckets */
+	unsigned int bits;		/*!< \brief log2 of the number of buckets */
+	unsigned int count;		/*!< \brief number of entries */
+	void *ctx;			/*!< \brief talloc context of the buckets */
+};
+
+/*! \brief mix a value into a hash value
+ *  \param[in] val value to be hashed
+ *
+ * Multiplication by the golden ratio. The upper bits of the result,
+ * which select the bucket, depend on all bits of the value. */
+static inline uint32_t osmo_hash_32(uint32_t val)
+{
+	return val * 0x61c88647;
+}
+
+int osmo_hash_init(struct osmo_hashtable *ht, void *ctx, unsigned int bits);
+void osmo_hash_free(struct osmo_hashtable *ht);
+int osmo_hash_add(struct osmo_hashtable *ht, struct osmo_hash_node *node,
+		  uint32_t hash);
+void osmo_hash_del(struct osmo_hashtable *ht, struct osmo_hash_node *node);
+
+/*! \brief check if a node is in a hash table */
+static inline int osmo_hash_hashed(const struct osmo_hash_node *node)
+{
+	return node->list.next != NULL;
+}
+
+/*! \brief get the bucket of a hash value, the table must have buckets */
+static inline struct llist_head *
+osmo_hash_bucket(const struct osmo_hashtable *ht, uint32_t hash)
+{
+	return &ht->bucket[hash >> (32 - ht->bits)];
+}
+
+/*! \brief get the next node with the given hash value
+ *  \param[in] ht hash table
+ *  \param[in] pos list entry after which to search
+ *  \param[in] hash hash value
+ *  \returns the node, or NULL if there is none */
+static inline struct osmo_hash_node *
+_osmo_hash_next(const struct osmo_hashtable *ht, struct llist_head *pos,
+		uint32_t hash)
+{
+	struct llist_head *head = osmo_hash_bucket(ht, hash);
+	struct osmo_hash_node *node;
+
+	for (pos = pos->next; pos != head; pos = pos->next) {
+		node = llist_entry(pos, struct osmo_hash_node, list);
+		if (node->hash == hash)
+			return node;
+	}
+	return NULL;
+}
+
+/*! \brief get the first node with the given hash value
+ *  \returns the node, or NULL if there is none */
+static inline struct osmo_hash_node *
+osmo_hash_first(const struct osmo_hashtable *ht, uint32_t hash)
+{
+	if (!ht->count)
+		return NULL;
+	return _osmo_hash_next(ht, osmo_hash_bucket(ht, hash), hash);
+}
+
+/*! \brief get the next node with the same hash value
+ *  \returns the node, or NULL if there is none */
+static inline struct osmo_hash_node *
+osmo_hash_next(const struct osmo_hashtable *ht, struct osmo_hash_node *node)
+{
+	return _osmo_hash_next(ht, &node->list, node->hash);
+}
+
+/*! \brief get the object of a node, NULL if there is no node */
+#define osmo_hash_entry(node, type, member) \
+	((node) ? llist_entry(node, type, member) : NULL)
+
+/*! \brief iterate over all objects with the given hash value
+ *  \param ht hash table
+ *  \param pos pointer to the object, used as loop variable
+ *  \param member name of the struct osmo_hash_node in the object
+ *  \param hash hash value */
+#define osmo_hash_for_each_possible(ht, pos, member, hash)		\
+	for (pos = osmo_hash_entry(osmo_hash_first(ht, hash),		\
+				   typeof(*pos), member);		\
+	     pos;							\
+	     pos = osmo_hash_entry(osmo_hash_next(ht, &pos->member),	\
+				   typeof(*pos), member))
+
+/*! @} */
+
+#endif /* _OSMO_HASHTABLE_H */
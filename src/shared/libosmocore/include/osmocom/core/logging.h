@@ -20,8 +20,16 @@
 #define DEBUG
 
 #ifdef DEBUG
-#define DEBUGP(ss, fmt, args...) logp(ss, __FILE__, __LINE__, 0, fmt, ## args)
-#define DEBUGPC(ss, fmt, args...) logp(ss, __FILE__, __LINE__, 1, fmt, ## args)
+#define DEBUGP(ss, fmt, args...) \
+	do { \
+		if (log_check_level(ss, LOGL_DEBUG)) \
+			logp(ss, __FILE__, __LINE__, 0, fmt, ## args); \
+	} while (0)
+#define DEBUGPC(ss, fmt, args...) \
+	do { \
+		if (log_check_level(ss, LOGL_DEBUG)) \
+			logp(ss, __FILE__, __LINE__, 1, fmt, ## args); \
+	} while (0)
 #else
 #define DEBUGP(xss, fmt, args...)
 #define DEBUGPC(ss, fmt, args...)
@@ -33,14 +41,22 @@ void osmo_vlogp(int subsys, int level, const char *file, int line,
 
 void logp(int subsys, const char *file, int line, int cont, const char *format, ...) __attribute__ ((format (printf, 5, 6)));
 
+int log_check_level(int subsys, unsigned int level);
+
 /*! \brief Log a new message through the Osmocom logging framework
  *  \param[in] ss logging subsystem (e.g. \ref DLGLOBAL)
  *  \param[in] level logging level (e.g. \ref LOGL_NOTICE)
  *  \param[in] fmt format string
  *  \param[in] args variable argument list
+ *
+ * The arguments are only evaluated if some target logs \a level
+ * messages of \a ss at all, see \ref log_check_level.
  */
 #define LOGP(ss, level, fmt, args...) \
-	logp2(ss, level, __FILE__, __LINE__, 0, fmt, ##args)
+	do { \
+		if (log_check_level(ss, level)) \
+			logp2(ss, level, __FILE__, __LINE__, 0, fmt, ##args); \
+	} while (0)
 
 /*! \brief Continue a log message through the Osmocom logging framework
  *  \param[in] ss logging subsystem (e.g. \ref DLGLOBAL)
@@ -49,7 +65,10 @@ void logp(int subsys, const char *file, int line, int cont, const char *format,
  *  \param[in] args variable argument list
  */
 #define LOGPC(ss, level, fmt, args...) \
-	logp2(ss, level, __FILE__, __LINE__, 1, fmt, ##args)
+	do { \
+		if (log_check_level(ss, level)) \
+			logp2(ss, level, __FILE__, __LINE__, 1, fmt, ##args); \
+	} while (0)
 
 /*! \brief different log levels */
 #define LOGL_DEBUG	1	/*!< \brief debugging information */
@@ -116,6 +135,15 @@ enum log_target_type {
 	LOG_TGT_TYPE_STDERR,	/*!< \brief stderr logging */
 };
 
+/*! \brief Output mode of a logging target, see \ref log_target_set_async */
+enum log_async_policy {
+	LOG_ASYNC_OFF,		/*!< \brief write from the caller (default) */
+	LOG_ASYNC_DROP,		/*!< \brief writer thread, drop if ring is full */
+	LOG_ASYNC_BLOCK,	/*!< \brief writer thread, wait if ring is full */
+};
+
+struct log_async;
+
 /*! \brief structure representing a logging target */
 struct log_target {
         struct llist_head entry;		/*!< \brief linked list */
@@ -164,6 +192,9 @@ struct log_target {
 	 */
         void (*output) (struct log_target *target, unsigned int level,
 			const char *string);
+
+	/*! \brief writer thread state, NULL unless asynchronous */
+	struct log_async *async;
 };
 
 /* use the above macros */
@@ -198,6 +229,10 @@ struct log_target *log_target_create_file(const char *fname);
 struct log_target *log_target_create_syslog(const char *ident, int option,
 					    int facility);
 int log_target_file_reopen(struct log_target *tgt);
+int log_target_set_async(struct log_target *target,
+			 enum log_async_policy policy);
+enum log_async_policy log_target_get_async(const struct log_target *target,
+					   unsigned long *dropped);
 
 void log_add_target(struct log_target *target);
 void log_del_target(struct log_target *target);
@@ -60,6 +60,7 @@ struct msgb {
 
 	uint16_t data_len;   /*!< \brief length of underlying data array */
 	uint16_t len;	     /*!< \brief length of bytes used in msgb */
+	uint8_t pool_class;  /*!< \brief msgb pool size class + 1, 0 if not pooled */
 
 	unsigned char *head;	/*!< \brief start of underlying memory buffer */
 	unsigned char *tail;	/*!< \brief end of message in buffer */
@@ -74,6 +75,24 @@ extern struct msgb *msgb_dequeue(struct llist_head *queue);
 extern void msgb_reset(struct msgb *m);
 uint16_t msgb_length(const struct msgb *msg);
 
+/*! \brief maximum number of size classes of the msgb pool */
+#define MSGB_POOL_MAX_CLASSES	8
+
+/*! \brief statistics of one size class of the msgb pool */
+struct msgb_pool_stats {
+	uint16_t size;		/*!< \brief data size of this class */
+	unsigned long hits;	/*!< \brief allocations served from free list */
+	unsigned long misses;	/*!< \brief allocations that needed talloc */
+	unsigned int in_use;	/*!< \brief msgbs currently allocated */
+	unsigned int high_water; /*!< \brief maximum of \a in_use */
+	unsigned int free;	/*!< \brief msgbs on the free list */
+};
+
+int msgb_pool_enable(const uint16_t *sizes, unsigned int num_sizes);
+void msgb_pool_disable(void);
+int msgb_pool_get_stats(struct msgb_pool_stats *stats, unsigned int max,
+			unsigned long *oversize);
+
 #ifdef MSGB_DEBUG
 #include <osmocom/core/panic.h>
 #define MSGB_ABORT(msg, fmt, args ...) do {		\
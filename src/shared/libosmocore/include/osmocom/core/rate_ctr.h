@@ -24,15 +24,19 @@ enum rate_ctr_intv {
 
 /*! \brief data we keep for each of the intervals */
 struct rate_ctr_per_intv {
-	uint64_t last;		/*!< \brief counter value in last interval */
+	uint64_t last;		/*!< \brief counter value at interval start */
 	uint64_t rate;		/*!< \brief counter rate */
 };
 
-/*! \brief data we keep for each actual value */
+/*! \brief data we keep for each actual value
+ *
+ * The interval rates are only updated by rate_ctr_group_upd_intv(). */
 struct rate_ctr {
 	uint64_t current;	/*!< \brief current value */
 	/*! \brief per-interval data */
 	struct rate_ctr_per_intv intv[RATE_CTR_INTV_NUM];
+	/*! \brief value at the last update of the intervals */
+	uint64_t seen;
 };
 
 /*! \brief rate counter description */
@@ -61,6 +65,8 @@ struct rate_ctr_group {
 	const struct rate_ctr_group_desc *desc;
 	/*! \brief The index of this ctr_group within its class */
 	unsigned int idx;
+	/*! \brief time of the last update of the intervals (ms) */
+	uint64_t intv_msecs;
 	/*! \brief Actual counter structures below */
 	struct rate_ctr ctr[0];
 };
@@ -81,6 +87,12 @@ static inline void rate_ctr_inc(struct rate_ctr *ctr)
 
 int rate_ctr_init(void *tall_ctx);
 
+void rate_ctr_group_upd_intv(struct rate_ctr_group *grp);
+void rate_ctr_set_clock(uint64_t (*msecs)(void));
+
+int rate_ctr_for_each_group(int (*handle_group)(struct rate_ctr_group *, void *),
+			    void *data);
+
 struct rate_ctr_group *rate_ctr_get_group_by_name_idx(const char *name, const unsigned int idx);
 const struct rate_ctr *rate_ctr_get_by_name(const struct rate_ctr_group *ctrg, const char *name);
 
@@ -18,14 +18,18 @@
 /*! \brief Indicate interest in exceptions from the file descriptor */
 #define BSC_FD_EXCEPT	0x0004
 
-/*! \brief Structure representing a file dsecriptor */
+/*! \brief Structure representing a file dsecriptor
+ *
+ * The select loop keeps its own state in it, so it must be zero-initialised
+ * (static, talloc_zero() or memset()) before it is first used. */
 struct osmo_fd {
 	/*! linked list for internal management */
 	struct llist_head list;	
 	/*! actual operating-system level file decriptor */
 	int fd;
 	/*! bit-mask or of \ref BSC_FD_READ, \ref BSC_FD_WRITE and/or
-	 * \ref BSC_FD_EXCEPT */
+	 * \ref BSC_FD_EXCEPT; change it with \ref osmo_fd_update_when
+	 * once the fd is registered */
 	unsigned int when;
 	/*! call-back function to be called once file descriptor becomes
 	 * available */
@@ -34,10 +38,30 @@ struct osmo_fd {
 	void *data;
 	/*! private number, extending \a data */
 	unsigned int priv_nr;
+	/*! \a when as last programmed into the kernel (epoll backend) */
+	unsigned int kernel_when;
+	/*! entry in the list of fds whose \a when changed (epoll backend) */
+	struct llist_head when_list;
+	/*! internal state of the select loop, zero while not registered */
+	unsigned int state;
 };
 
+/*! \brief Event loop backends for \ref osmo_select_main */
+enum osmo_select_backend {
+	OSMO_SELECT_BACKEND_SELECT,	/*!< \brief select(2), the default */
+	OSMO_SELECT_BACKEND_EPOLL,	/*!< \brief epoll(7), Linux only */
+};
+
+/*! \brief Use edge-triggered notification (epoll backend only).
+ *  Call-backs must then consume all pending data until EAGAIN. */
+#define OSMO_SELECT_F_EDGE	0x0001
+
+int osmo_select_init(enum osmo_select_backend backend, unsigned int flags);
+enum osmo_select_backend osmo_select_get_backend(void);
+
 int osmo_fd_register(struct osmo_fd *fd);
 void osmo_fd_unregister(struct osmo_fd *fd);
+void osmo_fd_update_when(struct osmo_fd *fd, unsigned int when);
 int osmo_select_main(int polling);
 
 /*! @} */
@@ -0,0 +1,84 @@
+#ifndef _OSMO_STATS_SHM_H
+#define _OSMO_STATS_SHM_H
+
+/*! \defgroup stats_shm Shared memory statistics
+ *  @{
+ */
+
+/*! \file stats_shm.h
+ *  \brief Export of counters through a shared memory segment
+ *
+ * A process that calls osmo_stats_shm_init() exports its \ref osmo_counter
+ * and \ref rate_ctr_group values in a POSIX shared memory segment. Every
+ * counter gets a fixed slot with its name and description. A timer copies
+ * the values into the slots. Readers in other processes map the segment
+ * read-only and take consistent snapshots with osmo_stats_shm_snapshot(),
+ * without involving the main loop of the exporting process.
+ */
+
+#include <stdint.h>
+
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/statistics.h>
+
+#define OSMO_STATS_SHM_MAGIC		0x4f534d53	/* "OSMS" */
+#define OSMO_STATS_SHM_VERSION		1
+
+#define OSMO_STATS_SHM_GROUP_LEN	32
+#define OSMO_STATS_SHM_NAME_LEN		64
+#define OSMO_STATS_SHM_DESC_LEN		96
+
+/*! \brief type of a slot */
+enum osmo_stats_shm_type {
+	OSMO_STATS_SHM_FREE,		/*!< \brief unused slot */
+	OSMO_STATS_SHM_COUNTER,		/*!< \brief \ref osmo_counter */
+	OSMO_STATS_SHM_RATE_CTR,	/*!< \brief counter of a group */
+};
+
+/*! \brief one counter in the shared memory segment */
+struct osmo_stats_shm_slot {
+	uint32_t type;			/*!< \brief osmo_stats_shm_type */
+	uint32_t group_idx;		/*!< \brief index of the group */
+	char group[OSMO_STATS_SHM_GROUP_LEN];	/*!< \brief group name */
+	char name[OSMO_STATS_SHM_NAME_LEN];	/*!< \brief counter name */
+	char description[OSMO_STATS_SHM_DESC_LEN];
+	uint64_t value;			/*!< \brief current value */
+	uint64_t rate[RATE_CTR_INTV_NUM]; /*!< \brief interval rates */
+};
+
+/*! \brief header of the shared memory segment */
+struct osmo_stats_shm_hdr {
+	uint32_t magic;			/*!< \brief OSMO_STATS_SHM_MAGIC */
+	uint32_t version;		/*!< \brief OSMO_STATS_SHM_VERSION */
+	uint32_t slot_size;		/*!< \brief size of one slot */
+	uint32_t num_slots;		/*!< \brief number of slots */
+	uint32_t pid;			/*!< \brief pid of the writer */
+	/*! \brief odd while the writer changes the segment */
+	volatile uint32_t seq;
+	uint32_t used_slots;		/*!< \brief slots below this may be used */
+	uint32_t interval_ms;		/*!< \brief time between two updates */
+	uint64_t update_time_ms;	/*!< \brief wall clock of last update */
+	struct osmo_stats_shm_slot slot[0];
+};
+
+/* writer side */
+int osmo_stats_shm_init(const char *name, unsigned int num_slots,
+			unsigned int interval_ms);
+void osmo_stats_shm_exit(void);
+void osmo_stats_shm_update(void);
+
+int osmo_stats_shm_add_ctrg(struct rate_ctr_group *ctrg);
+void osmo_stats_shm_del_ctrg(struct rate_ctr_group *ctrg);
+int osmo_stats_shm_add_counter(struct osmo_counter *ctr);
+void osmo_stats_shm_del_counter(struct osmo_counter *ctr);
+
+/* reader side */
+const struct osmo_stats_shm_hdr *osmo_stats_shm_open(const char *name);
+void osmo_stats_shm_close(const struct osmo_stats_shm_hdr *hdr);
+int osmo_stats_shm_snapshot(const struct osmo_stats_shm_hdr *hdr,
+			    struct osmo_stats_shm_slot *slots,
+			    unsigned int num_slots);
+
+/*! @} */
+
+#endif /* _OSMO_STATS_SHM_H */
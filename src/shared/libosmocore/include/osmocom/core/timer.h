@@ -76,6 +76,15 @@ int osmo_timer_pending(struct osmo_timer_list *timer);
 int osmo_timer_remaining(const struct osmo_timer_list *timer,
 			 const struct timeval *now,
 			 struct timeval *remaining);
+/*! \brief Engines implementing the timer management */
+enum osmo_timer_engine {
+	OSMO_TIMER_ENGINE_RBTREE,	/*!< \brief rb-tree on gettimeofday() */
+	OSMO_TIMER_ENGINE_WHEEL,	/*!< \brief timing wheel on CLOCK_MONOTONIC */
+};
+
+int osmo_timers_set_engine(enum osmo_timer_engine engine);
+enum osmo_timer_engine osmo_timers_get_engine(void);
+
 /*
  * internal timer list management
  */
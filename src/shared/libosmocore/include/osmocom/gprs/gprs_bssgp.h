@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/hashtable.h>
 
 #include <osmocom/gsm/gsm48.h>
 #include <osmocom/gsm/prim.h>
@@ -56,13 +57,32 @@ struct osmo_bssgp_prim {
 
 /* gprs_bssgp.c */
 
-/*! \brief BSSGP flow control (SGSN side) According to Section 8.2 */
+#define BSSGP_FC_HIST_BINS	16
+
+/*! \brief histograms of a BVC flow control
+ *
+ * Bin 0 counts the value 0, bin n counts values from 2^(n-1) to 2^n - 1.
+ * The last bin also counts all larger values. */
+struct bssgp_fc_stats {
+	/*! number of queued PDUs of the BVC after each enqueue */
+	uint32_t queue_depth[BSSGP_FC_HIST_BINS];
+	/*! time in milliseconds the dequeued PDUs spent in the queue */
+	uint32_t delay_ms[BSSGP_FC_HIST_BINS];
+	uint32_t ticks;			/*!< number of scheduler runs */
+};
+
+/*! \brief BSSGP flow control (SGSN side) According to Section 8.2
+ *
+ * A flow control of a BVC schedules the PDUs of its own queue and of the
+ * queues of its per-MS flow controls (see bssgp_fc_ms_init()) by deficit
+ * round robin. Each timer expiry sends as many PDUs as the buckets allow.
+ */
 struct bssgp_flow_control {
 	uint32_t bucket_size_max;	/*!< maximum size of the bucket (octets) */
 	uint32_t bucket_leak_rate; 	/*!< leak rate of the bucket (octets/sec) */
 
 	uint32_t bucket_counter;	/*!< number of tokens in the bucket */
-	struct timeval time_last_pdu;	/*!< timestamp of last PDU sent */
+	struct timeval time_last_pdu;	/*!< time of the bucket_counter value */
 
 	/* the built-in queue */
 	uint32_t max_queue_depth;	/*!< how many packets to queue (mgs) */
@@ -73,6 +93,22 @@ struct bssgp_flow_control {
 	/*! callback to be called at output of flow control */
 	int (*out_cb)(struct bssgp_flow_control *fc, struct msgb *msg,
 			uint32_t llc_pdu_len, void *priv);
+
+	/*! BVC flow control of a per-MS flow control, NULL otherwise */
+	struct bssgp_flow_control *parent;
+	/*! flows with queued PDUs, in deficit round robin order */
+	struct llist_head active;
+	unsigned int num_active;	/*!< number of entries in active */
+	struct llist_head active_list;	/*!< entry in active of the BVC */
+	uint32_t quantum;		/*!< octets per flow and round */
+	uint32_t deficit;		/*!< octets this flow may still send */
+	uint32_t ms_queue_depth;	/*!< PDUs queued by per-MS flows */
+	struct bssgp_fc_stats stats;	/*!< histograms of the BVC */
+
+	/*! per-MS flow controls by TLLI, see bssgp_fc_ms_set_tlli() */
+	struct osmo_hashtable ms_by_tlli;
+	struct osmo_hash_node tlli_node;
+	uint32_t tlli;
 };
 
 #define BVC_S_BLOCKED	0x0001
@@ -102,12 +138,20 @@ struct bssgp_bvc_ctx {
 	/* we might want to add this as a shortcut later, avoiding the NSVC
 	 * lookup for every packet, similar to a routing cache */
 	//struct gprs_nsvc *nsvc;
+
+	/*! entries in the lookup tables, see btsctx_rehash() */
+	struct osmo_hash_node bvci_nsei_node;
+	struct osmo_hash_node raid_cid_node;
 };
 extern struct llist_head bssgp_bvc_ctxts;
+/* Allocate a BTS context for a BVCI+NSEI tuple */
+struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei);
 /* Find a BTS Context based on parsed RA ID and Cell ID */
 struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t cid);
 /* Find a BTS context based on BVCI+NSEI tuple */
 struct bssgp_bvc_ctx *btsctx_by_bvci_nsei(uint16_t bvci, uint16_t nsei);
+/* Update the lookup tables after a change of BVCI, NSEI, RA ID or Cell ID */
+void btsctx_rehash(struct bssgp_bvc_ctx *bctx);
 
 #define BVC_F_BLOCKED	0x0001
 
@@ -202,6 +246,12 @@ int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
 		     uint16_t nsei, uint32_t max_queue_depth);
 
+/* Set the TLLI by which a FLOW-CONTROL-MS finds a per-MS flow control */
+int bssgp_fc_ms_set_tlli(struct bssgp_flow_control *fc_ms, uint32_t tlli);
+
+/* Drop the queued PDUs of a per-MS flow control before it is freed */
+void bssgp_fc_ms_release(struct bssgp_flow_control *fc_ms);
+
 /* gprs_bssgp_vty.c */
 int bssgp_vty_init(void);
 void bssgp_set_log_ss(int ss);
@@ -9,6 +9,7 @@
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/hashtable.h>
 #include <osmocom/gprs/gprs_msgb.h>
 
 #include <osmocom/gprs/protocol/gsm_08_16.h>
@@ -50,6 +51,7 @@ enum gprs_ns_evt {
 };
 
 struct gprs_nsvc;
+struct gprs_nsip_batch;
 /*! \brief Osmocom GPRS callback function type */
 typedef int gprs_ns_cb_t(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
 			 struct msgb *msg, uint16_t bvci);
@@ -73,6 +75,10 @@ struct gprs_ns_inst {
 		struct osmo_fd fd;
 		uint32_t local_ip;
 		uint16_t local_port;
+		/*! \brief datagrams in flight, see gprs_ns_nsip_set_batch() */
+		struct gprs_nsip_batch *batch;
+		/*! \brief queued datagrams the socket refused */
+		unsigned long tx_dropped;
 	} nsip;
 	/*! \brief NS-over-FR-over-GRE-over-IP specific bits */
 	struct {
@@ -80,6 +86,12 @@ struct gprs_ns_inst {
 		uint32_t local_ip;
 		unsigned int enabled:1;
 	} frgre;
+
+	/*! \brief NSVCs of gprs_nsvcs indexed by NSVCI, NSEI and
+	 *	   remote address */
+	struct osmo_hashtable nsvc_by_nsvci;
+	struct osmo_hashtable nsvc_by_nsei;
+	struct osmo_hashtable nsvc_by_addr;
 };
 
 enum nsvc_timer_mode {
@@ -123,6 +135,12 @@ struct gprs_nsvc {
 			struct sockaddr_in bts_addr;
 		} frgre;
 	};
+
+	/*! \brief entries in the lookup tables of the NS Instance,
+	 *	   see gprs_nsvc_rehash() */
+	struct osmo_hash_node nsvci_node;
+	struct osmo_hash_node nsei_node;
+	struct osmo_hash_node addr_node;
 };
 
 /* Create a new NS protocol instance */
@@ -134,6 +152,15 @@ void gprs_ns_destroy(struct gprs_ns_inst *nsi);
 /* Listen for incoming GPRS packets via NS/UDP */
 int gprs_ns_nsip_listen(struct gprs_ns_inst *nsi);
 
+/*! \brief most datagrams a batched NS/IP socket reads or sends at once */
+#define GPRS_NSIP_BATCH_MAX	64
+
+/* Read and send up to len NS/IP datagrams per system call */
+int gprs_ns_nsip_set_batch(struct gprs_ns_inst *nsi, unsigned int len);
+
+/* Send the NS/IP datagrams queued in batch mode right away */
+int gprs_ns_nsip_flush(struct gprs_ns_inst *nsi);
+
 /* Establish a connection (from the BSS) to the SGSN */
 struct gprs_nsvc *gprs_ns_nsip_connect(struct gprs_ns_inst *nsi,
 					struct sockaddr_in *dest,
@@ -156,6 +183,7 @@ struct gprs_nsvc *gprs_nsvc_create(struct gprs_ns_inst *nsi, uint16_t nsvci);
 void gprs_nsvc_delete(struct gprs_nsvc *nsvc);
 struct gprs_nsvc *gprs_nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei);
 struct gprs_nsvc *gprs_nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci);
+void gprs_nsvc_rehash(struct gprs_nsvc *nsvc);
 
 /* Initiate a RESET procedure (including timer start, ...)*/
 void gprs_nsvc_reset(struct gprs_nsvc *nsvc, uint8_t cause);
@@ -58,6 +58,20 @@ void osmo_a5(int n, const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 void osmo_a5_1(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 void osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 
+/*! \brief Size in bytes of one packed 114 bit A5 keystream */
+#define OSMO_A5_PBIT_LEN	15
+
+	/* Batch generators:
+	 *  - output is packed (MSB first, as osmo_ubit2pbit), one
+	 *    OSMO_A5_PBIT_LEN byte block per generated keystream
+	 *  - dl and ul must be either NULL or count blocks long
+	 */
+int osmo_a5_batch_fn(int n, const uint8_t *key, uint32_t fn,
+		     unsigned int count, pbit_t *dl, pbit_t *ul);
+int osmo_a5_batch_keys(int n, const uint8_t *keys, uint32_t fn,
+		       unsigned int count, pbit_t *dl, pbit_t *ul);
+unsigned int osmo_a5_batch_lanes(void);
+
 /*! @} */
 
 #endif /* __OSMO_A5_H__ */
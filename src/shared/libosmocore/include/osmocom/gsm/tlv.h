@@ -406,6 +406,68 @@ int tlv_parse(struct tlv_parsed *dec, const struct tlv_definition *def,
 /* take a master (src) tlvdev and fill up all empty slots in 'dst' */
 void tlv_def_patch(struct tlv_definition *dst, const struct tlv_definition *src);
 
+/*! \brief Decoding of one IE, precomputed from its \ref tlv_def
+ *
+ *  The value length is fixed_len plus the length octets at len_ofs[]
+ *  masked with len_mask[] and shifted right by len_shift, so all IE types
+ *  are decoded the same way.
+ */
+struct tlv_cdef {
+	uint8_t tag;		/*!< \brief tag under which the IE is stored */
+	uint8_t hdr_len;	/*!< \brief octets needed to decode, 0 = invalid */
+	uint8_t val_ofs;	/*!< \brief offset of the value */
+	uint8_t skip;		/*!< \brief octets consumed besides the value */
+	uint8_t var;		/*!< \brief 1 if the next entry is used when bit 8
+				 *	    of the octet after the tag is set */
+	uint8_t len_ofs[2];	/*!< \brief offsets of the length octets */
+	uint8_t len_mask[2];	/*!< \brief masks of the length octets */
+	uint8_t len_shift;	/*!< \brief right shift of the length */
+	uint8_t fixed_len;	/*!< \brief constant part of the length */
+};
+
+/*! \brief Precompiled form of a \ref tlv_definition, see \ref tlv_compile */
+struct tlv_compiled {
+	struct tlv_cdef def[256][2];
+};
+
+/*! \brief \ref tlv_parsed which can be reset without clearing all tags
+ *
+ *  Must be zero-initialized before it is passed to \ref tlv_parse_compiled
+ *  for the first time.  Use TLVP_PRESENT(&x->tp, tag) and friends to
+ *  access the result.
+ */
+struct tlv_parsed_sparse {
+	struct tlv_parsed tp;	/*!< \brief result of the last parse */
+	uint16_t num_seen;	/*!< \brief number of valid tags in seen[] */
+	uint8_t seen[256];	/*!< \brief tags set in tp */
+};
+
+/*! \brief Set of mandatory IEs of a message */
+struct tlv_mandatory {
+	uint32_t bitmap[8];	/*!< \brief one bit per tag */
+	unsigned int count;	/*!< \brief number of bits set */
+};
+
+/*! \brief Add an IE to a set of mandatory IEs
+ *  \param[in] m set of mandatory IEs, zero-initialized before first use
+ *  \param[in] tag tag of the IE (as stored in \ref tlv_parsed)
+ */
+static inline void tlv_mandatory_add(struct tlv_mandatory *m, uint8_t tag)
+{
+	if (m->bitmap[tag >> 5] & (1U << (tag & 31)))
+		return;
+	m->bitmap[tag >> 5] |= 1U << (tag & 31);
+	m->count++;
+}
+
+void tlv_compile(struct tlv_compiled *c, const struct tlv_definition *def);
+int tlv_parse_compiled(struct tlv_parsed_sparse *dec,
+		       const struct tlv_compiled *c,
+		       const struct tlv_mandatory *mand,
+		       const uint8_t *buf, int buf_len, uint8_t lv_tag,
+		       uint8_t lv_tag2);
+void tlv_parsed_sparse_clear(struct tlv_parsed_sparse *dec);
+
 #define TLVP_PRESENT(x, y)	((x)->lv[y].val)
 #define TLVP_LEN(x, y)		(x)->lv[y].len
 #define TLVP_VAL(x, y)		(x)->lv[y].val
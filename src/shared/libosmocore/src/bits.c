@@ -1,5 +1,6 @@
 
 #include <stdint.h>
+#include <string.h>
 
 #include <osmocom/core/bits.h>
 
@@ -12,6 +13,213 @@
  */
 
 
+/*
+ * The conversions work on whole bytes of packed bits (8 unpacked bits)
+ * at a time wherever the bit offsets allow it. The portable kernels
+ * gather or spread the 8 bits held in a 64 bit word with a single
+ * multiplication, each partial product landing on its own bit. On x86
+ * SSE2 (and AVX2 when the CPU has it) do 16 (32) bits at once with
+ * byte shuffles and movemask.
+ *
+ * Any non-zero unpacked bit is taken as a 1, soft bits map 0 to 127 and
+ * 1 to -127, any negative soft bit being taken as a 1.
+ */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BITS_LE64(x)	__builtin_bswap64(x)
+#else
+#define BITS_LE64(x)	(x)
+#endif
+
+/* gather byte k bit 0 (ubit) into bit 7-k (MSB first) or k (LSB first) */
+#define BITS_PACK_MSB	0x8040201008040201ULL
+#define BITS_PACK_LSB	0x0102040810204080ULL
+/* spread bit 7-k into bit 8k+7 */
+#define BITS_SPREAD	0x8040201008040201ULL
+#define BITS_ONES	0x0101010101010101ULL
+#define BITS_LOW7	0x7f7f7f7f7f7f7f7fULL
+
+static inline uint64_t _bits_load8(const uint8_t *in)
+{
+	uint64_t v;
+
+	memcpy(&v, in, sizeof(v));
+	return BITS_LE64(v);
+}
+
+static inline void _bits_store8(uint8_t *out, uint64_t v)
+{
+	v = BITS_LE64(v);
+	memcpy(out, &v, sizeof(v));
+}
+
+/* 8 ubits to 8 bytes of 0 or 1: the low 7 bits of a non-zero byte
+ * carry into its bit 7, never into the next byte */
+static inline uint64_t _bits_norm8(uint64_t v)
+{
+	return ((((v & BITS_LOW7) + BITS_LOW7) | v) >> 7) & BITS_ONES;
+}
+
+/* 8 ubits (in the low bit of each byte) to one MSB first pbit_t */
+static inline pbit_t _bits_pack8(uint64_t v)
+{
+	return (v * BITS_PACK_MSB) >> 56;
+}
+
+/* one MSB first pbit_t to 8 ubits */
+static inline uint64_t _bits_unpack8(pbit_t b)
+{
+	return ((b * BITS_SPREAD) >> 7) & BITS_ONES;
+}
+
+/* 8 ubits to 8 sbits: 0x7f ^ 0xfe is 0x81, i.e. -127 */
+static inline uint64_t _bits_u2s8(uint64_t v)
+{
+	return (BITS_ONES * 0x7f) ^ (v * 0xfe);
+}
+
+/* 8 sbits to 8 ubits, from the sign bits */
+static inline uint64_t _bits_s2u8(uint64_t v)
+{
+	return (v >> 7) & BITS_ONES;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_BITS_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(HAVE_BITS_AVX2)
+#include <immintrin.h>
+#endif
+
+#ifdef __SSE2__
+/* reverse the byte order within both 64 bit halves, so that movemask
+ * puts the first bit of every 8 into the MSB */
+static inline __m128i _bits_rev_sse2(__m128i v)
+{
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/* 2 pbit_t to 16 bytes of 0xff (bit set) or 0x00 */
+static inline __m128i _bits_expand_sse2(const pbit_t *in)
+{
+	const __m128i sel = _mm_set_epi8(
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80);
+	__m128i v = _mm_cvtsi32_si128(in[0] | (in[1] << 8));
+
+	v = _mm_unpacklo_epi8(v, v);
+	v = _mm_unpacklo_epi16(v, v);
+	v = _mm_unpacklo_epi32(v, v);
+	return _mm_cmpeq_epi8(_mm_and_si128(v, sel), sel);
+}
+#endif
+
+#ifdef HAVE_BITS_AVX2
+__attribute__((target("avx2"))) static void
+_bits_ubit2pbit_avx2(pbit_t *out, const ubit_t *in, unsigned int nbytes)
+{
+	const __m256i rev = _mm256_set_epi8(
+		8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+		8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+	unsigned int i;
+	uint32_t m;
+	__m256i v;
+
+	for (i = 0; i + 4 <= nbytes; i += 4) {
+		v = _mm256_loadu_si256((const __m256i *) (in + 8 * i));
+		v = _mm256_shuffle_epi8(v, rev);
+		/* movemask of the zero bytes, any other value is a 1 */
+		m = ~_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+		memcpy(out + i, &m, sizeof(m));
+	}
+	for (; i < nbytes; i++)
+		out[i] = _bits_pack8(_bits_norm8(_bits_load8(in + 8 * i)));
+}
+
+__attribute__((target("avx2"))) static void
+_bits_pbit2ubit_avx2(ubit_t *out, const pbit_t *in, unsigned int nbytes)
+{
+	const __m256i spread = _mm256_set_epi8(
+		3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+		1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i sel = _mm256_set1_epi64x(0x0102040810204080LL);
+	const __m256i one = _mm256_set1_epi8(1);
+	unsigned int i;
+	uint32_t w;
+	__m256i v;
+
+	for (i = 0; i + 4 <= nbytes; i += 4) {
+		memcpy(&w, in + i, sizeof(w));
+		v = _mm256_shuffle_epi8(_mm256_set1_epi32(w), spread);
+		v = _mm256_cmpeq_epi8(_mm256_and_si256(v, sel), sel);
+		_mm256_storeu_si256((__m256i *) (out + 8 * i),
+				    _mm256_and_si256(v, one));
+	}
+	for (; i < nbytes; i++)
+		_bits_store8(out + 8 * i, _bits_unpack8(in[i]));
+}
+
+static int _bits_have_avx2(void)
+{
+	static int have = -1;
+
+	if (have < 0)
+		have = __builtin_cpu_supports("avx2");
+	return have;
+}
+#endif
+
+/* nbytes whole pbit_t from 8 * nbytes ubits, MSB first */
+static void _bits_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int nbytes)
+{
+	unsigned int i = 0;
+
+#ifdef HAVE_BITS_AVX2
+	if (nbytes >= 4 && _bits_have_avx2()) {
+		_bits_ubit2pbit_avx2(out, in, nbytes);
+		return;
+	}
+#endif
+#ifdef __SSE2__
+	for (; i + 2 <= nbytes; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + 8 * i));
+		int m = ~_mm_movemask_epi8(_bits_rev_sse2(
+			_mm_cmpeq_epi8(v, _mm_setzero_si128())));
+		out[i] = m;
+		out[i + 1] = m >> 8;
+	}
+#endif
+	for (; i < nbytes; i++)
+		out[i] = _bits_pack8(_bits_norm8(_bits_load8(in + 8 * i)));
+}
+
+/* 8 * nbytes ubits from nbytes whole pbit_t, MSB first */
+static void _bits_pbit2ubit(ubit_t *out, const pbit_t *in, unsigned int nbytes)
+{
+	unsigned int i = 0;
+
+#ifdef HAVE_BITS_AVX2
+	if (nbytes >= 4 && _bits_have_avx2()) {
+		_bits_pbit2ubit_avx2(out, in, nbytes);
+		return;
+	}
+#endif
+#ifdef __SSE2__
+	for (; i + 2 <= nbytes; i += 2) {
+		__m128i v = _bits_expand_sse2(in + i);
+		_mm_storeu_si128((__m128i *) (out + 8 * i),
+				 _mm_and_si128(v, _mm_set1_epi8(1)));
+	}
+#endif
+	for (; i < nbytes; i++)
+		_bits_store8(out + 8 * i, _bits_unpack8(in[i]));
+}
+
 /*! \brief convert unpacked bits to packed bits, return length in bytes
  *  \param[out] out output buffer of packed bits
  *  \param[in] in input buffer of unpacked bits
@@ -19,25 +227,20 @@
  */
 int osmo_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
 {
+	unsigned int nbytes = num_bits / 8;
 	unsigned int i;
 	uint8_t curbyte = 0;
-	pbit_t *outptr = out;
 
-	for (i = 0; i < num_bits; i++) {
-		uint8_t bitnum = 7 - (i % 8);
+	_bits_ubit2pbit(out, in, nbytes);
 
-		curbyte |= (in[i] << bitnum);
-
-		if(i % 8 == 7){
-			*outptr++ = curbyte;
-			curbyte = 0;
-		}
-	}
 	/* we have a non-modulo-8 bitcount */
-	if (i % 8)
-		*outptr++ = curbyte;
+	if (num_bits % 8) {
+		for (i = 0; i < num_bits % 8; i++)
+			curbyte |= !!in[8 * nbytes + i] << (7 - i);
+		out[nbytes++] = curbyte;
+	}
 
-	return outptr - out;
+	return nbytes;
 }
 
 /*! \brief convert packed bits to unpacked bits, return length in bytes
@@ -47,38 +250,15 @@ int osmo_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
  */
 int osmo_pbit2ubit(ubit_t *out, const pbit_t *in, unsigned int num_bits)
 {
+	unsigned int nbytes = num_bits / 8;
 	unsigned int i;
-	ubit_t *cur = out;
-	ubit_t *limit = out + num_bits;
-
-	for (i = 0; i < (num_bits/8)+1; i++) {
-		pbit_t byte = in[i];
-		*cur++ = (byte >> 7) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 6) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 5) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 4) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 3) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 2) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 1) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 0) & 1;
-		if (cur >= limit)
-			break;
-	}
-	return cur - out;
+
+	_bits_pbit2ubit(out, in, nbytes);
+
+	for (i = 0; i < num_bits % 8; i++)
+		out[8 * nbytes + i] = (in[nbytes] >> (7 - i)) & 1;
+
+	return num_bits;
 }
 
 /*! \brief convert unpacked bits to packed bits (extended options)
@@ -94,8 +274,32 @@ int osmo_ubit2pbit_ext(pbit_t *out, unsigned int out_ofs,
                        const ubit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode)
 {
-	int i, op, bn;
+	unsigned int i, op, bn, nbytes;
+	unsigned int head = (8 - (out_ofs & 7)) & 7;
+
+	if (head > num_bits)
+		head = num_bits;
+
+	/* bit by bit up to the first output byte boundary, and for the
+	 * remainder, leaving the other bits of those bytes untouched */
 	for (i=0; i<num_bits; i++) {
+		if (i == head) {
+			nbytes = (num_bits - head) / 8;
+			op = (out_ofs + head) >> 3;
+			if (lsb_mode) {
+				unsigned int j;
+				uint64_t v;
+				for (j=0; j<nbytes; j++) {
+					v = _bits_norm8(_bits_load8(
+						in + in_ofs + i + 8*j));
+					out[op+j] = (v * BITS_PACK_LSB) >> 56;
+				}
+			} else
+				_bits_ubit2pbit(out + op, in + in_ofs + i, nbytes);
+			i += 8 * nbytes;
+			if (i >= num_bits)
+				break;
+		}
 		op = out_ofs + i;
 		bn = lsb_mode ? (op&7) : (7-(op&7));
 		if (in[in_ofs+i])
@@ -119,8 +323,29 @@ int osmo_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
                        const pbit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode)
 {
-	int i, ip, bn;
+	unsigned int i, ip, bn, nbytes;
+	unsigned int head = (8 - (in_ofs & 7)) & 7;
+
+	if (head > num_bits)
+		head = num_bits;
+
+	/* bit by bit up to the first input byte boundary and for the
+	 * remainder, whole bytes in between */
 	for (i=0; i<num_bits; i++) {
+		if (i == head) {
+			nbytes = (num_bits - head) / 8;
+			ip = (in_ofs + head) >> 3;
+			if (lsb_mode) {
+				unsigned int j;
+				for (j=0; j<nbytes; j++)
+					_bits_store8(out + out_ofs + i + 8*j,
+						_bits_unpack8(osmo_revbytebits_8(in[ip+j])));
+			} else
+				_bits_pbit2ubit(out + out_ofs + i, in + ip, nbytes);
+			i += 8 * nbytes;
+			if (i >= num_bits)
+				break;
+		}
 		ip = in_ofs + i;
 		bn = lsb_mode ? (ip&7) : (7-(ip&7));
 		out[out_ofs+i] = !!(in[ip>>3] & (1<<bn));
@@ -128,6 +353,102 @@ int osmo_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
 	return out_ofs + num_bits;
 }
 
+/*! \brief convert unpacked bits to soft bits, return number of bits
+ *  \param[out] out output buffer of soft bits (0 -> 127, 1 -> -127)
+ *  \param[in] in input buffer of unpacked bits
+ *  \param[in] num_bits number of bits
+ */
+int osmo_ubit2sbit(sbit_t *out, const ubit_t *in, unsigned int num_bits)
+{
+	unsigned int i;
+
+	for (i = 0; i + 8 <= num_bits; i += 8)
+		_bits_store8((uint8_t *) out + i,
+			     _bits_u2s8(_bits_norm8(_bits_load8(in + i))));
+	for (; i < num_bits; i++)
+		out[i] = in[i] ? -127 : 127;
+
+	return num_bits;
+}
+
+/*! \brief hard decide soft bits into unpacked bits, return number of bits
+ *  \param[out] out output buffer of unpacked bits (1 for negative soft bits)
+ *  \param[in] in input buffer of soft bits
+ *  \param[in] num_bits number of bits
+ */
+int osmo_sbit2ubit(ubit_t *out, const sbit_t *in, unsigned int num_bits)
+{
+	unsigned int i;
+
+	for (i = 0; i + 8 <= num_bits; i += 8)
+		_bits_store8(out + i,
+			     _bits_s2u8(_bits_load8((const uint8_t *) in + i)));
+	for (; i < num_bits; i++)
+		out[i] = in[i] < 0;
+
+	return num_bits;
+}
+
+/*! \brief convert packed bits to soft bits, return number of bits
+ *  \param[out] out output buffer of soft bits (0 -> 127, 1 -> -127)
+ *  \param[in] in input buffer of packed bits
+ *  \param[in] num_bits number of bits
+ */
+int osmo_pbit2sbit(sbit_t *out, const pbit_t *in, unsigned int num_bits)
+{
+	unsigned int nbytes = num_bits / 8;
+	unsigned int i = 0;
+
+#ifdef __SSE2__
+	for (; i + 2 <= nbytes; i += 2) {
+		__m128i v = _bits_expand_sse2(in + i);
+		v = _mm_xor_si128(_mm_and_si128(v, _mm_set1_epi8((char) 0xfe)),
+				  _mm_set1_epi8(0x7f));
+		_mm_storeu_si128((__m128i *) (out + 8 * i), v);
+	}
+#endif
+	for (; i < nbytes; i++)
+		_bits_store8((uint8_t *) out + 8 * i,
+			     _bits_u2s8(_bits_unpack8(in[i])));
+	for (i = 0; i < num_bits % 8; i++)
+		out[8 * nbytes + i] = (in[nbytes] >> (7 - i)) & 1 ? -127 : 127;
+
+	return num_bits;
+}
+
+/*! \brief hard decide soft bits into packed bits, return length in bytes
+ *  \param[out] out output buffer of packed bits (1 for negative soft bits)
+ *  \param[in] in input buffer of soft bits
+ *  \param[in] num_bits number of bits
+ */
+int osmo_sbit2pbit(pbit_t *out, const sbit_t *in, unsigned int num_bits)
+{
+	unsigned int nbytes = num_bits / 8;
+	unsigned int i = 0;
+	uint8_t curbyte = 0;
+
+#ifdef __SSE2__
+	/* the sign bits are what movemask picks anyway */
+	for (; i + 2 <= nbytes; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + 8 * i));
+		int m = _mm_movemask_epi8(_bits_rev_sse2(v));
+		out[i] = m;
+		out[i + 1] = m >> 8;
+	}
+#endif
+	for (; i < nbytes; i++)
+		out[i] = _bits_pack8(
+			_bits_s2u8(_bits_load8((const uint8_t *) in + 8 * i)));
+
+	if (num_bits % 8) {
+		for (i = 0; i < num_bits % 8; i++)
+			curbyte |= (in[8 * nbytes + i] < 0) << (7 - i);
+		out[nbytes++] = curbyte;
+	}
+
+	return nbytes;
+}
+
 /* generalized bit reversal function, Chapter 7 "Hackers Delight" */
 uint32_t osmo_bit_reversal(uint32_t x, enum osmo_br_mode k)
 {
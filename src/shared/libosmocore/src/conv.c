@@ -238,6 +238,307 @@ osmo_conv_encode(const struct osmo_conv_code *code,
 
 #define MAX_AE 0x00ffffff
 
+/* Maximum N for which branch metrics are precomputed */
+#define MAX_N 8
+
+#if defined(__GNUC__) && defined(__x86_64__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_CONV_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(HAVE_CONV_AVX2)
+#include <immintrin.h>
+#endif
+
+/*
+ * If the successors of every state s are 2s and 2s+1 (mod n_states),
+ * which holds for any shift register code, recursive or not, the
+ * states j and j+n/2 lead to the same two states 2j and 2j+1.  Such a
+ * 'butterfly' allows the add-compare-select to run over consecutive
+ * states.  The four transitions of butterfly j are:
+ *
+ *   A0: j -> 2j,  A1: j -> 2j+1,  B0: j+n/2 -> 2j,  B1: j+n/2 -> 2j+1
+ */
+enum conv_tr {
+	TR_A0, TR_A1, TR_B0, TR_B1,
+	_NUM_TR
+};
+
+typedef void (*conv_acs_fn)(const struct osmo_conv_trellis *tr, int N,
+                            const int *bm, const unsigned int *ae,
+                            unsigned int *ae_next, uint8_t *sh);
+
+struct osmo_conv_trellis {
+	int h;				/* n_states / 2 */
+	conv_acs_fn acs;		/* add-compare-select of one step */
+	int bm_table;			/* acs wants bm[output] */
+	uint8_t *out[_NUM_TR];		/* [h] output of each transition */
+	int32_t *mask;			/* [N][_NUM_TR][h] -1 if bit set */
+};
+
+/* Branch metrics of one input symbol.  The error of a soft bit against
+ * an expected bit is ((is - ov)^2 >> 9) with ov = +-127, and 0 for an
+ * erased (0) soft bit.  Either fill bm[output] for all 2^N outputs,
+ * or bm[0] = error if all bits are 0 and bm[1+j] = difference for bit
+ * j (MSB first) being 1. */
+static void
+_conv_branch_metrics(const sbit_t *in_sym, int N, int table, int *bm)
+{
+	int e0[MAX_N], e1[MAX_N];
+	int j, k, n;
+
+	for (j=0; j<N; j++) {
+		int is = in_sym[j];
+		if (is) {
+			e0[j] = ((is - 127) * (is - 127)) >> 9;
+			e1[j] = ((is + 127) * (is + 127)) >> 9;
+		} else {
+			e0[j] = e1[j] = 0;
+		}
+	}
+
+	if (!table) {
+		bm[0] = 0;
+		for (j=0; j<N; j++) {
+			bm[0] += e0[j];
+			bm[1+j] = e1[j] - e0[j];
+		}
+		return;
+	}
+
+	/* build up the table one bit at a time, MSB first */
+	bm[0] = 0;
+	for (j=0, n=1; j<N; j++, n<<=1) {
+		for (k=n-1; k>=0; k--) {
+			bm[2*k+1] = bm[k] + e1[j];
+			bm[2*k]   = bm[k] + e0[j];
+		}
+	}
+}
+
+static void
+_conv_acs_scalar(const struct osmo_conv_trellis *tr, int N,
+                 const int *bm, const unsigned int *ae,
+                 unsigned int *ae_next, uint8_t *sh)
+{
+	int h = tr->h;
+	int j;
+
+	for (j=0; j<h; j++) {
+		unsigned int a = ae[j], b = ae[j+h];
+		unsigned int ca, cb;
+
+		/* on equal error, the lower state wins, as it would
+		 * when scanning states in order */
+		ca = a + bm[tr->out[TR_A0][j]];
+		cb = b + bm[tr->out[TR_B0][j]];
+		sh[2*j] = cb < ca ? j+h : j;
+		ca = cb < ca ? cb : ca;
+		ae_next[2*j] = ca < MAX_AE ? ca : MAX_AE;
+
+		ca = a + bm[tr->out[TR_A1][j]];
+		cb = b + bm[tr->out[TR_B1][j]];
+		sh[2*j+1] = cb < ca ? j+h : j;
+		ca = cb < ca ? cb : ca;
+		ae_next[2*j+1] = ca < MAX_AE ? ca : MAX_AE;
+	}
+}
+
+#ifdef __SSE2__
+static void
+_conv_acs_sse2(const struct osmo_conv_trellis *tr, int N,
+               const int *bm, const unsigned int *ae,
+               unsigned int *ae_next, uint8_t *sh)
+{
+	int h = tr->h;
+	__m128i d[MAX_N], c[_NUM_TR];
+	__m128i e0 = _mm_set1_epi32(bm[0]);
+	__m128i max = _mm_set1_epi32(MAX_AE);
+	__m128i hv = _mm_set1_epi32(h);
+	__m128i jv = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i a, b, s0, s1, r0, r1, p0, p1, t;
+	int j, k, g;
+
+	for (k=0; k<N; k++)
+		d[k] = _mm_set1_epi32(bm[1+k]);
+
+	/* metrics stay below 2^31, so signed compares are fine */
+	for (j=0; j<h; j+=4) {
+		a = _mm_loadu_si128((const __m128i *) &ae[j]);
+		b = _mm_loadu_si128((const __m128i *) &ae[j+h]);
+
+		for (g=0; g<_NUM_TR; g++) {
+			c[g] = e0;
+			for (k=0; k<N; k++) {
+				t = _mm_loadu_si128((const __m128i *)
+					&tr->mask[(k * _NUM_TR + g) * h + j]);
+				c[g] = _mm_add_epi32(c[g], _mm_and_si128(t, d[k]));
+			}
+		}
+
+		c[TR_A0] = _mm_add_epi32(c[TR_A0], a);
+		c[TR_B0] = _mm_add_epi32(c[TR_B0], b);
+		c[TR_A1] = _mm_add_epi32(c[TR_A1], a);
+		c[TR_B1] = _mm_add_epi32(c[TR_B1], b);
+
+		s0 = _mm_cmplt_epi32(c[TR_B0], c[TR_A0]);
+		s1 = _mm_cmplt_epi32(c[TR_B1], c[TR_A1]);
+		r0 = _mm_or_si128(_mm_and_si128(s0, c[TR_B0]),
+		                  _mm_andnot_si128(s0, c[TR_A0]));
+		r1 = _mm_or_si128(_mm_and_si128(s1, c[TR_B1]),
+		                  _mm_andnot_si128(s1, c[TR_A1]));
+
+		t  = _mm_cmplt_epi32(r0, max);
+		r0 = _mm_or_si128(_mm_and_si128(t, r0), _mm_andnot_si128(t, max));
+		t  = _mm_cmplt_epi32(r1, max);
+		r1 = _mm_or_si128(_mm_and_si128(t, r1), _mm_andnot_si128(t, max));
+
+		_mm_storeu_si128((__m128i *) &ae_next[2*j],
+		                 _mm_unpacklo_epi32(r0, r1));
+		_mm_storeu_si128((__m128i *) &ae_next[2*j+4],
+		                 _mm_unpackhi_epi32(r0, r1));
+
+		p0 = _mm_add_epi32(jv, _mm_and_si128(s0, hv));
+		p1 = _mm_add_epi32(jv, _mm_and_si128(s1, hv));
+		t  = _mm_packs_epi32(_mm_unpacklo_epi32(p0, p1),
+		                     _mm_unpackhi_epi32(p0, p1));
+		_mm_storel_epi64((__m128i *) &sh[2*j], _mm_packus_epi16(t, t));
+
+		jv = _mm_add_epi32(jv, _mm_set1_epi32(4));
+	}
+}
+#endif
+
+#ifdef HAVE_CONV_AVX2
+__attribute__((target("avx2"))) static void
+_conv_acs_avx2(const struct osmo_conv_trellis *tr, int N,
+               const int *bm, const unsigned int *ae,
+               unsigned int *ae_next, uint8_t *sh)
+{
+	int h = tr->h;
+	__m256i d[MAX_N], c[_NUM_TR];
+	__m256i e0 = _mm256_set1_epi32(bm[0]);
+	__m256i max = _mm256_set1_epi32(MAX_AE);
+	__m256i hv = _mm256_set1_epi32(h);
+	__m256i jv = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i a, b, s0, s1, r0, r1, lo, hi, t;
+	__m128i p0, p1;
+	int j, k, g;
+
+	for (k=0; k<N; k++)
+		d[k] = _mm256_set1_epi32(bm[1+k]);
+
+	for (j=0; j<h; j+=8) {
+		a = _mm256_loadu_si256((const __m256i *) &ae[j]);
+		b = _mm256_loadu_si256((const __m256i *) &ae[j+h]);
+
+		for (g=0; g<_NUM_TR; g++) {
+			c[g] = e0;
+			for (k=0; k<N; k++) {
+				t = _mm256_loadu_si256((const __m256i *)
+					&tr->mask[(k * _NUM_TR + g) * h + j]);
+				c[g] = _mm256_add_epi32(c[g], _mm256_and_si256(t, d[k]));
+			}
+		}
+
+		c[TR_A0] = _mm256_add_epi32(c[TR_A0], a);
+		c[TR_B0] = _mm256_add_epi32(c[TR_B0], b);
+		c[TR_A1] = _mm256_add_epi32(c[TR_A1], a);
+		c[TR_B1] = _mm256_add_epi32(c[TR_B1], b);
+
+		s0 = _mm256_cmpgt_epi32(c[TR_A0], c[TR_B0]);
+		s1 = _mm256_cmpgt_epi32(c[TR_A1], c[TR_B1]);
+		r0 = _mm256_blendv_epi8(c[TR_A0], c[TR_B0], s0);
+		r1 = _mm256_blendv_epi8(c[TR_A1], c[TR_B1], s1);
+		r0 = _mm256_min_epi32(r0, max);
+		r1 = _mm256_min_epi32(r1, max);
+
+		/* unpack works per 128 bit lane, restore state order */
+		lo = _mm256_unpacklo_epi32(r0, r1);
+		hi = _mm256_unpackhi_epi32(r0, r1);
+		_mm256_storeu_si256((__m256i *) &ae_next[2*j],
+		                    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *) &ae_next[2*j+8],
+		                    _mm256_permute2x128_si256(lo, hi, 0x31));
+
+		r0 = _mm256_add_epi32(jv, _mm256_and_si256(s0, hv));
+		r1 = _mm256_add_epi32(jv, _mm256_and_si256(s1, hv));
+		lo = _mm256_unpacklo_epi32(r0, r1);
+		hi = _mm256_unpackhi_epi32(r0, r1);
+		p0 = _mm_packs_epi32(_mm256_castsi256_si128(lo),
+		                     _mm256_castsi256_si128(hi));
+		p1 = _mm_packs_epi32(_mm256_extracti128_si256(lo, 1),
+		                     _mm256_extracti128_si256(hi, 1));
+		_mm_storeu_si128((__m128i *) &sh[2*j], _mm_packus_epi16(p0, p1));
+
+		jv = _mm256_add_epi32(jv, _mm256_set1_epi32(8));
+	}
+}
+#endif
+
+static struct osmo_conv_trellis *
+_conv_trellis_alloc(const struct osmo_conv_code *code, int n_states)
+{
+	struct osmo_conv_trellis *tr;
+	int h = n_states >> 1;
+	int N = code->N;
+	int s, j, g, k;
+
+	if (N > MAX_N || n_states < 2)
+		return NULL;
+
+	/* check for butterfly structure */
+	for (s=0; s<n_states; s++) {
+		int e = (2 * s) & (n_states - 1);
+		int ns0 = code->next_state[s][0];
+		int ns1 = code->next_state[s][1];
+
+		if (!((ns0 == e && ns1 == e+1) || (ns0 == e+1 && ns1 == e)))
+			return NULL;
+	}
+
+	tr = malloc(sizeof(*tr) + sizeof(int32_t) * N * _NUM_TR * h +
+		    sizeof(uint8_t) * _NUM_TR * h);
+	if (!tr)
+		return NULL;
+
+	tr->h = h;
+	tr->mask = (int32_t *) (tr + 1);
+	for (g=0; g<_NUM_TR; g++)
+		tr->out[g] = (uint8_t *) &tr->mask[N * _NUM_TR * h] + g * h;
+
+	for (j=0; j<h; j++) {
+		for (g=0; g<_NUM_TR; g++) {
+			int src = (g == TR_A0 || g == TR_A1) ? j : j + h;
+			int dst = (g == TR_A0 || g == TR_B0) ? 2*j : 2*j + 1;
+			int b = code->next_state[src][0] == dst ? 0 : 1;
+			uint8_t out = code->next_output[src][b];
+
+			tr->out[g][j] = out;
+			for (k=0; k<N; k++)
+				tr->mask[(k * _NUM_TR + g) * h + j] =
+					(out >> (N - k - 1)) & 1 ? -1 : 0;
+		}
+	}
+
+	tr->acs = _conv_acs_scalar;
+	tr->bm_table = 1;
+#ifdef HAVE_CONV_AVX2
+	if (h >= 8 && __builtin_cpu_supports("avx2")) {
+		tr->acs = _conv_acs_avx2;
+		tr->bm_table = 0;
+	} else
+#endif
+#ifdef __SSE2__
+	if (h >= 4) {
+		tr->acs = _conv_acs_sse2;
+		tr->bm_table = 0;
+	}
+#endif
+
+	return tr;
+}
+
 void
 osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
                       const struct osmo_conv_code *code, int len, int start_state)
@@ -262,6 +563,9 @@ osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
 
 	decoder->state_history = malloc(sizeof(uint8_t) * n_states * (len + decoder->code->K - 1));
 
+	/* Fast path for shift register codes, NULL otherwise */
+	decoder->trellis = _conv_trellis_alloc(code, n_states);
+
 	/* Classic reset */
 	osmo_conv_decode_reset(decoder, start_state);
 }
@@ -313,25 +617,63 @@ osmo_conv_decode_deinit(struct osmo_conv_decoder *decoder)
 	free(decoder->ae);
 	free(decoder->ae_next);
 	free(decoder->state_history);
+	free(decoder->trellis);
 
 	memset(decoder, 0x00, sizeof(struct osmo_conv_decoder));
 }
 
+/* Resolve puncturing up front: expand n symbols of input into N soft
+ * bits each, with 0 (undefined) at the punctured positions */
+static int
+_conv_depuncture(struct osmo_conv_decoder *decoder,
+                 const sbit_t *input, sbit_t *in, int n)
+{
+	const struct osmo_conv_code *code = decoder->code;
+	int i_idx, p_idx, idx, end;
+
+	if (!code->puncture) {
+		/* Easy, just copy N bits per symbol */
+		memcpy(in, input, n * code->N);
+		return n * code->N;
+	}
+
+	i_idx = 0;
+	p_idx = decoder->p_idx;
+	idx = decoder->o_idx * code->N;
+	end = idx + n * code->N;
+
+	for (; idx<end; idx++) {
+		if (idx == code->puncture[p_idx]) {
+			*in++ = 0;	/* Undefined */
+			p_idx++;
+		} else {
+			*in++ = input[i_idx++];
+		}
+	}
+
+	decoder->p_idx = p_idx;
+
+	return i_idx;
+}
+
 int
 osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
                       const sbit_t *input, int n)
 {
 	const struct osmo_conv_code *code = decoder->code;
+	const struct osmo_conv_trellis *tr = decoder->trellis;
 
-	int i, s, b, j;
+	int i, s, b;
 
 	int n_states;
 	unsigned int *ae;
 	unsigned int *ae_next;
+	unsigned int *tmp;
 	uint8_t *state_history;
-	sbit_t *in_sym;
+	sbit_t *in;
+	int bm[1 << MAX_N];
 
-	int i_idx, p_idx;
+	int i_idx;
 
 	/* Prepare */
 	n_states = decoder->n_states;
@@ -340,64 +682,41 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 	ae_next = decoder->ae_next;
 	state_history = &decoder->state_history[n_states * decoder->o_idx];
 
-	in_sym  = alloca(sizeof(sbit_t) * code->N);
-
-	i_idx = 0;
-	p_idx = decoder->p_idx;
+	in = alloca(sizeof(sbit_t) * code->N * n);
+	i_idx = _conv_depuncture(decoder, input, in, n);
 
 	/* Scan the treillis */
 	for (i=0; i<n; i++)
 	{
+		const sbit_t *in_sym = &in[i * code->N];
+
+		if (tr) {
+			_conv_branch_metrics(in_sym, code->N, tr->bm_table, bm);
+			tr->acs(tr, code->N, bm, ae, ae_next,
+			        &state_history[n_states * i]);
+			goto next;
+		}
+
+		/* Generic trellis, with the same metrics */
+		_conv_branch_metrics(in_sym, code->N, 1, bm);
+
 		/* Reset next accumulated error */
 		for (s=0; s<n_states; s++) {
 			ae_next[s] = MAX_AE;
 		}
 
-		/* Get input */
-		if (code->puncture) {
-			/* Hard way ... */
-			for (j=0; j<code->N; j++) {
-				int idx = ((decoder->o_idx + i) * code->N) + j;
-				if (idx == code->puncture[p_idx]) {
-					in_sym[j] = 0;	/* Undefined */
-					p_idx++;
-				} else {
-					in_sym[j] = input[i_idx];
-					i_idx++;
-				}
-			}
-		} else {
-			/* Easy, just copy N bits */
-			memcpy(in_sym, &input[i_idx], code->N);
-			i_idx += code->N;
-		}
-
 		/* Scan all state */
 		for (s=0; s<n_states; s++)
 		{
 			/* Scan possible input bits */
 			for (b=0; b<2; b++)
 			{
-				int nae, ov, e;
-				uint8_t m;
-
 				/* Next output and state */
 				uint8_t out   = code->next_output[s][b];
 				uint8_t state = code->next_state[s][b];
 
 				/* New error for this path */
-				nae = ae[s];			/* start from last error */
-				m = 1 << (code->N - 1);		/* mask for 'out' bit selection */
-
-				for (j=0; j<code->N; j++) {
-					int is = (int)in_sym[j];
-					if (is) {
-						ov = (out & m) ? -127 : 127; /* sbit_t value for it */
-						e = is - ov;                 /* raw error for this bit */
-						nae += (e * e) >> 9;         /* acc the squared/scaled value */
-					}
-					m >>= 1;                     /* next mask bit */
-				}
+				unsigned int nae = ae[s] + bm[out];
 
 				/* Is it survivor ? */
 				if (ae_next[state] > nae) {
@@ -407,12 +726,16 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 			}
 		}
 
-		/* Copy accumulated error */
-		memcpy(ae, ae_next, sizeof(unsigned int) * n_states);
+next:
+		/* Swap accumulated error */
+		tmp = ae;
+		ae = ae_next;
+		ae_next = tmp;
 	}
 
 	/* Update decoder state */
-	decoder->p_idx = p_idx;
+	decoder->ae = ae;
+	decoder->ae_next = ae_next;
 	decoder->o_idx += n;
 
 	return i_idx;
@@ -35,6 +35,14 @@
 #include <osmocom/core/bits.h>
 #include <osmocom/core/crcXXgen.h>
 
+#if defined(__GNUC__) && defined(__x86_64__) && (__GNUC__ >= 5)
+#define HAVE_CRC_CLMUL 1
+#include <immintrin.h>
+#endif
+
+/* below this many bytes, folding does not pay off */
+#define CRC_CLMUL_MIN_BYTES	64
+
 
 /*! \brief Compute the CRC value of a given array of hard-bits
  *  \param[in] code The CRC code description to apply
@@ -53,13 +61,13 @@ osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
 	for (i=0; i<len; i++) {
 		uintXX_t bit = in[i] & 1;
 		crc ^= (bit << n);
-		if (crc & (1 << n)) {
+		if (crc & ((uintXX_t)1 << n)) {
 			crc <<= 1;
 			crc ^= poly;
 		} else {
 			crc <<= 1;
 		}
-		crc &= (1ULL << code->bits) - 1;
+		crc &= ((uintXX_t)2 << n) - 1;
 	}
 
 	crc ^= code->remainder;
@@ -115,6 +123,183 @@ osmo_crcXXgen_set_bits(const struct osmo_crcXXgen_code *code,
 		crc_bits[i] = ((crc >> (code->bits-i-1)) & 1);
 }
 
+
+/*
+ * Byte wise computation
+ *
+ * The CRC register is kept left aligned in a XX bit word, which makes
+ * codes of any width up to XX bits work the same. slice[k][i] is the
+ * register after clocking in the byte i followed by k zero bytes, so 8
+ * input bytes are processed with 8 independent table lookups.
+ *
+ * Longer buffers are first folded with carry-less multiplications where
+ * the CPU supports it: a 128 bit block A followed by B is congruent to
+ * A_hi * (x^192 mod P) + A_lo * (x^128 mod P) followed by B, P being the
+ * code polynomial aligned to 64 bits. The last 128 bit remainder then
+ * goes through the tables as well.
+ */
+
+#define CRC_TOP		((uintXX_t)1 << (XX - 1))
+
+/*! \brief x^n modulo (x^64 + p), for n >= 64 */
+static uint64_t
+_crcXXgen_xpow_mod(uint64_t p, int n)
+{
+	uint64_t r = p;
+
+	for (n -= 64; n > 0; n--)
+		r = (r << 1) ^ ((r >> 63) ? p : 0);
+
+	return r;
+}
+
+/*! \brief Initialize the lookup tables for a CRC code
+ *  \param[out] tbl The tables to fill
+ *  \param[in] code The CRC code description (must outlive tbl)
+ */
+void
+osmo_crcXXgen_table_init(struct osmo_crcXXgen_table *tbl,
+                         const struct osmo_crcXXgen_code *code)
+{
+	const uintXX_t poly = code->poly << (XX - code->bits);
+	uintXX_t r;
+	int i, j, k;
+
+	tbl->code = code;
+
+	for (i=0; i<256; i++) {
+		r = (uintXX_t)i << (XX - 8);
+		for (j=0; j<8; j++)
+			r = (r & CRC_TOP) ? (r << 1) ^ poly : (r << 1);
+		tbl->slice[0][i] = r;
+	}
+
+	for (k=1; k<8; k++) {
+		for (i=0; i<256; i++) {
+			r = tbl->slice[k-1][i];
+			tbl->slice[k][i] = (r << 8) ^
+				tbl->slice[0][r >> (XX - 8)];
+		}
+	}
+
+	tbl->fold[0] = _crcXXgen_xpow_mod((uint64_t)code->poly << (64 - code->bits), 192);
+	tbl->fold[1] = _crcXXgen_xpow_mod((uint64_t)code->poly << (64 - code->bits), 128);
+
+	tbl->clmul = 0;
+#ifdef HAVE_CRC_CLMUL
+	tbl->clmul = __builtin_cpu_supports("pclmul") &&
+		     __builtin_cpu_supports("ssse3");
+#endif
+}
+
+/*! \brief Run the left aligned CRC register over whole bytes */
+static uintXX_t
+_crcXXgen_bytes(const struct osmo_crcXXgen_table *tbl, uintXX_t r,
+                const uint8_t *in, int nbytes)
+{
+	uint64_t w;
+
+	for (; nbytes >= 8; nbytes -= 8, in += 8) {
+		w = ((uint64_t)in[0] << 56) | ((uint64_t)in[1] << 48) |
+		    ((uint64_t)in[2] << 40) | ((uint64_t)in[3] << 32) |
+		    ((uint64_t)in[4] << 24) | ((uint64_t)in[5] << 16) |
+		    ((uint64_t)in[6] << 8)  |  (uint64_t)in[7];
+		w ^= (uint64_t)r << (64 - XX);
+		r = tbl->slice[7][ w >> 56        ] ^
+		    tbl->slice[6][(w >> 48) & 0xff] ^
+		    tbl->slice[5][(w >> 40) & 0xff] ^
+		    tbl->slice[4][(w >> 32) & 0xff] ^
+		    tbl->slice[3][(w >> 24) & 0xff] ^
+		    tbl->slice[2][(w >> 16) & 0xff] ^
+		    tbl->slice[1][(w >>  8) & 0xff] ^
+		    tbl->slice[0][ w        & 0xff];
+	}
+
+	for (; nbytes > 0; nbytes--, in++)
+		r = (r << 8) ^ tbl->slice[0][(r >> (XX - 8)) ^ *in];
+
+	return r;
+}
+
+#ifdef HAVE_CRC_CLMUL
+/*! \brief Fold whole 128 bit blocks with carry-less multiplications
+ *  \param[in] tbl The lookup tables (for the folding constants)
+ *  \param[in] in Input bytes, at least 32
+ *  \param[in] nbytes Number of input bytes
+ *  \param[in] init Initial CRC register, aligned to 64 bits
+ *  \param[out] rest 16 bytes congruent to the consumed input
+ *  \returns Number of input bytes consumed
+ */
+__attribute__((target("pclmul,ssse3"))) static int
+_crcXXgen_fold_clmul(const struct osmo_crcXXgen_table *tbl,
+                     const uint8_t *in, int nbytes, uint64_t init,
+                     uint8_t *rest)
+{
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+	                                   8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i k = _mm_set_epi64x(tbl->fold[1], tbl->fold[0]);
+	__m128i v, b;
+	int i;
+
+	/* the initial register just adds to the first bits */
+	v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in), bswap);
+	v = _mm_xor_si128(v, _mm_set_epi64x(init, 0));
+
+	for (i=16; i+16<=nbytes; i+=16) {
+		b = _mm_loadu_si128((const __m128i *)(in + i));
+		b = _mm_shuffle_epi8(b, bswap);
+		v = _mm_xor_si128(b, _mm_xor_si128(
+			_mm_clmulepi64_si128(v, k, 0x01),
+			_mm_clmulepi64_si128(v, k, 0x10)));
+	}
+
+	_mm_storeu_si128((__m128i *)rest, _mm_shuffle_epi8(v, bswap));
+
+	return i;
+}
+#endif
+
+/*! \brief Compute the CRC value of a given array of packed bits
+ *  \param[in] tbl Lookup tables of the CRC code to apply
+ *  \param[in] in Array of packed bits (MSB first)
+ *  \param[in] len Length of the array in bits
+ *  \returns The CRC value
+ *
+ * Gives the same result as osmo_crcXXgen_compute_bits() on the
+ * unpacked bits, only faster.
+ */
+uintXX_t
+osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_table *tbl,
+                            const pbit_t *in, int len)
+{
+	const struct osmo_crcXXgen_code *code = tbl->code;
+	const uintXX_t poly = code->poly << (XX - code->bits);
+	uintXX_t r = code->init << (XX - code->bits);
+	int i, nbytes = len >> 3;
+
+#ifdef HAVE_CRC_CLMUL
+	if (tbl->clmul && nbytes >= CRC_CLMUL_MIN_BYTES) {
+		uint8_t rest[16];
+
+		i = _crcXXgen_fold_clmul(tbl, in, nbytes,
+			(uint64_t)code->init << (64 - code->bits), rest);
+		r = _crcXXgen_bytes(tbl, 0, rest, sizeof(rest));
+		in += i;
+		nbytes -= i;
+	}
+#endif
+
+	r = _crcXXgen_bytes(tbl, r, in, nbytes);
+
+	/* the trailing bits of a partial byte */
+	for (i=0; i<(len & 7); i++) {
+		r ^= (uintXX_t)((in[nbytes] >> (7 - i)) & 1) << (XX - 1);
+		r = (r & CRC_TOP) ? (r << 1) ^ poly : (r << 1);
+	}
+
+	return (r >> (XX - code->bits)) ^ code->remainder;
+}
+
 /*! @} */
 
 /* vim: set syntax=c: */
@@ -24,6 +24,7 @@
 
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <netinet/in.h>
 
@@ -60,12 +61,63 @@ LLIST_HEAD(bssgp_bvc_ctxts);
 static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 			   uint32_t llc_pdu_len, void *priv);
 
+/* BVC contexts of bssgp_bvc_ctxts indexed by BVCI+NSEI and RA ID+CI */
+static struct osmo_hashtable bvc_by_bvci_nsei;
+static struct osmo_hashtable bvc_by_raid_cid;
+
+/* IEs of the PDU being received. Kept between calls of bssgp_rcvmsg() so
+ * only the tags of the previous PDU are reset. A call nested in the
+ * handling of another PDU parses into a tlv_parsed of its own. */
+static struct tlv_parsed_sparse bssgp_rx_tps;
+static int bssgp_rx_tps_busy;
+
+static inline uint32_t bvci_nsei_hash(uint16_t bvci, uint16_t nsei)
+{
+	return osmo_hash_32((bvci << 16) | nsei);
+}
+
+static inline uint32_t raid_cid_hash(const struct gprs_ra_id *raid,
+				     uint16_t cid)
+{
+	uint32_t hash;
+
+	hash = osmo_hash_32((raid->mcc << 16) | raid->mnc);
+	hash = osmo_hash_32(hash ^ ((raid->lac << 16) | cid));
+	return osmo_hash_32(hash ^ raid->rac);
+}
+
+/*! \brief Update the lookup tables after a change of a BVC context
+ *  \param[in] bctx BVC context whose BVCI, NSEI, RA ID or Cell ID changed
+ *
+ * The lookup functions find a context by the values it had when it was
+ * allocated or last rehashed. Code outside of this library that modifies
+ * these fields has to call this function afterwards.
+ */
+void btsctx_rehash(struct bssgp_bvc_ctx *bctx)
+{
+	uint32_t hash;
+
+	hash = bvci_nsei_hash(bctx->bvci, bctx->nsei);
+	if (!osmo_hash_hashed(&bctx->bvci_nsei_node) ||
+	    bctx->bvci_nsei_node.hash != hash) {
+		osmo_hash_del(&bvc_by_bvci_nsei, &bctx->bvci_nsei_node);
+		osmo_hash_add(&bvc_by_bvci_nsei, &bctx->bvci_nsei_node, hash);
+	}
+	hash = raid_cid_hash(&bctx->ra_id, bctx->cell_id);
+	if (!osmo_hash_hashed(&bctx->raid_cid_node) ||
+	    bctx->raid_cid_node.hash != hash) {
+		osmo_hash_del(&bvc_by_raid_cid, &bctx->raid_cid_node);
+		osmo_hash_add(&bvc_by_raid_cid, &bctx->raid_cid_node, hash);
+	}
+}
+
 /* Find a BTS Context based on parsed RA ID and Cell ID */
 struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t cid)
 {
 	struct bssgp_bvc_ctx *bctx;
 
-	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+	osmo_hash_for_each_possible(&bvc_by_raid_cid, bctx, raid_cid_node,
+				    raid_cid_hash(raid, cid)) {
 		if (!memcmp(&bctx->ra_id, raid, sizeof(bctx->ra_id)) &&
 		    bctx->cell_id == cid)
 			return bctx;
@@ -78,7 +130,8 @@ struct bssgp_bvc_ctx *btsctx_by_bvci_nsei(uint16_t bvci, uint16_t nsei)
 {
 	struct bssgp_bvc_ctx *bctx;
 
-	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+	osmo_hash_for_each_possible(&bvc_by_bvci_nsei, bctx, bvci_nsei_node,
+				    bvci_nsei_hash(bvci, nsei)) {
 		if (bctx->nsei == nsei && bctx->bvci == bvci)
 			return bctx;
 	}
@@ -101,6 +154,7 @@ struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei)
 	bssgp_fc_init(ctx->fc, 100000, 2*1024*1024/8, 30, &_bssgp_tx_dl_ud);
 
 	llist_add(&ctx->list, &bssgp_bvc_ctxts);
+	btsctx_rehash(ctx);
 
 	return ctx;
 }
@@ -121,6 +175,26 @@ static int bssgp_tx_fc_bvc_ack(uint16_t nsei, uint8_t tag, uint16_t ns_bvci)
 	return gprs_ns_sendmsg(bssgp_nsi, msg);
 }
 
+/* Chapter 10.4.11: Flow Control MS ACK */
+static int bssgp_tx_fc_ms_ack(uint16_t nsei, uint32_t tlli, uint8_t tag,
+			      uint16_t ns_bvci)
+{
+	struct msgb *msg = bssgp_msgb_alloc();
+	struct bssgp_normal_hdr *bgph =
+			(struct bssgp_normal_hdr *) msgb_put(msg, sizeof(*bgph));
+	uint32_t _tlli;
+
+	msgb_nsei(msg) = nsei;
+	msgb_bvci(msg) = ns_bvci;
+
+	bgph->pdu_type = BSSGP_PDUT_FLOW_CONTROL_MS_ACK;
+	_tlli = htonl(tlli);
+	msgb_tvlv_put(msg, BSSGP_IE_TLLI, 4, (uint8_t *) &_tlli);
+	msgb_tvlv_put(msg, BSSGP_IE_TAG, 1, &tag);
+
+	return gprs_ns_sendmsg(bssgp_nsi, msg);
+}
+
 /* 10.3.7 SUSPEND-ACK PDU */
 int bssgp_tx_suspend_ack(uint16_t nsei, uint32_t tlli,
 			 const struct gprs_ra_id *ra_id, uint8_t suspend_ref)
@@ -267,6 +341,7 @@ static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_parsed *tp,
 		/* actually extract RAC / CID */
 		bctx->cell_id = bssgp_parse_cell_id(&bctx->ra_id,
 						TLVP_VAL(tp, BSSGP_IE_CELL_ID));
+		btsctx_rehash(bctx);
 		LOGP(DBSSGP, LOGL_NOTICE, "Cell %u-%u-%u-%u CI %u on BVCI %u\n",
 			bctx->ra_id.mcc, bctx->ra_id.mnc, bctx->ra_id.lac,
 			bctx->ra_id.rac, bctx->cell_id, bvci);
@@ -516,6 +591,11 @@ static int bssgp_rx_llc_disc(struct msgb *msg, struct tlv_parsed *tp,
 	return bssgp_prim_cb(&nmp.oph, NULL);
 }
 
+/* DRR quantum of the flows of a BVC, larger than any LLC PDU */
+#define BSSGP_FC_QUANTUM	1600
+/* minimum time between two runs of the scheduler of a BVC (us) */
+#define BSSGP_FC_TICK		10000
+
 /* One element (msgb) in a BSSGP Flow Control queue */
 struct bssgp_fc_queue_element {
 	/* linked list of queue elements */
@@ -526,150 +606,309 @@ struct bssgp_fc_queue_element {
 	uint32_t llc_pdu_len;
 	/* private pointer passed to the flow control out_cb function */
 	void *priv;
+	/* time at which the message was enqueued */
+	struct timeval time_enqueued;
 };
 
-static int fc_queue_timer_cfg(struct bssgp_flow_control *fc);
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len);
+static void fc_timer_cb(void *data);
 
-static void fc_timer_cb(void *data)
+/* number of microseconds from a to b */
+static int64_t fc_usecs(const struct timeval *a, const struct timeval *b)
 {
-	struct bssgp_flow_control *fc = data;
-	struct bssgp_fc_queue_element *fcqe;
-	struct timeval time_now;
+	return (int64_t) (b->tv_sec - a->tv_sec) * 1000000 +
+		b->tv_usec - a->tv_usec;
+}
+
+static void fc_hist_add(uint32_t *hist, uint32_t val)
+{
+	unsigned int bin = 0;
+
+	while (val && bin < BSSGP_FC_HIST_BINS - 1) {
+		val >>= 1;
+		bin++;
+	}
+	hist[bin]++;
+}
 
-	/* if the queue is empty, we return without sending something
-	 * and without re-starting the timer */
-	if (llist_empty(&fc->queue))
+/* According to Section 8.2: leak the bucket up to the current time
+ * B' = B - (Tc - Tp)*R */
+static void fc_leak(struct bssgp_flow_control *fc, const struct timeval *now)
+{
+	int64_t usecs = fc_usecs(&fc->time_last_pdu, now);
+	uint64_t leaked;
+
+	if (usecs <= 0 || !fc->bucket_leak_rate)
+		return;
+	/* cap at 10^12 us, which empties any bucket without overflow */
+	if (usecs > 1000000000000LL)
+		usecs = 1000000000000LL;
+
+	leaked = usecs * fc->bucket_leak_rate / 1000000;
+	if (leaked >= fc->bucket_counter) {
+		fc->bucket_counter = 0;
+		fc->time_last_pdu = *now;
 		return;
+	}
+
+	/* advance the time by the leaked octets only, so that the
+	 * remainder of the interval is not lost */
+	fc->bucket_counter -= leaked;
+	usecs = leaked * 1000000 / fc->bucket_leak_rate;
+	fc->time_last_pdu.tv_sec += usecs / 1000000;
+	fc->time_last_pdu.tv_usec += usecs % 1000000;
+	if (fc->time_last_pdu.tv_usec >= 1000000) {
+		fc->time_last_pdu.tv_sec++;
+		fc->time_last_pdu.tv_usec -= 1000000;
+	}
+}
+
+/* number of microseconds until a leaked bucket can take pdu_len octets,
+ * 0 if it can take them now. An empty bucket takes any PDU, a queued one
+ * may be larger than a Bmax that was lowered after it was queued. */
+static int64_t fc_wait(const struct bssgp_flow_control *fc,
+		       const struct timeval *now, uint32_t pdu_len)
+{
+	uint64_t excess;
+	int64_t usecs;
+
+	if (!fc->bucket_counter ||
+	    fc->bucket_counter + pdu_len <= fc->bucket_size_max)
+		return 0;
+	/* a bucket that doesn't leak is retried once per second */
+	if (!fc->bucket_leak_rate)
+		return 1000000;
+
+	excess = fc->bucket_counter + pdu_len - fc->bucket_size_max;
+	if (excess > fc->bucket_counter)
+		excess = fc->bucket_counter;
+	usecs = (excess * 1000000 + fc->bucket_leak_rate - 1) /
+		fc->bucket_leak_rate;
+	usecs -= fc_usecs(&fc->time_last_pdu, now);
+	return usecs > 0 ? usecs : 1;
+}
+
+/* extend the wait for a full BVC bucket to one tick, so that the next
+ * run sends a batch of PDUs, unless the bucket would run empty */
+static int64_t fc_tick(const struct bssgp_flow_control *fc, int64_t usecs)
+{
+	int64_t usecs_empty;
+
+	if (usecs >= BSSGP_FC_TICK || !fc->bucket_leak_rate)
+		return usecs;
+
+	usecs_empty = (int64_t) fc->bucket_counter * 1000000 /
+		fc->bucket_leak_rate;
+	if (usecs_empty > BSSGP_FC_TICK)
+		usecs_empty = BSSGP_FC_TICK;
+	return usecs_empty > usecs ? usecs_empty : usecs;
+}
+
+static void fc_timer_set(struct bssgp_flow_control *fc, int64_t usecs)
+{
+	fc->timer.data = fc;
+	fc->timer.cb = &fc_timer_cb;
+	osmo_timer_schedule(&fc->timer, usecs / 1000000, usecs % 1000000);
+}
 
-	/* get the first entry from the queue */
-	fcqe = llist_entry(fc->queue.next, struct bssgp_fc_queue_element,
+/* number of microseconds until the first PDU of a flow of a BVC flow
+ * control can pass both buckets */
+static int64_t fc_flow_wait(struct bssgp_flow_control *fc,
+			    struct bssgp_flow_control *flow,
+			    const struct timeval *now)
+{
+	struct bssgp_fc_queue_element *fcqe;
+	int64_t usecs, usecs_ms;
+
+	fcqe = llist_entry(flow->queue.next, struct bssgp_fc_queue_element,
 			   list);
 
-	if (bssgp_fc_needs_queueing(fc, fcqe->llc_pdu_len)) {
-		LOGP(DBSSGP, LOGL_NOTICE, "BSSGP-FC: fc_timer_cb() but still "
-			"not able to send PDU of %u bytes\n", fcqe->llc_pdu_len);
-		/* make sure we re-start the timer */
-		fc_queue_timer_cfg(fc);
-		return;
+	usecs = fc_wait(fc, now, fcqe->llc_pdu_len);
+	if (usecs)
+		usecs = fc_tick(fc, usecs);
+	if (flow != fc) {
+		fc_leak(flow, now);
+		usecs_ms = fc_wait(flow, now, fcqe->llc_pdu_len);
+		if (usecs_ms > usecs)
+			usecs = usecs_ms;
 	}
+	return usecs;
+}
 
-	/* remove from the queue */
-	llist_del(&fcqe->list);
+/* schedule the timer of a BVC flow control for the first PDU of the
+ * first flow in the deficit round robin */
+static void fc_queue_timer_cfg(struct bssgp_flow_control *fc,
+			       const struct timeval *now)
+{
+	struct bssgp_flow_control *flow;
+
+	if (llist_empty(&fc->active))
+		return;
+
+	flow = llist_entry(fc->active.next, struct bssgp_flow_control,
+			   active_list);
+	fc_timer_set(fc, fc_flow_wait(fc, flow, now));
+}
 
-	fc->queue_depth--;
+/* reschedule the timer of a BVC flow control after a change of the
+ * bucket parameters */
+static void fc_reschedule(struct bssgp_flow_control *fc)
+{
+	struct timeval time_now;
+
+	if (llist_empty(&fc->active))
+		return;
 
-	/* record the time we transmitted this PDU */
 	gettimeofday(&time_now, NULL);
-	fc->time_last_pdu = time_now;
+	fc_leak(fc, &time_now);
+	fc_queue_timer_cfg(fc, &time_now);
+}
 
-	/* call the output callback for this FC instance */
-	fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+/* remove the first PDU of a flow and pass it to the output of the BVC */
+static void fc_dequeue(struct bssgp_flow_control *fc,
+		       struct bssgp_flow_control *flow,
+		       const struct timeval *now)
+{
+	struct bssgp_fc_queue_element *fcqe;
+	void *priv = NULL;
+
+	fcqe = llist_entry(flow->queue.next, struct bssgp_fc_queue_element,
+			   list);
+	llist_del(&fcqe->list);
+	flow->queue_depth--;
+	flow->deficit -= fcqe->llc_pdu_len;
+	fc->bucket_counter += fcqe->llc_pdu_len;
+	if (flow != fc) {
+		flow->bucket_counter += fcqe->llc_pdu_len;
+		fc->ms_queue_depth--;
+	} else
+		priv = fcqe->priv;
+
+	if (llist_empty(&flow->queue)) {
+		llist_del_init(&flow->active_list);
+		fc->num_active--;
+		flow->deficit = 0;
+	}
+
+	fc_hist_add(fc->stats.delay_ms,
+		    fc_usecs(&fcqe->time_enqueued, now) / 1000);
+
+	/* call the output callback for this FC instance, the PDUs of
+	 * a per-MS flow take the path they took through bssgp_fc_in() */
+	fc->out_cb(priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
 
 	/* we expect that out_cb will in the end free the msgb once
 	 * it is no longer needed */
 
 	/* but we have to free the queue element ourselves */
 	talloc_free(fcqe);
-
-	/* re-configure the timer for the next PDU */
-	fc_queue_timer_cfg(fc);
 }
 
-/* configure/schedule the flow control timer to expire once the bucket
- * will have leaked a sufficient number of bytes to transmit the next
- * PDU in the queue */
-static int fc_queue_timer_cfg(struct bssgp_flow_control *fc)
+/* send as many PDUs of a BVC as its bucket allows, deficit round robin
+ * between its own queue and the queues of its per-MS flows */
+static void fc_timer_cb(void *data)
 {
+	struct bssgp_flow_control *fc = data;
+	struct bssgp_flow_control *flow;
 	struct bssgp_fc_queue_element *fcqe;
-	uint32_t msecs;
+	struct timeval time_now;
+	unsigned int blocked = 0;
+	int64_t usecs, usecs_ms = 0;
 
-	if (llist_empty(&fc->queue))
-		return 0;
+	gettimeofday(&time_now, NULL);
+	fc_leak(fc, &time_now);
+	fc->stats.ticks++;
+
+	/* stop once the BVC bucket is full, or a whole round of flows is
+	 * waiting for their per-MS buckets */
+	while (!llist_empty(&fc->active) && blocked < fc->num_active) {
+		flow = llist_entry(fc->active.next, struct bssgp_flow_control,
+				   active_list);
+		fcqe = llist_entry(flow->queue.next,
+				   struct bssgp_fc_queue_element, list);
+
+		if (fcqe->llc_pdu_len > flow->deficit) {
+			/* end of the turn of this flow */
+			flow->deficit += fc->quantum;
+			llist_move_tail(&flow->active_list, &fc->active);
+			blocked = 0;
+			continue;
+		}
 
-	fcqe = llist_entry(&fc->queue.next, struct bssgp_fc_queue_element,
-			   list);
+		if (flow != fc) {
+			fc_leak(flow, &time_now);
+			usecs = fc_wait(flow, &time_now, fcqe->llc_pdu_len);
+			if (usecs) {
+				/* it keeps its deficit for the next turn */
+				if (!usecs_ms || usecs < usecs_ms)
+					usecs_ms = usecs;
+				llist_move_tail(&flow->active_list, &fc->active);
+				blocked++;
+				continue;
+			}
+		}
 
-	/* Calculate the point in time at which we will have leaked
-	 * a sufficient number of bytes from the bucket to transmit
-	 * the first PDU in the queue */
-	msecs = (fcqe->llc_pdu_len * 1000) / fc->bucket_leak_rate;
-	/* FIXME: add that time to fc->time_last_pdu and subtract it from
-	 * current time */
+		usecs = fc_wait(fc, &time_now, fcqe->llc_pdu_len);
+		if (usecs) {
+			fc_timer_set(fc, fc_tick(fc, usecs));
+			return;
+		}
 
-	fc->timer.data = fc;
-	fc->timer.cb = &fc_timer_cb;
-	osmo_timer_schedule(&fc->timer, msecs / 1000, (msecs % 1000) * 1000);
+		fc_dequeue(fc, flow, &time_now);
+		blocked = 0;
+	}
 
-	return 0;
+	if (!llist_empty(&fc->active))
+		fc_timer_set(fc, usecs_ms);
 }
 
 /* Enqueue a PDU in the flow control queue for delayed transmission */
 static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
-		      uint32_t llc_pdu_len, void *priv)
+		      uint32_t llc_pdu_len, void *priv,
+		      const struct timeval *now)
 {
+	struct bssgp_flow_control *bvc_fc = fc->parent ? fc->parent : fc;
 	struct bssgp_fc_queue_element *fcqe;
+	struct timeval remaining;
+	int64_t usecs;
 
 	if (fc->queue_depth >= fc->max_queue_depth)
 		return -ENOSPC;
 
-	fcqe = talloc_zero(fc, struct bssgp_fc_queue_element);
+	/* a per-MS flow control need not be a talloc chunk */
+	fcqe = talloc_zero(bvc_fc, struct bssgp_fc_queue_element);
 	if (!fcqe)
 		return -ENOMEM;
 	fcqe->msg = msg;
 	fcqe->llc_pdu_len = llc_pdu_len;
 	fcqe->priv = priv;
+	fcqe->time_enqueued = *now;
 
 	llist_add_tail(&fcqe->list, &fc->queue);
 
 	fc->queue_depth++;
+	if (fc != bvc_fc)
+		bvc_fc->ms_queue_depth++;
+	fc_hist_add(bvc_fc->stats.queue_depth,
+		    bvc_fc->queue_depth + bvc_fc->ms_queue_depth);
 
-	/* re-configure the timer for dequeueing the pdu */
-	fc_queue_timer_cfg(fc);
-
-	return 0;
-}
-
-/* According to Section 8.2 */
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len)
-{
-	struct timeval time_now, time_diff;
-	int64_t bucket_predicted;
-	uint32_t csecs_elapsed, leaked;
-
-	/* B' = B + L(p) - (Tc - Tp)*R */
-
-	/* compute number of centi-seconds that have elapsed since transmitting
-	 * the last PDU (Tc - Tp) */
-	gettimeofday(&time_now, NULL);
-	timersub(&time_now, &fc->time_last_pdu, &time_diff);
-	csecs_elapsed = time_diff.tv_sec*100 + time_diff.tv_usec/10000;
-
-	/* compute number of bytes that have leaked in the elapsed number
-	 * of centi-seconds */
-	leaked = csecs_elapsed * (fc->bucket_leak_rate / 100);
-	/* add the current PDU length to the last bucket level */
-	bucket_predicted = fc->bucket_counter + pdu_len;
-	/* ... and subtract the number of leaked bytes */
-	bucket_predicted -= leaked;
-
-	if (bucket_predicted < pdu_len) {
-		/* this is just to make sure the bucket doesn't underflow */
-		bucket_predicted = pdu_len;
-		goto pass;
-	}
-
-	if (bucket_predicted <= fc->bucket_size_max) {
-		/* the bucket is not full yet, we can pass the packet */
-		fc->bucket_counter = bucket_predicted;
-		goto pass;
-	}
+	if (fc->queue_depth > 1)
+		return 0;
 
-	/* bucket is full, PDU needs to be delayed */
-	return 1;
+	/* a flow joins the round robin at the end */
+	fc->deficit = bvc_fc->quantum;
+	llist_add_tail(&fc->active_list, &bvc_fc->active);
+	bvc_fc->num_active++;
+
+	/* the running timer takes care of this PDU as well, unless the
+	 * PDU could pass earlier, e.g. when the other flows wait for
+	 * their per-MS buckets */
+	usecs = fc_flow_wait(bvc_fc, fc, now);
+	if (osmo_timer_pending(&bvc_fc->timer) &&
+	    !osmo_timer_remaining(&bvc_fc->timer, NULL, &remaining) &&
+	    remaining.tv_sec * 1000000LL + remaining.tv_usec <= usecs)
+		return 0;
+	fc_timer_set(bvc_fc, usecs);
 
-pass:
-	/* if we reach here, the PDU can pass */
 	return 0;
 }
 
@@ -686,6 +925,7 @@ static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		uint32_t llc_pdu_len, void *priv)
 {
+	struct bssgp_flow_control *bvc_fc = fc->parent;
 	struct timeval time_now;
 
 	if (llc_pdu_len > fc->bucket_size_max) {
@@ -695,14 +935,34 @@ int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		return -EIO;
 	}
 
-	if (bssgp_fc_needs_queueing(fc, llc_pdu_len)) {
-		return fc_enqueue(fc, msg, llc_pdu_len, priv);
-	} else {
-		/* record the time we transmitted this PDU */
-		gettimeofday(&time_now, NULL);
-		fc->time_last_pdu = time_now;
+	gettimeofday(&time_now, NULL);
+	fc_leak(fc, &time_now);
+
+	if (!bvc_fc) {
+		/* PDUs pass in order, only if nothing is queued */
+		if (!llist_empty(&fc->active) ||
+		    fc_wait(fc, &time_now, llc_pdu_len))
+			return fc_enqueue(fc, msg, llc_pdu_len, priv,
+					  &time_now);
+		fc->bucket_counter += llc_pdu_len;
 		return fc->out_cb(priv, msg, llc_pdu_len, NULL);
 	}
+
+	/* per-MS flow control, scheduled by the flow control of its BVC */
+	if (llc_pdu_len > bvc_fc->bucket_size_max) {
+		LOGP(DBSSGP, LOGL_NOTICE, "Single PDU (size=%u) is larger "
+		     "than maximum bucket size (%u)!\n", llc_pdu_len,
+		     bvc_fc->bucket_size_max);
+		return -EIO;
+	}
+	fc_leak(bvc_fc, &time_now);
+	if (!llist_empty(&bvc_fc->active) ||
+	    fc_wait(fc, &time_now, llc_pdu_len) ||
+	    fc_wait(bvc_fc, &time_now, llc_pdu_len))
+		return fc_enqueue(fc, msg, llc_pdu_len, priv, &time_now);
+	fc->bucket_counter += llc_pdu_len;
+	bvc_fc->bucket_counter += llc_pdu_len;
+	return bvc_fc->out_cb(NULL, msg, llc_pdu_len, NULL);
 }
 
 
@@ -716,9 +976,23 @@ void bssgp_fc_init(struct bssgp_flow_control *fc,
 	fc->out_cb = out_cb;
 	fc->bucket_size_max = bucket_size_max;
 	fc->bucket_leak_rate = bucket_leak_rate;
+	fc->bucket_counter = 0;
 	fc->max_queue_depth = max_queue_depth;
+	fc->queue_depth = 0;
 	INIT_LLIST_HEAD(&fc->queue);
 	gettimeofday(&fc->time_last_pdu, NULL);
+
+	fc->parent = NULL;
+	INIT_LLIST_HEAD(&fc->active);
+	fc->num_active = 0;
+	INIT_LLIST_HEAD(&fc->active_list);
+	fc->quantum = BSSGP_FC_QUANTUM;
+	fc->deficit = 0;
+	fc->ms_queue_depth = 0;
+	memset(&fc->stats, 0, sizeof(fc->stats));
+	memset(&fc->ms_by_tlli, 0, sizeof(fc->ms_by_tlli));
+	memset(&fc->tlli_node, 0, sizeof(fc->tlli_node));
+	fc->tlli = 0;
 }
 
 /* Initialize the Flow Control parameters for a new MS according to
@@ -735,10 +1009,75 @@ int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
 	/* output call-back of per-MS FC is per-CTX FC */
 	bssgp_fc_init(fc_ms, ctx->bmax_default_ms, ctx->r_default_ms,
 			max_queue_depth, bssgp_fc_in);
+	/* queued PDUs are scheduled by the per-CTX FC */
+	fc_ms->parent = ctx->fc;
 
 	return 0;
 }
 
+/*! \brief Set the TLLI of a per-MS flow control
+ *  \param[in] fc_ms flow control initialized by bssgp_fc_ms_init()
+ *  \param[in] tlli TLLI of the MS
+ *
+ * A FLOW-CONTROL-MS from the BSS updates the bucket of the per-MS flow
+ * control that has its TLLI. Call this again after a TLLI change.
+ */
+int bssgp_fc_ms_set_tlli(struct bssgp_flow_control *fc_ms, uint32_t tlli)
+{
+	struct bssgp_flow_control *bvc_fc = fc_ms->parent;
+
+	if (!bvc_fc)
+		return -EINVAL;
+
+	osmo_hash_del(&bvc_fc->ms_by_tlli, &fc_ms->tlli_node);
+	fc_ms->tlli = tlli;
+	return osmo_hash_add(&bvc_fc->ms_by_tlli, &fc_ms->tlli_node,
+			     osmo_hash_32(tlli));
+}
+
+/*! \brief Release a per-MS flow control
+ *  \param[in] fc_ms flow control initialized by bssgp_fc_ms_init()
+ *
+ * Frees the queued PDUs and removes the flow control from its BVC.
+ * It has to be called before fc_ms is freed or initialized again.
+ */
+void bssgp_fc_ms_release(struct bssgp_flow_control *fc_ms)
+{
+	struct bssgp_flow_control *bvc_fc = fc_ms->parent;
+	struct bssgp_fc_queue_element *fcqe, *tmp;
+
+	llist_for_each_entry_safe(fcqe, tmp, &fc_ms->queue, list) {
+		llist_del(&fcqe->list);
+		msgb_free(fcqe->msg);
+		talloc_free(fcqe);
+	}
+	if (!bvc_fc)
+		return;
+
+	bvc_fc->ms_queue_depth -= fc_ms->queue_depth;
+	fc_ms->queue_depth = 0;
+	if (!llist_empty(&fc_ms->active_list)) {
+		llist_del_init(&fc_ms->active_list);
+		bvc_fc->num_active--;
+	}
+	osmo_hash_del(&bvc_fc->ms_by_tlli, &fc_ms->tlli_node);
+	fc_ms->parent = NULL;
+}
+
+/* Find the per-MS flow control of a TLLI on a BVC */
+static struct bssgp_flow_control *fc_ms_by_tlli(struct bssgp_bvc_ctx *bctx,
+						uint32_t tlli)
+{
+	struct bssgp_flow_control *fc_ms;
+
+	osmo_hash_for_each_possible(&bctx->fc->ms_by_tlli, fc_ms, tlli_node,
+				    osmo_hash_32(tlli)) {
+		if (fc_ms->tlli == tlli)
+			return fc_ms;
+	}
+	return NULL;
+}
+
 static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_parsed *tp,
 			   struct bssgp_bvc_ctx *bctx)
 {
@@ -769,11 +1108,51 @@ static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_parsed *tp,
 	bctx->r_default_ms = 100 *
 		ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_R_DEFAULT_MS)) / 8;
 
+	/* the queued PDUs may pass earlier or later now */
+	fc_reschedule(bctx->fc);
+
 	/* Send FLOW_CONTROL_BVC_ACK */
 	return bssgp_tx_fc_bvc_ack(msgb_nsei(msg), *TLVP_VAL(tp, BSSGP_IE_TAG),
 				   msgb_bvci(msg));
 }
 
+static int bssgp_rx_fc_ms(struct msgb *msg, struct tlv_parsed *tp,
+			  struct bssgp_bvc_ctx *bctx)
+{
+	struct bssgp_flow_control *fc_ms;
+	uint32_t tlli;
+
+	DEBUGP(DBSSGP, "BSSGP BVCI=%u Rx Flow Control MS\n",
+		bctx->bvci);
+
+	if (!TLVP_PRESENT(tp, BSSGP_IE_TLLI) ||
+	    !TLVP_PRESENT(tp, BSSGP_IE_TAG) ||
+	    !TLVP_PRESENT(tp, BSSGP_IE_MS_BUCKET_SIZE) ||
+	    !TLVP_PRESENT(tp, BSSGP_IE_BUCKET_LEAK_RATE)) {
+		LOGP(DBSSGP, LOGL_ERROR, "BSSGP BVCI=%u Rx FC MS "
+			"missing mandatory IE\n", bctx->bvci);
+		return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
+	}
+
+	tlli = ntohl(*(uint32_t *)TLVP_VAL(tp, BSSGP_IE_TLLI));
+
+	/* the MS may not have a flow control, see bssgp_fc_ms_set_tlli() */
+	fc_ms = fc_ms_by_tlli(bctx, tlli);
+	if (fc_ms) {
+		/* 11.3.21 MS Bucket Size in 100 octets unit */
+		fc_ms->bucket_size_max = 100 *
+			ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_MS_BUCKET_SIZE));
+		/* 11.3.4 Bucket Leak Rate in 100 bits/sec unit */
+		fc_ms->bucket_leak_rate = 100 *
+			ntohs(*(uint16_t *)TLVP_VAL(tp, BSSGP_IE_BUCKET_LEAK_RATE)) / 8;
+		fc_reschedule(bctx->fc);
+	}
+
+	/* Send FLOW_CONTROL_MS_ACK */
+	return bssgp_tx_fc_ms_ack(msgb_nsei(msg), tlli,
+				  *TLVP_VAL(tp, BSSGP_IE_TAG), msgb_bvci(msg));
+}
+
 /* Receive a BSSGP PDU from a BSS on a PTP BVCI */
 static int bssgp_rx_ptp(struct msgb *msg, struct tlv_parsed *tp,
 			struct bssgp_bvc_ctx *bctx)
@@ -814,10 +1193,7 @@ static int bssgp_rx_ptp(struct msgb *msg, struct tlv_parsed *tp,
 		break;
 	case BSSGP_PDUT_FLOW_CONTROL_MS:
 		/* BSS informs us of available bandwidth to one MS */
-		DEBUGP(DBSSGP, "BSSGP BVCI=%u Rx Flow Control MS\n",
-			bctx->bvci);
-		/* FIXME: actually implement flow control */
-		/* FIXME: Send FLOW_CONTROL_MS_ACK */
+		rc = bssgp_rx_fc_ms(msg, tp, bctx);
 		break;
 	case BSSGP_PDUT_STATUS:
 		/* Some exception has occurred */
@@ -943,16 +1319,30 @@ err_mand_ie:
 	return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
 }
 
+static const struct tlv_compiled *bssgp_tlv_compiled(void)
+{
+	static struct tlv_compiled c;
+	static int compiled;
+
+	if (!compiled) {
+		tlv_compile(&c, &tvlv_att_def);
+		compiled = 1;
+	}
+	return &c;
+}
+
 /* We expect msgb_bssgph() to point to the BSSGP header */
 int bssgp_rcvmsg(struct msgb *msg)
 {
 	struct bssgp_normal_hdr *bgph =
 			(struct bssgp_normal_hdr *) msgb_bssgph(msg);
 	struct bssgp_ud_hdr *budh = (struct bssgp_ud_hdr *) msgb_bssgph(msg);
-	struct tlv_parsed tp;
+	struct tlv_parsed tp_nested;
+	struct tlv_parsed *tp;
 	struct bssgp_bvc_ctx *bctx;
 	uint8_t pdu_type = bgph->pdu_type;
 	uint16_t ns_bvci = msgb_bvci(msg);
+	uint8_t *data;
 	int data_len;
 	int rc = 0;
 
@@ -961,11 +1351,22 @@ int bssgp_rcvmsg(struct msgb *msg)
 	/* UNITDATA BSSGP headers have TLLI in front */
 	if (pdu_type != BSSGP_PDUT_UL_UNITDATA &&
 	    pdu_type != BSSGP_PDUT_DL_UNITDATA) {
+		data = bgph->data;
 		data_len = msgb_bssgp_len(msg) - sizeof(*bgph);
-		rc = bssgp_tlv_parse(&tp, bgph->data, data_len);
 	} else {
+		data = budh->data;
 		data_len = msgb_bssgp_len(msg) - sizeof(*budh);
-		rc = bssgp_tlv_parse(&tp, budh->data, data_len);
+	}
+
+	if (!bssgp_rx_tps_busy) {
+		bssgp_rx_tps_busy = 1;
+		tp = &bssgp_rx_tps.tp;
+		rc = tlv_parse_compiled(&bssgp_rx_tps, bssgp_tlv_compiled(),
+					NULL, data, data_len, 0, 0);
+	} else {
+		/* the outer PDU is still being handled */
+		tp = &tp_nested;
+		rc = tlv_parse(tp, &tvlv_att_def, data, data_len, 0, 0);
 	}
 
 	/* look-up or create the BTS context for this BVC */
@@ -975,7 +1376,8 @@ int bssgp_rcvmsg(struct msgb *msg)
 		LOGP(DBSSGP, LOGL_NOTICE, "NSEI=%u/BVCI=%u Rejecting PDU "
 			"type %u for unknown BVCI\n", msgb_nsei(msg), ns_bvci,
 			pdu_type);
-		return bssgp_tx_status(BSSGP_CAUSE_UNKNOWN_BVCI, NULL, msg);
+		rc = bssgp_tx_status(BSSGP_CAUSE_UNKNOWN_BVCI, NULL, msg);
+		goto out;
 	}
 
 	if (bctx) {
@@ -986,12 +1388,18 @@ int bssgp_rcvmsg(struct msgb *msg)
 	}
 
 	if (ns_bvci == BVCI_SIGNALLING)
-		rc = bssgp_rx_sign(msg, &tp, bctx);
+		rc = bssgp_rx_sign(msg, tp, bctx);
 	else if (ns_bvci == BVCI_PTM)
 		rc = bssgp_tx_status(BSSGP_CAUSE_PDU_INCOMP_FEAT, NULL, msg);
 	else
-		rc = bssgp_rx_ptp(msg, &tp, bctx);
+		rc = bssgp_rx_ptp(msg, tp, bctx);
 
+out:
+	/* don't keep pointers into the msgb, it is reused after this */
+	if (tp == &bssgp_rx_tps.tp) {
+		tlv_parsed_sparse_clear(&bssgp_rx_tps);
+		bssgp_rx_tps_busy = 0;
+	}
 	return rc;
 }
 
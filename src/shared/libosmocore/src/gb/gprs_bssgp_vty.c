@@ -81,6 +81,26 @@ DEFUN(cfg_bssgp, cfg_bssgp_cmd,
 	return CMD_SUCCESS;
 }
 
+/* print the non-empty bins of a flow control histogram */
+static void dump_fc_hist(struct vty *vty, const char *name,
+			 const uint32_t *hist)
+{
+	int i;
+
+	vty_out(vty, "%s", name);
+	for (i = 0; i < BSSGP_FC_HIST_BINS; i++) {
+		if (!hist[i])
+			continue;
+		if (i == 0)
+			vty_out(vty, " 0: %u", hist[i]);
+		else if (i == BSSGP_FC_HIST_BINS - 1)
+			vty_out(vty, " >=%u: %u", 1 << (i - 1), hist[i]);
+		else
+			vty_out(vty, " <%u: %u", 1 << i, hist[i]);
+	}
+	vty_out(vty, "%s", VTY_NEWLINE);
+}
+
 static void dump_bvc(struct vty *vty, struct bssgp_bvc_ctx *bvc, int stats)
 {
 	vty_out(vty, "NSEI %5u, BVCI %5u, RA-ID: %u-%u-%u-%u, CID: %u, "
@@ -94,12 +114,19 @@ static void dump_bvc(struct vty *vty, struct bssgp_bvc_ctx *bvc, int stats)
 
 		vty_out_rate_ctr_group(vty, " ", bvc->ctrg);
 
-		if (fc)
+		if (fc) {
 			vty_out(vty, "FC-BVC(bucket_max: %uoct, leak_rate: "
 				"%uoct/s, cur_tokens: %uoct, max_q_d: %u, "
-				"cur_q_d: %u)\n", fc->bucket_size_max,
-				fc->bucket_leak_rate, fc->bucket_counter,
-				fc->max_queue_depth, fc->queue_depth);
+				"cur_q_d: %u, ms_q_d: %u, ms_active: %u)\n",
+				fc->bucket_size_max, fc->bucket_leak_rate,
+				fc->bucket_counter, fc->max_queue_depth,
+				fc->queue_depth, fc->ms_queue_depth,
+				fc->num_active);
+			dump_fc_hist(vty, " FC queue depth (msgs):",
+				     fc->stats.queue_depth);
+			dump_fc_hist(vty, " FC queue delay (ms):",
+				     fc->stats.delay_ms);
+		}
 	}
 }
 
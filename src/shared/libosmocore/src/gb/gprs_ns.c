@@ -61,6 +61,9 @@
  *  o There are no BLOCK and UNBLOCK timers (yet?)
  */
 
+#define _GNU_SOURCE	/* for recvmmsg() and sendmmsg() */
+#include "../../config.h"
+
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
@@ -68,6 +71,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 
 #include <osmocom/core/msgb.h>
@@ -118,6 +122,64 @@ static const struct rate_ctr_group_desc nsvc_ctrg_desc = {
 	.ctr_desc = nsvc_ctr_description,
 };
 
+static inline uint32_t nsvc_addr_hash(const struct sockaddr_in *sin)
+{
+	return osmo_hash_32(osmo_hash_32(sin->sin_addr.s_addr) ^
+			    sin->sin_port);
+}
+
+/* put a NS-VC into the lookup tables, or move it to the buckets of its
+ * current NSVCI, NSEI and remote address */
+static void nsvc_hash(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_inst *nsi = nsvc->nsi;
+	uint32_t hash;
+
+	hash = osmo_hash_32(nsvc->nsvci);
+	if (!osmo_hash_hashed(&nsvc->nsvci_node) ||
+	    nsvc->nsvci_node.hash != hash) {
+		osmo_hash_del(&nsi->nsvc_by_nsvci, &nsvc->nsvci_node);
+		osmo_hash_add(&nsi->nsvc_by_nsvci, &nsvc->nsvci_node, hash);
+	}
+	hash = osmo_hash_32(nsvc->nsei);
+	if (!osmo_hash_hashed(&nsvc->nsei_node) ||
+	    nsvc->nsei_node.hash != hash) {
+		osmo_hash_del(&nsi->nsvc_by_nsei, &nsvc->nsei_node);
+		osmo_hash_add(&nsi->nsvc_by_nsei, &nsvc->nsei_node, hash);
+	}
+	hash = nsvc_addr_hash(&nsvc->ip.bts_addr);
+	if (!osmo_hash_hashed(&nsvc->addr_node) ||
+	    nsvc->addr_node.hash != hash) {
+		osmo_hash_del(&nsi->nsvc_by_addr, &nsvc->addr_node);
+		osmo_hash_add(&nsi->nsvc_by_addr, &nsvc->addr_node, hash);
+	}
+}
+
+static void nsvc_unhash(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_inst *nsi = nsvc->nsi;
+
+	osmo_hash_del(&nsi->nsvc_by_nsvci, &nsvc->nsvci_node);
+	osmo_hash_del(&nsi->nsvc_by_nsei, &nsvc->nsei_node);
+	osmo_hash_del(&nsi->nsvc_by_addr, &nsvc->addr_node);
+}
+
+/*! \brief Update the lookup tables after a change of a NS-VC
+ *  \param[in] nsvc gprs_nsvc whose NSEI, NSVCI or remote address changed
+ *
+ * The lookup functions find a NS-VC by the values it had when it was
+ * created or last rehashed. Code outside of this library that modifies
+ * these fields has to call this function afterwards.
+ */
+void gprs_nsvc_rehash(struct gprs_nsvc *nsvc)
+{
+	/* the unknown_nsvc is not part of any lookup */
+	if (!osmo_hash_hashed(&nsvc->nsvci_node))
+		return;
+
+	nsvc_hash(nsvc);
+}
+
 /*! \brief Lookup struct gprs_nsvc based on NSVCI
  *  \param[in] nsi NS instance in which to search
  *  \param[in] nsvci NSVCI to be searched
@@ -126,7 +188,8 @@ static const struct rate_ctr_group_desc nsvc_ctrg_desc = {
 struct gprs_nsvc *gprs_nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	osmo_hash_for_each_possible(&nsi->nsvc_by_nsvci, nsvc, nsvci_node,
+				    osmo_hash_32(nsvci)) {
 		if (nsvc->nsvci == nsvci)
 			return nsvc;
 	}
@@ -141,7 +204,8 @@ struct gprs_nsvc *gprs_nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci)
 struct gprs_nsvc *gprs_nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	osmo_hash_for_each_possible(&nsi->nsvc_by_nsei, nsvc, nsei_node,
+				    osmo_hash_32(nsei)) {
 		if (nsvc->nsei == nsei)
 			return nsvc;
 	}
@@ -153,7 +217,8 @@ static struct gprs_nsvc *nsvc_by_rem_addr(struct gprs_ns_inst *nsi,
 					  struct sockaddr_in *sin)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	osmo_hash_for_each_possible(&nsi->nsvc_by_addr, nsvc, addr_node,
+				    nsvc_addr_hash(sin)) {
 		if (nsvc->ip.bts_addr.sin_addr.s_addr ==
 					sin->sin_addr.s_addr &&
 		    nsvc->ip.bts_addr.sin_port == sin->sin_port)
@@ -180,6 +245,7 @@ struct gprs_nsvc *gprs_nsvc_create(struct gprs_ns_inst *nsi, uint16_t nsvci)
 	nsvc->ctrg = rate_ctr_group_alloc(nsvc, &nsvc_ctrg_desc, nsvci);
 
 	llist_add(&nsvc->list, &nsi->gprs_nsvcs);
+	nsvc_hash(nsvc);
 
 	return nsvc;
 }
@@ -191,6 +257,7 @@ void gprs_nsvc_delete(struct gprs_nsvc *nsvc)
 {
 	if (osmo_timer_pending(&nsvc->timer))
 		osmo_timer_del(&nsvc->timer);
+	nsvc_unhash(nsvc);
 	llist_del(&nsvc->list);
 	talloc_free(nsvc);
 }
@@ -683,6 +750,7 @@ static int gprs_ns_rx_reset(struct gprs_nsvc *nsvc, struct msgb *msg)
 
 	nsvc->nsei = ntohs(*nsei);
 	nsvc->nsvci = ntohs(*nsvci);
+	gprs_nsvc_rehash(nsvc);
 
 	/* start the test procedure */
 	gprs_ns_tx_simple(nsvc, NS_PDUT_ALIVE);
@@ -807,6 +875,7 @@ int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
 		}
 		/* Update the remote peer IP address/port */
 		nsvc->ip.bts_addr = *saddr;
+		gprs_nsvc_rehash(nsvc);
 	} else
 		msgb_nsei(msg) = nsvc->nsei;
 
@@ -901,6 +970,9 @@ struct gprs_ns_inst *gprs_ns_instantiate(gprs_ns_cb_t *cb, void *ctx)
 
 	nsi->cb = cb;
 	INIT_LLIST_HEAD(&nsi->gprs_nsvcs);
+	osmo_hash_init(&nsi->nsvc_by_nsvci, nsi, 0);
+	osmo_hash_init(&nsi->nsvc_by_nsei, nsi, 0);
+	osmo_hash_init(&nsi->nsvc_by_addr, nsi, 0);
 	nsi->timeout[NS_TOUT_TNS_BLOCK] = 3;
 	nsi->timeout[NS_TOUT_TNS_BLOCK_RETRIES] = 3;
 	nsi->timeout[NS_TOUT_TNS_RESET] = 3;
@@ -912,6 +984,7 @@ struct gprs_ns_inst *gprs_ns_instantiate(gprs_ns_cb_t *cb, void *ctx)
 	/* Create the dummy NSVC that we use for sending
 	 * messages to non-existant/unknown NS-VC's */
 	nsi->unknown_nsvc = gprs_nsvc_create(nsi, 0xfffe);
+	nsvc_unhash(nsi->unknown_nsvc);
 	llist_del(&nsi->unknown_nsvc->list);
 
 	return nsi;
@@ -931,10 +1004,13 @@ void gprs_ns_destroy(struct gprs_ns_inst *nsi)
 	llist_for_each_entry_safe(nsvc, nsvc2, &nsi->gprs_nsvcs, list)
 		gprs_nsvc_delete(nsvc);
 
-	/* close socket and unregister */
+	/* send what is queued, free the buffers of the batch mode */
+	gprs_ns_nsip_set_batch(nsi, 0);
+
+	/* unregister and close socket */
 	if (nsi->nsip.fd.data) {
-		close(nsi->nsip.fd.fd);
 		osmo_fd_unregister(&nsi->nsip.fd);
+		close(nsi->nsip.fd.fd);
 	}
 
 	/* free the NSI */
@@ -978,13 +1054,118 @@ static struct msgb *read_nsip_msg(struct osmo_fd *bfd, int *error,
 	return msg;
 }
 
+/* datagrams of a NS/IP socket in batch mode */
+struct gprs_nsip_batch {
+	unsigned int len;	/* datagrams per system call */
+
+	/* receive side, the msgbs are reused for each read */
+	struct msgb *rx_msg[GPRS_NSIP_BATCH_MAX];
+	struct sockaddr_in rx_addr[GPRS_NSIP_BATCH_MAX];
+	struct iovec rx_iov[GPRS_NSIP_BATCH_MAX];
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr rx_mmsg[GPRS_NSIP_BATCH_MAX];
+#endif
+
+	/* transmit side, PDUs not yet sent, in [0, tx_len) */
+	unsigned int tx_len;
+	struct msgb *tx_msg[GPRS_NSIP_BATCH_MAX];
+	struct sockaddr_in tx_addr[GPRS_NSIP_BATCH_MAX];
+	struct iovec tx_iov[GPRS_NSIP_BATCH_MAX];
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr tx_mmsg[GPRS_NSIP_BATCH_MAX];
+#endif
+};
+
+/* prepare a received msgb for the next read */
+static void nsip_batch_rx_reset(struct gprs_nsip_batch *b, unsigned int i)
+{
+	struct msgb *msg = b->rx_msg[i];
+
+	msgb_reset(msg);
+	msgb_reserve(msg, NS_ALLOC_HEADROOM);
+	b->rx_iov[i].iov_base = msg->data;
+	b->rx_iov[i].iov_len = NS_ALLOC_SIZE - NS_ALLOC_HEADROOM;
+}
+
+/* Read up to b->len NS-over-IP messages, returns how many */
+static int read_nsip_batch(struct osmo_fd *bfd, struct gprs_nsip_batch *b)
+{
+	int i, ret;
+
+#ifdef HAVE_RECVMMSG
+	for (i = 0; i < b->len; i++)
+		b->rx_mmsg[i].msg_hdr.msg_namelen = sizeof(b->rx_addr[i]);
+
+	ret = recvmmsg(bfd->fd, b->rx_mmsg, b->len, MSG_DONTWAIT, NULL);
+#else
+	for (i = 0; i < b->len; i++) {
+		socklen_t saddr_len = sizeof(b->rx_addr[i]);
+		int rc;
+
+		rc = recvfrom(bfd->fd, b->rx_iov[i].iov_base,
+			      b->rx_iov[i].iov_len, MSG_DONTWAIT,
+			      (struct sockaddr *)&b->rx_addr[i], &saddr_len);
+		if (rc < 0)
+			break;
+		b->rx_iov[i].iov_len = rc;
+	}
+	ret = (i) ? i : -1;
+#endif
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		LOGP(DNS, LOGL_ERROR, "recv error %s during NSIP recv\n",
+			strerror(errno));
+		return -errno;
+	}
+
+	return ret;
+}
+
+static int handle_nsip_read_batch(struct osmo_fd *bfd)
+{
+	struct gprs_ns_inst *nsi = bfd->data;
+	struct gprs_nsip_batch *b = nsi->nsip.batch;
+	struct msgb *msg;
+	int i, n, len, error = 0;
+
+	n = read_nsip_batch(bfd, b);
+	if (n < 0)
+		return n;
+
+	for (i = 0; i < n; i++) {
+#ifdef HAVE_RECVMMSG
+		len = b->rx_mmsg[i].msg_len;
+#else
+		len = b->rx_iov[i].iov_len;
+#endif
+		msg = b->rx_msg[i];
+		if (len > 0) {
+			msg->l2h = msg->data;
+			msgb_put(msg, len);
+			error = gprs_ns_rcvmsg(nsi, msg, &b->rx_addr[i],
+					       GPRS_NS_LL_UDP);
+		}
+		/* the batch is gone if the callback turned it off */
+		if (nsi->nsip.batch != b)
+			break;
+		nsip_batch_rx_reset(b, i);
+	}
+
+	return error;
+}
+
 static int handle_nsip_read(struct osmo_fd *bfd)
 {
 	int error;
 	struct sockaddr_in saddr;
 	struct gprs_ns_inst *nsi = bfd->data;
-	struct msgb *msg = read_nsip_msg(bfd, &error, &saddr);
+	struct msgb *msg;
+
+	if (nsi->nsip.batch)
+		return handle_nsip_read_batch(bfd);
 
+	msg = read_nsip_msg(bfd, &error, &saddr);
 	if (!msg)
 		return error;
 
@@ -995,18 +1176,166 @@ static int handle_nsip_read(struct osmo_fd *bfd)
 	return error;
 }
 
+/*! \brief Send the NS/IP datagrams queued in batch mode
+ *  \param[in] nsi NS-instance
+ *  \returns 0, or the negative error of the last datagram that failed
+ *
+ * In batch mode, queued datagrams are sent once per \ref
+ * osmo_select_main iteration, or as soon as the batch is full. This is
+ * for sending right away. A datagram that the socket refuses is dropped
+ * and counted in tx_dropped.
+ */
+int gprs_ns_nsip_flush(struct gprs_ns_inst *nsi)
+{
+	struct gprs_nsip_batch *b = nsi->nsip.batch;
+	unsigned int i, done = 0;
+	int rc, err = 0;
+
+	if (!b)
+		return 0;
+
+	while (done < b->tx_len) {
+#ifdef HAVE_SENDMMSG
+		rc = sendmmsg(nsi->nsip.fd.fd, b->tx_mmsg + done,
+			      b->tx_len - done, 0);
+#else
+		rc = sendto(nsi->nsip.fd.fd, b->tx_iov[done].iov_base,
+			    b->tx_iov[done].iov_len, 0,
+			    (struct sockaddr *)&b->tx_addr[done],
+			    sizeof(b->tx_addr[done]));
+		if (rc >= 0)
+			rc = 1;
+#endif
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			/* e.g. ICMP port unreachable from the peer */
+			err = -errno;
+			nsi->nsip.tx_dropped++;
+			done++;
+			continue;
+		}
+		done += rc;
+	}
+
+	for (i = 0; i < b->tx_len; i++)
+		msgb_free(b->tx_msg[i]);
+	b->tx_len = 0;
+	osmo_fd_update_when(&nsi->nsip.fd, nsi->nsip.fd.when & ~BSC_FD_WRITE);
+
+	return err;
+}
+
+/*! \brief Read and send up to \a len NS/IP datagrams per system call
+ *  \param[in] nsi NS-instance
+ *  \param[in] len datagrams per system call, 0 to turn the batch mode off
+ *  \returns 0 on success; negative on error
+ *
+ * By default, each received datagram is read with one recvfrom() into a
+ * newly allocated msgb, and each PDU is sent with its own sendto(). In
+ * batch mode, a readable socket is drained with one recvmmsg() into up to
+ * \a len msgbs that are reused for every read. Outgoing PDUs are queued
+ * and sent with one sendmmsg() at the next \ref osmo_select_main
+ * iteration, or as soon as \a len of them are queued. The receive callback
+ * must not keep the msgb, which also holds without batch mode.
+ */
+int gprs_ns_nsip_set_batch(struct gprs_ns_inst *nsi, unsigned int len)
+{
+	struct gprs_nsip_batch *b = nsi->nsip.batch;
+	unsigned int i;
+
+	if (len > GPRS_NSIP_BATCH_MAX)
+		return -EINVAL;
+
+	if (b) {
+		gprs_ns_nsip_flush(nsi);
+		if (len) {
+			b->len = len;
+			return 0;
+		}
+		for (i = 0; i < GPRS_NSIP_BATCH_MAX; i++)
+			msgb_free(b->rx_msg[i]);
+		talloc_free(b);
+		nsi->nsip.batch = NULL;
+		return 0;
+	}
+	if (!len)
+		return 0;
+
+	b = talloc_zero(nsi, struct gprs_nsip_batch);
+	if (!b)
+		return -ENOMEM;
+	for (i = 0; i < GPRS_NSIP_BATCH_MAX; i++) {
+		b->rx_msg[i] = gprs_ns_msgb_alloc();
+		if (!b->rx_msg[i]) {
+			while (i--)
+				msgb_free(b->rx_msg[i]);
+			talloc_free(b);
+			return -ENOMEM;
+		}
+		nsip_batch_rx_reset(b, i);
+#ifdef HAVE_RECVMMSG
+		b->rx_mmsg[i].msg_hdr.msg_name = &b->rx_addr[i];
+		b->rx_mmsg[i].msg_hdr.msg_iov = &b->rx_iov[i];
+		b->rx_mmsg[i].msg_hdr.msg_iovlen = 1;
+#endif
+#ifdef HAVE_SENDMMSG
+		b->tx_mmsg[i].msg_hdr.msg_name = &b->tx_addr[i];
+		b->tx_mmsg[i].msg_hdr.msg_namelen = sizeof(b->tx_addr[i]);
+		b->tx_mmsg[i].msg_hdr.msg_iov = &b->tx_iov[i];
+		b->tx_mmsg[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
+	b->len = len;
+	nsi->nsip.batch = b;
+
+	return 0;
+}
+
 static int handle_nsip_write(struct osmo_fd *bfd)
 {
+	struct gprs_ns_inst *nsi = bfd->data;
+
+	if (nsi->nsip.batch)
+		return gprs_ns_nsip_flush(nsi);
+
 	/* FIXME: actually send the data here instead of nsip_sendmsg() */
 	return -EIO;
 }
 
+/* queue a PDU until the next flush of the batch */
+static int nsip_queue(struct gprs_ns_inst *nsi, struct sockaddr_in *daddr,
+		      struct msgb *msg)
+{
+	struct gprs_nsip_batch *b = nsi->nsip.batch;
+	unsigned int i = b->tx_len++;
+	int len = msg->len;
+
+	b->tx_msg[i] = msg;
+	b->tx_addr[i] = *daddr;
+	b->tx_iov[i].iov_base = msg->data;
+	b->tx_iov[i].iov_len = msg->len;
+
+	/* the PDU is taken, an error of the flush may belong to any of
+	 * the queued ones and is only counted in tx_dropped */
+	if (b->tx_len >= b->len)
+		gprs_ns_nsip_flush(nsi);
+	else
+		osmo_fd_update_when(&nsi->nsip.fd,
+				    nsi->nsip.fd.when | BSC_FD_WRITE);
+
+	return len;
+}
+
 static int nsip_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg)
 {
 	int rc;
 	struct gprs_ns_inst *nsi = nsvc->nsi;
 	struct sockaddr_in *daddr = &nsvc->ip.bts_addr;
 
+	if (nsi->nsip.batch)
+		return nsip_queue(nsi, daddr, msg);
+
 	rc = sendto(nsi->nsip.fd.fd, msg->data, msg->len, 0,
 		  (struct sockaddr *)daddr, sizeof(*daddr));
 
@@ -1101,6 +1430,7 @@ struct gprs_nsvc *gprs_ns_nsip_connect(struct gprs_ns_inst *nsi,
 	nsvc->ip.bts_addr = *dest;
 	nsvc->nsei = nsei;
 	nsvc->nsvci = nsvci;
+	gprs_nsvc_rehash(nsvc);
 	nsvc->remote_end_is_sgsn = 1;
 
 	gprs_nsvc_reset(nsvc, NS_CAUSE_OM_INTERVENTION);
@@ -35,8 +35,10 @@
  */
 
 #include <string.h>
+#include <errno.h>
 
 #include <osmocom/gsm/a5.h>
+#include <osmocom/gsm/gsm_utils.h>
 
 /*! \brief Main method to generate a A5/x cipher stream
  *  \param[in] n Which A5/x method to use
@@ -364,4 +366,377 @@ osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul)
 	}
 }
 
+
+/* ------------------------------------------------------------------------ */
+/* Bitsliced A5/1&2 for batches of keystreams                               */
+/* ------------------------------------------------------------------------ */
+
+/* Each register bit is held in one 'slice' word, whose bit l is the state
+ * of the l-th independent generator (lane). All lanes are then clocked at
+ * once with plain logic ops, the per lane majority clocking becoming a
+ * select mask. The slice width is fixed at build time by what the target
+ * supports natively. */
+
+#if defined(__GNUC__) && defined(__AVX2__)
+typedef uint64_t a5_slice_t __attribute__((vector_size(32)));
+#elif defined(__GNUC__) && defined(__SSE2__)
+typedef uint64_t a5_slice_t __attribute__((vector_size(16)));
+#else
+typedef uint64_t a5_slice_t;
+#endif
+
+#define A5_SLICE_WORDS	(sizeof(a5_slice_t) / sizeof(uint64_t))
+#define A5_SLICE_LANES	(A5_SLICE_WORDS * 64)
+
+/* 64 bit word w of a slice */
+#define A5_SLICE_WORD(s, w)	(((uint64_t *) &(s))[w])
+
+struct a5_bs_regs {
+	a5_slice_t r1[A5_R1_LEN];
+	a5_slice_t r2[A5_R2_LEN];
+	a5_slice_t r3[A5_R3_LEN];
+	a5_slice_t r4[A5_R4_LEN];	/* A5/2 only */
+};
+
+/* feedback of each register, see A5_Rx_TAPS */
+#define A5_BS_R1_FB(r)	((r)[13] ^ (r)[16] ^ (r)[17] ^ (r)[18])
+#define A5_BS_R2_FB(r)	((r)[20] ^ (r)[21])
+#define A5_BS_R3_FB(r)	((r)[7] ^ (r)[20] ^ (r)[21] ^ (r)[22])
+#define A5_BS_R4_FB(r)	((r)[11] ^ (r)[16])
+
+#define A5_BS_MAJ(a, b, c)	(((a) & (b)) | ((c) & ((a) | (b))))
+
+/*! \brief Transpose a 64x64 bit matrix in place
+ *  \param[inout] a Matrix rows, column 0 being the MSB
+ */
+static void
+_a5_bs_transpose64(uint64_t a[64])
+{
+	uint64_t m, t;
+	int j, k;
+
+	for (j = 32, m = 0x00000000ffffffffULL; j; j >>= 1, m ^= m << j) {
+		for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+			t = (a[k] ^ (a[k | j] >> j)) & m;
+			a[k] ^= t;
+			a[k | j] ^= t << j;
+		}
+	}
+}
+
+/*! \brief Spread per lane values into slices
+ *  \param[out] dst nbits slices, slice i holding bit i of every lane
+ *  \param[in] v One value per lane (A5_SLICE_LANES of them)
+ *  \param[in] nbits Number of bits to take from each value
+ */
+static void
+_a5_bs_load(a5_slice_t *dst, const uint64_t *v, int nbits)
+{
+	uint64_t a[64];
+	int w, l, i;
+
+	for (w = 0; w < A5_SLICE_WORDS; w++) {
+		for (l = 0; l < 64; l++)
+			a[63 - l] = v[w * 64 + l];
+		_a5_bs_transpose64(a);
+		for (i = 0; i < nbits; i++)
+			A5_SLICE_WORD(dst[i], w) = a[63 - i];
+	}
+}
+
+/*! \brief Gather sliced output bits into packed per lane keystreams
+ *  \param[out] out count blocks of OSMO_A5_PBIT_LEN bytes
+ *  \param[in] o 128 slices, output bit t in o[t], o[114..127] zero
+ *  \param[in] count Number of lanes to store
+ */
+static void
+_a5_bs_store(pbit_t *out, const a5_slice_t *o, unsigned int count)
+{
+	uint64_t a[2][64], hi, lo;
+	unsigned int lane;
+	int w, l, t, k;
+	pbit_t *p;
+
+	for (w = 0; w < A5_SLICE_WORDS && w * 64 < count; w++) {
+		for (t = 0; t < 64; t++) {
+			a[0][t] = A5_SLICE_WORD(o[t], w);
+			a[1][t] = A5_SLICE_WORD(o[64 + t], w);
+		}
+		_a5_bs_transpose64(a[0]);
+		_a5_bs_transpose64(a[1]);
+
+		/* row 63-l now holds lane l, first output bit in the MSB */
+		for (l = 0; l < 64; l++) {
+			lane = w * 64 + l;
+			if (lane >= count)
+				break;
+			p = out + lane * OSMO_A5_PBIT_LEN;
+			hi = a[0][63 - l];
+			lo = a[1][63 - l];
+			for (k = 0; k < 8; k++)
+				p[k] = hi >> (56 - 8 * k);
+			for (k = 0; k < OSMO_A5_PBIT_LEN - 8; k++)
+				p[8 + k] = lo >> (56 - 8 * k);
+		}
+	}
+}
+
+/*! \brief Clock a sliced register in all lanes selected by a mask */
+static inline void
+_a5_bs_clock(a5_slice_t *r, int len, a5_slice_t fb, a5_slice_t m)
+{
+	int i;
+
+	for (i = len - 1; i > 0; i--)
+		r[i] ^= (r[i] ^ r[i - 1]) & m;
+	r[0] ^= (r[0] ^ fb) & m;
+}
+
+/*! \brief Clock a sliced register in all lanes */
+static inline void
+_a5_bs_clock_force(a5_slice_t *r, int len, a5_slice_t fb)
+{
+	memmove(&r[1], &r[0], (len - 1) * sizeof(*r));
+	r[0] = fb;
+}
+
+/*! \brief Forced clocking of all registers, then xor a bit into them */
+static inline void
+_a5_bs_load_bit(struct a5_bs_regs *s, int n, a5_slice_t b)
+{
+	_a5_bs_clock_force(s->r1, A5_R1_LEN, A5_BS_R1_FB(s->r1) ^ b);
+	_a5_bs_clock_force(s->r2, A5_R2_LEN, A5_BS_R2_FB(s->r2) ^ b);
+	_a5_bs_clock_force(s->r3, A5_R3_LEN, A5_BS_R3_FB(s->r3) ^ b);
+	if (n == 2)
+		_a5_bs_clock_force(s->r4, A5_R4_LEN, A5_BS_R4_FB(s->r4) ^ b);
+}
+
+static inline void
+_a5_1_bs_clock(struct a5_bs_regs *s)
+{
+	a5_slice_t c1 = s->r1[8], c2 = s->r2[10], c3 = s->r3[10];
+	a5_slice_t maj = A5_BS_MAJ(c1, c2, c3);
+
+	_a5_bs_clock(s->r1, A5_R1_LEN, A5_BS_R1_FB(s->r1), ~(c1 ^ maj));
+	_a5_bs_clock(s->r2, A5_R2_LEN, A5_BS_R2_FB(s->r2), ~(c2 ^ maj));
+	_a5_bs_clock(s->r3, A5_R3_LEN, A5_BS_R3_FB(s->r3), ~(c3 ^ maj));
+}
+
+static inline a5_slice_t
+_a5_1_bs_output(struct a5_bs_regs *s)
+{
+	return s->r1[A5_R1_LEN-1] ^ s->r2[A5_R2_LEN-1] ^ s->r3[A5_R3_LEN-1];
+}
+
+static inline void
+_a5_2_bs_clock(struct a5_bs_regs *s)
+{
+	a5_slice_t c1 = s->r4[10], c2 = s->r4[3], c3 = s->r4[7];
+	a5_slice_t maj = A5_BS_MAJ(c1, c2, c3);
+
+	_a5_bs_clock(s->r1, A5_R1_LEN, A5_BS_R1_FB(s->r1), ~(c1 ^ maj));
+	_a5_bs_clock(s->r2, A5_R2_LEN, A5_BS_R2_FB(s->r2), ~(c2 ^ maj));
+	_a5_bs_clock(s->r3, A5_R3_LEN, A5_BS_R3_FB(s->r3), ~(c3 ^ maj));
+	_a5_bs_clock_force(s->r4, A5_R4_LEN, A5_BS_R4_FB(s->r4));
+}
+
+static inline a5_slice_t
+_a5_2_bs_output(struct a5_bs_regs *s)
+{
+	return	_a5_1_bs_output(s) ^
+		A5_BS_MAJ( s->r1[15], ~s->r1[14],  s->r1[12]) ^
+		A5_BS_MAJ(~s->r2[16],  s->r2[13],  s->r2[9]) ^
+		A5_BS_MAJ( s->r3[18],  s->r3[16], ~s->r3[13]);
+}
+
+/*! \brief Generate up to A5_SLICE_LANES A5/1 or A5/2 keystreams at once
+ *  \param[in] n Which A5/x method to use (1 or 2)
+ *  \param[in] kv Key of each lane, as 64 bit big endian value
+ *  \param[in] fv fn_count of each lane
+ *  \param[in] count Number of lanes actually used
+ *  \param[out] dl count packed Downlink keystreams (or NULL)
+ *  \param[out] ul count packed Uplink keystreams (or NULL)
+ */
+static void
+_a5_bs_gen(int n, const uint64_t *kv, const uint64_t *fv,
+	   unsigned int count, pbit_t *dl, pbit_t *ul)
+{
+	struct a5_bs_regs s;
+	a5_slice_t ld[64], o[128], ones;
+	int i;
+
+	memset(&s, 0, sizeof(s));
+	memset(o, 0, sizeof(o));
+	ones = ~o[0];
+
+	/* Key load */
+	_a5_bs_load(ld, kv, 64);
+	for (i = 0; i < 64; i++)
+		_a5_bs_load_bit(&s, n, ld[i]);
+
+	/* Frame count load */
+	_a5_bs_load(ld, fv, 22);
+	for (i = 0; i < 22; i++)
+		_a5_bs_load_bit(&s, n, ld[i]);
+
+	if (n == 1) {
+		/* Mix */
+		for (i = 0; i < 100; i++)
+			_a5_1_bs_clock(&s);
+
+		/* Output */
+		for (i = 0; i < 114; i++) {
+			_a5_1_bs_clock(&s);
+			o[i] = _a5_1_bs_output(&s);
+		}
+		if (dl)
+			_a5_bs_store(dl, o, count);
+		if (!ul)
+			return;
+		for (i = 0; i < 114; i++) {
+			_a5_1_bs_clock(&s);
+			o[i] = _a5_1_bs_output(&s);
+		}
+	} else {
+		s.r1[15] = ones;
+		s.r2[16] = ones;
+		s.r3[18] = ones;
+		s.r4[10] = ones;
+
+		/* Mix */
+		for (i = 0; i < 99; i++)
+			_a5_2_bs_clock(&s);
+
+		/* Output */
+		for (i = 0; i < 114; i++) {
+			_a5_2_bs_clock(&s);
+			o[i] = _a5_2_bs_output(&s);
+		}
+		if (dl)
+			_a5_bs_store(dl, o, count);
+		if (!ul)
+			return;
+		for (i = 0; i < 114; i++) {
+			_a5_2_bs_clock(&s);
+			o[i] = _a5_2_bs_output(&s);
+		}
+	}
+	_a5_bs_store(ul, o, count);
+}
+
+static inline uint64_t
+_a5_key_value(const uint8_t *key)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		v = (v << 8) | key[i];
+	return v;
+}
+
+/*! \brief Common part of the batch generators
+ *  \param[in] key_step 8 to walk an array of keys, 0 to reuse one key
+ *  \param[in] fn_step 1 to walk consecutive frame numbers, 0 to reuse fn
+ */
+static int
+_a5_batch(int n, const uint8_t *key, unsigned int key_step, uint32_t fn,
+	  unsigned int fn_step, unsigned int count, pbit_t *dl, pbit_t *ul)
+{
+	uint64_t kv[A5_SLICE_LANES], fv[A5_SLICE_LANES];
+	unsigned int i, c;
+
+	switch (n) {
+	case 0:
+		if (dl)
+			memset(dl, 0x00, count * OSMO_A5_PBIT_LEN);
+		if (ul)
+			memset(ul, 0x00, count * OSMO_A5_PBIT_LEN);
+		return 0;
+	case 1:
+	case 2:
+		break;
+	default:
+		/* a5/[3..7] not supported here/yet */
+		return -ENOTSUP;
+	}
+
+	fn %= GSM_MAX_FN;
+
+	while (count) {
+		c = count < A5_SLICE_LANES ? count : A5_SLICE_LANES;
+
+		memset(kv, 0, sizeof(kv));
+		memset(fv, 0, sizeof(fv));
+		for (i = 0; i < c; i++) {
+			kv[i] = _a5_key_value(key);
+			fv[i] = osmo_a5_fn_count(fn);
+			key += key_step;
+			fn += fn_step;
+			if (fn == GSM_MAX_FN)
+				fn = 0;
+		}
+
+		_a5_bs_gen(n, kv, fv, c, dl, ul);
+
+		count -= c;
+		if (dl)
+			dl += c * OSMO_A5_PBIT_LEN;
+		if (ul)
+			ul += c * OSMO_A5_PBIT_LEN;
+	}
+
+	return 0;
+}
+
+/*! \brief Generate A5/x cipher streams for consecutive frame numbers
+ *  \param[in] n Which A5/x method to use
+ *  \param[in] key 8 byte array for the key (as received from the SIM)
+ *  \param[in] fn Frame number of the first keystream
+ *  \param[in] count Number of frames (fn, fn+1, ... modulo GSM_MAX_FN)
+ *  \param[out] dl Packed Downlink cipher streams, count * OSMO_A5_PBIT_LEN
+ *  \param[out] ul Packed Uplink cipher streams, count * OSMO_A5_PBIT_LEN
+ *  \return 0 on success, -ENOTSUP for an unsupported algorithm
+ *
+ * Produces the same keystreams as calling osmo_a5() for every frame and
+ * packing the result with osmo_ubit2pbit(), but computes
+ * osmo_a5_batch_lanes() of them at a time.
+ * Either (or both) of dl/ul can be NULL if not needed.
+ */
+int
+osmo_a5_batch_fn(int n, const uint8_t *key, uint32_t fn,
+		 unsigned int count, pbit_t *dl, pbit_t *ul)
+{
+	return _a5_batch(n, key, 0, fn, 1, count, dl, ul);
+}
+
+/*! \brief Generate A5/x cipher streams of many keys for one frame number
+ *  \param[in] n Which A5/x method to use
+ *  \param[in] keys count consecutive 8 byte keys
+ *  \param[in] fn Frame number
+ *  \param[in] count Number of keys
+ *  \param[out] dl Packed Downlink cipher streams, count * OSMO_A5_PBIT_LEN
+ *  \param[out] ul Packed Uplink cipher streams, count * OSMO_A5_PBIT_LEN
+ *  \return 0 on success, -ENOTSUP for an unsupported algorithm
+ *
+ * Either (or both) of dl/ul can be NULL if not needed.
+ */
+int
+osmo_a5_batch_keys(int n, const uint8_t *keys, uint32_t fn,
+		   unsigned int count, pbit_t *dl, pbit_t *ul)
+{
+	return _a5_batch(n, keys, 8, fn, 0, count, dl, ul);
+}
+
+/*! \brief Number of keystreams the batch generators compute in parallel
+ *
+ * 64, 128 or 256 depending on the vector width the library was built for.
+ * Batches that are a multiple of this make the best use of it.
+ */
+unsigned int
+osmo_a5_batch_lanes(void)
+{
+	return A5_SLICE_LANES;
+}
+
 /*! @} */
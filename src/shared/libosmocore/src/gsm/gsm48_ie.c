@@ -744,16 +744,156 @@ int gsm48_encode_more(struct msgb *msg)
 	return 0;
 }
 
-static int32_t smod(int32_t n, int32_t m)
+/* parameters of the Range formats, see TS 04.08 10.5.2.13.3 .. 10.5.2.13.6 */
+struct freq_range_fmt {
+	uint16_t range;		/* RANGE of the format */
+	uint8_t range_bits;	/* log2(RANGE), width of W(1) */
+	uint8_t w_offset;	/* bit offset of W(1) */
+	uint8_t num_w;		/* number of W(k) in a 16 octet element */
+	uint8_t min_len;	/* element must at least contain W(1) */
+};
+
+static const struct freq_range_fmt freq_range_1024 = { 1024, 10,  6, 16, 2 };
+static const struct freq_range_fmt freq_range_512  = {  512,  9, 17, 17, 4 };
+static const struct freq_range_fmt freq_range_256  = {  256,  8, 17, 21, 4 };
+static const struct freq_range_fmt freq_range_128  = {  128,  7, 17, 28, 3 };
+
+#define L 0x80
+
+/* path from W(k) up to W(1), TS 04.08 Annex J: each step names the parent
+ * index and whether W(k) is in its left subtree, which adds an offset of
+ * -RANGE / 2^floor(log2(k)) at that level */
+static const uint8_t range_path[29][4] = {
+	[2] = { 1 | L },
+	[3] = { 1 },
+	[4] = { 2 | L, 1 | L },
+	[5] = { 3 | L, 1 },
+	[6] = { 2, 1 | L },
+	[7] = { 3, 1 },
+	[8] = { 4 | L, 2 | L, 1 | L },
+	[9] = { 5 | L, 3 | L, 1 },
+	[10] = { 6 | L, 2, 1 | L },
+	[11] = { 7 | L, 3, 1 },
+	[12] = { 4, 2 | L, 1 | L },
+	[13] = { 5, 3 | L, 1 },
+	[14] = { 6, 2, 1 | L },
+	[15] = { 7, 3, 1 },
+	[16] = { 8 | L, 4 | L, 2 | L, 1 | L },
+	[17] = { 9 | L, 5 | L, 3 | L, 1 },
+	[18] = { 10 | L, 6 | L, 2, 1 | L },
+	[19] = { 11 | L, 7 | L, 3, 1 },
+	[20] = { 12 | L, 4, 2 | L, 1 | L },
+	[21] = { 13 | L, 5, 3 | L, 1 },
+	[22] = { 14 | L, 6, 2, 1 | L },
+	[23] = { 15 | L, 7, 3, 1 },
+	[24] = { 8, 4 | L, 2 | L, 1 | L },
+	[25] = { 9, 5 | L, 3 | L, 1 },
+	[26] = { 10, 6 | L, 2, 1 | L },
+	[27] = { 11, 7 | L, 3, 1 },
+	[28] = { 12, 4, 2 | L, 1 | L },
+};
+
+#undef L
+
+/* the loops below only pay off when unrolled for a constant format */
+#if defined(__GNUC__) && __GNUC__ >= 8
+#define RANGE_UNROLL	_Pragma("GCC unroll 32")
+#else
+#define RANGE_UNROLL
+#endif
+
+/* floor(log2(k)) for k = 1..28 */
+static inline int range_log2(int k)
+{
+	return 31 - __builtin_clz(k);
+}
+
+/* read 'n' (<= 10) bits at bit offset 'off', MSB first */
+static inline uint16_t range_get_bits(const uint8_t *buf, int off, int n)
+{
+	uint32_t v;
+
+	v = (buf[off >> 3] << 16) | (buf[(off >> 3) + 1] << 8)
+		| buf[(off >> 3) + 2];
+
+	return (v >> (24 - (off & 7) - n)) & ((1 << n) - 1);
+}
+
+/* decode any of the Range formats
+ *
+ * All W(k) are extracted with one generic bit reader, W(k) having a width
+ * of log2(RANGE) - floor(log2(k)) bits. Each frequency is then
+ * reconstructed along its path to W(1). The reduction "n SMOD m" needs no
+ * division there, as n + W(parent) always stays within (-m, 2m].
+ *
+ * The function is inlined for each format, so that the compiler can
+ * resolve the bit positions and the path table at compile time.
+ */
+static inline __attribute__((always_inline))
+int decode_freq_range(struct gsm_sysinfo_freq *f, const uint8_t *cd,
+		      uint8_t len, const struct freq_range_fmt *fmt,
+		      uint8_t frqt)
 {
-	int32_t res;
+	uint8_t buf[16 + 2];
+	uint16_t w[29]; /* 0..28 */
+	const int range = fmt->range;
+	int off, bits, nbits, num, k, s, lj, m, n;
 
-	res = n % m;
+	if (len < fmt->min_len)
+		return -EINVAL;
+	if (len > 16)
+		len = 16;
+
+	/* padding allows the bit reader to always fetch three octets */
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, cd, len);
+	nbits = len * 8;
+
+	if (range == 1024) {
+		/* F0 */
+		w[0] = 0;
+		if (buf[0] & 0x04)
+			f[0].mask |= frqt;
+	} else {
+		/* ORIG-ARFCN */
+		w[0] = range_get_bits(buf, 7, 10);
+		f[w[0]].mask |= frqt;
+	}
+
+	/* only decode the W(k) that fit into the element */
+	off = fmt->w_offset;
+	num = 0;
+	RANGE_UNROLL
+	for (k = 1; k <= fmt->num_w; k++) {
+		bits = fmt->range_bits - range_log2(k);
+		if (off + bits <= nbits) {
+			w[k] = range_get_bits(buf, off, bits);
+			num = k;
+		} else
+			w[k] = 0;
+		off += bits;
+	}
 
-	if (res <= 0)
-		res += m;
+	RANGE_UNROLL
+	for (k = 1; k <= num; k++) {
+		if (!w[k])
+			continue;
+		n = w[k];
+		lj = range_log2(k);
+		RANGE_UNROLL
+		for (s = 0; s < range_log2(k); s++, lj--) {
+			m = (2 * range >> lj) - 1;
+			n += w[range_path[k][s] & 0x1f];
+			if (range_path[k][s] & 0x80)
+				n -= range >> lj;
+			n += (n <= 0) ? m : 0;
+			n -= (n > m) ? m : 0;
+		}
+		/* w[0] is 0 for Range 1024, where F(k) is absolute */
+		f[(w[0] + n) & 1023].mask |= frqt;
+	}
 
-	return res;
+	return 0;
 }
 
 /* decode "Cell Channel Description" (10.5.2.1b) and other frequency lists */
@@ -766,8 +906,7 @@ int gsm48_decode_freq_list(struct gsm_sysinfo_freq *f, uint8_t *cd,
 	 *
 	 * The Range format uses "SMOD" computation.
 	 * e.g. "n SMOD m" equals "((n - 1) % m) + 1"
-	 * A cascade of multiple SMOD computations is simpified:
-	 * "(n SMOD m) SMOD o" equals "(((n - 1) % m) % o) + 1"
+	 * See decode_freq_range() for how it is evaluated.
 	 *
 	 * The Range format uses 16 octets of data in SYSTEM INFORMATION.
 	 * When used in dedicated messages, the length can be less.
@@ -792,385 +931,17 @@ int gsm48_decode_freq_list(struct gsm_sysinfo_freq *f, uint8_t *cd,
 	}
 
 	/* 10..0XX. */
-	if ((cd[0] & 0xc8 & mask) == 0x80) {
-		/* Range 1024 format */
-		uint16_t w[17]; /* 1..16 */
-		struct gsm48_range_1024 *r = (struct gsm48_range_1024 *)cd;
-
-		if (len < 2)
-			return -EINVAL;
-		memset(w, 0, sizeof(w));
-		if (r->f0)
-			f[0].mask |= frqt;
-		w[1] = (r->w1_hi << 8) | r->w1_lo;
-		if (len >= 4)
-			w[2] = (r->w2_hi << 1) | r->w2_lo;
-		if (len >= 5)
-			w[3] = (r->w3_hi << 2) | r->w3_lo;
-		if (len >= 6)
-			w[4] = (r->w4_hi << 2) | r->w4_lo;
-		if (len >= 7)
-			w[5] = (r->w5_hi << 2) | r->w5_lo;
-		if (len >= 8)
-			w[6] = (r->w6_hi << 2) | r->w6_lo;
-		if (len >= 9)
-			w[7] = (r->w7_hi << 2) | r->w7_lo;
-		if (len >= 10)
-			w[8] = (r->w8_hi << 1) | r->w8_lo;
-		if (len >= 10)
-			w[9] = r->w9;
-		if (len >= 11)
-			w[10] = r->w10;
-		if (len >= 12)
-			w[11] = (r->w11_hi << 6) | r->w11_lo;
-		if (len >= 13)
-			w[12] = (r->w12_hi << 5) | r->w12_lo;
-		if (len >= 14)
-			w[13] = (r->w13_hi << 4) | r->w13_lo;
-		if (len >= 15)
-			w[14] = (r->w14_hi << 3) | r->w14_lo;
-		if (len >= 16)
-			w[15] = (r->w15_hi << 2) | r->w15_lo;
-		if (len >= 16)
-			w[16] = r->w16;
-		if (w[1])
-			f[w[1]].mask |= frqt;
-		if (w[2])
-			f[smod(w[1] - 512 + w[2], 1023)].mask |= frqt;
-		if (w[3])
-			f[smod(w[1]       + w[3], 1023)].mask |= frqt;
-		if (w[4])
-			f[smod(w[1] - 512 + smod(w[2] - 256 + w[4], 511), 1023)].mask |= frqt;
-		if (w[5])
-			f[smod(w[1]       + smod(w[3] - 256 + w[5], 511), 1023)].mask |= frqt;
-		if (w[6])
-			f[smod(w[1] - 512 + smod(w[2]       + w[6], 511), 1023)].mask |= frqt;
-		if (w[7])
-			f[smod(w[1]       + smod(w[3]       + w[7], 511), 1023)].mask |= frqt;
-		if (w[8])
-			f[smod(w[1] - 512 + smod(w[2] - 256 + smod(w[4] - 128 + w[8] , 255), 511), 1023)].mask |= frqt;
-		if (w[9])
-			f[smod(w[1]       + smod(w[3] - 256 + smod(w[5] - 128 + w[9] , 255), 511), 1023)].mask |= frqt;
-		if (w[10])
-			f[smod(w[1] - 512 + smod(w[2]       + smod(w[6] - 128 + w[10], 255), 511), 1023)].mask |= frqt;
-		if (w[11])
-			f[smod(w[1]       + smod(w[3]       + smod(w[7] - 128 + w[11], 255), 511), 1023)].mask |= frqt;
-		if (w[12])
-			f[smod(w[1] - 512 + smod(w[2] - 256 + smod(w[4]       + w[12], 255), 511), 1023)].mask |= frqt;
-		if (w[13])
-			f[smod(w[1]       + smod(w[3] - 256 + smod(w[5]       + w[13], 255), 511), 1023)].mask |= frqt;
-		if (w[14])
-			f[smod(w[1] - 512 + smod(w[2]       + smod(w[6]       + w[14], 255), 511), 1023)].mask |= frqt;
-		if (w[15])
-			f[smod(w[1]       + smod(w[3]       + smod(w[7]       + w[15], 255), 511), 1023)].mask |= frqt;
-		if (w[16])
-			f[smod(w[1] - 512 + smod(w[2] - 256 + smod(w[4] - 128 + smod(w[8] - 64 + w[16], 127), 255), 511), 1023)].mask |= frqt;
-
-		return 0;
-	}
+	if ((cd[0] & 0xc8 & mask) == 0x80)
+		return decode_freq_range(f, cd, len, &freq_range_1024, frqt);
 	/* 10..100. */
-	if ((cd[0] & 0xce & mask) == 0x88) {
-		/* Range 512 format */
-		uint16_t w[18]; /* 1..17 */
-		struct gsm48_range_512 *r = (struct gsm48_range_512 *)cd;
-
-		if (len < 4)
-			return -EINVAL;
-		memset(w, 0, sizeof(w));
-		w[0] = (r->orig_arfcn_hi << 9) | (r->orig_arfcn_mid << 1) | r->orig_arfcn_lo;
-		w[1] = (r->w1_hi << 2) | r->w1_lo;
-		if (len >= 5)
-			w[2] = (r->w2_hi << 2) | r->w2_lo;
-		if (len >= 6)
-			w[3] = (r->w3_hi << 2) | r->w3_lo;
-		if (len >= 7)
-			w[4] = (r->w4_hi << 1) | r->w4_lo;
-		if (len >= 7)
-			w[5] = r->w5;
-		if (len >= 8)
-			w[6] = r->w6;
-		if (len >= 9)
-			w[7] = (r->w7_hi << 6) | r->w7_lo;
-		if (len >= 10)
-			w[8] = (r->w8_hi << 4) | r->w8_lo;
-		if (len >= 11)
-			w[9] = (r->w9_hi << 2) | r->w9_lo;
-		if (len >= 11)
-			w[10] = r->w10;
-		if (len >= 12)
-			w[11] = r->w11;
-		if (len >= 13)
-			w[12] = (r->w12_hi << 4) | r->w12_lo;
-		if (len >= 14)
-			w[13] = (r->w13_hi << 2) | r->w13_lo;
-		if (len >= 14)
-			w[14] = r->w14;
-		if (len >= 15)
-			w[15] = r->w15;
-		if (len >= 16)
-			w[16] = (r->w16_hi << 3) | r->w16_lo;
-		if (len >= 16)
-			w[17] = r->w17;
-		f[w[0]].mask |= frqt;
-		if (w[1])
-			f[(w[0] + w[1]) % 1024].mask |= frqt;
-		if (w[2])
-			f[(w[0] + smod(w[1] - 256 + w[2], 511)) % 1024].mask |= frqt;
-		if (w[3])
-			f[(w[0] + smod(w[1]       + w[3], 511)) % 1024].mask |= frqt;
-		if (w[4])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2] - 128 + w[4], 255), 511)) % 1024].mask |= frqt;
-		if (w[5])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 128 + w[5], 255), 511)) % 1024].mask |= frqt;
-		if (w[6])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2]       + w[6], 255), 511)) % 1024].mask |= frqt;
-		if (w[7])
-			f[(w[0] + smod(w[1]       + smod(w[3]       + w[7], 255), 511)) % 1024].mask |= frqt;
-		if (w[8])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2] - 128 + smod(w[4] - 64 + w[8] , 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[9])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 128 + smod(w[5] - 64 + w[9] , 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[10])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2]       + smod(w[6] - 64 + w[10], 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[11])
-			f[(w[0] + smod(w[1]       + smod(w[3]       + smod(w[7] - 64 + w[11], 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[12])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2] - 128 + smod(w[4]      + w[12], 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[13])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 128 + smod(w[5]      + w[13], 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[14])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2]       + smod(w[6]      + w[14], 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[15])
-			f[(w[0] + smod(w[1]       + smod(w[3]       + smod(w[7]      + w[15], 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[16])
-			f[(w[0] + smod(w[1] - 256 + smod(w[2] - 128 + smod(w[4] - 64 + smod(w[8] - 32 + w[16], 63), 127), 255), 511)) % 1024].mask |= frqt;
-		if (w[17])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 128 + smod(w[5] - 64 + smod(w[9] - 32 + w[17], 63), 127), 255), 511)) % 1024].mask |= frqt;
-
-		return 0;
-	}
+	if ((cd[0] & 0xce & mask) == 0x88)
+		return decode_freq_range(f, cd, len, &freq_range_512, frqt);
 	/* 10..101. */
-	if ((cd[0] & 0xce & mask) == 0x8a) {
-		/* Range 256 format */
-		uint16_t w[22]; /* 1..21 */
-		struct gsm48_range_256 *r = (struct gsm48_range_256 *)cd;
-
-		if (len < 4)
-			return -EINVAL;
-		memset(w, 0, sizeof(w));
-		w[0] = (r->orig_arfcn_hi << 9) | (r->orig_arfcn_mid << 1) | r->orig_arfcn_lo;
-		w[1] = (r->w1_hi << 1) | r->w1_lo;
-		if (len >= 4)
-			w[2] = r->w2;
-		if (len >= 5)
-			w[3] = r->w3;
-		if (len >= 6)
-			w[4] = (r->w4_hi << 5) | r->w4_lo;
-		if (len >= 7)
-			w[5] = (r->w5_hi << 3) | r->w5_lo;
-		if (len >= 8)
-			w[6] = (r->w6_hi << 1) | r->w6_lo;
-		if (len >= 8)
-			w[7] = r->w7;
-		if (len >= 9)
-			w[8] = (r->w8_hi << 4) | r->w8_lo;
-		if (len >= 10)
-			w[9] = (r->w9_hi << 1) | r->w9_lo;
-		if (len >= 10)
-			w[10] = r->w10;
-		if (len >= 11)
-			w[11] = (r->w11_hi << 3) | r->w11_lo;
-		if (len >= 11)
-			w[12] = r->w12;
-		if (len >= 12)
-			w[13] = r->w13;
-		if (len >= 13)
-			w[14] = r->w15;
-		if (len >= 13)
-			w[15] = (r->w14_hi << 2) | r->w14_lo;
-		if (len >= 14)
-			w[16] = (r->w16_hi << 3) | r->w16_lo;
-		if (len >= 14)
-			w[17] = r->w17;
-		if (len >= 15)
-			w[18] = r->w19;
-		if (len >= 15)
-			w[19] = (r->w18_hi << 3) | r->w18_lo;
-		if (len >= 16)
-			w[20] = (r->w20_hi << 3) | r->w20_lo;
-		if (len >= 16)
-			w[21] = r->w21;
-		f[w[0]].mask |= frqt;
-		if (w[1])
-			f[(w[0] + w[1]) % 1024].mask |= frqt;
-		if (w[2])
-			f[(w[0] + smod(w[1] - 128 + w[2], 255)) % 1024].mask |= frqt;
-		if (w[3])
-			f[(w[0] + smod(w[1]       + w[3], 255)) % 1024].mask |= frqt;
-		if (w[4])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2] - 64 + w[4], 127), 255)) % 1024].mask |= frqt;
-		if (w[5])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 64 + w[5], 127), 255)) % 1024].mask |= frqt;
-		if (w[6])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2]      + w[6], 127), 255)) % 1024].mask |= frqt;
-		if (w[7])
-			f[(w[0] + smod(w[1]       + smod(w[3]      + w[7], 127), 255)) % 1024].mask |= frqt;
-		if (w[8])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2] - 64 + smod(w[4] - 32 + w[8] , 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[9])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 64 + smod(w[5] - 32 + w[9] , 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[10])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2]      + smod(w[6] - 32 + w[10], 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[11])
-			f[(w[0] + smod(w[1]       + smod(w[3]      + smod(w[7] - 32 + w[11], 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[12])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2] - 64 + smod(w[4]      + w[12], 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[13])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 64 + smod(w[5]      + w[13], 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[14])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2]      + smod(w[6]      + w[14], 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[15])
-			f[(w[0] + smod(w[1]       + smod(w[3]      + smod(w[7]      + w[15], 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[16])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2] - 64 + smod(w[4] - 32 + smod(w[8]  - 16 + w[16], 31), 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[17])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 64 + smod(w[5] - 32 + smod(w[9]  - 16 + w[17], 31), 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[18])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2]      + smod(w[6] - 32 + smod(w[10] - 16 + w[18], 31), 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[19])
-			f[(w[0] + smod(w[1]       + smod(w[3]      + smod(w[7] - 32 + smod(w[11] - 16 + w[19], 31), 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[20])
-			f[(w[0] + smod(w[1] - 128 + smod(w[2] - 64 + smod(w[4]      + smod(w[12] - 16 + w[20], 31), 63), 127), 255)) % 1024].mask |= frqt;
-		if (w[21])
-			f[(w[0] + smod(w[1]       + smod(w[3] - 64 + smod(w[5]      + smod(w[13] - 16 + w[21], 31), 63), 127), 255)) % 1024].mask |= frqt;
-
-		return 0;
-	}
+	if ((cd[0] & 0xce & mask) == 0x8a)
+		return decode_freq_range(f, cd, len, &freq_range_256, frqt);
 	/* 10..110. */
-	if ((cd[0] & 0xce & mask) == 0x8c) {
-		/* Range 128 format */
-		uint16_t w[29]; /* 1..28 */
-		struct gsm48_range_128 *r = (struct gsm48_range_128 *)cd;
-
-		if (len < 3)
-			return -EINVAL;
-		memset(w, 0, sizeof(w));
-		w[0] = (r->orig_arfcn_hi << 9) | (r->orig_arfcn_mid << 1) | r->orig_arfcn_lo;
-		w[1] = r->w1;
-		if (len >= 4)
-			w[2] = r->w2;
-		if (len >= 5)
-			w[3] = (r->w3_hi << 4) | r->w3_lo;
-		if (len >= 6)
-			w[4] = (r->w4_hi << 1) | r->w4_lo;
-		if (len >= 6)
-			w[5] = r->w5;
-		if (len >= 7)
-			w[6] = (r->w6_hi << 3) | r->w6_lo;
-		if (len >= 7)
-			w[7] = r->w7;
-		if (len >= 8)
-			w[8] = r->w8;
-		if (len >= 8)
-			w[9] = r->w9;
-		if (len >= 9)
-			w[10] = r->w10;
-		if (len >= 9)
-			w[11] = r->w11;
-		if (len >= 10)
-			w[12] = r->w12;
-		if (len >= 10)
-			w[13] = r->w13;
-		if (len >= 11)
-			w[14] = r->w14;
-		if (len >= 11)
-			w[15] = r->w15;
-		if (len >= 12)
-			w[16] = r->w16;
-		if (len >= 12)
-			w[17] = r->w17;
-		if (len >= 13)
-			w[18] = (r->w18_hi << 1) | r->w18_lo;
-		if (len >= 13)
-			w[19] = r->w19;
-		if (len >= 13)
-			w[20] = r->w20;
-		if (len >= 14)
-			w[21] = (r->w21_hi << 2) | r->w21_lo;
-		if (len >= 14)
-			w[22] = r->w22;
-		if (len >= 14)
-			w[23] = r->w23;
-		if (len >= 15)
-			w[24] = r->w24;
-		if (len >= 15)
-			w[25] = r->w25;
-		if (len >= 16)
-			w[26] = (r->w26_hi << 1) | r->w26_lo;
-		if (len >= 16)
-			w[27] = r->w27;
-		if (len >= 16)
-			w[28] = r->w28;
-		f[w[0]].mask |= frqt;
-		if (w[1])
-			f[(w[0] + w[1]) % 1024].mask |= frqt;
-		if (w[2])
-			f[(w[0] + smod(w[1] - 64 + w[2], 127)) % 1024].mask |= frqt;
-		if (w[3])
-			f[(w[0] + smod(w[1]      + w[3], 127)) % 1024].mask |= frqt;
-		if (w[4])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + w[4], 63), 127)) % 1024].mask |= frqt;
-		if (w[5])
-			f[(w[0] + smod(w[1]      + smod(w[3] - 32 + w[5], 63), 127)) % 1024].mask |= frqt;
-		if (w[6])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2]      + w[6], 63), 127)) % 1024].mask |= frqt;
-		if (w[7])
-			f[(w[0] + smod(w[1]      + smod(w[3]      + w[7], 63), 127)) % 1024].mask |= frqt;
-		if (w[8])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + smod(w[4] - 16 + w[8] , 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[9])
-			f[(w[0] + smod(w[1]      + smod(w[3] - 32 + smod(w[5] - 16 + w[9] , 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[10])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2]      + smod(w[6] - 16 + w[10], 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[11])
-			f[(w[0] + smod(w[1]      + smod(w[3]      + smod(w[7] - 16 + w[11], 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[12])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + smod(w[4]      + w[12], 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[13])
-			f[(w[0] + smod(w[1]      + smod(w[3] - 32 + smod(w[5]      + w[13], 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[14])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2]      + smod(w[6]      + w[14], 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[15])
-			f[(w[0] + smod(w[1]      + smod(w[3]      + smod(w[7]      + w[15], 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[16])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + smod(w[4] - 16 + smod(w[8]  - 8 + w[16], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[17])
-			f[(w[0] + smod(w[1]      + smod(w[3] - 32 + smod(w[5] - 16 + smod(w[9]  - 8 + w[17], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[18])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2]      + smod(w[6] - 16 + smod(w[10] - 8 + w[18], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[19])
-			f[(w[0] + smod(w[1]      + smod(w[3]      + smod(w[7] - 16 + smod(w[11] - 8 + w[19], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[20])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + smod(w[4]      + smod(w[12] - 8 + w[20], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[21])
-			f[(w[0] + smod(w[1]      + smod(w[3] - 32 + smod(w[5]      + smod(w[13] - 8 + w[21], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[22])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2]      + smod(w[6]      + smod(w[14] - 8 + w[22], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[23])
-			f[(w[0] + smod(w[1]      + smod(w[3]      + smod(w[7]      + smod(w[15] - 8 + w[23], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[24])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + smod(w[4] - 16 + smod(w[8]      + w[24], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[25])
-			f[(w[0] + smod(w[1]      + smod(w[3] - 32 + smod(w[5] - 16 + smod(w[9]      + w[25], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[26])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2]      + smod(w[6] - 16 + smod(w[10]     + w[26], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[27])
-			f[(w[0] + smod(w[1]      + smod(w[3]      + smod(w[7] - 16 + smod(w[11]     + w[27], 15), 31), 63), 127)) % 1024].mask |= frqt;
-		if (w[28])
-			f[(w[0] + smod(w[1] - 64 + smod(w[2] - 32 + smod(w[4]      + smod(w[12]     + w[28], 15), 31), 63), 127)) % 1024].mask |= frqt;
-
-		return 0;
-	}
+	if ((cd[0] & 0xce & mask) == 0x8c)
+		return decode_freq_range(f, cd, len, &freq_range_128, frqt);
 	/* 10..111. */
 	if ((cd[0] & 0xce & mask) == 0x8e) {
 		/* Variable bitmap format (can be any length >= 3) */
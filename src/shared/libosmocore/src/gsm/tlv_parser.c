@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/gsm/tlv.h>
 
@@ -196,6 +197,204 @@ void tlv_def_patch(struct tlv_definition *dst, const struct tlv_definition *src)
 	}
 }
 
+/* length in the octet after the tag */
+static void cdef_len8(struct tlv_cdef *e, uint8_t mask)
+{
+	e->hdr_len = e->val_ofs = e->skip = 2;
+	e->len_ofs[0] = 1;
+	e->len_mask[0] = mask;
+	e->len_shift = 8;
+}
+
+/* length in the two octets after the tag */
+static void cdef_len16(struct tlv_cdef *e, uint8_t mask)
+{
+	e->hdr_len = e->val_ofs = e->skip = 3;
+	e->len_ofs[0] = 1;
+	e->len_ofs[1] = 2;
+	e->len_mask[0] = mask;
+	e->len_mask[1] = 0xff;
+}
+
+/*! \brief Precompile a TLV definition for \ref tlv_parse_compiled
+ *  \param[out] c caller-allocated compiled definition
+ *  \param[in] def structure defining the valid TLV tags / configurations
+ *
+ *  The result decodes exactly like \ref tlv_parse_one, but has to be
+ *  rebuilt if \a def is modified (e.g. by \ref tlv_def_patch).
+ */
+void tlv_compile(struct tlv_compiled *c, const struct tlv_definition *def)
+{
+	int i;
+
+	memset(c, 0, sizeof(*c));
+
+	for (i = 0; i < ARRAY_SIZE(c->def); i++) {
+		struct tlv_cdef *e = c->def[i];
+
+		e[0].tag = e[1].tag = i;
+
+		/* single octet TV IE */
+		if (def->def[i & 0xf0].type == TLV_TYPE_SINGLE_TV) {
+			e->tag = i & 0xf0;
+			e->hdr_len = 1;
+			e->fixed_len = 1;
+			continue;
+		}
+
+		switch (def->def[i].type) {
+		case TLV_TYPE_T:
+			e->hdr_len = e->skip = 1;
+			break;
+		case TLV_TYPE_TV:
+			e->hdr_len = e->val_ofs = e->skip = 1;
+			e->fixed_len = 1;
+			break;
+		case TLV_TYPE_FIXED:
+			e->hdr_len = e->val_ofs = e->skip = 1;
+			e->fixed_len = def->def[i].fixed_len;
+			break;
+		case TLV_TYPE_TLV:
+			cdef_len8(e, 0xff);
+			break;
+		case TLV_TYPE_TL16V:
+			cdef_len16(e, 0xff);
+			break;
+		case TLV_TYPE_TvLV:
+			/* 7 bit length if the highest bit is set */
+			e[0].var = 1;
+			cdef_len16(&e[0], 0xff);
+			cdef_len8(&e[1], 0x7f);
+			break;
+		case TLV_TYPE_vTvLV_GAN:
+			/* 15 bit length if the highest bit is set */
+			e[0].var = 1;
+			cdef_len8(&e[0], 0xff);
+			cdef_len16(&e[1], 0x7f);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*! \brief Reset the tags set by the last \ref tlv_parse_compiled
+ *  \param[inout] dec result of the last parse
+ *
+ *  Afterwards no pointers into the parsed buffer are left in \a dec.
+ */
+void tlv_parsed_sparse_clear(struct tlv_parsed_sparse *dec)
+{
+	unsigned int i;
+
+	for (i = 0; i < dec->num_seen; i++) {
+		dec->tp.lv[dec->seen[i]].val = NULL;
+		dec->tp.lv[dec->seen[i]].len = 0;
+	}
+	dec->num_seen = 0;
+}
+
+/*! \brief Parse an entire buffer of TLV encoded IEs, precompiled version
+ *  \param[inout] dec result, only the tags of the previous parse are reset
+ *  \param[in] c definition precompiled by \ref tlv_compile
+ *  \param[in] mand mandatory IEs to check for (may be NULL)
+ *  \param[in] buf the input data buffer to be parsed
+ *  \param[in] buf_len length of the input data buffer
+ *  \param[in] lv_tag an initial LV tag at the start of the buffer
+ *  \param[in] lv_tag2 a second initial LV tag following the \a lv_tag
+ *  \returns number of IEs parsed, -4 if an IE from \a mand is missing, or
+ *	     the errors of \ref tlv_parse
+ */
+int tlv_parse_compiled(struct tlv_parsed_sparse *dec,
+		       const struct tlv_compiled *c,
+		       const struct tlv_mandatory *mand,
+		       const uint8_t *buf, int buf_len, uint8_t lv_tag,
+		       uint8_t lv_tag2)
+{
+	static const struct tlv_mandatory no_mand;
+	struct tlv_p_entry *lv = dec->tp.lv;
+	unsigned int missing, num_seen = 0;
+	int ofs = 0, num_parsed = 0, rc;
+
+	tlv_parsed_sparse_clear(dec);
+
+	if (!mand)
+		mand = &no_mand;
+	missing = mand->count;
+
+/* record a tag the first time it is seen in this buffer */
+#define SPARSE_SET(tag, v, l)						\
+	do {								\
+		if (!lv[tag].val) {					\
+			dec->seen[num_seen++] = tag;			\
+			missing -= (mand->bitmap[(tag) >> 5]		\
+					>> ((tag) & 31)) & 1;		\
+		}							\
+		lv[tag].val = v;					\
+		lv[tag].len = l;					\
+	} while (0)
+
+	if (lv_tag) {
+		rc = -1;
+		if (ofs + 1 > buf_len)
+			goto out;
+		rc = -2;
+		if (ofs + 1 + buf[ofs] > buf_len)
+			goto out;
+		SPARSE_SET(lv_tag, &buf[ofs+1], buf[ofs]);
+		num_parsed++;
+		ofs += 1 + buf[ofs];
+	}
+	if (lv_tag2) {
+		rc = -1;
+		if (ofs + 1 > buf_len)
+			goto out;
+		rc = -2;
+		if (ofs + 1 + buf[ofs] > buf_len)
+			goto out;
+		SPARSE_SET(lv_tag2, &buf[ofs+1], buf[ofs]);
+		num_parsed++;
+		ofs += 1 + buf[ofs];
+	}
+
+	while (ofs < buf_len) {
+		const uint8_t *p = &buf[ofs];
+		const struct tlv_cdef *e = c->def[p[0]];
+		int rem = buf_len - ofs;
+		int len;
+
+		if (e->var) {
+			rc = -1;
+			if (rem < 2)
+				goto out;
+			e += p[1] >> 7;
+		}
+		rc = -3;
+		if (!e->hdr_len)
+			goto out;
+		rc = -1;
+		if (rem < e->hdr_len)
+			goto out;
+
+		len = e->fixed_len +
+		      ((((p[e->len_ofs[0]] & e->len_mask[0]) << 8) |
+			(p[e->len_ofs[1]] & e->len_mask[1])) >> e->len_shift);
+		rc = -2;
+		if (e->skip + len > rem)
+			goto out;
+
+		SPARSE_SET(e->tag, p + e->val_ofs, len);
+		ofs += e->skip + len;
+		num_parsed++;
+	}
+#undef SPARSE_SET
+
+	rc = missing ? -4 : num_parsed;
+out:
+	dec->num_seen = num_seen;
+	return rc;
+}
+
 static __attribute__((constructor)) void on_dso_load_tlv(void)
 {
 	int i;
@@ -20,6 +20,7 @@
  *
  */
 
+#define _GNU_SOURCE	/* for sendmmsg() */
 #include "../config.h"
 
 #include <osmocom/core/gsmtap_util.h>
@@ -88,6 +89,25 @@ uint8_t chantype_rsl2gsmtap(uint8_t rsl_chantype, uint8_t link_id)
 	return ret;
 }
 
+static void gsmtap_fill_hdr(struct gsmtap_hdr *gh, uint8_t type,
+			    uint16_t arfcn, uint8_t ts, uint8_t chan_type,
+			    uint8_t ss, uint32_t fn, int8_t signal_dbm,
+			    uint8_t snr)
+{
+	gh->version = GSMTAP_VERSION;
+	gh->hdr_len = sizeof(*gh)/4;
+	gh->type = type;
+	gh->timeslot = ts;
+	gh->sub_slot = ss;
+	gh->arfcn = htons(arfcn);
+	gh->snr_db = snr;
+	gh->signal_dbm = signal_dbm;
+	gh->frame_number = htonl(fn);
+	gh->sub_type = chan_type;
+	gh->antenna_nr = 0;
+	gh->res = 0;
+}
+
 /*! \brief create an arbitrary type GSMTAP message
  *  \param[in] type The GSMTAP_TYPE_xxx constant of the message to create
  *  \param[in] arfcn GSM ARFCN (Channel Number)
@@ -116,18 +136,8 @@ struct msgb *gsmtap_makemsg_ex(uint8_t type, uint16_t arfcn, uint8_t ts, uint8_t
 		return NULL;
 
 	gh = (struct gsmtap_hdr *) msgb_put(msg, sizeof(*gh));
-
-	gh->version = GSMTAP_VERSION;
-	gh->hdr_len = sizeof(*gh)/4;
-	gh->type = type;
-	gh->timeslot = ts;
-	gh->sub_slot = ss;
-	gh->arfcn = htons(arfcn);
-	gh->snr_db = snr;
-	gh->signal_dbm = signal_dbm;
-	gh->frame_number = htonl(fn);
-	gh->sub_type = chan_type;
-	gh->antenna_nr = 0;
+	gsmtap_fill_hdr(gh, type, arfcn, ts, chan_type, ss, fn, signal_dbm,
+			snr);
 
 	dst = msgb_put(msg, len);
 	memcpy(dst, data, len);
@@ -160,8 +170,23 @@ struct msgb *gsmtap_makemsg(uint16_t arfcn, uint8_t ts, uint8_t chan_type,
 #ifdef HAVE_SYS_SOCKET_H
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 
+/* largest packet a ring slot holds, bigger ones bypass the ring */
+#define GSMTAP_BATCH_PKT	256
+
+/* packets of a GSMTAP_MODE_BATCH instance not yet sent */
+struct gsmtap_batch {
+	unsigned int len;	/* pending packets, in slots [0, len) */
+	unsigned int flush_len;	/* flush as soon as this many are pending */
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr mmsg[GSMTAP_BATCH_SLOTS];
+#endif
+	struct iovec iov[GSMTAP_BATCH_SLOTS];
+	uint8_t pkt[GSMTAP_BATCH_SLOTS][GSMTAP_BATCH_PKT];
+};
+
 /*! \brief Create a new (sending) GSMTAP source socket 
  *  \param[in] host host name or IP address in string format
  *  \param[in] port UDP port number in host byte order
@@ -203,31 +228,163 @@ int gsmtap_source_add_sink_fd(int gsmtap_fd)
 	return -ENODEV;
 }
 
+/*! \brief Send the packets pending in a \ref GSMTAP_MODE_BATCH instance
+ *  \param[in] gti GSMTAP instance
+ *  \returns 0 or the negative error of a packet that was dropped
+ *
+ * Batch mode instances flush by themselves once per \ref osmo_select_main
+ * iteration, this is for sending right away, e.g. before exiting.  What
+ * the socket does not take now stays queued in order.
+ */
+int gsmtap_flush(struct gsmtap_inst *gti)
+{
+	struct gsmtap_batch *b = gti->batch;
+	unsigned int i, done = 0;
+	int rc, err = 0;
+
+	if (!b)
+		return 0;
+
+	while (done < b->len) {
+#ifdef HAVE_SENDMMSG
+		rc = sendmmsg(gsmtap_inst_fd(gti), b->mmsg + done,
+			      b->len - done, MSG_DONTWAIT);
+#else
+		rc = send(gsmtap_inst_fd(gti), b->iov[done].iov_base,
+			  b->iov[done].iov_len, MSG_DONTWAIT);
+		if (rc >= 0)
+			rc = 1;
+#endif
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK
+			 || errno == EINTR)
+				break;
+			/* e.g. no one listening on a local port */
+			err = -errno;
+			gti->tx_dropped++;
+			done++;
+			continue;
+		}
+		gti->tx_packets += rc;
+		done += rc;
+	}
+
+	if (done && done < b->len) {
+		for (i = 0; i < b->len - done; i++) {
+			b->iov[i].iov_len = b->iov[done + i].iov_len;
+			memcpy(b->pkt[i], b->pkt[done + i], b->iov[i].iov_len);
+		}
+	}
+	b->len -= done;
+
+	if (b->len)
+		osmo_fd_update_when(&gti->wq.bfd,
+				    gti->wq.bfd.when | BSC_FD_WRITE);
+	else
+		osmo_fd_update_when(&gti->wq.bfd,
+				    gti->wq.bfd.when & ~BSC_FD_WRITE);
+
+	return err;
+}
+
+/*! \brief Set when a \ref GSMTAP_MODE_BATCH instance flushes by itself
+ *  \param[in] gti GSMTAP instance
+ *  \param[in] len send as soon as this many packets are pending
+ *  \returns 0 on success; negative on error
+ *
+ * The default is half of \ref GSMTAP_BATCH_SLOTS.  In any case, pending
+ * packets are sent at the next \ref osmo_select_main iteration.
+ */
+int gsmtap_set_batch_len(struct gsmtap_inst *gti, unsigned int len)
+{
+	if (!gti->batch || len < 1 || len > GSMTAP_BATCH_SLOTS)
+		return -EINVAL;
+
+	gti->batch->flush_len = len;
+	if (gti->batch->len >= len)
+		return gsmtap_flush(gti);
+	return 0;
+}
+
+/* next free ring slot for a packet of len octets */
+static uint8_t *gsmtap_batch_slot(struct gsmtap_inst *gti, unsigned int len)
+{
+	struct gsmtap_batch *b = gti->batch;
+
+	if (b->len == GSMTAP_BATCH_SLOTS) {
+		/* the socket did not take the previous flush */
+		gsmtap_flush(gti);
+		if (b->len == GSMTAP_BATCH_SLOTS) {
+			gti->tx_dropped++;
+			return NULL;
+		}
+	}
+	b->iov[b->len].iov_len = len;
+
+	return b->pkt[b->len];
+}
+
+/* add the packet just written to the slot to the pending ones. Errors
+ * of the flush may be caused by earlier packets, they are only counted
+ * in tx_dropped. */
+static void gsmtap_batch_commit(struct gsmtap_inst *gti)
+{
+	struct gsmtap_batch *b = gti->batch;
+
+	if (++b->len >= b->flush_len)
+		gsmtap_flush(gti);
+	else
+		osmo_fd_update_when(&gti->wq.bfd,
+				    gti->wq.bfd.when | BSC_FD_WRITE);
+}
+
 /*! \brief Send a \ref msgb through a GSMTAP source
  *  \param[in] gti GSMTAP instance
  *  \param[in] msgb message buffer
+ *  \returns 0 if \a msg was taken over; negative if the caller still owns it
  */
 int gsmtap_sendmsg(struct gsmtap_inst *gti, struct msgb *msg)
 {
+	uint8_t *pkt;
+	int rc;
+
 	if (!gti)
 		return -ENODEV;
 
-	if (gti->ofd_wq_mode)
-		return osmo_wqueue_enqueue(&gti->wq, msg);
-	else {
-		/* try immediate send and return error if any */
-		int rc;
-
-		rc = write(gsmtap_inst_fd(gti), msg->data, msg->len);
-		if (rc <= 0) {
-			return rc;
-		} else if (rc >= msg->len) {
+	switch (gti->ofd_wq_mode) {
+	case GSMTAP_MODE_WQ:
+		rc = osmo_wqueue_enqueue(&gti->wq, msg);
+		if (rc < 0)
+			gti->tx_dropped++;
+		return rc;
+	case GSMTAP_MODE_BATCH:
+		if (msg->len <= GSMTAP_BATCH_PKT) {
+			pkt = gsmtap_batch_slot(gti, msg->len);
+			if (!pkt)
+				return -ENOSPC;
+			memcpy(pkt, msg->data, msg->len);
 			msgb_free(msg);
+			gsmtap_batch_commit(gti);
 			return 0;
-		} else {
-			/* short write */
-			return -EIO;
 		}
+		/* too large for the ring, send it after the pending ones */
+		gsmtap_flush(gti);
+		break;
+	}
+
+	/* try immediate send and return error if any */
+	rc = write(gsmtap_inst_fd(gti), msg->data, msg->len);
+	if (rc <= 0) {
+		gti->tx_dropped++;
+		return rc;
+	} else if (rc >= msg->len) {
+		gti->tx_packets++;
+		msgb_free(msg);
+		return 0;
+	} else {
+		/* short write */
+		gti->tx_dropped++;
+		return -EIO;
 	}
 }
 
@@ -239,11 +396,25 @@ int gsmtap_send_ex(struct gsmtap_inst *gti, uint8_t type, uint16_t arfcn, uint8_
 		int8_t signal_dbm, uint8_t snr, const uint8_t *data,
 		unsigned int len)
 {
+	struct gsmtap_hdr *gh;
 	struct msgb *msg;
 
 	if (!gti)
 		return -ENODEV;
 
+	/* build the packet right in the ring, no msgb needed */
+	if (gti->batch && sizeof(*gh) + len <= GSMTAP_BATCH_PKT) {
+		gh = (struct gsmtap_hdr *) gsmtap_batch_slot(gti,
+							sizeof(*gh) + len);
+		if (!gh)
+			return -ENOSPC;
+		gsmtap_fill_hdr(gh, type, arfcn, ts, chan_type, ss, fn,
+				signal_dbm, snr);
+		memcpy(gh + 1, data, len);
+		gsmtap_batch_commit(gti);
+		return 0;
+	}
+
 	msg = gsmtap_makemsg_ex(type, arfcn, ts, chan_type, ss, fn, signal_dbm,
 			     snr, data, len);
 	if (!msg)
@@ -267,17 +438,30 @@ int gsmtap_send(struct gsmtap_inst *gti, uint16_t arfcn, uint8_t ts,
 /* Callback from select layer if we can write to the socket */
 static int gsmtap_wq_w_cb(struct osmo_fd *ofd, struct msgb *msg)
 {
+	struct gsmtap_inst *gti = ofd->data;
 	int rc;
 
 	rc = write(ofd->fd, msg->data, msg->len);
 	if (rc < 0) {
+		gti->tx_dropped++;
 		perror("writing msgb to gsmtap fd");
 		return rc;
 	}
 	if (rc != msg->len) {
+		gti->tx_dropped++;
 		perror("short write to gsmtap fd");
 		return -EIO;
 	}
+	gti->tx_packets++;
+
+	return 0;
+}
+
+/* Callback from select layer to flush the ring of a batch mode instance */
+static int gsmtap_batch_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	if (what & BSC_FD_WRITE)
+		gsmtap_flush(ofd->data);
 
 	return 0;
 }
@@ -328,17 +512,23 @@ int gsmtap_source_add_sink(struct gsmtap_inst *gti)
 /*! \brief Open GSMTAP source socket, connect and register osmo_fd
  *  \param[in] host host name or IP address in string format
  *  \param[in] port UDP port number in host byte order
- *  \param[in] osmo_wq_mode Register \ref osmo_wqueue (1) or not (0)
+ *  \param[in] osmo_wq_mode \ref gsmtap_inst_mode
  *
  * Open GSMTAP source (sending) socket, connect it to host/port,
  * allocate 'struct gsmtap_inst' and optionally osmo_fd/osmo_wqueue
  * registration.  This means it is like \ref gsmtap_init2 but integrated
- * with libosmocore \ref select */
+ * with libosmocore \ref select
+ *
+ * In \ref GSMTAP_MODE_BATCH, packets are built in a preallocated ring
+ * and sent together, with one sendmmsg() where available, once per
+ * \ref osmo_select_main iteration or when \ref gsmtap_set_batch_len
+ * packets are pending.  Call \ref gsmtap_flush before exiting. */
 struct gsmtap_inst *gsmtap_source_init(const char *host, uint16_t port,
 					int ofd_wq_mode)
 {
 	struct gsmtap_inst *gti;
-	int fd;
+	struct gsmtap_batch *b;
+	int fd, i;
 
 	fd = gsmtap_source_init_fd(host, port);
 	if (fd < 0)
@@ -349,11 +539,35 @@ struct gsmtap_inst *gsmtap_source_init(const char *host, uint16_t port,
 	gti->wq.bfd.fd = fd;
 	gti->sink_ofd.fd = -1;
 
-	if (ofd_wq_mode) {
+	switch (ofd_wq_mode) {
+	case GSMTAP_MODE_WQ:
 		osmo_wqueue_init(&gti->wq, 64);
 		gti->wq.write_cb = &gsmtap_wq_w_cb;
+		gti->wq.bfd.data = gti;
 
 		osmo_fd_register(&gti->wq.bfd);
+		break;
+	case GSMTAP_MODE_BATCH:
+		b = talloc_zero(gti, struct gsmtap_batch);
+		if (!b) {
+			close(fd);
+			talloc_free(gti);
+			return NULL;
+		}
+		b->flush_len = GSMTAP_BATCH_SLOTS / 2;
+		for (i = 0; i < GSMTAP_BATCH_SLOTS; i++) {
+			b->iov[i].iov_base = b->pkt[i];
+#ifdef HAVE_SENDMMSG
+			b->mmsg[i].msg_hdr.msg_iov = &b->iov[i];
+			b->mmsg[i].msg_hdr.msg_iovlen = 1;
+#endif
+		}
+		gti->batch = b;
+		gti->wq.bfd.cb = gsmtap_batch_fd_cb;
+		gti->wq.bfd.data = gti;
+
+		osmo_fd_register(&gti->wq.bfd);
+		break;
 	}
 
 	return gti;
@@ -0,0 +1,134 @@
+/*
+ * Resizable hash table of nodes embedded in the hashed objects
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup hashtable
+ *  @{
+ */
+
+/*! \file hashtable.c */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/hashtable.h>
+
+#define HASH_MIN_BITS	4
+#define HASH_MAX_BITS	24
+
+/* move all entries into a new array of 1 << bits buckets */
+static int hash_resize(struct osmo_hashtable *ht, unsigned int bits)
+{
+	struct llist_head *bucket, *old = ht->bucket;
+	struct osmo_hash_node *node, *node2;
+	unsigned int i, old_num = (old) ? 1 << ht->bits : 0;
+
+	bucket = talloc_array(ht->ctx, struct llist_head, 1 << bits);
+	if (!bucket)
+		return -ENOMEM;
+	talloc_set_name_const(bucket, "osmo_hashtable");
+	for (i = 0; i < (1 << bits); i++)
+		INIT_LLIST_HEAD(&bucket[i]);
+
+	ht->bucket = bucket;
+	ht->bits = bits;
+	for (i = 0; i < old_num; i++) {
+		llist_for_each_entry_safe(node, node2, &old[i], list)
+			llist_add_tail(&node->list,
+				       osmo_hash_bucket(ht, node->hash));
+	}
+	talloc_free(old);
+
+	return 0;
+}
+
+/*! \brief initialize a hash table
+ *  \param[in] ht hash table
+ *  \param[in] ctx talloc context for the buckets
+ *  \param[in] bits log2 of the initial number of buckets, 0 for default
+ *  \returns 0 on success, negative on error
+ *
+ * A zero-initialized table does not need this call, its buckets are
+ * allocated from the NULL context on the first insertion. */
+int osmo_hash_init(struct osmo_hashtable *ht, void *ctx, unsigned int bits)
+{
+	ht->bucket = NULL;
+	ht->bits = 0;
+	ht->count = 0;
+	ht->ctx = ctx;
+
+	if (bits < HASH_MIN_BITS)
+		bits = HASH_MIN_BITS;
+	if (bits > HASH_MAX_BITS)
+		bits = HASH_MAX_BITS;
+
+	return hash_resize(ht, bits);
+}
+
+/*! \brief free the buckets of a hash table
+ *
+ * The nodes of the objects in the table are not touched. */
+void osmo_hash_free(struct osmo_hashtable *ht)
+{
+	talloc_free(ht->bucket);
+	ht->bucket = NULL;
+	ht->bits = 0;
+	ht->count = 0;
+}
+
+/*! \brief add a node to a hash table
+ *  \param[in] ht hash table
+ *  \param[in] node node of the object to add, must not be in a table
+ *  \param[in] hash hash value of the object's key
+ *  \returns 0 on success, negative if no buckets could be allocated
+ *
+ * The table grows when it has more entries than buckets. */
+int osmo_hash_add(struct osmo_hashtable *ht, struct osmo_hash_node *node,
+		  uint32_t hash)
+{
+	if (!ht->bucket) {
+		if (hash_resize(ht, HASH_MIN_BITS) < 0)
+			return -ENOMEM;
+	} else if (ht->count >= (1 << ht->bits) && ht->bits < HASH_MAX_BITS) {
+		/* a failed resize only makes the buckets longer */
+		hash_resize(ht, ht->bits + 1);
+	}
+
+	node->hash = hash;
+	llist_add(&node->list, osmo_hash_bucket(ht, hash));
+	ht->count++;
+
+	return 0;
+}
+
+/*! \brief remove a node from its hash table
+ *  \param[in] ht hash table
+ *  \param[in] node node to remove, nothing is done if it is not hashed */
+void osmo_hash_del(struct osmo_hashtable *ht, struct osmo_hash_node *node)
+{
+	if (!osmo_hash_hashed(node))
+		return;
+
+	llist_del(&node->list);
+	node->list.next = node->list.prev = NULL;
+	ht->count--;
+}
+
+/*! @} */
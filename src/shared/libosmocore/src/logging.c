@@ -40,6 +40,10 @@
 #include <time.h>
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/logging.h>
@@ -52,6 +56,10 @@ static struct log_context log_context;
 static void *tall_log_ctx = NULL;
 LLIST_HEAD(osmo_log_target_list);
 
+/* lowest level any registered target outputs, per category */
+static uint8_t *log_cat_min_level;
+#define LOG_LEVEL_NONE	0xff
+
 #define LOGLEVEL_DEFS	6	/* Number of loglevels.*/
 
 static const struct value_string loglevel_strs[LOGLEVEL_DEFS+1] = {
@@ -125,6 +133,57 @@ static int subsys_lib2index(int subsys)
 	return (subsys * -1) + (osmo_log_info->num_cat_user-1);
 }
 
+/* recompute log_cat_min_level, whenever a target or its settings change */
+static void log_update_min_level(void)
+{
+	struct log_target *tar;
+	int i;
+
+	if (!log_cat_min_level)
+		return;
+
+	memset(log_cat_min_level, LOG_LEVEL_NONE, osmo_log_info->num_cat);
+
+	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
+		for (i = 0; i < osmo_log_info->num_cat; i++) {
+			const struct log_category *cat = &tar->categories[i];
+			uint8_t level;
+
+			if (!cat->enabled)
+				continue;
+
+			/* as checked in osmo_vlogp() */
+			level = tar->loglevel ? tar->loglevel : cat->loglevel;
+			if (level < log_cat_min_level[i])
+				log_cat_min_level[i] = level;
+		}
+	}
+}
+
+/*! \brief Check if any log target would output a message
+ *  \param[in] subsys logging subsystem
+ *  \param[in] level logging level
+ *  \returns 0 if no target logs \a level messages of \a subsys
+ *
+ * This is what \ref LOGP checks before evaluating its arguments. It
+ * does not consider filters, which depend on the context at the time
+ * of logging, so a non-zero result means a message may be output.
+ */
+int log_check_level(int subsys, unsigned int level)
+{
+	if (!log_cat_min_level)
+		return 0;
+
+	if (subsys < 0)
+		subsys = subsys_lib2index(subsys);
+
+	/* out of range, let osmo_vlogp() deal with it */
+	if (subsys < 0 || subsys >= osmo_log_info->num_cat)
+		return 1;
+
+	return level >= log_cat_min_level[subsys];
+}
+
 /*! \brief Parse a human-readable log level into a numeric value */
 int log_parse_level(const char *lvl)
 {
@@ -205,6 +264,8 @@ void log_parse_category_mask(struct log_target* target, const char *_mask)
 	} while ((category_token = strtok(NULL, ":")));
 
 	free(mask);
+
+	log_update_min_level();
 }
 
 static const char* color(int subsys)
@@ -215,6 +276,27 @@ static const char* color(int subsys)
 	return NULL;
 }
 
+/* ctime() of the current second, only reformatted once the second changes */
+static const char *timestamp(void)
+{
+	static time_t last;
+	static char str[32] = "";
+	time_t tm;
+
+	tm = time(NULL);
+	if (tm != last || !str[0]) {
+		char *s;
+
+		last = tm;
+		s = ctime(&tm);
+		if (!s)
+			return "";
+		snprintf(str, sizeof(str), "%s", s);
+		str[strcspn(str, "\n")] = '\0';
+	}
+	return str;
+}
+
 static void _output(struct log_target *target, unsigned int subsys,
 		    unsigned int level, const char *file, int line, int cont,
 		    const char *format, va_list ap)
@@ -234,12 +316,7 @@ static void _output(struct log_target *target, unsigned int subsys,
 	}
 	if (!cont) {
 		if (target->print_timestamp) {
-			char *timestr;
-			time_t tm;
-			tm = time(NULL);
-			timestr = ctime(&tm);
-			timestr[strlen(timestr)-1] = '\0';
-			ret = snprintf(buf + offset, rem, "%s ", timestr);
+			ret = snprintf(buf + offset, rem, "%s ", timestamp());
 			if (ret < 0)
 				goto err;
 			OSMO_SNPRINTF_RET(ret, rem, offset, len);
@@ -343,6 +420,7 @@ void logp2(int subsys, unsigned int level, const char *file, int line, int cont,
 void log_add_target(struct log_target *target)
 {
 	llist_add_tail(&target->entry, &osmo_log_target_list);
+	log_update_min_level();
 }
 
 /*! \brief Unregister a log target from the logging core
@@ -351,6 +429,7 @@ void log_add_target(struct log_target *target)
 void log_del_target(struct log_target *target)
 {
 	llist_del(&target->entry);
+	log_update_min_level();
 }
 
 /*! \brief Reset (clear) the logging context */
@@ -429,6 +508,7 @@ void log_set_print_filename(struct log_target *target, int print_filename)
 void log_set_log_level(struct log_target *target, int log_level)
 {
 	target->loglevel = log_level;
+	log_update_min_level();
 }
 
 void log_set_category_filter(struct log_target *target, int category,
@@ -438,6 +518,7 @@ void log_set_category_filter(struct log_target *target, int category,
 		return;
 	target->categories[category].enabled = !!enable;
 	target->categories[category].loglevel = level;
+	log_update_min_level();
 }
 
 static void _file_output(struct log_target *target, unsigned int level,
@@ -447,6 +528,288 @@ static void _file_output(struct log_target *target, unsigned int level,
 	fflush(target->tgt_file.out);
 }
 
+#ifdef HAVE_PTHREAD
+
+/* Asynchronous targets: the caller only copies the formatted line into a
+ * single-producer/single-consumer ring, a writer thread owned by the target
+ * drains it.  head is only written by the logging (main) thread, tail only
+ * by the writer thread; the mutex and condition variables are used just for
+ * sleeping when the ring is empty or (LOG_ASYNC_BLOCK) full. */
+
+#define LOG_ASYNC_RING_SIZE	(256 * 1024)	/* power of two */
+#define LOG_ASYNC_MAX_LINE	4095		/* as formatted by _output() */
+/* a sleeping writer is woken once this much is queued, or after the
+ * timeout, so bursts of lines are written in batches */
+#define LOG_ASYNC_WAKEUP_FILL	(LOG_ASYNC_RING_SIZE / 8)
+#define LOG_ASYNC_WAKEUP_MS	20
+
+struct log_async_hdr {
+	uint16_t len;
+	uint8_t level;
+	uint8_t pad;
+};
+
+struct log_async {
+	enum log_async_policy policy;
+	/* output function of the target when synchronous */
+	void (*output)(struct log_target *target, unsigned int level,
+		       const char *string);
+	unsigned long dropped;
+
+	uint8_t *ring;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t last_wakeup;	/* head at the last wakeup of the writer */
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t data_cond;
+	pthread_cond_t space_cond;
+	int writer_sleeping;
+	int producer_waiting;
+	int stop;
+};
+
+static void ring_read(const struct log_async *a, uint32_t pos, void *data,
+		      size_t len)
+{
+	uint32_t off = pos & (LOG_ASYNC_RING_SIZE - 1);
+	size_t first = LOG_ASYNC_RING_SIZE - off;
+
+	if (first > len)
+		first = len;
+	memcpy(data, a->ring + off, first);
+	memcpy((uint8_t *) data + first, a->ring, len - first);
+}
+
+static void ring_write(struct log_async *a, uint32_t pos, const void *data,
+		       size_t len)
+{
+	uint32_t off = pos & (LOG_ASYNC_RING_SIZE - 1);
+	size_t first = LOG_ASYNC_RING_SIZE - off;
+
+	if (first > len)
+		first = len;
+	memcpy(a->ring + off, data, first);
+	memcpy(a->ring, (const uint8_t *) data + first, len - first);
+}
+
+static void *_async_writer(void *data)
+{
+	struct log_target *target = data;
+	struct log_async *a = target->async;
+	char line[LOG_ASYNC_MAX_LINE + 1];
+	struct timespec ts;
+	uint32_t head, tail = a->tail;
+
+	while (1) {
+		head = __atomic_load_n(&a->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (a->output == _file_output)
+				fflush(target->tgt_file.out);
+			if (__atomic_load_n(&a->stop, __ATOMIC_SEQ_CST))
+				break;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += LOG_ASYNC_WAKEUP_MS * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+
+			pthread_mutex_lock(&a->lock);
+			__atomic_store_n(&a->writer_sleeping, 1,
+					 __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&a->head, __ATOMIC_SEQ_CST) == tail
+			 && !__atomic_load_n(&a->stop, __ATOMIC_SEQ_CST))
+				pthread_cond_timedwait(&a->data_cond, &a->lock,
+						       &ts);
+			__atomic_store_n(&a->writer_sleeping, 0,
+					 __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&a->lock);
+			continue;
+		}
+
+		while (tail != head) {
+			struct log_async_hdr hdr;
+
+			ring_read(a, tail, &hdr, sizeof(hdr));
+			ring_read(a, tail + sizeof(hdr), line, hdr.len);
+			line[hdr.len] = '\0';
+			tail += sizeof(hdr) + hdr.len;
+
+			/* the stdio buffer is only flushed once the ring
+			 * runs empty */
+			if (a->output == _file_output)
+				fputs(line, target->tgt_file.out);
+			else
+				a->output(target, hdr.level, line);
+		}
+
+		__atomic_store_n(&a->tail, tail, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&a->producer_waiting, __ATOMIC_SEQ_CST)) {
+			pthread_mutex_lock(&a->lock);
+			pthread_cond_signal(&a->space_cond);
+			pthread_mutex_unlock(&a->lock);
+		}
+	}
+
+	return NULL;
+}
+
+static void _async_output(struct log_target *target, unsigned int level,
+			  const char *log)
+{
+	struct log_async *a = target->async;
+	struct log_async_hdr hdr;
+	uint32_t head = a->head, need;
+	size_t len = strlen(log);
+
+	if (len > LOG_ASYNC_MAX_LINE)
+		len = LOG_ASYNC_MAX_LINE;
+	need = sizeof(hdr) + len;
+
+	while (LOG_ASYNC_RING_SIZE - (head - __atomic_load_n(&a->tail,
+					__ATOMIC_ACQUIRE)) < need) {
+		if (a->policy == LOG_ASYNC_DROP) {
+			a->dropped++;
+			return;
+		}
+		pthread_mutex_lock(&a->lock);
+		__atomic_store_n(&a->producer_waiting, 1, __ATOMIC_SEQ_CST);
+		if (LOG_ASYNC_RING_SIZE - (head - __atomic_load_n(&a->tail,
+						__ATOMIC_SEQ_CST)) < need)
+			pthread_cond_wait(&a->space_cond, &a->lock);
+		__atomic_store_n(&a->producer_waiting, 0, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&a->lock);
+	}
+
+	hdr.len = len;
+	hdr.level = level;
+	hdr.pad = 0;
+	ring_write(a, head, &hdr, sizeof(hdr));
+	ring_write(a, head + sizeof(hdr), log, len);
+	__atomic_store_n(&a->head, head + need, __ATOMIC_SEQ_CST);
+
+	if (head + need - a->last_wakeup >= LOG_ASYNC_WAKEUP_FILL
+	 && __atomic_load_n(&a->writer_sleeping, __ATOMIC_SEQ_CST)) {
+		a->last_wakeup = head + need;
+		pthread_mutex_lock(&a->lock);
+		pthread_cond_signal(&a->data_cond);
+		pthread_mutex_unlock(&a->lock);
+	}
+}
+
+static int async_start(struct log_target *target, enum log_async_policy policy)
+{
+	struct log_async *a;
+	int rc;
+
+	a = talloc_zero(target, struct log_async);
+	if (!a)
+		return -ENOMEM;
+	a->ring = talloc_size(a, LOG_ASYNC_RING_SIZE);
+	if (!a->ring) {
+		talloc_free(a);
+		return -ENOMEM;
+	}
+	a->policy = policy;
+	a->output = target->output;
+	pthread_mutex_init(&a->lock, NULL);
+	pthread_cond_init(&a->data_cond, NULL);
+	pthread_cond_init(&a->space_cond, NULL);
+
+	target->async = a;
+	rc = pthread_create(&a->thread, NULL, _async_writer, target);
+	if (rc) {
+		target->async = NULL;
+		talloc_free(a);
+		return -rc;
+	}
+	target->output = _async_output;
+
+	return 0;
+}
+
+/* write out everything still queued and join the writer thread */
+static void async_stop(struct log_target *target)
+{
+	struct log_async *a = target->async;
+
+	__atomic_store_n(&a->stop, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_lock(&a->lock);
+	pthread_cond_signal(&a->data_cond);
+	pthread_mutex_unlock(&a->lock);
+	pthread_join(a->thread, NULL);
+
+	pthread_cond_destroy(&a->space_cond);
+	pthread_cond_destroy(&a->data_cond);
+	pthread_mutex_destroy(&a->lock);
+
+	target->output = a->output;
+	target->async = NULL;
+	talloc_free(a);
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*! \brief Move the output of a log target to a writer thread
+ *  \param[in] target log target, must not be a VTY target
+ *  \param[in] policy what to do when the writer falls behind, or
+ *		      \ref LOG_ASYNC_OFF to write from the caller again
+ *  \returns 0 on success, negative error code otherwise
+ *
+ *  Log lines are formatted by the caller as usual and then copied into a
+ *  ring buffer, so a slow disk no longer stalls the main loop.  With
+ *  \ref LOG_ASYNC_DROP a full ring discards the line and increments the
+ *  counter returned by \ref log_target_get_async.  Switching the mode or
+ *  destroying the target writes out all pending lines first.
+ */
+int log_target_set_async(struct log_target *target,
+			 enum log_async_policy policy)
+{
+#ifdef HAVE_PTHREAD
+	if (target->type == LOG_TGT_TYPE_VTY)
+		return -EINVAL;
+
+	if (target->async) {
+		if (policy != LOG_ASYNC_OFF) {
+			target->async->policy = policy;
+			return 0;
+		}
+		async_stop(target);
+		return 0;
+	}
+
+	if (policy == LOG_ASYNC_OFF)
+		return 0;
+
+	return async_start(target, policy);
+#else
+	return policy == LOG_ASYNC_OFF ? 0 : -ENOTSUP;
+#endif
+}
+
+/*! \brief Get the output mode of a log target
+ *  \param[in] target log target
+ *  \param[out] dropped lines dropped due to a full ring (may be NULL)
+ *  \returns policy set by \ref log_target_set_async
+ */
+enum log_async_policy log_target_get_async(const struct log_target *target,
+					   unsigned long *dropped)
+{
+#ifdef HAVE_PTHREAD
+	if (target->async) {
+		if (dropped)
+			*dropped = target->async->dropped;
+		return target->async->policy;
+	}
+#endif
+	if (dropped)
+		*dropped = 0;
+	return LOG_ASYNC_OFF;
+}
+
 /*! \brief Create a new log target skeleton */
 struct log_target *log_target_create(void)
 {
@@ -556,6 +919,8 @@ void log_target_destroy(struct log_target *target)
 	/* just in case, to make sure we don't have any references */
 	log_del_target(target);
 
+	log_target_set_async(target, LOG_ASYNC_OFF);
+
 	if (target->output == &_file_output) {
 /* since C89/C99 says stderr is a macro, we can safely do this! */
 #ifdef stderr
@@ -574,15 +939,36 @@ void log_target_destroy(struct log_target *target)
 /*! \brief close and re-open a log file (for log file rotation) */
 int log_target_file_reopen(struct log_target *target)
 {
-	fclose(target->tgt_file.out);
+	enum log_async_policy policy;
+	unsigned long dropped;
+	int rc = 0;
+
+	/* the writer thread must not touch the FILE while it is replaced */
+	policy = log_target_get_async(target, &dropped);
+	log_target_set_async(target, LOG_ASYNC_OFF);
+
+	/* a previous reopen may have failed */
+	if (target->tgt_file.out)
+		fclose(target->tgt_file.out);
 
 	target->tgt_file.out = fopen(target->tgt_file.fname, "a");
 	if (!target->tgt_file.out)
-		return -errno;
+		rc = -errno;
 
 	/* we assume target->output already to be set */
 
-	return 0;
+	/* the output mode is kept, even if the file could not be opened */
+	if (policy != LOG_ASYNC_OFF) {
+		int rc_async = log_target_set_async(target, policy);
+#ifdef HAVE_PTHREAD
+		if (rc_async == 0)
+			target->async->dropped = dropped;
+#endif
+		if (rc == 0)
+			rc = rc_async;
+	}
+
+	return rc;
 }
 
 /*! \brief Generates the logging command string for VTY
@@ -766,6 +1152,15 @@ int log_init(const struct log_info *inf, void *ctx)
 			&internal_cat[i], sizeof(struct log_info_cat));
 	}
 
+	log_cat_min_level = talloc_array(osmo_log_info, uint8_t,
+					 osmo_log_info->num_cat);
+	if (!log_cat_min_level) {
+		talloc_free(osmo_log_info);
+		osmo_log_info = NULL;
+		return -ENOMEM;
+	}
+	log_update_min_level();
+
 	return 0;
 }
 
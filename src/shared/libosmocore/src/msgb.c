@@ -28,14 +28,67 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
 //#include <openbsc/gsm_data.h>
 #include <osmocom/core/talloc.h>
 //#include <openbsc/debug.h>
 
 void *tall_msgb_ctx;
 
+/* size classes of the msgb pool, sorted by size */
+static struct msgb_pool_class {
+	struct llist_head free_list;
+	struct msgb_pool_stats stats;
+} pool_classes[MSGB_POOL_MAX_CLASSES];
+static unsigned int pool_num_classes;
+static unsigned long pool_oversize;
+
+static const uint16_t pool_default_sizes[] = { 64, 256, 512, 2048 };
+
+static struct msgb *msgb_pool_alloc(uint16_t size, const char *name)
+{
+	struct msgb_pool_class *pc;
+	struct msgb *msg;
+	unsigned int i;
+
+	for (i = 0; i < pool_num_classes; i++) {
+		if (size <= pool_classes[i].stats.size)
+			break;
+	}
+	if (i == pool_num_classes) {
+		pool_oversize++;
+		return NULL;
+	}
+	pc = &pool_classes[i];
+
+	if (!llist_empty(&pc->free_list)) {
+		msg = llist_entry(pc->free_list.next, struct msgb, list);
+		llist_del(&msg->list);
+		pc->stats.free--;
+		pc->stats.hits++;
+		talloc_set_name_const(msg, name);
+	} else {
+		msg = talloc_named_const(tall_msgb_ctx,
+				sizeof(*msg) + pc->stats.size, name);
+		if (!msg)
+			return NULL;
+		pc->stats.misses++;
+	}
+
+	/* only the header is cleared, the data is left as it is */
+	memset(msg, 0, sizeof(*msg));
+	msg->pool_class = i + 1;
+
+	pc->stats.in_use++;
+	if (pc->stats.in_use > pc->stats.high_water)
+		pc->stats.high_water = pc->stats.in_use;
+
+	return msg;
+}
+
 /*! \brief Allocate a new message buffer
  * \param[in] size Length in octets, including headroom
  * \param[in] name Human-readable name to be associated with msgb
@@ -43,12 +96,18 @@ void *tall_msgb_ctx;
  * This function allocates a 'struct msgb' as well as the underlying
  * memory buffer for the actual message data (size specified by \a size)
  * using the talloc memory context previously set by \ref msgb_set_talloc_ctx
+ *
+ * If the msgb pool is enabled, see \ref msgb_pool_enable, the data of
+ * the returned message buffer is not zeroed.
  */
 struct msgb *msgb_alloc(uint16_t size, const char *name)
 {
-	struct msgb *msg;
+	struct msgb *msg = NULL;
 
-	msg = _talloc_zero(tall_msgb_ctx, sizeof(*msg) + size, name);
+	if (pool_num_classes)
+		msg = msgb_pool_alloc(size, name);
+	if (!msg)
+		msg = _talloc_zero(tall_msgb_ctx, sizeof(*msg) + size, name);
 
 	if (!msg) {
 		//LOGP(DRSL, LOGL_FATAL, "unable to allocate msgb\n");
@@ -69,9 +128,102 @@ struct msgb *msgb_alloc(uint16_t size, const char *name)
  */
 void msgb_free(struct msgb *m)
 {
+	struct msgb_pool_class *pc;
+
+	/* the size check catches buffers of a pool that was re-enabled
+	 * with different classes in the meantime */
+	if (m->pool_class && m->pool_class <= pool_num_classes &&
+	    talloc_get_size(m) == sizeof(*m) +
+				pool_classes[m->pool_class - 1].stats.size) {
+		pc = &pool_classes[m->pool_class - 1];
+		if (pc->stats.in_use)
+			pc->stats.in_use--;
+		pc->stats.free++;
+		llist_add(&m->list, &pc->free_list);
+		return;
+	}
+
 	talloc_free(m);
 }
 
+/*! \brief Enable recycling of message buffers in size classes
+ * \param[in] sizes data sizes of the classes, NULL for the default
+ *	       of 64, 256, 512 and 2048 octets
+ * \param[in] num_sizes number of entries in \a sizes
+ * \returns 0 on success, negative in case of error
+ *
+ * Once enabled, \ref msgb_alloc rounds the size up to the next class
+ * and serves it from the free list of that class, \ref msgb_free puts
+ * it back there.  Larger message buffers are allocated as before.
+ * Recycled message buffers only get their header zeroed, not their
+ * data.  Any previously enabled pool is disabled first.
+ */
+int msgb_pool_enable(const uint16_t *sizes, unsigned int num_sizes)
+{
+	unsigned int i;
+
+	if (!sizes) {
+		sizes = pool_default_sizes;
+		num_sizes = ARRAY_SIZE(pool_default_sizes);
+	}
+	if (num_sizes == 0 || num_sizes > MSGB_POOL_MAX_CLASSES)
+		return -EINVAL;
+	for (i = 1; i < num_sizes; i++) {
+		if (sizes[i] <= sizes[i-1])
+			return -EINVAL;
+	}
+
+	msgb_pool_disable();
+
+	for (i = 0; i < num_sizes; i++) {
+		INIT_LLIST_HEAD(&pool_classes[i].free_list);
+		memset(&pool_classes[i].stats, 0,
+			sizeof(pool_classes[i].stats));
+		pool_classes[i].stats.size = sizes[i];
+	}
+	pool_oversize = 0;
+	pool_num_classes = num_sizes;
+
+	return 0;
+}
+
+/*! \brief Disable the msgb pool and release all recycled buffers
+ *
+ * Message buffers from the pool that are still in use are released
+ * to talloc when they are free'd.
+ */
+void msgb_pool_disable(void)
+{
+	struct msgb *msg, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < pool_num_classes; i++) {
+		llist_for_each_entry_safe(msg, tmp,
+					  &pool_classes[i].free_list, list)
+			talloc_free(msg);
+	}
+	pool_num_classes = 0;
+}
+
+/*! \brief Get statistics of the msgb pool
+ * \param[out] stats array receiving the statistics of each class
+ * \param[in] max number of entries in \a stats
+ * \param[out] oversize number of allocations too large for any class
+ * \returns number of size classes
+ */
+int msgb_pool_get_stats(struct msgb_pool_stats *stats, unsigned int max,
+			unsigned long *oversize)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool_num_classes && i < max; i++)
+		stats[i] = pool_classes[i].stats;
+	if (oversize)
+		*oversize = pool_oversize;
+
+	return pool_num_classes;
+}
+
 /*! \brief Enqueue message buffer to tail of a queue
  * \param[in] queue linked list header of queue
  * \param[in] msgb message buffer to be added to the queue
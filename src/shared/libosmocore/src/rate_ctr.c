@@ -29,17 +29,49 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include <osmocom/core/utils.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/talloc.h>
-#include <osmocom/core/timer.h>
 #include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats_shm.h>
+
+#include "../config.h"
 
 static LLIST_HEAD(rate_ctr_groups);
 
 static void *tall_rate_ctr_ctx;
 
+/* length of the intervals in milliseconds */
+static const uint64_t intv_msecs[RATE_CTR_INTV_NUM] = {
+	[RATE_CTR_INTV_SEC]	= 1000,
+	[RATE_CTR_INTV_MIN]	= 60 * 1000,
+	[RATE_CTR_INTV_HOUR]	= 60 * 60 * 1000,
+	[RATE_CTR_INTV_DAY]	= 24 * 60 * 60 * 1000,
+};
+
+/* replacement of the clock, see rate_ctr_set_clock() */
+static uint64_t (*rate_ctr_clock)(void);
+
+/* milliseconds on a clock that doesn't jump */
+static uint64_t rate_ctr_msecs(void)
+{
+	if (rate_ctr_clock)
+		return rate_ctr_clock();
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
 /*! \brief Allocate a new group of counters according to description
  *  \param[in] ctx \ref talloc context
  *  \param[in] desc Rate counter group description
@@ -64,8 +96,10 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 
 	group->desc = desc;
 	group->idx = idx;
+	group->intv_msecs = rate_ctr_msecs();
 
 	llist_add(&group->list, &rate_ctr_groups);
+	osmo_stats_shm_add_ctrg(group);
 
 	return group;
 }
@@ -73,6 +107,7 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 /*! \brief Free the memory for the specified group of counters */
 void rate_ctr_group_free(struct rate_ctr_group *grp)
 {
+	osmo_stats_shm_del_ctrg(grp);
 	llist_del(&grp->list);
 	talloc_free(grp);
 }
@@ -83,60 +118,111 @@ void rate_ctr_add(struct rate_ctr *ctr, int inc)
 	ctr->current += inc;
 }
 
-static void interval_expired(struct rate_ctr *ctr, enum rate_ctr_intv intv)
+/* estimate the value of a counter at time t between the last update of
+ * its group and now, assuming a constant rate in between */
+static uint64_t value_at(const struct rate_ctr *ctr, uint64_t current,
+			 uint64_t t_seen, uint64_t t_now, uint64_t t)
 {
-	/* calculate rate over last interval */
-	ctr->intv[intv].rate = ctr->current - ctr->intv[intv].last;
-	/* save current counter for next interval */
-	ctr->intv[intv].last = ctr->current;
-
-	/* update the rate of the next bigger interval.  This will
-	 * be overwritten when that next larger interval expires */
-	if (intv + 1 < ARRAY_SIZE(ctr->intv))
-		ctr->intv[intv+1].rate += ctr->intv[intv].rate;
-}
+	double delta = (int64_t) (current - ctr->seen);
 
-static struct osmo_timer_list rate_ctr_timer;
-static uint64_t timer_ticks;
+	return ctr->seen + (int64_t) (delta * (t - t_seen) / (t_now - t_seen));
+}
 
-/* The one-second interval has expired */
-static void rate_ctr_group_intv(struct rate_ctr_group *grp)
+/*! \brief Update the interval rates of a group of counters
+ *  \param[in] grp Rate counter group
+ *
+ * There is no periodic timer. The rates are computed when they are read,
+ * so the groups that nobody reads cost nothing. The value of a counter at
+ * the end of an interval is interpolated between the previous update and
+ * now. The rates are exact as long as the group is updated at least once
+ * per interval, and averages over the time between two updates otherwise.
+ */
+void rate_ctr_group_upd_intv(struct rate_ctr_group *grp)
 {
-	unsigned int i;
+	uint64_t t_seen = grp->intv_msecs;
+	uint64_t t_now = rate_ctr_msecs();
+	uint64_t t_end[RATE_CTR_INTV_NUM];
+	int started[RATE_CTR_INTV_NUM];
+	unsigned int i, intv, num_intv = 0;
+
+	/* all boundaries of a longer interval are also boundaries of the
+	 * shorter ones */
+	for (intv = 0; intv < RATE_CTR_INTV_NUM; intv++) {
+		uint64_t n_seen = t_seen / intv_msecs[intv];
+		uint64_t n_now = t_now / intv_msecs[intv];
+
+		if (n_now == n_seen)
+			break;
+		t_end[intv] = n_now * intv_msecs[intv];
+		/* did the previous update see the start of the interval
+		 * that ended last? */
+		started[intv] = n_now == n_seen + 1;
+		num_intv++;
+	}
+
+	/* within the same second the previous update is as good */
+	if (!num_intv)
+		return;
 
 	for (i = 0; i < grp->desc->num_ctr; i++) {
 		struct rate_ctr *ctr = &grp->ctr[i];
-
-		interval_expired(ctr, RATE_CTR_INTV_SEC);
-		if ((timer_ticks % 60) == 0)
-			interval_expired(ctr, RATE_CTR_INTV_MIN);
-		if ((timer_ticks % (60*60)) == 0)
-			interval_expired(ctr, RATE_CTR_INTV_HOUR);
-		if ((timer_ticks % (24*60*60)) == 0)
-			interval_expired(ctr, RATE_CTR_INTV_DAY);
+		uint64_t current = ctr->current;
+
+		for (intv = 0; intv < num_intv; intv++) {
+			struct rate_ctr_per_intv *pi = &ctr->intv[intv];
+			uint64_t start, end;
+
+			end = value_at(ctr, current, t_seen, t_now,
+				       t_end[intv]);
+			if (started[intv])
+				start = pi->last;
+			else
+				start = value_at(ctr, current, t_seen,
+					t_now, t_end[intv] - intv_msecs[intv]);
+			pi->rate = end - start;
+			pi->last = end;
+		}
+		ctr->seen = current;
 	}
+
+	grp->intv_msecs = t_now;
 }
 
-static void rate_ctr_timer_cb(void *data)
+/*! \brief Replace the clock the interval rates are computed with
+ *  \param[in] msecs returns milliseconds on a clock that doesn't jump,
+ *  NULL for the monotonic clock of the system
+ *
+ * Meant for tests, must be called before the first group is allocated.
+ */
+void rate_ctr_set_clock(uint64_t (*msecs)(void))
 {
-	struct rate_ctr_group *ctrg;
-
-	/* Increment number of ticks before we calculate intervals,
-	 * as a counter value of 0 would already wrap all counters */
-	timer_ticks++;
-
-	llist_for_each_entry(ctrg, &rate_ctr_groups, list)
-		rate_ctr_group_intv(ctrg);
-
-	osmo_timer_schedule(&rate_ctr_timer, 1, 0);
+	rate_ctr_clock = msecs;
 }
 
 /*! \brief Initialize the counter module */
 int rate_ctr_init(void *tall_ctx)
 {
 	tall_rate_ctr_ctx = tall_ctx;
-	rate_ctr_timer.cb = rate_ctr_timer_cb;
-	osmo_timer_schedule(&rate_ctr_timer, 1, 0);
+
+	return 0;
+}
+
+/*! \brief Call a function for each counter group
+ *  \param[in] handle_group Function called for each group
+ *  \param[in] data Passed to handle_group
+ *  \returns the first negative value returned by handle_group; 0 otherwise
+ */
+int rate_ctr_for_each_group(int (*handle_group)(struct rate_ctr_group *, void *),
+			    void *data)
+{
+	struct rate_ctr_group *ctrg;
+	int rc;
+
+	llist_for_each_entry(ctrg, &rate_ctr_groups, list) {
+		rc = handle_group(ctrg, data);
+		if (rc < 0)
+			return rc;
+	}
 
 	return 0;
 }
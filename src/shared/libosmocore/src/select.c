@@ -21,6 +21,8 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include <osmocom/core/select.h>
 #include <osmocom/core/linuxlist.h>
@@ -30,6 +32,10 @@
 
 #ifdef HAVE_SYS_SELECT_H
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 /*! \addtogroup select
  *  @{
  */
@@ -42,6 +48,245 @@ static int maxfd = 0;
 static LLIST_HEAD(osmo_fds);
 static int unregistered_count;
 
+static enum osmo_select_backend backend = OSMO_SELECT_BACKEND_SELECT;
+
+/* osmo_fd->state */
+#define FD_S_REGISTERED		0x0001	/* in osmo_fds */
+#define FD_S_WHEN_CHANGED	0x0002	/* in when_changed */
+#define FD_S_EPOLL		0x0004	/* in the epoll set */
+
+/* registered fds whose \a when differs from \a kernel_when */
+static LLIST_HEAD(when_changed);
+
+static void when_changed_del(struct osmo_fd *fd)
+{
+	if (fd->state & FD_S_WHEN_CHANGED) {
+		llist_del(&fd->when_list);
+		fd->state &= ~FD_S_WHEN_CHANGED;
+	}
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+/* maximum number of events fetched by a single epoll_wait() */
+#define EPOLL_MAX_EVENTS	64
+
+static int epoll_fd = -1;
+static unsigned int epoll_flags;
+/* events of the epoll_wait() currently being dispatched */
+static struct epoll_event epoll_events[EPOLL_MAX_EVENTS];
+static int epoll_nevents;
+
+static uint32_t when2epoll(unsigned int when)
+{
+	uint32_t events = 0;
+
+	if (when & BSC_FD_READ)
+		events |= EPOLLIN;
+	if (when & BSC_FD_WRITE)
+		events |= EPOLLOUT;
+	if (when & BSC_FD_EXCEPT)
+		events |= EPOLLPRI;
+	if (epoll_flags & OSMO_SELECT_F_EDGE)
+		events |= EPOLLET;
+
+	return events;
+}
+
+/* epoll reports errors and hangup even if no events are asked for, while
+ * select() doesn't look at an fd that is not waited for. Such fds are kept
+ * out of the epoll set, or a pending error would wake us up over and over */
+static void epoll_remove(struct osmo_fd *fd)
+{
+	fd->kernel_when = 0;
+	if (!(fd->state & FD_S_EPOLL))
+		return;
+
+	/* users that close the fd first must set it to -1, its number
+	 * may already be reused by another fd */
+	if (fd->fd >= 0)
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd->fd, NULL);
+	fd->state &= ~FD_S_EPOLL;
+}
+
+static int epoll_update(struct osmo_fd *fd)
+{
+	struct epoll_event ev;
+	int rc;
+
+	if (!fd->when) {
+		epoll_remove(fd);
+		return 0;
+	}
+
+	ev.events = when2epoll(fd->when);
+	ev.data.ptr = fd;
+
+	rc = epoll_ctl(epoll_fd, fd->state & FD_S_EPOLL ? EPOLL_CTL_MOD :
+			EPOLL_CTL_ADD, fd->fd, &ev);
+	if (rc < 0)
+		return rc;
+	fd->state |= FD_S_EPOLL;
+	fd->kernel_when = fd->when;
+
+	return 0;
+}
+
+static void epoll_forget(struct osmo_fd *fd)
+{
+	int i;
+
+	epoll_remove(fd);
+
+	/* do not dispatch events still pending for this fd */
+	for (i = 0; i < epoll_nevents; i++) {
+		if (epoll_events[i].data.ptr == fd)
+			epoll_events[i].data.ptr = NULL;
+	}
+}
+
+static int epoll_main(int polling)
+{
+	struct osmo_fd *ufd, *tmp;
+	struct timeval *tv;
+	int work = 0, timeout, rc, i;
+
+	/* push the masks changed by osmo_fd_update_when() to the kernel,
+	 * the other fds are not touched */
+	llist_for_each_entry_safe(ufd, tmp, &when_changed, when_list) {
+		when_changed_del(ufd);
+		if (ufd->when != ufd->kernel_when)
+			epoll_update(ufd);
+	}
+
+	osmo_timers_check();
+
+	if (!polling)
+		osmo_timers_prepare();
+
+	if (polling)
+		timeout = 0;
+	else if (!(tv = osmo_timers_nearest()))
+		timeout = -1;
+	else /* round up, we must not wake up before the timer expired */
+		timeout = tv->tv_sec * 1000 + (tv->tv_usec + 999) / 1000;
+
+	rc = epoll_wait(epoll_fd, epoll_events, EPOLL_MAX_EVENTS, timeout);
+	if (rc < 0)
+		return 0;
+	epoll_nevents = rc;
+
+	/* fire timers */
+	osmo_timers_update();
+
+	/* call registered callback functions */
+	for (i = 0; i < epoll_nevents; i++) {
+		uint32_t events = epoll_events[i].events;
+		int flags = 0;
+
+		ufd = epoll_events[i].data.ptr;
+		/* unregistered by an earlier call-back */
+		if (!ufd)
+			continue;
+
+		/* select() reports errors and hangup as readable and
+		 * writable, so do the same here */
+		if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			flags |= BSC_FD_READ;
+		if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+			flags |= BSC_FD_WRITE;
+		if (events & EPOLLPRI)
+			flags |= BSC_FD_EXCEPT;
+		flags &= ufd->when;
+
+		if (flags) {
+			work = 1;
+			ufd->cb(ufd, flags);
+		} else {
+			/* an error or hangup while neither reading nor
+			 * writing, select() wouldn't report it either */
+			epoll_remove(ufd);
+		}
+	}
+	epoll_nevents = 0;
+
+	return work;
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
+
+/*! \brief Select the backend used by \ref osmo_select_main
+ *  \param[in] new_backend the backend to be used
+ *  \param[in] flags bit-mask of OSMO_SELECT_F_* flags
+ *  \returns 0 on success, negative in case of error
+ *
+ * This may be called at any time from outside of the call-backs;
+ * already registered file descriptors are moved to the new backend.
+ * If the epoll backend cannot be set up, the select backend stays
+ * in use.
+ */
+int osmo_select_init(enum osmo_select_backend new_backend, unsigned int flags)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	struct osmo_fd *ufd, *tmp;
+	int rc, fdflags;
+
+	/* the new backend starts from the current masks */
+	llist_for_each_entry_safe(ufd, tmp, &when_changed, when_list)
+		when_changed_del(ufd);
+	llist_for_each_entry(ufd, &osmo_fds, list)
+		ufd->state &= ~FD_S_EPOLL;
+
+	if (epoll_fd >= 0) {
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
+
+	switch (new_backend) {
+	case OSMO_SELECT_BACKEND_SELECT:
+		break;
+	case OSMO_SELECT_BACKEND_EPOLL:
+		epoll_fd = epoll_create(EPOLL_MAX_EVENTS);
+		if (epoll_fd < 0)
+			goto err;
+		fdflags = fcntl(epoll_fd, F_GETFD);
+		if (fdflags >= 0)
+			fcntl(epoll_fd, F_SETFD, fdflags | FD_CLOEXEC);
+		epoll_flags = flags;
+
+		llist_for_each_entry(ufd, &osmo_fds, list) {
+			rc = epoll_update(ufd);
+			if (rc < 0) {
+				close(epoll_fd);
+				epoll_fd = -1;
+				goto err;
+			}
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	backend = new_backend;
+	return 0;
+
+err:
+	rc = -errno;
+	backend = OSMO_SELECT_BACKEND_SELECT;
+	return rc;
+#else
+	if (new_backend != OSMO_SELECT_BACKEND_SELECT)
+		return -ENOTSUP;
+	return 0;
+#endif
+}
+
+/*! \brief Get the backend currently used by \ref osmo_select_main */
+enum osmo_select_backend osmo_select_get_backend(void)
+{
+	return backend;
+}
+
 /*! \brief Register a new file descriptor with select loop abstraction
  *  \param[in] fd osmocom file descriptor to be registered
  */
@@ -81,7 +326,17 @@ int osmo_fd_register(struct osmo_fd *fd)
 	}
 #endif
 
+	fd->state = 0;
+#ifdef HAVE_SYS_EPOLL_H
+	if (backend == OSMO_SELECT_BACKEND_EPOLL) {
+		int rc = epoll_update(fd);
+		if (rc < 0)
+			return -errno;
+	}
+#endif
+
 	llist_add_tail(&fd->list, &osmo_fds);
+	fd->state |= FD_S_REGISTERED;
 
 	return 0;
 }
@@ -93,6 +348,35 @@ void osmo_fd_unregister(struct osmo_fd *fd)
 {
 	unregistered_count++;
 	llist_del(&fd->list);
+	when_changed_del(fd);
+#ifdef HAVE_SYS_EPOLL_H
+	if (backend == OSMO_SELECT_BACKEND_EPOLL)
+		epoll_forget(fd);
+#endif
+	fd->state = 0;
+}
+
+/*! \brief Change the events a file descriptor is waited for
+ *  \param[in] fd osmocom file descriptor
+ *  \param[in] when new bit-mask of BSC_FD_READ, BSC_FD_WRITE and/or
+ *  BSC_FD_EXCEPT
+ *
+ * Registered file descriptors must be changed through this function,
+ * the epoll backend only passes changes made by it to the kernel. It may
+ * also be used before registration, on a zero-initialised \ref osmo_fd
+ * or one that was unregistered.
+ */
+void osmo_fd_update_when(struct osmo_fd *fd, unsigned int when)
+{
+	fd->when = when;
+
+	if (backend != OSMO_SELECT_BACKEND_EPOLL ||
+	    !(fd->state & FD_S_REGISTERED) ||
+	    (fd->state & FD_S_WHEN_CHANGED) || when == fd->kernel_when)
+		return;
+
+	llist_add_tail(&fd->when_list, &when_changed);
+	fd->state |= FD_S_WHEN_CHANGED;
 }
 
 /*! \brief select main loop integration
@@ -105,6 +389,11 @@ int osmo_select_main(int polling)
 	int work = 0, rc;
 	struct timeval no_time = {0, 0};
 
+#ifdef HAVE_SYS_EPOLL_H
+	if (backend == OSMO_SELECT_BACKEND_EPOLL)
+		return epoll_main(polling);
+#endif
+
 	FD_ZERO(&readset);
 	FD_ZERO(&writeset);
 	FD_ZERO(&exceptset);
@@ -25,6 +25,7 @@
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/statistics.h>
+#include <osmocom/core/stats_shm.h>
 
 static LLIST_HEAD(counters);
 
@@ -39,12 +40,14 @@ struct osmo_counter *osmo_counter_alloc(const char *name)
 
 	ctr->name = name;
 	llist_add_tail(&ctr->list, &counters);
+	osmo_stats_shm_add_counter(ctr);
 
 	return ctr;
 }
 
 void osmo_counter_free(struct osmo_counter *ctr)
 {
+	osmo_stats_shm_del_counter(ctr);
 	llist_del(&ctr->list);
 	talloc_free(ctr);
 }
@@ -0,0 +1,518 @@
+/* export of counters through a shared memory segment */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup stats_shm
+ *  @{
+ */
+
+/*! \file stats_shm.c */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/statistics.h>
+#include <osmocom/core/stats_shm.h>
+
+#include "../config.h"
+
+/* how often a reader retries a snapshot the writer keeps changing */
+#define SNAPSHOT_RETRIES	1000
+
+#ifdef HAVE_SHM_OPEN
+
+/* the counter behind a slot, only known to the writer */
+struct shm_owner {
+	void *ptr;		/* rate_ctr_group or osmo_counter */
+	unsigned int idx;	/* counter within the group */
+};
+
+static struct {
+	struct osmo_stats_shm_hdr *hdr;
+	size_t size;
+	char name[NAME_MAX];
+	struct shm_owner *owner;
+	struct osmo_timer_list timer;
+} shm;
+
+static size_t seg_size(unsigned int num_slots)
+{
+	return sizeof(struct osmo_stats_shm_hdr) +
+		num_slots * sizeof(struct osmo_stats_shm_slot);
+}
+
+static void shm_name(char *buf, size_t len, const char *name)
+{
+	snprintf(buf, len, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+/* seqlock write side: the sequence number is odd while the segment is
+ * inconsistent, readers retry until they see the same even number before
+ * and after their copy */
+static void write_begin(void)
+{
+	shm.hdr->seq++;
+	__sync_synchronize();
+}
+
+static void write_end(void)
+{
+	__sync_synchronize();
+	shm.hdr->seq++;
+}
+
+/* find num consecutive free slots, first fit */
+static int slots_alloc(unsigned int num)
+{
+	unsigned int i, run = 0;
+
+	for (i = 0; i < shm.hdr->num_slots; i++) {
+		if (shm.hdr->slot[i].type != OSMO_STATS_SHM_FREE) {
+			run = 0;
+			continue;
+		}
+		if (++run == num)
+			return i + 1 - num;
+	}
+	return -ENOSPC;
+}
+
+static void slots_free(void *ptr)
+{
+	unsigned int i, used = 0;
+
+	for (i = 0; i < shm.hdr->used_slots; i++) {
+		if (shm.owner[i].ptr == ptr) {
+			memset(&shm.hdr->slot[i], 0, sizeof(shm.hdr->slot[i]));
+			shm.owner[i].ptr = NULL;
+		} else if (shm.hdr->slot[i].type != OSMO_STATS_SHM_FREE)
+			used = i + 1;
+	}
+	shm.hdr->used_slots = used;
+}
+
+static void slot_fill(unsigned int i, enum osmo_stats_shm_type type,
+		      void *ptr, unsigned int idx, const char *group,
+		      unsigned int group_idx, const char *name,
+		      const char *description)
+{
+	struct osmo_stats_shm_slot *slot = &shm.hdr->slot[i];
+
+	slot->type = type;
+	slot->group_idx = group_idx;
+	strncpy(slot->group, group ? group : "", sizeof(slot->group) - 1);
+	strncpy(slot->name, name ? name : "", sizeof(slot->name) - 1);
+	strncpy(slot->description, description ? description : "",
+		sizeof(slot->description) - 1);
+	shm.owner[i].ptr = ptr;
+	shm.owner[i].idx = idx;
+	if (i >= shm.hdr->used_slots)
+		shm.hdr->used_slots = i + 1;
+}
+
+/*! \brief Give the counters of a group slots in the segment
+ *  \param[in] ctrg Rate counter group
+ *  \returns 0 in case of success; negative otherwise
+ *
+ * Called by rate_ctr_group_alloc(), does nothing unless
+ * osmo_stats_shm_init() was called.
+ */
+int osmo_stats_shm_add_ctrg(struct rate_ctr_group *ctrg)
+{
+	const struct rate_ctr_group_desc *desc = ctrg->desc;
+	unsigned int i;
+	int first;
+
+	if (!shm.hdr || !desc->num_ctr)
+		return 0;
+
+	first = slots_alloc(desc->num_ctr);
+	if (first < 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "No room for counter group %s.%u "
+		     "in statistics segment\n", desc->group_name_prefix,
+		     ctrg->idx);
+		return first;
+	}
+
+	write_begin();
+	for (i = 0; i < desc->num_ctr; i++)
+		slot_fill(first + i, OSMO_STATS_SHM_RATE_CTR, ctrg, i,
+			  desc->group_name_prefix, ctrg->idx,
+			  desc->ctr_desc[i].name,
+			  desc->ctr_desc[i].description);
+	write_end();
+
+	return 0;
+}
+
+/*! \brief Release the slots of a counter group */
+void osmo_stats_shm_del_ctrg(struct rate_ctr_group *ctrg)
+{
+	if (!shm.hdr)
+		return;
+
+	write_begin();
+	slots_free(ctrg);
+	write_end();
+}
+
+/*! \brief Give a counter a slot in the segment
+ *  \param[in] ctr Counter
+ *  \returns 0 in case of success; negative otherwise
+ *
+ * Called by osmo_counter_alloc(), does nothing unless
+ * osmo_stats_shm_init() was called.
+ */
+int osmo_stats_shm_add_counter(struct osmo_counter *ctr)
+{
+	int i;
+
+	if (!shm.hdr)
+		return 0;
+
+	i = slots_alloc(1);
+	if (i < 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "No room for counter %s "
+		     "in statistics segment\n", ctr->name);
+		return i;
+	}
+
+	write_begin();
+	slot_fill(i, OSMO_STATS_SHM_COUNTER, ctr, 0, NULL, 0, ctr->name,
+		  ctr->description);
+	write_end();
+
+	return 0;
+}
+
+/*! \brief Release the slot of a counter */
+void osmo_stats_shm_del_counter(struct osmo_counter *ctr)
+{
+	if (!shm.hdr)
+		return;
+
+	write_begin();
+	slots_free(ctr);
+	write_end();
+}
+
+static uint64_t wall_msecs(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*! \brief Copy the current values of all counters into the segment
+ *
+ * Called by the timer every interval_ms, can be called in between to
+ * publish a change right away.
+ */
+void osmo_stats_shm_update(void)
+{
+	struct rate_ctr_group *ctrg;
+	struct osmo_counter *ctr;
+	struct rate_ctr *rctr;
+	unsigned int i, intv;
+
+	if (!shm.hdr)
+		return;
+
+	/* the interval rates are computed on read, do it for each group
+	 * before entering the write section */
+	for (i = 0; i < shm.hdr->used_slots; i++) {
+		if (shm.hdr->slot[i].type == OSMO_STATS_SHM_RATE_CTR &&
+		    shm.owner[i].idx == 0)
+			rate_ctr_group_upd_intv(shm.owner[i].ptr);
+	}
+
+	write_begin();
+	for (i = 0; i < shm.hdr->used_slots; i++) {
+		struct osmo_stats_shm_slot *slot = &shm.hdr->slot[i];
+
+		switch (slot->type) {
+		case OSMO_STATS_SHM_RATE_CTR:
+			ctrg = shm.owner[i].ptr;
+			rctr = &ctrg->ctr[shm.owner[i].idx];
+			slot->value = rctr->current;
+			for (intv = 0; intv < RATE_CTR_INTV_NUM; intv++)
+				slot->rate[intv] = rctr->intv[intv].rate;
+			break;
+		case OSMO_STATS_SHM_COUNTER:
+			ctr = shm.owner[i].ptr;
+			slot->value = ctr->value;
+			/* users set the description after the allocation */
+			if (!slot->description[0] && ctr->description)
+				strncpy(slot->description, ctr->description,
+					sizeof(slot->description) - 1);
+			break;
+		}
+	}
+	shm.hdr->update_time_ms = wall_msecs();
+	write_end();
+}
+
+static void update_cb(void *data)
+{
+	unsigned int ms = shm.hdr->interval_ms;
+
+	osmo_stats_shm_update();
+	osmo_timer_schedule(&shm.timer, ms / 1000, (ms % 1000) * 1000);
+}
+
+static int add_counter_cb(struct osmo_counter *ctr, void *data)
+{
+	return osmo_stats_shm_add_counter(ctr);
+}
+
+static int add_ctrg_cb(struct rate_ctr_group *ctrg, void *data)
+{
+	return osmo_stats_shm_add_ctrg(ctrg);
+}
+
+/*! \brief Export all counters in a shared memory segment
+ *  \param[in] name Name of the segment, e.g. the name of the program
+ *  \param[in] num_slots Number of counters the segment can hold
+ *  \param[in] interval_ms Time between two updates, 0 for no timer
+ *  \returns 0 in case of success; negative otherwise
+ *
+ * The segment is created as /dev/shm/<name>, existing counters get their
+ * slots right away, counters allocated later when they are allocated.
+ * The segment is removed by osmo_stats_shm_exit().
+ */
+int osmo_stats_shm_init(const char *name, unsigned int num_slots,
+			unsigned int interval_ms)
+{
+	struct osmo_stats_shm_hdr *hdr;
+	size_t size = seg_size(num_slots);
+	int fd, rc;
+
+	if (shm.hdr)
+		return -EALREADY;
+
+	shm_name(shm.name, sizeof(shm.name), name);
+	fd = shm_open(shm.name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+	if (ftruncate(fd, size) < 0) {
+		rc = -errno;
+		goto err_unlink;
+	}
+	hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		rc = -errno;
+		goto err_unlink;
+	}
+	close(fd);
+
+	shm.owner = talloc_zero_array(NULL, struct shm_owner, num_slots);
+	if (!shm.owner) {
+		munmap(hdr, size);
+		shm_unlink(shm.name);
+		return -ENOMEM;
+	}
+
+	hdr->version = OSMO_STATS_SHM_VERSION;
+	hdr->slot_size = sizeof(struct osmo_stats_shm_slot);
+	hdr->num_slots = num_slots;
+	hdr->pid = getpid();
+	hdr->interval_ms = interval_ms;
+	/* readers check the magic last */
+	__sync_synchronize();
+	hdr->magic = OSMO_STATS_SHM_MAGIC;
+
+	shm.hdr = hdr;
+	shm.size = size;
+
+	rate_ctr_for_each_group(add_ctrg_cb, NULL);
+	osmo_counters_for_each(add_counter_cb, NULL);
+	osmo_stats_shm_update();
+
+	if (interval_ms) {
+		shm.timer.cb = update_cb;
+		osmo_timer_schedule(&shm.timer, interval_ms / 1000,
+				    (interval_ms % 1000) * 1000);
+	}
+
+	return 0;
+
+err_unlink:
+	close(fd);
+	shm_unlink(shm.name);
+	return rc;
+}
+
+/*! \brief Stop the export and remove the segment */
+void osmo_stats_shm_exit(void)
+{
+	if (!shm.hdr)
+		return;
+
+	osmo_timer_del(&shm.timer);
+	munmap(shm.hdr, shm.size);
+	shm_unlink(shm.name);
+	talloc_free(shm.owner);
+	memset(&shm, 0, sizeof(shm));
+}
+
+/*! \brief Map the segment of another process for reading
+ *  \param[in] name Name the writer passed to osmo_stats_shm_init()
+ *  \returns header of the segment; NULL in case of error
+ */
+const struct osmo_stats_shm_hdr *osmo_stats_shm_open(const char *name)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	char path[NAME_MAX];
+	struct stat st;
+	int fd;
+
+	shm_name(path, sizeof(path), name);
+	fd = shm_open(path, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED)
+		return NULL;
+
+	if (hdr->magic != OSMO_STATS_SHM_MAGIC ||
+	    hdr->version != OSMO_STATS_SHM_VERSION ||
+	    hdr->slot_size != sizeof(struct osmo_stats_shm_slot) ||
+	    seg_size(hdr->num_slots) > st.st_size) {
+		munmap((void *) hdr, st.st_size);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return hdr;
+}
+
+/*! \brief Unmap a segment mapped by osmo_stats_shm_open() */
+void osmo_stats_shm_close(const struct osmo_stats_shm_hdr *hdr)
+{
+	munmap((void *) hdr, seg_size(hdr->num_slots));
+}
+
+/*! \brief Take a consistent copy of the slots of a segment
+ *  \param[in] hdr Segment mapped by osmo_stats_shm_open()
+ *  \param[out] slots Buffer for the copy
+ *  \param[in] num_slots Size of the buffer in slots
+ *  \returns number of slots copied; negative in case of error
+ *
+ * Free slots are copied as well, check the type of each slot. The copy
+ * is retried while the writer changes the segment, the writer never
+ * waits for a reader.
+ */
+int osmo_stats_shm_snapshot(const struct osmo_stats_shm_hdr *hdr,
+			    struct osmo_stats_shm_slot *slots,
+			    unsigned int num_slots)
+{
+	unsigned int retries, used;
+	uint32_t seq;
+
+	for (retries = 0; retries < SNAPSHOT_RETRIES; retries++) {
+		seq = hdr->seq;
+		if (seq & 1) {
+			usleep(10);
+			continue;
+		}
+		__sync_synchronize();
+		used = OSMO_MIN(hdr->used_slots, num_slots);
+		if (used > hdr->num_slots)
+			used = hdr->num_slots;
+		memcpy(slots, hdr->slot, used * sizeof(*slots));
+		__sync_synchronize();
+		if (hdr->seq == seq)
+			return used;
+	}
+	return -EAGAIN;
+}
+
+#else /* !HAVE_SHM_OPEN */
+
+int osmo_stats_shm_add_ctrg(struct rate_ctr_group *ctrg)
+{
+	return 0;
+}
+
+void osmo_stats_shm_del_ctrg(struct rate_ctr_group *ctrg)
+{
+}
+
+int osmo_stats_shm_add_counter(struct osmo_counter *ctr)
+{
+	return 0;
+}
+
+void osmo_stats_shm_del_counter(struct osmo_counter *ctr)
+{
+}
+
+void osmo_stats_shm_update(void)
+{
+}
+
+int osmo_stats_shm_init(const char *name, unsigned int num_slots,
+			unsigned int interval_ms)
+{
+	return -ENOTSUP;
+}
+
+void osmo_stats_shm_exit(void)
+{
+}
+
+const struct osmo_stats_shm_hdr *osmo_stats_shm_open(const char *name)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+void osmo_stats_shm_close(const struct osmo_stats_shm_hdr *hdr)
+{
+}
+
+int osmo_stats_shm_snapshot(const struct osmo_stats_shm_hdr *hdr,
+			    struct osmo_stats_shm_slot *slots,
+			    unsigned int num_slots)
+{
+	return -ENOTSUP;
+}
+
+#endif /* HAVE_SHM_OPEN */
+
+/*! @} */
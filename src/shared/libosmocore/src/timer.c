@@ -37,12 +37,281 @@ static struct timeval *nearest_p;
 #include <assert.h>
 #include <string.h>
 #include <limits.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/timer_compat.h>
 #include <osmocom/core/linuxlist.h>
 
+#include "../config.h"
+
 static struct rb_root timer_root = RB_ROOT;
 
+static enum osmo_timer_engine engine = OSMO_TIMER_ENGINE_RBTREE;
+
+#ifdef HAVE_CLOCK_GETTIME
+
+/*
+ * Hierarchical timing wheel
+ *
+ * Time is counted in ticks of WHEEL_TICK_US on CLOCK_MONOTONIC.  Each
+ * level has WHEEL_SLOTS slots, a slot on level n covers
+ * WHEEL_SLOTS^n ticks.  Timers are hashed into the lowest level that
+ * can hold them; whenever the index of a level wraps, the current slot
+ * of the next level is cascaded down.  Timers further away than the
+ * top level can hold are re-hashed into the top level on every cascade
+ * until they come into range, so they never fire early.
+ */
+#define WHEEL_TICK_US	1000
+#define WHEEL_BITS	6
+#define WHEEL_SLOTS	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS	6
+#define WHEEL_MAX_TICKS	((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+static struct llist_head wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+/* bit set for every slot that may be non-empty, cleared lazily */
+static uint64_t wheel_map[WHEEL_LEVELS];
+/* next tick to be processed */
+static uint64_t wheel_base;
+static unsigned int wheel_count;
+
+static void wheel_gettime(struct timeval *tv)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	tv->tv_sec = ts.tv_sec;
+	tv->tv_usec = ts.tv_nsec / 1000;
+}
+
+/* expiration tick of a timer, rounded up so it never fires early */
+static uint64_t tv2tick_up(const struct timeval *tv)
+{
+	return ((uint64_t)tv->tv_sec * 1000000 + tv->tv_usec
+		+ WHEEL_TICK_US - 1) / WHEEL_TICK_US;
+}
+
+static uint64_t tv2tick(const struct timeval *tv)
+{
+	return ((uint64_t)tv->tv_sec * 1000000 + tv->tv_usec) / WHEEL_TICK_US;
+}
+
+/* (re-)start the empty wheel at the current time */
+static void wheel_init(void)
+{
+	static int initialized = 0;
+	struct timeval now;
+	int i, j;
+
+	if (!initialized) {
+		for (i = 0; i < WHEEL_LEVELS; i++) {
+			for (j = 0; j < WHEEL_SLOTS; j++)
+				INIT_LLIST_HEAD(&wheel[i][j]);
+		}
+		initialized = 1;
+	}
+	for (i = 0; i < WHEEL_LEVELS; i++)
+		wheel_map[i] = 0;
+	wheel_gettime(&now);
+	wheel_base = tv2tick(&now);
+}
+
+static void wheel_hash(struct osmo_timer_list *timer)
+{
+	uint64_t expires = tv2tick_up(&timer->timeout);
+	uint64_t delta;
+	int level, slot;
+
+	if (expires < wheel_base)
+		expires = wheel_base;
+	delta = expires - wheel_base;
+	if (delta > WHEEL_MAX_TICKS) {
+		delta = WHEEL_MAX_TICKS;
+		expires = wheel_base + delta;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (delta < (1ULL << (WHEEL_BITS * (level + 1))))
+			break;
+	}
+	slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+	llist_add_tail(&timer->list, &wheel[level][slot]);
+	wheel_map[level] |= 1ULL << slot;
+}
+
+static void wheel_cascade(int level, int slot)
+{
+	struct osmo_timer_list *this, *tmp;
+	LLIST_HEAD(cascade);
+
+	llist_splice_init(&wheel[level][slot], &cascade);
+	wheel_map[level] &= ~(1ULL << slot);
+
+	llist_for_each_entry_safe(this, tmp, &cascade, list)
+		wheel_hash(this);
+}
+
+/* distance from slot \a from to the next possibly non-empty slot */
+static int wheel_next_slot(uint64_t map, int from)
+{
+	if (from)
+		map = (map >> from) | (map << (WHEEL_SLOTS - from));
+	if (!map)
+		return -1;
+	return __builtin_ctzll(map);
+}
+
+/* earliest tick at which the wheel has something to do */
+static uint64_t wheel_next_event(void)
+{
+	uint64_t next = UINT64_MAX, start, t;
+	int level, shift, d;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		shift = WHEEL_BITS * level;
+		/* an unaligned base has already cascaded the current slot */
+		start = wheel_base >> shift;
+		if (wheel_base & ((1ULL << shift) - 1))
+			start++;
+		d = wheel_next_slot(wheel_map[level], start & WHEEL_MASK);
+		if (d < 0)
+			continue;
+		t = (start + d) << shift;
+		if (t < next)
+			next = t;
+	}
+	return next;
+}
+
+static void wheel_add(struct osmo_timer_list *timer)
+{
+	if (!wheel_count)
+		wheel_init();
+	wheel_count++;
+	wheel_hash(timer);
+}
+
+static void wheel_del(struct osmo_timer_list *timer)
+{
+	llist_del_init(&timer->list);
+	wheel_count--;
+}
+
+static void wheel_prepare(struct timeval *current)
+{
+	struct timeval cand;
+	uint64_t next, usec;
+
+	if (!wheel_count) {
+		nearest_p = NULL;
+		return;
+	}
+
+	next = wheel_next_event();
+	usec = next * WHEEL_TICK_US;
+	cand.tv_sec = usec / 1000000;
+	cand.tv_usec = usec % 1000000;
+	if (timercmp(&cand, current, >))
+		timersub(&cand, current, &nearest);
+	else {
+		nearest.tv_sec = 0;
+		nearest.tv_usec = 0;
+	}
+	nearest_p = &nearest;
+}
+
+/* move all timers that expired up to \a now to \a expired */
+static void wheel_run(uint64_t now, struct llist_head *expired)
+{
+	int idx, level, slot;
+
+	while (wheel_count && wheel_base <= now) {
+		idx = wheel_base & WHEEL_MASK;
+
+		if (!idx) {
+			for (level = 1; level < WHEEL_LEVELS; level++) {
+				slot = (wheel_base >> (WHEEL_BITS * level))
+					& WHEEL_MASK;
+				wheel_cascade(level, slot);
+				if (slot)
+					break;
+			}
+		}
+
+		/* nothing left in this round of level 0, skip ahead to
+		 * the next cascade or to the current time */
+		if (!(wheel_map[0] >> idx)) {
+			wheel_base = (wheel_base | WHEEL_MASK) + 1;
+			if (wheel_base > now + 1)
+				wheel_base = now + 1;
+			continue;
+		}
+
+		if (wheel_map[0] & (1ULL << idx)) {
+			llist_splice_init(&wheel[0][idx], expired);
+			wheel_map[0] &= ~(1ULL << idx);
+		}
+		wheel_base++;
+	}
+
+	/* keep the wheel in sync with the clock while it is empty */
+	if (!wheel_count)
+		wheel_base = now + 1;
+}
+
+#endif /* HAVE_CLOCK_GETTIME */
+
+/* current time on the clock of the active engine */
+static void osmo_timer_gettime(struct timeval *tv)
+{
+#ifdef HAVE_CLOCK_GETTIME
+	if (engine == OSMO_TIMER_ENGINE_WHEEL) {
+		wheel_gettime(tv);
+		return;
+	}
+#endif
+	gettimeofday(tv, NULL);
+}
+
+/*! \brief select the engine used for timer management
+ *  \param[in] new_engine the timer engine to be used
+ *  \returns 0 on success, negative in case of error
+ *
+ * The engine can only be changed while no timer is pending.  The wheel
+ * engine uses CLOCK_MONOTONIC, so \ref osmo_timer_list.timeout is then
+ * relative to that clock rather than to gettimeofday().
+ */
+int osmo_timers_set_engine(enum osmo_timer_engine new_engine)
+{
+	switch (new_engine) {
+	case OSMO_TIMER_ENGINE_RBTREE:
+		break;
+	case OSMO_TIMER_ENGINE_WHEEL:
+#ifdef HAVE_CLOCK_GETTIME
+		break;
+#else
+		return -ENOTSUP;
+#endif
+	default:
+		return -EINVAL;
+	}
+
+	if (osmo_timers_check())
+		return -EBUSY;
+
+	engine = new_engine;
+	return 0;
+}
+
+/*! \brief get the engine currently used for timer management */
+enum osmo_timer_engine osmo_timers_get_engine(void)
+{
+	return engine;
+}
+
 static void __add_timer(struct osmo_timer_list *timer)
 {
 	struct rb_node **new = &(timer_root.rb_node);
@@ -72,6 +341,12 @@ void osmo_timer_add(struct osmo_timer_list *timer)
 	osmo_timer_del(timer);
 	timer->active = 1;
 	INIT_LLIST_HEAD(&timer->list);
+#ifdef HAVE_CLOCK_GETTIME
+	if (engine == OSMO_TIMER_ENGINE_WHEEL) {
+		wheel_add(timer);
+		return;
+	}
+#endif
 	__add_timer(timer);
 }
 
@@ -90,7 +365,7 @@ osmo_timer_schedule(struct osmo_timer_list *timer, int seconds, int microseconds
 {
 	struct timeval current_time;
 
-	gettimeofday(&current_time, NULL);
+	osmo_timer_gettime(&current_time);
 	timer->timeout.tv_sec = seconds;
 	timer->timeout.tv_usec = microseconds;
 	timeradd(&timer->timeout, &current_time, &timer->timeout);
@@ -107,6 +382,12 @@ void osmo_timer_del(struct osmo_timer_list *timer)
 {
 	if (timer->active) {
 		timer->active = 0;
+#ifdef HAVE_CLOCK_GETTIME
+		if (engine == OSMO_TIMER_ENGINE_WHEEL) {
+			wheel_del(timer);
+			return;
+		}
+#endif
 		rb_erase(&timer->node, &timer_root);
 		/* make sure this is not already scheduled for removal. */
 		if (!llist_empty(&timer->list))
@@ -142,11 +423,11 @@ int osmo_timer_remaining(const struct osmo_timer_list *timer,
 	struct timeval current_time;
 
 	if (!now) {
-		gettimeofday(&current_time, NULL);
+		osmo_timer_gettime(&current_time);
 		now = &current_time;
 	}
 
-	timersub(&timer->timeout, &current_time, remaining);
+	timersub(&timer->timeout, now, remaining);
 
 	if (remaining->tv_sec < 0)
 		return -1;
@@ -192,7 +473,14 @@ void osmo_timers_prepare(void)
 	struct rb_node *node;
 	struct timeval current;
 
-	gettimeofday(&current, NULL);
+	osmo_timer_gettime(&current);
+
+#ifdef HAVE_CLOCK_GETTIME
+	if (engine == OSMO_TIMER_ENGINE_WHEEL) {
+		wheel_prepare(&current);
+		return;
+	}
+#endif
 
 	node = rb_first(&timer_root);
 	if (node) {
@@ -215,9 +503,17 @@ int osmo_timers_update(void)
 	struct osmo_timer_list *this;
 	int work = 0;
 
-	gettimeofday(&current_time, NULL);
+	osmo_timer_gettime(&current_time);
 
 	INIT_LLIST_HEAD(&timer_eviction_list);
+#ifdef HAVE_CLOCK_GETTIME
+	if (engine == OSMO_TIMER_ENGINE_WHEEL) {
+		/* the wheel links expired timers through their list
+		 * member, osmo_timer_del() unlinks them from here */
+		wheel_run(tv2tick(&current_time), &timer_eviction_list);
+		goto restart;
+	}
+#endif
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		this = container_of(node, struct osmo_timer_list, node);
 
@@ -255,6 +551,11 @@ int osmo_timers_check(void)
 	struct rb_node *node;
 	int i = 0;
 
+#ifdef HAVE_CLOCK_GETTIME
+	if (engine == OSMO_TIMER_ENGINE_WHEEL)
+		return wheel_count;
+#endif
+
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		i++;
 	}
@@ -149,6 +149,37 @@ DEFUN(logging_prnt_timestamp,
 	return CMD_SUCCESS;
 }
 
+static const struct value_string log_async_names[] = {
+	{ LOG_ASYNC_OFF,	"off" },
+	{ LOG_ASYNC_DROP,	"drop" },
+	{ LOG_ASYNC_BLOCK,	"block" },
+	{ 0, NULL }
+};
+
+DEFUN(logging_async,
+      logging_async_cmd,
+      "logging async (off|drop|block)",
+	LOGGING_STR "Configure writing log messages from a separate thread\n"
+	"Write each log message immediately\n"
+	"Queue log messages, drop them if the writer falls behind\n"
+	"Queue log messages, wait if the writer falls behind\n")
+{
+	struct log_target *tgt = osmo_log_vty2tgt(vty);
+	int rc;
+
+	if (!tgt)
+		return CMD_WARNING;
+
+	rc = log_target_set_async(tgt,
+			get_string_value(log_async_names, argv[0]));
+	if (rc < 0) {
+		vty_out(vty, "%% Unable to set async mode: %s%s",
+			strerror(-rc), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	return CMD_SUCCESS;
+}
+
 DEFUN(logging_level,
       logging_level_cmd,
       NULL, /* cmdstr is dynamically set in logging_vty_add_cmds(). */
@@ -177,8 +208,7 @@ DEFUN(logging_level,
 		return CMD_WARNING;
 	}
 
-	tgt->categories[category].enabled = 1;
-	tgt->categories[category].loglevel = level;
+	log_set_category_filter(tgt, category, 1, level);
 
 	return CMD_SUCCESS;
 }
@@ -267,6 +297,46 @@ DEFUN(show_logging_vty,
 	return CMD_SUCCESS;
 }
 
+static const char *log_target_name(const struct log_target *tgt)
+{
+	switch (tgt->type) {
+	case LOG_TGT_TYPE_VTY:
+		return "vty";
+	case LOG_TGT_TYPE_SYSLOG:
+		return "syslog";
+	case LOG_TGT_TYPE_FILE:
+		return tgt->tgt_file.fname;
+	case LOG_TGT_TYPE_STDERR:
+		return "stderr";
+	}
+	return "unknown";
+}
+
+DEFUN(show_logging_async,
+      show_logging_async_cmd,
+      "show logging async",
+	SHOW_STR SHOW_LOG_STR
+	"Show the writer thread state of all log targets\n")
+{
+	struct log_target *tgt;
+
+	llist_for_each_entry(tgt, &osmo_log_target_list, entry) {
+		enum log_async_policy policy;
+		unsigned long dropped;
+
+		if (tgt->type == LOG_TGT_TYPE_VTY)
+			continue;
+
+		policy = log_target_get_async(tgt, &dropped);
+		vty_out(vty, " %-20s Async: %-5s Dropped: %lu%s",
+			log_target_name(tgt),
+			get_value_string(log_async_names, policy),
+			dropped, VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
 gDEFUN(cfg_description, cfg_description_cmd,
 	"description .TEXT",
 	"Save human-readable decription of the object\n"
@@ -512,6 +582,7 @@ DEFUN(cfg_no_log_file, cfg_no_log_file_cmd,
 
 static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 {
+	enum log_async_policy policy;
 	int i;
 	char level_lower[32];
 
@@ -543,6 +614,10 @@ static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 		VTY_NEWLINE);
 	vty_out(vty, "  logging timestamp %u%s", tgt->print_timestamp ? 1 : 0,
 		VTY_NEWLINE);
+	policy = log_target_get_async(tgt, NULL);
+	if (policy != LOG_ASYNC_OFF)
+		vty_out(vty, "  logging async %s%s",
+			get_value_string(log_async_names, policy), VTY_NEWLINE);
 
 	/* stupid old osmo logging API uses uppercase strings... */
 	osmo_str2lower(level_lower, log_level_str(tgt->loglevel));
@@ -590,6 +665,7 @@ void logging_vty_add_cmds(const struct log_info *cat)
 	logging_level_cmd.doc = log_vty_command_description(cat);
 	install_element_ve(&logging_level_cmd);
 	install_element_ve(&show_logging_vty_cmd);
+	install_element_ve(&show_logging_async_cmd);
 
 	install_node(&cfg_log_node, config_write_log);
 	install_default(CFG_LOG_NODE);
@@ -598,6 +674,7 @@ void logging_vty_add_cmds(const struct log_info *cat)
 	install_element(CFG_LOG_NODE, &logging_use_clr_cmd);
 	install_element(CFG_LOG_NODE, &logging_prnt_timestamp_cmd);
 	install_element(CFG_LOG_NODE, &logging_level_cmd);
+	install_element(CFG_LOG_NODE, &logging_async_cmd);
 
 	install_element(CONFIG_NODE, &cfg_log_stderr_cmd);
 	install_element(CONFIG_NODE, &cfg_no_log_stderr_cmd);
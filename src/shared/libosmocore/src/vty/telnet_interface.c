@@ -95,8 +95,8 @@ int telnet_close_client(struct osmo_fd *fd)
 {
 	struct telnet_connection *conn = (struct telnet_connection*)fd->data;
 
-	close(fd->fd);
 	osmo_fd_unregister(fd);
+	close(fd->fd);
 
 	if (conn->dbg) {
 		log_del_target(conn->dbg);
@@ -114,7 +114,7 @@ static int client_data(struct osmo_fd *fd, unsigned int what)
 	int rc = 0;
 
 	if (what & BSC_FD_READ) {
-		conn->fd.when &= ~BSC_FD_READ;
+		osmo_fd_update_when(&conn->fd, conn->fd.when & ~BSC_FD_READ);
 		rc = vty_read(conn->vty);
 	}
 
@@ -125,7 +125,8 @@ static int client_data(struct osmo_fd *fd, unsigned int what)
 	if (what & BSC_FD_WRITE) {
 		rc = buffer_flush_all(conn->vty->obuf, fd->fd);
 		if (rc == BUFFER_EMPTY)
-			conn->fd.when &= ~BSC_FD_WRITE;
+			osmo_fd_update_when(&conn->fd,
+					    conn->fd.when & ~BSC_FD_WRITE);
 	}
 
 	return rc;
@@ -174,10 +175,10 @@ void vty_event(enum event event, int sock, struct vty *vty)
 
 	switch (event) {
 	case VTY_READ:
-		bfd->when |= BSC_FD_READ;
+		osmo_fd_update_when(bfd, bfd->when | BSC_FD_READ);
 		break;
 	case VTY_WRITE:
-		bfd->when |= BSC_FD_WRITE;
+		osmo_fd_update_when(bfd, bfd->when | BSC_FD_WRITE);
 		break;
 	case VTY_CLOSED:
 		/* vty layer is about to free() vty */
@@ -49,6 +49,8 @@ void vty_out_rate_ctr_group(struct vty *vty, const char *prefix,
 {
 	unsigned int i;
 
+	rate_ctr_group_upd_intv(ctrg);
+
 	vty_out(vty, "%s%s:%s", prefix, ctrg->desc->group_description, VTY_NEWLINE);
 	for (i = 0; i < ctrg->desc->num_ctr; i++) {
 		struct rate_ctr *ctr = &ctrg->ctr[i];
@@ -51,7 +51,7 @@ int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what)
 	if (what & BSC_FD_WRITE) {
 		struct msgb *msg;
 
-		fd->when &= ~BSC_FD_WRITE;
+		osmo_fd_update_when(fd, fd->when & ~BSC_FD_WRITE);
 
 		/* the queue might have been emptied */
 		if (!llist_empty(&queue->msg_queue)) {
@@ -62,7 +62,7 @@ int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what)
 			msgb_free(msg);
 
 			if (!llist_empty(&queue->msg_queue))
-				fd->when |= BSC_FD_WRITE;
+				osmo_fd_update_when(fd, fd->when | BSC_FD_WRITE);
 		}
 	}
 
@@ -94,7 +94,7 @@ int osmo_wqueue_enqueue(struct osmo_wqueue *queue, struct msgb *data)
 
 	++queue->current_length;
 	msgb_enqueue(&queue->msg_queue, data);
-	queue->bfd.when |= BSC_FD_WRITE;
+	osmo_fd_update_when(&queue->bfd, queue->bfd.when | BSC_FD_WRITE);
 
 	return 0;
 }
@@ -112,7 +112,7 @@ void osmo_wqueue_clear(struct osmo_wqueue *queue)
 	}
 
 	queue->current_length = 0;
-	queue->bfd.when &= ~BSC_FD_WRITE;
+	osmo_fd_update_when(&queue->bfd, queue->bfd.when & ~BSC_FD_WRITE);
 }
 
 /*! @} */
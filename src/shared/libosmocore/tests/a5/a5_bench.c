@@ -0,0 +1,89 @@
+/*
+ * Keystream throughput of A5/1 and A5/2, per frame and batched
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/gsm/a5.h>
+
+#define NUM_FRAMES	51200
+#define BATCH		1024
+
+static const uint8_t key[] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
+
+static pbit_t dl[BATCH * OSMO_A5_PBIT_LEN], ul[BATCH * OSMO_A5_PBIT_LEN];
+static uint8_t keys[BATCH * 8];
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(int n, const char *what, double t)
+{
+	/* 114 bits each for DL and UL */
+	printf("A5/%d %-10s %10.0f frames/s  %8.2f Mbit/s keystream\n",
+		n, what, NUM_FRAMES / t, NUM_FRAMES * 228 / t / 1e6);
+}
+
+static void run(int n)
+{
+	ubit_t udl[114], uul[114];
+	double start;
+	int i;
+
+	start = now_sec();
+	for (i = 0; i < NUM_FRAMES; i++) {
+		osmo_a5(n, key, i, udl, uul);
+		osmo_ubit2pbit(dl, udl, 114);
+		osmo_ubit2pbit(ul, uul, 114);
+	}
+	report(n, "osmo_a5", now_sec() - start);
+
+	start = now_sec();
+	for (i = 0; i < NUM_FRAMES; i += BATCH)
+		osmo_a5_batch_fn(n, key, i, BATCH, dl, ul);
+	report(n, "batch fn", now_sec() - start);
+
+	start = now_sec();
+	for (i = 0; i < NUM_FRAMES; i += BATCH)
+		osmo_a5_batch_keys(n, keys, i, BATCH, dl, ul);
+	report(n, "batch keys", now_sec() - start);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	srandom(42);
+	for (i = 0; i < sizeof(keys); i++)
+		keys[i] = random();
+
+	printf("%u lanes\n", osmo_a5_batch_lanes());
+	run(1);
+	run(2);
+
+	return EXIT_SUCCESS;
+}
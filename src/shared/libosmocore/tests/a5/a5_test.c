@@ -6,6 +6,10 @@
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/gsm/a5.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+/* more than one batch of lanes, crossing the hyperframe boundary */
+#define BATCH_NUM	300
 
 static const uint8_t key[] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
 static const uint32_t fn = 123456;
@@ -50,6 +54,66 @@ binstr(ubit_t *d, int n)
 	return str;
 }
 
+/* compare one batch keystream against the unpacked reference */
+static int
+check_batch(int n, const uint8_t *k, uint32_t f, const pbit_t *pdl,
+	    const pbit_t *pul)
+{
+	ubit_t rdl[114], rul[114];
+	pbit_t edl[OSMO_A5_PBIT_LEN], eul[OSMO_A5_PBIT_LEN];
+
+	osmo_a5(n, k, f, rdl, rul);
+	osmo_ubit2pbit(edl, rdl, 114);
+	osmo_ubit2pbit(eul, rul, 114);
+
+	return memcmp(edl, pdl, OSMO_A5_PBIT_LEN) ||
+	       memcmp(eul, pul, OSMO_A5_PBIT_LEN);
+}
+
+static void
+test_batch(int n)
+{
+	static pbit_t pdl[BATCH_NUM * OSMO_A5_PBIT_LEN];
+	static pbit_t pul[BATCH_NUM * OSMO_A5_PBIT_LEN];
+	uint8_t keys[BATCH_NUM * 8];
+	uint32_t f0 = GSM_MAX_FN - 100, f;
+	int i;
+
+	/* consecutive frame numbers, one key */
+	memset(pdl, 0xaa, sizeof(pdl));
+	memset(pul, 0xaa, sizeof(pul));
+	osmo_a5_batch_fn(n, key, f0, BATCH_NUM, pdl, pul);
+
+	for (i = 0; i < BATCH_NUM; i++) {
+		f = (f0 + i) % GSM_MAX_FN;
+		if (check_batch(n, key, f, &pdl[i * OSMO_A5_PBIT_LEN],
+				&pul[i * OSMO_A5_PBIT_LEN])) {
+			printf("A5/%d - batch fn: BAD at fn=%u\n", n, f);
+			fprintf(stderr, "[!] A5/%d batch fn failed", n);
+			exit(1);
+		}
+	}
+	printf("A5/%d - batch fn: OK\n", n);
+
+	/* many keys, one frame number */
+	for (i = 0; i < sizeof(keys); i++)
+		keys[i] = (i * 167 + 13) ^ (i >> 3);
+	memset(pdl, 0xaa, sizeof(pdl));
+	memset(pul, 0xaa, sizeof(pul));
+	osmo_a5_batch_keys(n, keys, fn, BATCH_NUM, pdl, pul);
+
+	for (i = 0; i < BATCH_NUM; i++) {
+		if (check_batch(n, &keys[i * 8], fn,
+				&pdl[i * OSMO_A5_PBIT_LEN],
+				&pul[i * OSMO_A5_PBIT_LEN])) {
+			printf("A5/%d - batch keys: BAD at key %d\n", n, i);
+			fprintf(stderr, "[!] A5/%d batch keys failed", n);
+			exit(1);
+		}
+	}
+	printf("A5/%d - batch keys: OK\n", n);
+}
+
 int main(int argc, char **argv)
 {
 	ubit_t exp[114];
@@ -94,5 +158,8 @@ int main(int argc, char **argv)
 		}
 	}
 
+	for (n=0; n<3; n++)
+		test_batch(n);
+
 	return 0;
 }
@@ -0,0 +1,141 @@
+/*
+ * Throughput of the bit packing and unpacking functions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+
+#define MAX_BITS	10000
+/* bits converted per measurement */
+#define TOTAL_BITS	200000000
+
+static ubit_t ubits[MAX_BITS];
+static pbit_t pbits[MAX_BITS / 8 + 1];
+static sbit_t sbits[MAX_BITS];
+
+/* the bit at a time loop the library used before, for comparison */
+static int ref_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
+{
+	unsigned int i;
+	uint8_t curbyte = 0;
+	pbit_t *outptr = out;
+
+	for (i = 0; i < num_bits; i++) {
+		uint8_t bitnum = 7 - (i % 8);
+
+		curbyte |= (in[i] << bitnum);
+
+		if (i % 8 == 7) {
+			*outptr++ = curbyte;
+			curbyte = 0;
+		}
+	}
+	if (i % 8)
+		*outptr++ = curbyte;
+
+	return outptr - out;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+enum op {
+	OP_REF_U2P,
+	OP_U2P,
+	OP_P2U,
+	OP_U2P_EXT,
+	OP_P2U_EXT,
+	OP_S2P,
+	OP_P2S,
+};
+
+static const char *op_names[] = {
+	[OP_REF_U2P]	= "ubit2pbit (bitwise)",
+	[OP_U2P]	= "ubit2pbit",
+	[OP_P2U]	= "pbit2ubit",
+	[OP_U2P_EXT]	= "ubit2pbit_ext ofs 3",
+	[OP_P2U_EXT]	= "pbit2ubit_ext ofs 3",
+	[OP_S2P]	= "sbit2pbit",
+	[OP_P2S]	= "pbit2sbit",
+};
+
+static void run(enum op op, unsigned int n)
+{
+	unsigned int i, iter = TOTAL_BITS / n;
+	double start, t;
+
+	start = now_sec();
+	for (i = 0; i < iter; i++) {
+		switch (op) {
+		case OP_REF_U2P:
+			ref_ubit2pbit(pbits, ubits, n);
+			break;
+		case OP_U2P:
+			osmo_ubit2pbit(pbits, ubits, n);
+			break;
+		case OP_P2U:
+			osmo_pbit2ubit(ubits, pbits, n);
+			break;
+		case OP_U2P_EXT:
+			osmo_ubit2pbit_ext(pbits, 3, ubits, 0, n - 3, 0);
+			break;
+		case OP_P2U_EXT:
+			osmo_pbit2ubit_ext(ubits, 0, pbits, 3, n - 3, 0);
+			break;
+		case OP_S2P:
+			osmo_sbit2pbit(pbits, sbits, n);
+			break;
+		case OP_P2S:
+			osmo_pbit2sbit(sbits, pbits, n);
+			break;
+		}
+		/* keep the compiler from hoisting the call */
+		__asm__ __volatile__("" ::: "memory");
+	}
+	t = now_sec() - start;
+
+	printf("%-20s %5u bits: %9.1f Mbit/s\n", op_names[op], n,
+		(double) iter * n / t / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned int sizes[] = { 114, 456, MAX_BITS };
+	int i, op;
+
+	srandom(42);
+	for (i = 0; i < MAX_BITS; i++) {
+		ubits[i] = random() & 1;
+		sbits[i] = ubits[i] ? -127 : 127;
+	}
+
+	for (op = 0; op <= OP_P2S; op++)
+		for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+			run(op, sizes[i]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bits.h>
+
+#define MAX_BITS	300
+#define MAX_OFS		17
+
+/* bit at a time reference implementations */
+
+static void ref_ubit2pbit_ext(pbit_t *out, unsigned int out_ofs,
+			      const ubit_t *in, unsigned int in_ofs,
+			      unsigned int num_bits, int lsb_mode)
+{
+	int i, op, bn;
+
+	for (i = 0; i < num_bits; i++) {
+		op = out_ofs + i;
+		bn = lsb_mode ? (op & 7) : (7 - (op & 7));
+		if (in[in_ofs + i])
+			out[op >> 3] |= 1 << bn;
+		else
+			out[op >> 3] &= ~(1 << bn);
+	}
+}
+
+static void ref_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
+			      const pbit_t *in, unsigned int in_ofs,
+			      unsigned int num_bits, int lsb_mode)
+{
+	int i, ip, bn;
+
+	for (i = 0; i < num_bits; i++) {
+		ip = in_ofs + i;
+		bn = lsb_mode ? (ip & 7) : (7 - (ip & 7));
+		out[out_ofs + i] = !!(in[ip >> 3] & (1 << bn));
+	}
+}
+
+static uint8_t pbits[MAX_BITS / 8 + 8], pref[MAX_BITS / 8 + 8];
+static ubit_t ubits[MAX_BITS + MAX_OFS], uref[MAX_BITS + MAX_OFS];
+static sbit_t sbits[MAX_BITS], sref[MAX_BITS];
+
+static void fail(const char *what, unsigned int n, unsigned int ofs, int lsb)
+{
+	printf("%s: mismatch for %u bits, offset %u, lsb_mode %d\n",
+		what, n, ofs, lsb);
+	fprintf(stderr, "%s failed\n", what);
+	exit(1);
+}
+
+static void random_ubits(ubit_t *u, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		u[i] = random() & 1;
+}
+
+/* unpacked bits that are 0 or any other value, taken as a 1 */
+static void random_ubit_values(ubit_t *u, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		u[i] = random() & 1 ? random() % 255 + 1 : 0;
+}
+
+static void random_pbits(pbit_t *p, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		p[i] = random();
+}
+
+/* every byte value, in every position of a 16 and 32 byte vector */
+static void test_bytes(void)
+{
+	ubit_t u[256 * 8];
+	pbit_t p[256], back[256];
+	int i, j;
+
+	for (i = 0; i < 256; i++)
+		p[i] = i;
+	osmo_pbit2ubit(u, p, sizeof(u));
+	for (i = 0; i < 256; i++) {
+		for (j = 0; j < 8; j++) {
+			if (u[i * 8 + j] != ((i >> (7 - j)) & 1))
+				fail("pbit2ubit bytes", 8 * 256, i, 0);
+		}
+	}
+	osmo_ubit2pbit(back, u, sizeof(u));
+	if (memcmp(back, p, sizeof(p)))
+		fail("ubit2pbit bytes", 8 * 256, 0, 0);
+
+	printf("all byte values: OK\n");
+}
+
+static void test_unpack_pack(void)
+{
+	unsigned int n;
+	int rc;
+
+	for (n = 0; n <= MAX_BITS; n++) {
+		random_ubits(uref, n);
+		memset(pref, 0, sizeof(pref));
+		ref_ubit2pbit_ext(pref, 0, uref, 0, n, 0);
+		memset(pbits, 0, sizeof(pbits));
+		rc = osmo_ubit2pbit(pbits, uref, n);
+		if (rc != osmo_pbit_bytesize(n) || memcmp(pbits, pref, sizeof(pref)))
+			fail("ubit2pbit", n, 0, 0);
+
+		random_pbits(pref, sizeof(pref));
+		ref_pbit2ubit_ext(uref, 0, pref, 0, n, 0);
+		memset(ubits, 0xaa, sizeof(ubits));
+		rc = osmo_pbit2ubit(ubits, pref, n);
+		if (rc != n || memcmp(ubits, uref, n) || ubits[n] != 0xaa)
+			fail("pbit2ubit", n, 0, 0);
+	}
+
+	printf("ubit2pbit / pbit2ubit: OK\n");
+}
+
+static void test_ext(void)
+{
+	unsigned int n, ofs;
+	int lsb, rc;
+
+	for (lsb = 0; lsb < 2; lsb++) {
+		for (ofs = 0; ofs < MAX_OFS; ofs++) {
+			for (n = 1; n <= MAX_BITS; n++) {
+				/* packed output offset, surrounding bits kept */
+				random_ubits(uref, n + ofs);
+				random_pbits(pref, sizeof(pref));
+				memcpy(pbits, pref, sizeof(pbits));
+				ref_ubit2pbit_ext(pref, ofs, uref, 3, n, lsb);
+				rc = osmo_ubit2pbit_ext(pbits, ofs, uref, 3, n, lsb);
+				if (rc != ((ofs + n - 1) >> 3) + 1 ||
+				    memcmp(pbits, pref, sizeof(pref)))
+					fail("ubit2pbit_ext", n, ofs, lsb);
+
+				/* packed input offset */
+				random_pbits(pref, sizeof(pref));
+				memset(uref, 0x55, sizeof(uref));
+				memset(ubits, 0x55, sizeof(ubits));
+				ref_pbit2ubit_ext(uref, 5, pref, ofs, n, lsb);
+				rc = osmo_pbit2ubit_ext(ubits, 5, pref, ofs, n, lsb);
+				if (rc != 5 + n || memcmp(ubits, uref, sizeof(uref)))
+					fail("pbit2ubit_ext", n, ofs, lsb);
+			}
+		}
+	}
+
+	printf("ubit2pbit_ext / pbit2ubit_ext: OK\n");
+}
+
+static void test_ubit_values(void)
+{
+	unsigned int n, ofs, i;
+	int lsb, rc;
+
+	for (n = 1; n <= MAX_BITS; n++) {
+		random_ubit_values(uref, n);
+		memset(pref, 0, sizeof(pref));
+		ref_ubit2pbit_ext(pref, 0, uref, 0, n, 0);
+		memset(pbits, 0, sizeof(pbits));
+		osmo_ubit2pbit(pbits, uref, n);
+		if (memcmp(pbits, pref, sizeof(pref)))
+			fail("ubit2pbit values", n, 0, 0);
+
+		for (lsb = 0; lsb < 2; lsb++) {
+			for (ofs = 0; ofs < MAX_OFS; ofs++) {
+				random_ubit_values(uref, n + 3);
+				random_pbits(pref, sizeof(pref));
+				memcpy(pbits, pref, sizeof(pbits));
+				ref_ubit2pbit_ext(pref, ofs, uref, 3, n, lsb);
+				rc = osmo_ubit2pbit_ext(pbits, ofs, uref, 3, n,
+							lsb);
+				if (rc != ((ofs + n - 1) >> 3) + 1 ||
+				    memcmp(pbits, pref, sizeof(pref)))
+					fail("ubit2pbit_ext values", n, ofs,
+					     lsb);
+			}
+		}
+
+		random_ubit_values(uref, n);
+		for (i = 0; i < n; i++)
+			sref[i] = uref[i] ? -127 : 127;
+		osmo_ubit2sbit(sbits, uref, n);
+		if (memcmp(sbits, sref, n))
+			fail("ubit2sbit values", n, 0, 0);
+	}
+
+	printf("unpacked bits other than 0 and 1: OK\n");
+}
+
+static void test_sbits(void)
+{
+	unsigned int n, i;
+	int rc;
+
+	for (n = 0; n <= MAX_BITS; n++) {
+		random_ubits(uref, n);
+		for (i = 0; i < n; i++)
+			sref[i] = uref[i] ? -127 : 127;
+
+		rc = osmo_ubit2sbit(sbits, uref, n);
+		if (rc != n || memcmp(sbits, sref, n))
+			fail("ubit2sbit", n, 0, 0);
+
+		/* any soft value, only the sign matters */
+		for (i = 0; i < n; i++) {
+			sbits[i] = random() % 255 - 127;
+			uref[i] = sbits[i] < 0;
+		}
+		rc = osmo_sbit2ubit(ubits, sbits, n);
+		if (rc != n || memcmp(ubits, uref, n))
+			fail("sbit2ubit", n, 0, 0);
+
+		memset(pref, 0, sizeof(pref));
+		ref_ubit2pbit_ext(pref, 0, uref, 0, n, 0);
+		memset(pbits, 0, sizeof(pbits));
+		rc = osmo_sbit2pbit(pbits, sbits, n);
+		if (rc != osmo_pbit_bytesize(n) || memcmp(pbits, pref, sizeof(pref)))
+			fail("sbit2pbit", n, 0, 0);
+
+		random_pbits(pref, sizeof(pref));
+		ref_pbit2ubit_ext(uref, 0, pref, 0, n, 0);
+		for (i = 0; i < n; i++)
+			sref[i] = uref[i] ? -127 : 127;
+		rc = osmo_pbit2sbit(sbits, pref, n);
+		if (rc != n || memcmp(sbits, sref, n))
+			fail("pbit2sbit", n, 0, 0);
+	}
+
+	printf("soft bit conversions: OK\n");
+}
+
+int main(int argc, char **argv)
+{
+	srandom(1);
+
+	test_bytes();
+	test_unpack_pack();
+	test_ext();
+	test_ubit_values();
+	test_sbits();
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Viterbi decoder throughput for K=5 and K=7 codes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+
+#define MAX_LEN_BITS	1024
+#define NUM_BLOCKS	20000
+
+struct bench_code {
+	const char *name;
+	int K;
+	unsigned int poly[2];
+	int len;
+	uint8_t next_output[64][2];
+	uint8_t next_state[64][2];
+	struct osmo_conv_code code;
+};
+
+static struct bench_code codes[] = {
+	{
+		/* GSM 05.03 xCCH: G0 = 1+D3+D4, G1 = 1+D+D3+D4 */
+		.name = "K=5 GSM xCCH",
+		.K = 5,
+		.poly = { 0x19, 0x1b },
+		.len = 224,
+	}, {
+		/* 133/171 octal, as used by 802.11 and WiMax */
+		.name = "K=7 133/171",
+		.K = 7,
+		.poly = { 0x5b, 0x79 },
+		.len = 224,
+	},
+};
+
+static int parity(unsigned int v)
+{
+	int p = 0;
+
+	while (v) {
+		p ^= v & 1;
+		v >>= 1;
+	}
+	return p;
+}
+
+/* build the tables of a rate 1/2 feed-forward code */
+static void build_code(struct bench_code *bc)
+{
+	int n_states = 1 << (bc->K - 1);
+	int s, b;
+
+	for (s = 0; s < n_states; s++) {
+		for (b = 0; b < 2; b++) {
+			unsigned int reg = (s << 1) | b;
+			bc->next_output[s][b] = (parity(reg & bc->poly[0]) << 1)
+					      | parity(reg & bc->poly[1]);
+			bc->next_state[s][b] = reg & (n_states - 1);
+		}
+	}
+
+	bc->code.N = 2;
+	bc->code.K = bc->K;
+	bc->code.len = bc->len;
+	bc->code.term = CONV_TERM_FLUSH;
+	bc->code.next_output = (const uint8_t (*)[2]) bc->next_output;
+	bc->code.next_state = (const uint8_t (*)[2]) bc->next_state;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(struct bench_code *bc)
+{
+	ubit_t in[MAX_LEN_BITS], enc[MAX_LEN_BITS], out[MAX_LEN_BITS];
+	sbit_t soft[MAX_LEN_BITS];
+	double start, t;
+	int i, l, errors = 0;
+
+	build_code(bc);
+
+	for (i = 0; i < bc->len; i++)
+		in[i] = random() & 1;
+	l = osmo_conv_encode(&bc->code, in, enc);
+
+	/* moderately noisy soft bits, still decodable */
+	for (i = 0; i < l; i++) {
+		int v = (enc[i] ? -127 : 127) + (int) (random() % 161) - 80;
+		soft[i] = v > 127 ? 127 : v < -127 ? -127 : v;
+	}
+
+	start = now_sec();
+	for (i = 0; i < NUM_BLOCKS; i++)
+		osmo_conv_decode(&bc->code, soft, out);
+	t = now_sec() - start;
+
+	for (i = 0; i < bc->len; i++)
+		errors += in[i] != out[i];
+
+	printf("%-14s %8.0f blocks/s  %6.2f Mbit/s decoded  (%d bit errors)\n",
+		bc->name, NUM_BLOCKS / t, NUM_BLOCKS * bc->len / t / 1e6,
+		errors);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	srandom(42);
+
+	for (i = 0; i < sizeof(codes) / sizeof(codes[0]); i++)
+		run(&codes[i]);
+
+	return EXIT_SUCCESS;
+}
@@ -346,6 +346,28 @@ ubit_to_sbit(sbit_t *dst, ubit_t *src, int n)
 		dst[i] = src[i] ? -127 : 127;
 }
 
+/* deterministic, so the decoder results can be compared bit by bit */
+static unsigned int noise_seed;
+
+static int
+noise_rand(void)
+{
+	noise_seed = noise_seed * 1103515245 + 12345;
+	return (noise_seed >> 16) & 0x7fff;
+}
+
+static void
+add_noise(sbit_t *b, int n, int amp)
+{
+	int i;
+	for (i=0; i<n; i++) {
+		int v = b[i] + (noise_rand() % (2 * amp + 1)) - amp;
+		if (noise_rand() % 32 == 0)
+			v = 0;	/* erasure */
+		b[i] = v > 127 ? 127 : v < -127 ? -127 : v;
+	}
+}
+
 static void
 sbit_to_ubit(ubit_t *dst, sbit_t *src, int n)
 {
@@ -474,6 +496,32 @@ int main(int argc, char argv[])
 			printf("OK\n");
 		}
 
+		/* Check noisy vectors against known decoder results */
+		printf("[.] Noisy vector checks:\n");
+
+		noise_seed = 1;
+		for (i=0; i<3; i++) {
+			int j, errors = 0, sum = 0;
+
+			for (j=0; j<tst->in_len; j++)
+				bu0[j] = noise_rand() & 1;
+
+			l = osmo_conv_encode(tst->code, bu0, bu1);
+			ubit_to_sbit(bs, bu1, l);
+			add_noise(bs, l, 80 * (i + 1));
+
+			l = osmo_conv_decode(tst->code, bs, bu1);
+
+			for (j=0; j<tst->in_len; j++) {
+				errors += bu0[j] != bu1[j];
+				sum = (sum * 31 + bu1[j]) & 0xffff;
+			}
+
+			printf("[..] Noise %3d : path error = %5d, "
+				"bit errors = %2d, sum = %04x\n",
+				80 * (i + 1), l, errors, sum);
+		}
+
 		/* Spacing */
 		printf("\n");
 	}
@@ -0,0 +1,159 @@
+/*
+ * Throughput of the bitwise and table driven CRC computations
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/crcgen.h>
+#include <osmocom/core/crc16.h>
+
+#define MAX_BITS	16384
+/* bits processed per measurement */
+#define TOTAL_BITS	200000000
+
+/* GSM 05.03 xCCH FIRE code */
+static const struct osmo_crc64gen_code xcch_fire = {
+	.bits = 40,
+	.poly = 0x0004820009ULL,
+	.init = 0x0000000000ULL,
+	.remainder = 0xffffffffffULL,
+};
+
+/* GSM 05.03 PDTCH CS-2..4 */
+static const struct osmo_crc16gen_code cs_crc16 = {
+	.bits = 16,
+	.poly = 0x1021,
+	.init = 0x0,
+	.remainder = 0xffff,
+};
+
+static ubit_t ubits[MAX_BITS];
+static pbit_t pbits[MAX_BITS / 8];
+static volatile uint64_t sink;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, int len, double t, int iter)
+{
+	printf("%-26s %5d bits: %9.1f Mbit/s\n", name, len,
+		(double) iter * len / t / 1e6);
+}
+
+static void run_fire(int len)
+{
+	static struct osmo_crc64gen_table tbl;
+	int i, iter = TOTAL_BITS / len;
+	double start;
+
+	osmo_crc64gen_table_init(&tbl, &xcch_fire);
+
+	start = now_sec();
+	for (i = 0; i < iter / 16; i++)
+		sink = osmo_crc64gen_compute_bits(&xcch_fire, ubits, len);
+	report("FIRE bitwise", len, now_sec() - start, iter / 16);
+
+	start = now_sec();
+	for (i = 0; i < iter; i++)
+		sink = osmo_crc64gen_compute_pbits(&tbl, pbits, len);
+	report(tbl.clmul ? "FIRE packed (clmul)" : "FIRE packed", len,
+		now_sec() - start, iter);
+
+	tbl.clmul = 0;
+	start = now_sec();
+	for (i = 0; i < iter; i++)
+		sink = osmo_crc64gen_compute_pbits(&tbl, pbits, len);
+	report("FIRE packed (slice-by-8)", len, now_sec() - start, iter);
+
+	/* unpacked input, packed first */
+	start = now_sec();
+	for (i = 0; i < iter; i++) {
+		osmo_ubit2pbit(pbits, ubits, len);
+		sink = osmo_crc64gen_compute_pbits(&tbl, pbits, len);
+	}
+	report("FIRE ubit2pbit + packed", len, now_sec() - start, iter);
+}
+
+static void run_crc16(int len)
+{
+	static struct osmo_crc16gen_table tbl;
+	int i, iter = TOTAL_BITS / len;
+	double start;
+
+	osmo_crc16gen_table_init(&tbl, &cs_crc16);
+
+	start = now_sec();
+	for (i = 0; i < iter / 16; i++)
+		sink = osmo_crc16gen_compute_bits(&cs_crc16, ubits, len);
+	report("CS-2 CRC16 bitwise", len, now_sec() - start, iter / 16);
+
+	start = now_sec();
+	for (i = 0; i < iter; i++)
+		sink = osmo_crc16gen_compute_pbits(&tbl, pbits, len);
+	report("CS-2 CRC16 packed", len, now_sec() - start, iter);
+}
+
+static void run_osmo_crc16(int len)
+{
+	int i, j, iter = TOTAL_BITS / len;
+	double start;
+	uint16_t crc;
+
+	start = now_sec();
+	for (i = 0; i < iter; i++) {
+		crc = 0;
+		for (j = 0; j < len / 8; j++)
+			crc = osmo_crc16_byte(crc, pbits[j]);
+		sink = crc;
+	}
+	report("osmo_crc16_byte loop", len, now_sec() - start, iter);
+
+	start = now_sec();
+	for (i = 0; i < iter; i++)
+		sink = osmo_crc16(0, pbits, len / 8);
+	report("osmo_crc16", len, now_sec() - start, iter);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	srandom(42);
+	for (i = 0; i < MAX_BITS; i++)
+		ubits[i] = random() & 1;
+	osmo_ubit2pbit(pbits, ubits, MAX_BITS);
+
+	/* xCCH block, RLC/MAC CS-4 block, large buffer */
+	run_fire(184);
+	run_fire(MAX_BITS);
+	run_crc16(431);
+	run_crc16(MAX_BITS);
+	/* osmoload memory chunk */
+	run_osmo_crc16(1024 * 8);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/crcgen.h>
+#include <osmocom/core/crc16.h>
+
+#define MAX_BITS	2048
+
+/* GSM 05.03 TCH/FR class 1a parity */
+static const struct osmo_crc8gen_code tch_fr_crc3 = {
+	.bits = 3,
+	.poly = 0x3,
+	.init = 0x0,
+	.remainder = 0x7,
+};
+
+/* GSM 05.03 TCH/AFS class 1a parity */
+static const struct osmo_crc8gen_code tch_afs_crc6 = {
+	.bits = 6,
+	.poly = 0x2f,
+	.init = 0x0,
+	.remainder = 0x3f,
+};
+
+/* GSM 05.03 PDTCH CS-2..4 and CCITT */
+static const struct osmo_crc16gen_code cs_crc16 = {
+	.bits = 16,
+	.poly = 0x1021,
+	.init = 0x0,
+	.remainder = 0xffff,
+};
+
+/* GSM 05.03 RACH/SCH style 10 bit parity */
+static const struct osmo_crc16gen_code sch_crc10 = {
+	.bits = 10,
+	.poly = 0x175,
+	.init = 0x0,
+	.remainder = 0x3ff,
+};
+
+/* Ethernet */
+static const struct osmo_crc32gen_code eth_crc32 = {
+	.bits = 32,
+	.poly = 0x04c11db7,
+	.init = 0xffffffff,
+	.remainder = 0xffffffff,
+};
+
+/* GSM 05.03 xCCH FIRE code */
+static const struct osmo_crc64gen_code xcch_fire = {
+	.bits = 40,
+	.poly = 0x0004820009ULL,
+	.init = 0x0000000000ULL,
+	.remainder = 0xffffffffffULL,
+};
+
+/* ECMA-182 */
+static const struct osmo_crc64gen_code ecma_crc64 = {
+	.bits = 64,
+	.poly = 0x42f0e1eba9ea3693ULL,
+	.init = 0xffffffffffffffffULL,
+	.remainder = 0x0ULL,
+};
+
+static ubit_t ubits[MAX_BITS];
+static pbit_t pbits[MAX_BITS / 8];
+
+/* lengths around the slice and folding thresholds */
+static int next_len(int len)
+{
+	return len < 160 ? len + 1 : len + 37;
+}
+
+#define TEST_CODE(XX, name, code)					\
+static void test_##name(int clmul)					\
+{									\
+	static struct osmo_crc##XX##gen_table tbl;			\
+	uint##XX##_t ref, crc;						\
+	int len;							\
+									\
+	osmo_crc##XX##gen_table_init(&tbl, &code);			\
+	if (!clmul)							\
+		tbl.clmul = 0;						\
+									\
+	for (len = 0; len <= MAX_BITS; len = next_len(len)) {		\
+		ref = osmo_crc##XX##gen_compute_bits(&code, ubits, len);	\
+		crc = osmo_crc##XX##gen_compute_pbits(&tbl, pbits, len);	\
+		if (crc != ref) {					\
+			printf(#name ": mismatch for %d bits\n", len);	\
+			fprintf(stderr, #name " failed\n");		\
+			exit(1);					\
+		}							\
+	}								\
+	if (clmul)							\
+		printf(#name ": OK\n");					\
+}
+
+TEST_CODE(8, tch_fr_crc3, tch_fr_crc3)
+TEST_CODE(8, tch_afs_crc6, tch_afs_crc6)
+TEST_CODE(16, cs_crc16, cs_crc16)
+TEST_CODE(16, sch_crc10, sch_crc10)
+TEST_CODE(32, eth_crc32, eth_crc32)
+TEST_CODE(64, xcch_fire, xcch_fire)
+TEST_CODE(64, ecma_crc64, ecma_crc64)
+
+int main(int argc, char **argv)
+{
+	uint8_t check[] = "123456789";
+	struct osmo_crc32gen_table tbl;
+	int i, clmul;
+
+	srandom(1);
+	for (i = 0; i < MAX_BITS; i++)
+		ubits[i] = random() & 1;
+	osmo_ubit2pbit(pbits, ubits, MAX_BITS);
+
+	/* table driven and, where available, folded */
+	for (clmul = 0; clmul < 2; clmul++) {
+		test_tch_fr_crc3(clmul);
+		test_tch_afs_crc6(clmul);
+		test_cs_crc16(clmul);
+		test_sch_crc10(clmul);
+		test_eth_crc32(clmul);
+		test_xcch_fire(clmul);
+		test_ecma_crc64(clmul);
+	}
+
+	/* well known check value, of a non reflected CRC-32 (BZIP2) */
+	osmo_crc32gen_table_init(&tbl, &eth_crc32);
+	printf("crc32 check: 0x%08x\n",
+		osmo_crc32gen_compute_pbits(&tbl, check, 9 * 8));
+
+	/* osmo_crc16() against the byte at a time update, any length */
+	for (i = 0; i <= 64; i++) {
+		uint16_t ref = 0xffff;
+		int j;
+
+		for (j = 0; j < i; j++)
+			ref = osmo_crc16_byte(ref, pbits[j]);
+		if (osmo_crc16(0xffff, pbits, i) != ref) {
+			printf("crc16: mismatch for %d bytes\n", i);
+			fprintf(stderr, "crc16 failed\n");
+			exit(1);
+		}
+	}
+	printf("crc16 check: 0x%04x\n", osmo_crc16(0, check, 9));
+
+	return 0;
+}
@@ -6,9 +6,11 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <limits.h>
 #include <getopt.h>
 
 #include <osmocom/core/application.h>
+#include <osmocom/core/select.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/talloc.h>
@@ -17,6 +19,21 @@
 static unsigned long in_ctr = 1;
 static struct timeval tv_start;
 
+/* bucket size max once the PDUs are queued, as set by a FLOW-CONTROL-BVC
+ * or FLOW-CONTROL-MS, 0 to keep it */
+static uint32_t shrink_size_max;
+
+/* give up on a queue that doesn't drain (centiseconds) */
+#define STALL_CSECS	6000
+
+/* state of the throughput test */
+static int tp_mode;
+static unsigned long tp_out_ctr;
+static unsigned long tp_out_octets;
+static struct timeval tv_last_out;
+static unsigned int *tp_ms_of_pdu;
+static unsigned int *tp_last_out_of_ms;
+
 int get_centisec_diff(void)
 {
 	struct timeval tv;
@@ -39,7 +56,19 @@ int round_decisec(int csec_in)
 static int fc_out_cb(struct bssgp_flow_control *fc, struct msgb *msg,
 		     uint32_t llc_pdu_len, void *priv)
 {
-	unsigned int csecs = get_centisec_diff();
+	unsigned int csecs;
+
+	if (tp_mode) {
+		unsigned long nr = (unsigned long) msg;
+
+		tp_out_ctr++;
+		tp_out_octets += llc_pdu_len;
+		tp_last_out_of_ms[tp_ms_of_pdu[nr]] = tp_out_ctr;
+		gettimeofday(&tv_last_out, NULL);
+		return 0;
+	}
+
+	csecs = get_centisec_diff();
 	csecs = round_decisec(csecs);
 
 	printf("%u: FC OUT Nr %lu\n", csecs, (unsigned long) msg);
@@ -75,6 +104,12 @@ static void test_fc(uint32_t bucket_size_max, uint32_t bucket_leak_rate,
 		osmo_timers_update();
 	}
 
+	if (shrink_size_max) {
+		printf("%u: bucket size max %u\n",
+			round_decisec(get_centisec_diff()), shrink_size_max);
+		fc->bucket_size_max = shrink_size_max;
+	}
+
 	while (1) {
 		usleep(100000);
 		osmo_timers_check();
@@ -83,9 +118,190 @@ static void test_fc(uint32_t bucket_size_max, uint32_t bucket_leak_rate,
 
 		if (llist_empty(&fc->queue))
 			break;
+		if (get_centisec_diff() > STALL_CSECS) {
+			printf("queue stalled\n");
+			break;
+		}
 	}
 }
 
+static void print_hist(const char *name, const uint32_t *hist)
+{
+	int i;
+
+	printf("%s:", name);
+	for (i = 0; i < BSSGP_FC_HIST_BINS; i++) {
+		if (hist[i])
+			printf(" [%d] %u", i, hist[i]);
+	}
+	printf("\n");
+}
+
+/* set up a BVC whose flow control ends in fc_out_cb() and which gives
+ * its per-MS flow controls the given bucket */
+static struct bssgp_bvc_ctx *bvc_alloc(uint32_t bucket_size_max,
+				       uint32_t bucket_leak_rate,
+				       uint32_t max_queue_depth,
+				       uint32_t ms_bucket_size_max,
+				       uint32_t ms_bucket_leak_rate,
+				       uint32_t quantum)
+{
+	static uint16_t bvci = 1;
+	struct bssgp_bvc_ctx *bctx;
+
+	bctx = btsctx_alloc(bvci++, 1);
+	bssgp_fc_init(bctx->fc, bucket_size_max, bucket_leak_rate,
+		      max_queue_depth, fc_out_cb);
+	bctx->fc->quantum = quantum;
+	bctx->bmax_default_ms = ms_bucket_size_max;
+	bctx->r_default_ms = ms_bucket_leak_rate;
+
+	return bctx;
+}
+
+/* The first 2/3 of the PDUs go to MS 0, the rest alternate between the
+ * other MS. Deficit round robin interleaves the queued PDUs of all MS. */
+static void test_fc_ms(uint32_t bucket_size_max, uint32_t bucket_leak_rate,
+		       uint32_t max_queue_depth, uint32_t pdu_len,
+		       uint32_t pdu_count, unsigned int num_ms,
+		       uint32_t ms_bucket_size_max,
+		       uint32_t ms_bucket_leak_rate, uint32_t quantum)
+{
+	struct bssgp_bvc_ctx *bctx;
+	struct bssgp_flow_control *fc_ms;
+	unsigned int ms;
+	int i;
+
+	bctx = bvc_alloc(bucket_size_max, bucket_leak_rate, max_queue_depth,
+			 ms_bucket_size_max, ms_bucket_leak_rate, quantum);
+	fc_ms = talloc_zero_array(NULL, struct bssgp_flow_control, num_ms);
+	for (ms = 0; ms < num_ms; ms++) {
+		bssgp_fc_ms_init(&fc_ms[ms], bctx->bvci, bctx->nsei,
+				 max_queue_depth);
+		bssgp_fc_ms_set_tlli(&fc_ms[ms], 0xc0000000 | ms);
+	}
+
+	gettimeofday(&tv_start, NULL);
+
+	for (i = 0; i < pdu_count; i++) {
+		if (num_ms == 1 || i < pdu_count * 2 / 3)
+			ms = 0;
+		else
+			ms = 1 + i % (num_ms - 1);
+		printf("%u: FC IN Nr %lu MS %u\n",
+			round_decisec(get_centisec_diff()), in_ctr, ms);
+		bssgp_fc_in(&fc_ms[ms], (struct msgb *) in_ctr, pdu_len,
+			    bctx->fc);
+		in_ctr++;
+		osmo_timers_check();
+		osmo_timers_prepare();
+		osmo_timers_update();
+	}
+
+	if (shrink_size_max) {
+		printf("%u: MS bucket size max %u\n",
+			round_decisec(get_centisec_diff()), shrink_size_max);
+		for (ms = 0; ms < num_ms; ms++)
+			fc_ms[ms].bucket_size_max = shrink_size_max;
+	}
+
+	while (1) {
+		usleep(100000);
+		osmo_timers_check();
+		osmo_timers_prepare();
+		osmo_timers_update();
+
+		if (llist_empty(&bctx->fc->active))
+			break;
+		if (get_centisec_diff() > STALL_CSECS) {
+			printf("queue stalled\n");
+			break;
+		}
+	}
+
+	print_hist("queue depth", bctx->fc->stats.queue_depth);
+	print_hist("delay (ms)", bctx->fc->stats.delay_ms);
+
+	for (ms = 0; ms < num_ms; ms++)
+		bssgp_fc_ms_release(&fc_ms[ms]);
+	talloc_free(fc_ms);
+}
+
+/* Many MS saturate a fast BVC. Check that the BVC leak rate is met, that
+ * a timer expiry sends more than one PDU and that every MS that had to
+ * queue sends its last PDU in the last round. */
+static void test_fc_throughput(uint32_t bucket_size_max,
+			       uint32_t bucket_leak_rate, uint32_t pdu_len,
+			       uint32_t pdu_count, unsigned int num_ms,
+			       uint32_t quantum)
+{
+	struct bssgp_bvc_ctx *bctx;
+	struct bssgp_flow_control *fc_ms;
+	struct timeval tv_diff;
+	unsigned long usecs, usecs_expected, first_last_out;
+	unsigned int ms, num_queued_ms = 0;
+	int i;
+
+	bctx = bvc_alloc(bucket_size_max, bucket_leak_rate, pdu_count,
+			 bucket_size_max, bucket_leak_rate, quantum);
+	fc_ms = talloc_zero_array(NULL, struct bssgp_flow_control, num_ms);
+	for (ms = 0; ms < num_ms; ms++)
+		bssgp_fc_ms_init(&fc_ms[ms], bctx->bvci, bctx->nsei,
+				 pdu_count);
+	tp_ms_of_pdu = talloc_zero_array(NULL, unsigned int,
+					 num_ms * pdu_count + in_ctr);
+	tp_last_out_of_ms = talloc_zero_array(NULL, unsigned int, num_ms);
+	tp_mode = 1;
+
+	gettimeofday(&tv_start, NULL);
+
+	/* each MS queues all its PDUs at once */
+	for (ms = 0; ms < num_ms; ms++) {
+		for (i = 0; i < pdu_count; i++) {
+			tp_ms_of_pdu[in_ctr] = ms;
+			bssgp_fc_in(&fc_ms[ms], (struct msgb *) in_ctr,
+				    pdu_len, bctx->fc);
+			in_ctr++;
+		}
+		if (fc_ms[ms].queue_depth)
+			num_queued_ms++;
+		else
+			tp_last_out_of_ms[ms] = UINT_MAX;
+	}
+
+	while (!llist_empty(&bctx->fc->active))
+		osmo_select_main(0);
+
+	tp_mode = 0;
+
+	/* the first bucket_size_max octets pass at once */
+	timersub(&tv_last_out, &tv_start, &tv_diff);
+	usecs = tv_diff.tv_sec * 1000000 + tv_diff.tv_usec;
+	usecs_expected = (uint64_t) (tp_out_octets - bucket_size_max) *
+		1000000 / bucket_leak_rate;
+	printf("PDUs out: %lu of %u\n", tp_out_ctr, num_ms * pdu_count);
+	printf("leak rate met: %s\n",
+		usecs >= usecs_expected * 95 / 100 &&
+		usecs <= usecs_expected * 105 / 100 ? "yes" : "no");
+	printf("more than one PDU per tick: %s\n",
+		bctx->fc->stats.ticks < tp_out_ctr / 2 ? "yes" : "no");
+
+	first_last_out = tp_out_ctr;
+	for (ms = 0; ms < num_ms; ms++) {
+		if (tp_last_out_of_ms[ms] < first_last_out)
+			first_last_out = tp_last_out_of_ms[ms];
+	}
+	printf("all queued MS done in the last round: %s\n",
+		num_queued_ms &&
+		tp_out_ctr - first_last_out < num_queued_ms ? "yes" : "no");
+
+	for (ms = 0; ms < num_ms; ms++)
+		bssgp_fc_ms_release(&fc_ms[ms]);
+	talloc_free(fc_ms);
+	talloc_free(tp_ms_of_pdu);
+	talloc_free(tp_last_out_of_ms);
+}
+
 static void help(void)
 {
 	printf(" -h --help                This help message\n");
@@ -93,6 +309,15 @@ static void help(void)
 	printf(" -r --bucket-leak-rate N  Bucket leak rate in octets/sec\n");
 	printf(" -d --max-queue-depth N   Maximum length of pending PDU queue (msgs)\n");
 	printf(" -l --pdu-length N        Length of each PDU in octets\n");
+	printf(" -c --pdu-count N         Number of PDUs (per MS with -t)\n");
+	printf(" -m --ms N                Send through N per-MS flow controls\n");
+	printf(" -S --ms-size-max N       Maximum size of the per-MS buckets\n");
+	printf(" -R --ms-leak-rate N      Leak rate of the per-MS buckets\n");
+	printf(" -q --quantum N           Deficit round robin quantum in octets\n");
+	printf(" -t --throughput          Measure the throughput of -m MS\n");
+	printf(" -b --shrink N            Lower the maximum bucket size (of the\n"
+	       "                          per-MS buckets with -m) to N once the\n"
+	       "                          PDUs are queued\n");
 }
 
 int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
@@ -109,6 +334,11 @@ int main(int argc, char **argv)
 	uint32_t max_queue_depth = 5; /* messages */
 	uint32_t pdu_length = 10; /* octets */
 	uint32_t pdu_count = 20; /* messages */
+	unsigned int num_ms = 0;
+	uint32_t ms_bucket_size_max = 0; /* octets */
+	uint32_t ms_bucket_leak_rate = 0; /* octets / second */
+	uint32_t quantum = 1600; /* octets */
+	int throughput = 0;
 	int c;
 
 	static const struct option long_options[] = {
@@ -117,6 +347,12 @@ int main(int argc, char **argv)
 		{ "max-queue-depth", 1, 0, 'd' },
 		{ "pdu-length", 1, 0, 'l' },
 		{ "pdu-count", 1, 0, 'c' },
+		{ "ms", 1, 0, 'm' },
+		{ "ms-size-max", 1, 0, 'S' },
+		{ "ms-leak-rate", 1, 0, 'R' },
+		{ "quantum", 1, 0, 'q' },
+		{ "throughput", 0, 0, 't' },
+		{ "shrink", 1, 0, 'b' },
 		{ "help", 0, 0, 'h' },
 		{ 0, 0, 0, 0 }
 	};
@@ -125,7 +361,7 @@ int main(int argc, char **argv)
 	log_set_use_color(osmo_stderr_target, 0);
 	log_set_print_filename(osmo_stderr_target, 0);
 
-	while ((c = getopt_long(argc, argv, "s:r:d:l:c:",
+	while ((c = getopt_long(argc, argv, "s:r:d:l:c:m:S:R:q:tb:",
 				long_options, NULL)) != -1) {
 		switch (c) {
 		case 's':
@@ -143,6 +379,24 @@ int main(int argc, char **argv)
 		case 'c':
 			pdu_count = atoi(optarg);
 			break;
+		case 'm':
+			num_ms = atoi(optarg);
+			break;
+		case 'S':
+			ms_bucket_size_max = atoi(optarg);
+			break;
+		case 'R':
+			ms_bucket_leak_rate = atoi(optarg);
+			break;
+		case 'q':
+			quantum = atoi(optarg);
+			break;
+		case 't':
+			throughput = 1;
+			break;
+		case 'b':
+			shrink_size_max = atoi(optarg);
+			break;
 		case 'h':
 			help();
 			exit(EXIT_SUCCESS);
@@ -158,12 +412,32 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	if (!ms_bucket_size_max)
+		ms_bucket_size_max = bucket_size_max;
+	if (!ms_bucket_leak_rate)
+		ms_bucket_leak_rate = bucket_leak_rate;
+
 	printf("===== BSSGP flow-control test START\n");
 	printf("size-max=%u oct, leak-rate=%u oct/s, "
-		"queue-len=%u msgs, pdu_len=%u oct, pdu_cnt=%u\n\n", bucket_size_max,
+		"queue-len=%u msgs, pdu_len=%u oct, pdu_cnt=%u\n", bucket_size_max,
 		bucket_leak_rate, max_queue_depth, pdu_length, pdu_count);
-	test_fc(bucket_size_max, bucket_leak_rate, max_queue_depth,
-		pdu_length, pdu_count);
+	if (num_ms)
+		printf("ms=%u, ms-size-max=%u oct, ms-leak-rate=%u oct/s, "
+			"quantum=%u oct%s\n", num_ms, ms_bucket_size_max,
+			ms_bucket_leak_rate, quantum,
+			throughput ? ", throughput" : "");
+	printf("\n");
+	if (throughput)
+		test_fc_throughput(bucket_size_max, bucket_leak_rate,
+				   pdu_length, pdu_count, num_ms ? num_ms : 1,
+				   quantum);
+	else if (num_ms)
+		test_fc_ms(bucket_size_max, bucket_leak_rate, max_queue_depth,
+			   pdu_length, pdu_count, num_ms, ms_bucket_size_max,
+			   ms_bucket_leak_rate, quantum);
+	else
+		test_fc(bucket_size_max, bucket_leak_rate, max_queue_depth,
+			pdu_length, pdu_count);
 	printf("===== BSSGP flow-control test END\n\n");
 
 	exit(EXIT_SUCCESS);
@@ -13,3 +13,18 @@ $T -l 1000
 # test with 100 byte PDUs (10 second)
 $T -s 100
 
+# bucket size max lowered below the queued PDUs (2 seconds)
+$T -l 40 -c 5 -d 100 -b 20
+
+
+# three MS, MS 0 floods the BVC (1 second)
+$T -s 500 -r 1000 -l 100 -c 15 -d 100 -m 3 -q 100
+
+# two MS limited by their own buckets (1.5 seconds)
+$T -s 1000 -r 10000 -l 100 -c 8 -d 100 -m 2 -S 100 -R 200
+
+# per-MS bucket size max lowered below the queued PDUs (2 seconds)
+$T -s 1000 -r 1000 -l 40 -c 6 -d 100 -m 2 -S 100 -R 100 -b 20
+
+# throughput of 50 MS saturating a 200 kB/s BVC (1 second)
+$T -s 20000 -r 200000 -l 500 -c 8 -m 50 -q 500 -t
@@ -0,0 +1,295 @@
+/*
+ * NS-VC and BVC lookups with many peers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/gprs/gprs_ns.h>
+#include <osmocom/gprs/gprs_bssgp.h>
+
+#define NUM_NSVC	10000
+#define BVC_PER_NSVC	5
+#define NUM_BVC		(NUM_NSVC * BVC_PER_NSVC)
+#define NUM_PACKETS	2000000
+/* the linear search is slow, fewer lookups are enough to time it */
+#define NUM_LINEAR	2000
+
+/* exported by libosmogb, but not declared in its headers */
+struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei);
+int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
+		   struct sockaddr_in *saddr, enum gprs_ns_ll ll);
+
+static struct gprs_nsvc *nsvcs[NUM_NSVC];
+static struct bssgp_bvc_ctx *bvcs[NUM_BVC];
+static struct gprs_ns_inst *nsi;
+
+/* set by the NS callback for the packet in flight */
+static struct bssgp_bvc_ctx *rx_bvc;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void peer_addr(struct sockaddr_in *sin, int i)
+{
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(0x0a000000 + i / 4);
+	sin->sin_port = htons(23000 + i % 4);
+}
+
+static void bvc_cell(struct gprs_ra_id *raid, uint16_t *cid, int i)
+{
+	memset(raid, 0, sizeof(*raid));
+	raid->mcc = 262;
+	raid->mnc = 42;
+	raid->lac = 1000 + i / 256;
+	raid->rac = i % 256;
+	*cid = i;
+}
+
+int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
+{
+	return 0;
+}
+
+static int ns_cb(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
+		 struct msgb *msg, uint16_t bvci)
+{
+	rx_bvc = btsctx_by_bvci_nsei(bvci, nsvc->nsei);
+	return 0;
+}
+
+static void setup(void)
+{
+	struct sockaddr_in sin;
+	int i;
+
+	nsi = gprs_ns_instantiate(ns_cb, NULL);
+
+	for (i = 0; i < NUM_NSVC; i++) {
+		struct gprs_nsvc *nsvc = gprs_nsvc_create(nsi, i);
+
+		peer_addr(&sin, i);
+		nsvc->ip.bts_addr = sin;
+		nsvc->nsei = 10000 + i;
+		nsvc->ll = GPRS_NS_LL_UDP;
+		nsvc->state = NSE_S_ALIVE;
+		gprs_nsvc_rehash(nsvc);
+		nsvcs[i] = nsvc;
+	}
+
+	for (i = 0; i < NUM_BVC; i++) {
+		struct bssgp_bvc_ctx *bctx;
+
+		/* BVCIs repeat on each NSE, only BVCI+NSEI is unique */
+		bctx = btsctx_alloc(2 + i % BVC_PER_NSVC,
+				    nsvcs[i / BVC_PER_NSVC]->nsei);
+		bvc_cell(&bctx->ra_id, &bctx->cell_id, i);
+		btsctx_rehash(bctx);
+		bvcs[i] = bctx;
+	}
+}
+
+/* the lookups as they were done before the hash tables */
+static struct gprs_nsvc *linear_by_addr(struct sockaddr_in *sin)
+{
+	struct gprs_nsvc *nsvc;
+
+	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+		if (nsvc->ip.bts_addr.sin_addr.s_addr ==
+					sin->sin_addr.s_addr &&
+		    nsvc->ip.bts_addr.sin_port == sin->sin_port)
+			return nsvc;
+	}
+	return NULL;
+}
+
+/* bssgp_bvc_ctxts is not exported, walk the contexts in its order */
+static struct bssgp_bvc_ctx *linear_by_bvci_nsei(uint16_t bvci, uint16_t nsei)
+{
+	int i;
+
+	for (i = NUM_BVC - 1; i >= 0; i--) {
+		if (bvcs[i]->nsei == nsei && bvcs[i]->bvci == bvci)
+			return bvcs[i];
+	}
+	return NULL;
+}
+
+static void bench_linear(const int *seq)
+{
+	struct sockaddr_in sin;
+	double t;
+	int i, j;
+
+	t = now_sec();
+	for (i = 0; i < NUM_LINEAR; i++) {
+		struct gprs_nsvc *nsvc;
+
+		j = seq[i];
+		peer_addr(&sin, j / BVC_PER_NSVC);
+		nsvc = linear_by_addr(&sin);
+		if (linear_by_bvci_nsei(bvcs[j]->bvci, nsvc->nsei) != bvcs[j]) {
+			fprintf(stderr, "linear lookup failed for BVC %d\n", j);
+			exit(1);
+		}
+	}
+	t = now_sec() - t;
+
+	printf("linear lists:  %8.0f packets/s (%.2f us/packet)\n",
+		NUM_LINEAR / t, t * 1e6 / NUM_LINEAR);
+}
+
+/* NS UNITDATA from the peer of each BVC, through the NS layer */
+static void bench_rcvmsg(const int *seq)
+{
+	struct msgb *msg = gprs_ns_msgb_alloc();
+	struct gprs_ns_hdr *nsh;
+	struct sockaddr_in sin;
+	double t;
+	int i, j;
+
+	nsh = (struct gprs_ns_hdr *) msgb_put(msg, sizeof(*nsh) + 3 + 20);
+	memset(nsh, 0, sizeof(*nsh) + 3 + 20);
+	nsh->pdu_type = NS_PDUT_UNITDATA;
+
+	t = now_sec();
+	for (i = 0; i < NUM_PACKETS; i++) {
+		j = seq[i];
+		peer_addr(&sin, j / BVC_PER_NSVC);
+		nsh->data[1] = bvcs[j]->bvci >> 8;
+		nsh->data[2] = bvcs[j]->bvci & 0xff;
+		msg->l2h = (uint8_t *) nsh;
+		rx_bvc = NULL;
+		gprs_ns_rcvmsg(nsi, msg, &sin, GPRS_NS_LL_UDP);
+		if (rx_bvc != bvcs[j]) {
+			fprintf(stderr, "rx lookup failed for BVC %d\n", j);
+			exit(1);
+		}
+	}
+	t = now_sec() - t;
+	msgb_free(msg);
+
+	printf("rcvmsg+BVC:    %8.0f packets/s (%.2f us/packet)\n",
+		NUM_PACKETS / t, t * 1e6 / NUM_PACKETS);
+}
+
+static void bench_lookups(const int *seq)
+{
+	struct gprs_ra_id raid;
+	uint16_t cid;
+	double t;
+	int i, j;
+
+	t = now_sec();
+	for (i = 0; i < NUM_PACKETS; i++) {
+		j = seq[i] / BVC_PER_NSVC;
+		if (gprs_nsvc_by_nsvci(nsi, j) != nsvcs[j]
+		 || gprs_nsvc_by_nsei(nsi, 10000 + j) != nsvcs[j]) {
+			fprintf(stderr, "NS-VC lookup failed for %d\n", j);
+			exit(1);
+		}
+	}
+	t = now_sec() - t;
+	printf("NSVCI+NSEI:    %8.0f lookups/s (%.3f us/lookup)\n",
+		2 * NUM_PACKETS / t, t * 1e6 / NUM_PACKETS / 2);
+
+	t = now_sec();
+	for (i = 0; i < NUM_PACKETS; i++) {
+		j = seq[i];
+		bvc_cell(&raid, &cid, j);
+		if (btsctx_by_raid_cid(&raid, cid) != bvcs[j]) {
+			fprintf(stderr, "RA ID lookup failed for BVC %d\n", j);
+			exit(1);
+		}
+	}
+	t = now_sec() - t;
+	printf("RA ID+CI:      %8.0f lookups/s (%.3f us/lookup)\n",
+		NUM_PACKETS / t, t * 1e6 / NUM_PACKETS);
+}
+
+/* move some NS-VCs and cells and check that they are found at the new
+ * keys only */
+static void check_rehash(void)
+{
+	struct sockaddr_in sin;
+	struct gprs_ra_id raid;
+	uint16_t cid;
+	int i;
+
+	for (i = 0; i < NUM_NSVC; i += 97) {
+		peer_addr(&sin, i);
+		sin.sin_port = htons(30000);
+		nsvcs[i]->ip.bts_addr = sin;
+		nsvcs[i]->nsei += 40000;
+		gprs_nsvc_rehash(nsvcs[i]);
+		if (gprs_nsvc_by_nsei(nsi, 10000 + i)
+		 || gprs_nsvc_by_nsei(nsi, 50000 + i) != nsvcs[i]) {
+			fprintf(stderr, "rehash of NS-VC %d failed\n", i);
+			exit(1);
+		}
+	}
+	for (i = 0; i < NUM_BVC; i += 101) {
+		bvcs[i]->cell_id += 60000;
+		btsctx_rehash(bvcs[i]);
+		bvc_cell(&raid, &cid, i);
+		if (btsctx_by_raid_cid(&raid, cid)
+		 || btsctx_by_raid_cid(&raid, cid + 60000) != bvcs[i]) {
+			fprintf(stderr, "rehash of BVC %d failed\n", i);
+			exit(1);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int *seq;
+	int i;
+
+	setup();
+
+	printf("%d NS-VCs, %d BVCs, %d packets\n\n",
+		NUM_NSVC, NUM_BVC, NUM_PACKETS);
+
+	/* packets of random BVCs, no locality between lookups */
+	seq = malloc(NUM_PACKETS * sizeof(*seq));
+	srand(1);
+	for (i = 0; i < NUM_PACKETS; i++)
+		seq[i] = rand() % NUM_BVC;
+
+	bench_linear(seq);
+	bench_rcvmsg(seq);
+	bench_lookups(seq);
+	check_rehash();
+
+	gprs_ns_destroy(nsi);
+	free(seq);
+
+	return 0;
+}
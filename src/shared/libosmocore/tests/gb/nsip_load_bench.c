@@ -0,0 +1,337 @@
+/*
+ * NS/IP load generator on the loopback interface
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* A NS instance echoes each UNITDATA PDU it receives back to its
+ * sender, the way an SGSN answers uplink data. Simulated BSS peers keep
+ * a fixed number of PDUs in flight, and measure the time from sending a
+ * PDU until its echo arrives. */
+
+#define _GNU_SOURCE	/* for recvmmsg() and sendmmsg() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/gprs/gprs_ns.h>
+#include <osmocom/gprs/gprs_bssgp.h>
+
+#include "../../config.h"
+
+#define NUM_PEERS	16
+#define NUM_PDUS	400000
+/* PDUs in flight over all peers */
+#define WINDOW		256
+/* octets of BSSGP payload in each PDU, the timestamp comes first */
+#define PAYLOAD_LEN	64
+#define PEER_BATCH	(WINDOW / NUM_PEERS)
+
+struct peer {
+	struct osmo_fd ofd;
+	uint16_t nsei;
+};
+
+static struct peer peers[NUM_PEERS];
+static struct sockaddr_in sgsn_addr;
+static struct gprs_ns_inst *nsi;
+
+static uint64_t *latency;
+static unsigned int sent, received, lost;
+static unsigned int last_received;
+static struct osmo_timer_list stall_timer;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* libosmogb needs it, BSSGP is not used here */
+int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
+{
+	return 0;
+}
+
+/* the SGSN side: send the payload back on the same BVC */
+static int ns_cb(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
+		 struct msgb *msg, uint16_t bvci)
+{
+	struct msgb *echo;
+	unsigned int len;
+
+	if (event != GPRS_NS_EVT_UNIT_DATA)
+		return 0;
+
+	len = msgb_l2len(msg) - (msgb_bssgph(msg) - msg->l2h);
+	echo = gprs_ns_msgb_alloc();
+	memcpy(msgb_put(echo, len), msgb_bssgph(msg), len);
+	msgb_nsei(echo) = nsvc->nsei;
+	msgb_bvci(echo) = bvci;
+
+	return gprs_ns_sendmsg(nsi, echo);
+}
+
+/* send up to num PDUs from one peer, at most PEER_BATCH */
+static void peer_send(struct peer *p, unsigned int num)
+{
+	uint8_t pdu[PEER_BATCH][4 + PAYLOAD_LEN];
+	struct iovec iov[PEER_BATCH];
+	unsigned int i;
+	uint64_t t;
+	int rc;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr mmsg[PEER_BATCH];
+#endif
+
+	if (num > NUM_PDUS - sent)
+		num = NUM_PDUS - sent;
+	if (!num)
+		return;
+
+	t = now_ns();
+	for (i = 0; i < num; i++) {
+		memset(pdu[i], 0, sizeof(pdu[i]));
+		pdu[i][0] = NS_PDUT_UNITDATA;
+		pdu[i][3] = 2;		/* BVCI */
+		memcpy(pdu[i] + 4, &t, sizeof(t));
+		iov[i].iov_base = pdu[i];
+		iov[i].iov_len = sizeof(pdu[i]);
+#ifdef HAVE_SENDMMSG
+		memset(&mmsg[i], 0, sizeof(mmsg[i]));
+		mmsg[i].msg_hdr.msg_name = &sgsn_addr;
+		mmsg[i].msg_hdr.msg_namelen = sizeof(sgsn_addr);
+		mmsg[i].msg_hdr.msg_iov = &iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
+
+#ifdef HAVE_SENDMMSG
+	rc = sendmmsg(p->ofd.fd, mmsg, num, 0);
+#else
+	for (rc = 0; rc < num; rc++) {
+		if (sendto(p->ofd.fd, iov[rc].iov_base, iov[rc].iov_len, 0,
+			   (struct sockaddr *)&sgsn_addr,
+			   sizeof(sgsn_addr)) < 0)
+			break;
+	}
+#endif
+	if (rc < 0) {
+		perror("peer send");
+		exit(1);
+	}
+	sent += rc;
+}
+
+/* the BSS side: take the echoes, send as many new PDUs */
+static int peer_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct peer *p = ofd->data;
+	uint8_t buf[PEER_BATCH][NS_ALLOC_SIZE];
+	struct iovec iov[PEER_BATCH];
+	uint64_t t, now;
+	int i, n;
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr mmsg[PEER_BATCH];
+
+	memset(mmsg, 0, sizeof(mmsg));
+	for (i = 0; i < PEER_BATCH; i++) {
+		iov[i].iov_base = buf[i];
+		iov[i].iov_len = sizeof(buf[i]);
+		mmsg[i].msg_hdr.msg_iov = &iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 1;
+	}
+	n = recvmmsg(ofd->fd, mmsg, PEER_BATCH, MSG_DONTWAIT, NULL);
+#else
+	for (n = 0; n < PEER_BATCH; n++) {
+		int rc = recv(ofd->fd, buf[n], sizeof(buf[n]), MSG_DONTWAIT);
+		if (rc < 0)
+			break;
+		iov[n].iov_len = rc;
+	}
+#endif
+	if (n <= 0)
+		return 0;
+
+	now = now_ns();
+	for (i = 0; i < n; i++) {
+		if (received == NUM_PDUS)
+			break;
+		memcpy(&t, buf[i] + 4, sizeof(t));
+		latency[received++] = now - t;
+	}
+	peer_send(p, n);
+
+	return 0;
+}
+
+/* the window shrinks with every lost datagram, refill it */
+static void stall_cb(void *data)
+{
+	unsigned int i, missing;
+
+	if (received == last_received) {
+		missing = sent - received;
+		lost += missing;
+		sent -= missing;
+		for (i = 0; i < NUM_PEERS; i++)
+			peer_send(&peers[i], missing / NUM_PEERS + 1);
+	}
+	last_received = received;
+	osmo_timer_schedule(&stall_timer, 0, 200000);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void setup(unsigned int batch)
+{
+	struct sockaddr_in sin;
+	int rcvbuf = 1 << 20;
+	socklen_t len;
+	int i;
+
+	nsi = gprs_ns_instantiate(ns_cb, NULL);
+	nsi->nsip.local_ip = INADDR_LOOPBACK;
+	nsi->nsip.local_port = 0;
+	if (gprs_ns_nsip_listen(nsi) < 0
+	 || gprs_ns_nsip_set_batch(nsi, batch) < 0) {
+		fprintf(stderr, "cannot set up the NS instance\n");
+		exit(1);
+	}
+	len = sizeof(sgsn_addr);
+	getsockname(nsi->nsip.fd.fd, (struct sockaddr *)&sgsn_addr, &len);
+	/* room for the whole window, lost datagrams stall the peers */
+	setsockopt(nsi->nsip.fd.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+		   sizeof(rcvbuf));
+
+	for (i = 0; i < NUM_PEERS; i++) {
+		struct peer *p = &peers[i];
+		struct gprs_nsvc *nsvc;
+
+		p->ofd.cb = peer_cb;
+		p->ofd.data = p;
+		p->ofd.when = BSC_FD_READ;
+		if (osmo_sock_init_ofd(&p->ofd, AF_INET, SOCK_DGRAM,
+				       IPPROTO_UDP, "127.0.0.1", 0,
+				       OSMO_SOCK_F_BIND) < 0) {
+			fprintf(stderr, "cannot open peer socket\n");
+			exit(1);
+		}
+		len = sizeof(sin);
+		getsockname(p->ofd.fd, (struct sockaddr *)&sin, &len);
+
+		/* as if the peer had done the RESET procedure */
+		p->nsei = 100 + i;
+		nsvc = gprs_nsvc_create(nsi, 1000 + i);
+		nsvc->nsei = p->nsei;
+		nsvc->ip.bts_addr = sin;
+		nsvc->ll = GPRS_NS_LL_UDP;
+		nsvc->state = NSE_S_ALIVE;
+		gprs_nsvc_rehash(nsvc);
+	}
+}
+
+static void teardown(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_PEERS; i++) {
+		osmo_fd_unregister(&peers[i].ofd);
+		close(peers[i].ofd.fd);
+	}
+	gprs_ns_destroy(nsi);
+}
+
+static void run(unsigned int batch)
+{
+	uint64_t t;
+	int i;
+
+	setup(batch);
+	sent = received = lost = last_received = 0;
+
+	stall_timer.cb = stall_cb;
+	osmo_timer_schedule(&stall_timer, 0, 200000);
+
+	t = now_ns();
+	for (i = 0; i < NUM_PEERS; i++)
+		peer_send(&peers[i], PEER_BATCH);
+	while (received < NUM_PDUS)
+		osmo_select_main(0);
+	t = now_ns() - t;
+
+	osmo_timer_del(&stall_timer);
+	teardown();
+
+	qsort(latency, NUM_PDUS, sizeof(*latency), cmp_u64);
+	if (batch)
+		printf("batch %2u:  ", batch);
+	else
+		printf("single:    ");
+	printf("%8.0f PDUs/s, latency us p50 %6.1f p90 %6.1f "
+		"p99 %6.1f p99.9 %6.1f max %7.1f",
+		NUM_PDUS / (t / 1e9),
+		latency[NUM_PDUS / 2] / 1e3,
+		latency[NUM_PDUS * 9 / 10] / 1e3,
+		latency[NUM_PDUS * 99 / 100] / 1e3,
+		latency[NUM_PDUS * 999 / 1000] / 1e3,
+		latency[NUM_PDUS - 1] / 1e3);
+	if (lost)
+		printf(", %u lost", lost);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int batch[] = { 0, 8, 32, 64 };
+	int i;
+
+	latency = malloc(NUM_PDUS * sizeof(*latency));
+
+	printf("%d peers, %d PDUs of %d octets, %d in flight\n\n",
+		NUM_PEERS, NUM_PDUS, 4 + PAYLOAD_LEN, WINDOW);
+
+	if (argc > 1) {
+		run(atoi(argv[1]));
+	} else {
+		for (i = 0; i < sizeof(batch) / sizeof(batch[0]); i++)
+			run(batch[i]);
+	}
+
+	free(latency);
+
+	return 0;
+}
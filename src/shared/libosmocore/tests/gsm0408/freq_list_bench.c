@@ -0,0 +1,87 @@
+/*
+ * Throughput of gsm48_decode_freq_list() for the Range formats
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/gsm/gsm48_ie.h>
+
+#define NUM_DECODES	2000000
+#define NUM_LISTS	1024
+
+static const struct {
+	const char *name;
+	uint8_t id, id_mask;
+} formats[] = {
+	{ "range1024",	0x80, 0xc8 },
+	{ "range512",	0x88, 0xce },
+	{ "range256",	0x8a, 0xce },
+	{ "range128",	0x8c, 0xce },
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(int n, int len)
+{
+	static struct gsm_sysinfo_freq f[1024];
+	static uint8_t cd[NUM_LISTS][16];
+	double start, t;
+	int i, j, rc = 0;
+
+	/* fully populated lists, every W(k) non-zero */
+	for (i = 0; i < NUM_LISTS; i++) {
+		for (j = 0; j < 16; j++)
+			cd[i][j] = random() | 0x11;
+		cd[i][0] = (cd[i][0] & ~formats[n].id_mask) | formats[n].id;
+	}
+
+	start = now_sec();
+	for (i = 0; i < NUM_DECODES; i++)
+		rc |= gsm48_decode_freq_list(f, cd[i % NUM_LISTS], len,
+					     0xce, 0x01);
+	t = now_sec() - start;
+
+	printf("%-10s len=%-2d %10.0f decodes/s  (%6.1f ns/decode)\n",
+		formats[n].name, len, NUM_DECODES / t, t * 1e9 / NUM_DECODES);
+	if (rc < 0)
+		printf("ERROR: %s failed to decode\n", formats[n].name);
+}
+
+int main(int argc, char **argv)
+{
+	int n;
+
+	srandom(1);
+
+	for (n = 0; n < sizeof(formats) / sizeof(formats[0]); n++) {
+		/* SYSTEM INFORMATION and a short dedicated mode element */
+		run(n, 16);
+		run(n, 8);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+ * Throughput of the GSMTAP source modes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+
+#define NUM_PACKETS	1000000
+/* packets sent per event loop iteration, as by a busy layer23 */
+#define PER_LOOP	16
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* nobody reads the sink, the kernel drops what does not fit */
+static uint16_t sink_open(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &sin, sizeof(sin)) < 0
+	 || getsockname(fd, (struct sockaddr *) &sin, &len) < 0) {
+		perror("sink");
+		exit(1);
+	}
+
+	return ntohs(sin.sin_port);
+}
+
+static void run(const char *name, int mode, uint16_t port)
+{
+	struct gsmtap_inst *gti;
+	uint8_t data[23];
+	double start, t;
+	int i;
+
+	gti = gsmtap_source_init("127.0.0.1", port, mode);
+	if (!gti) {
+		printf("%s: gsmtap_source_init failed\n", name);
+		return;
+	}
+	memset(data, 0x2b, sizeof(data));
+
+	start = now_sec();
+	for (i = 0; i < NUM_PACKETS; i++) {
+		gsmtap_send(gti, 871, 0, GSMTAP_CHANNEL_CCCH, 0, i, -60, 20,
+			    data, sizeof(data));
+		if (i % PER_LOOP == PER_LOOP - 1)
+			osmo_select_main(1);
+	}
+	while (gti->wq.bfd.when & BSC_FD_WRITE)
+		osmo_select_main(1);
+	t = now_sec() - start;
+
+	printf("%-8s %10.0f packets/s  (%5.1f ns/packet, %lu sent, "
+		"%lu dropped)\n", name, NUM_PACKETS / t, t * 1e9 / NUM_PACKETS,
+		gti->tx_packets, gti->tx_dropped);
+
+	if (gti->ofd_wq_mode != GSMTAP_MODE_DIRECT)
+		osmo_fd_unregister(&gti->wq.bfd);
+	close(gsmtap_inst_fd(gti));
+	talloc_free(gti);
+}
+
+int main(int argc, char **argv)
+{
+	uint16_t port = sink_open();
+
+	run("direct", GSMTAP_MODE_DIRECT, port);
+	run("wqueue", GSMTAP_MODE_WQ, port);
+	run("batch", GSMTAP_MODE_BATCH, port);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/msgb.h>
+
+static int sink;
+
+/* a UDP socket on localhost to collect what the instance sends */
+static uint16_t sink_open(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+
+	sink = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (sink < 0 || bind(sink, (struct sockaddr *) &sin, sizeof(sin)) < 0
+	 || getsockname(sink, (struct sockaddr *) &sin, &len) < 0) {
+		perror("sink");
+		exit(1);
+	}
+
+	return ntohs(sin.sin_port);
+}
+
+/* print the frame numbers of the packets received so far */
+static void sink_read(const char *what)
+{
+	uint8_t buf[1024];
+	struct gsmtap_hdr *gh = (struct gsmtap_hdr *) buf;
+	int rc;
+
+	printf("%s:", what);
+	while ((rc = recv(sink, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		if (rc < sizeof(*gh) || gh->version != GSMTAP_VERSION
+		 || gh->hdr_len != sizeof(*gh) / 4 || gh->type != GSMTAP_TYPE_UM
+		 || ntohs(gh->arfcn) != 871 || gh->res != 0)
+			printf(" bad");
+		else
+			printf(" %u/%u", ntohl(gh->frame_number),
+				(unsigned) (rc - sizeof(*gh)));
+	}
+	printf("\n");
+}
+
+static void send_frames(struct gsmtap_inst *gti, uint32_t fn, int num,
+			unsigned int len)
+{
+	uint8_t data[512];
+
+	memset(data, 0x2b, sizeof(data));
+	while (num--)
+		gsmtap_send(gti, 871, 0, GSMTAP_CHANNEL_BCCH, 0, fn++, -60, 20,
+			    data, len);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsmtap_inst *gti;
+	int i, rc;
+
+	gti = gsmtap_source_init("127.0.0.1", sink_open(), GSMTAP_MODE_BATCH);
+	if (!gti) {
+		printf("gsmtap_source_init failed\n");
+		return 1;
+	}
+
+	/* below the flush length nothing is sent before the select loop */
+	send_frames(gti, 0, 5, 23);
+	sink_read("queued");
+	osmo_select_main(1);
+	sink_read("select");
+
+	/* flush as soon as four are pending */
+	printf("set_batch_len: %d %d\n", gsmtap_set_batch_len(gti, 4),
+		gsmtap_set_batch_len(gti, GSMTAP_BATCH_SLOTS + 1));
+	send_frames(gti, 10, 6, 23);
+	sink_read("batch of 4");
+	gsmtap_flush(gti);
+	sink_read("flush");
+
+	/* too large for the ring, but stays in order */
+	send_frames(gti, 20, 2, 23);
+	send_frames(gti, 22, 1, 400);
+	sink_read("large");
+
+	/* prebuilt messages go through the ring as well */
+	gsmtap_sendmsg(gti, gsmtap_makemsg(871, 0, GSMTAP_CHANNEL_BCCH, 0, 30,
+					   -60, 20, (uint8_t *) "abc", 3));
+	gsmtap_flush(gti);
+	sink_read("sendmsg");
+
+	printf("sent %lu dropped %lu\n", gti->tx_packets, gti->tx_dropped);
+
+	/* errors of a flush belong to earlier packets, the one just put
+	 * into the ring is taken over anyway */
+	close(sink);
+	gsmtap_set_batch_len(gti, 1);
+	for (i = 0; i < 4; i++) {
+		rc = gsmtap_sendmsg(gti, gsmtap_makemsg(871, 0,
+				GSMTAP_CHANNEL_BCCH, 0, 40 + i, -60, 20,
+				(uint8_t *) "abc", 3));
+		printf("sendmsg to closed port: %d\n", rc);
+	}
+	printf("dropped %s\n", gti->tx_dropped ? "some" : "none");
+
+	return 0;
+}
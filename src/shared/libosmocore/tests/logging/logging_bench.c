@@ -0,0 +1,149 @@
+/*
+ * Cost of disabled debug log statements, as in the layer23 L1CTL path
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/rsl.h>
+
+#define NUM_FRAMES	1000000
+
+enum {
+	DL1C,
+	DRR,
+};
+
+static const struct log_info_cat categories[] = {
+	[DL1C] = {
+		.name = "DL1C",
+		.description = "Layer 1 Control",
+		.enabled = 1, .loglevel = LOGL_NOTICE,
+	},
+	[DRR] = {
+		.name = "DRR",
+		.description = "Radio Resource",
+		.enabled = 1, .loglevel = LOGL_NOTICE,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = categories,
+	.num_cat = ARRAY_SIZE(categories),
+};
+
+static const uint8_t ccch[23] = {
+	0x2d, 0x06, 0x3f, 0x10, 0x0e, 0x23, 0x01, 0x00, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b,
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* time spent in the main loop for enabled, timestamped lines to a file */
+static void run_file(const char *fname, const char *name,
+		     enum log_async_policy policy)
+{
+	struct log_target *tgt;
+	unsigned long dropped;
+	double start, t;
+	int i;
+
+	tgt = log_target_create_file(fname);
+	if (!tgt) {
+		perror(fname);
+		exit(EXIT_FAILURE);
+	}
+	log_add_target(tgt);
+	log_set_all_filter(tgt, 1);
+	log_set_print_timestamp(tgt, 1);
+	log_parse_category_mask(tgt, "DL1C,1");
+	if (log_target_set_async(tgt, policy) < 0) {
+		printf("%-14s not available\n", name);
+		log_target_destroy(tgt);
+		return;
+	}
+
+	start = now_sec();
+	for (i = 0; i < NUM_FRAMES / 10; i++)
+		DEBUGP(DL1C, "%s (%.4u/%.2u/%.2u) %d dBm: %s\n",
+			rsl_chan_nr_str(0x90), i % 2048, i % 26, i % 51,
+			-60, osmo_hexdump(ccch, sizeof(ccch)));
+	t = now_sec() - start;
+	log_target_get_async(tgt, &dropped);
+	log_target_destroy(tgt);
+	unlink(fname);
+
+	printf("%-14s %10.0f lines/s   (%6.1f ns/line, %lu dropped)\n",
+		name, NUM_FRAMES / 10 / t, t * 1e9 / (NUM_FRAMES / 10),
+		dropped);
+}
+
+int main(int argc, char **argv)
+{
+	struct log_target *tgt;
+	double start, t;
+	int i;
+
+	log_init(&log_info, NULL);
+
+	/* debug logging configured, but DL1C only at NOTICE */
+	tgt = log_target_create_file("/dev/null");
+	log_add_target(tgt);
+	log_set_all_filter(tgt, 1);
+	log_parse_category_mask(tgt, "DL1C,5:DRR,1");
+
+	/* what DEBUGP() in rx_ph_data_ind() expanded to before */
+	start = now_sec();
+	for (i = 0; i < NUM_FRAMES; i++)
+		logp(DL1C, __FILE__, __LINE__, 0,
+			"%s (%.4u/%.2u/%.2u) %d dBm: %s\n",
+			rsl_chan_nr_str(0x90), i % 2048, i % 26, i % 51,
+			-60, osmo_hexdump(ccch, sizeof(ccch)));
+	t = now_sec() - start;
+	printf("unconditional  %10.0f frames/s  (%6.1f ns/frame)\n",
+		NUM_FRAMES / t, t * 1e9 / NUM_FRAMES);
+
+	start = now_sec();
+	for (i = 0; i < NUM_FRAMES; i++)
+		DEBUGP(DL1C, "%s (%.4u/%.2u/%.2u) %d dBm: %s\n",
+			rsl_chan_nr_str(0x90), i % 2048, i % 26, i % 51,
+			-60, osmo_hexdump(ccch, sizeof(ccch)));
+	t = now_sec() - start;
+	printf("DEBUGP         %10.0f frames/s  (%6.1f ns/frame)\n",
+		NUM_FRAMES / t, t * 1e9 / NUM_FRAMES);
+
+	log_target_destroy(tgt);
+
+	run_file("logging_bench.log", "file sync", LOG_ASYNC_OFF);
+	run_file("logging_bench.log", "file async", LOG_ASYNC_BLOCK);
+	run_file("logging_bench.log", "file async/drop", LOG_ASYNC_DROP);
+
+	return EXIT_SUCCESS;
+}
@@ -18,6 +18,10 @@
  *
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 
@@ -53,6 +57,43 @@ const struct log_info log_info = {
 	.num_cat = ARRAY_SIZE(default_categories),
 };
 
+/* a failed reopen, e.g. after the log directory was removed by log
+ * rotation, must not turn an asynchronous target synchronous */
+static void test_reopen_async(void)
+{
+	struct log_target *file_target;
+	const char *fname;
+	char path[] = "/tmp/logging_test.XXXXXX";
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return;
+	close(fd);
+
+	file_target = log_target_create_file(path);
+	if (!file_target ||
+	    log_target_set_async(file_target, LOG_ASYNC_DROP) != 0)
+		goto out;
+
+	fname = file_target->tgt_file.fname;
+	file_target->tgt_file.fname = "/nonexistent/logging_test";
+	if (log_target_file_reopen(file_target) == 0)
+		fprintf(stderr, "reopen of a missing directory succeeded\n");
+	if (log_target_get_async(file_target, NULL) != LOG_ASYNC_DROP)
+		fprintf(stderr, "failed reopen turned the target synchronous\n");
+
+	file_target->tgt_file.fname = fname;
+	if (log_target_file_reopen(file_target) != 0 ||
+	    log_target_get_async(file_target, NULL) != LOG_ASYNC_DROP)
+		fprintf(stderr, "reopen failed\n");
+
+out:
+	if (file_target)
+		log_target_destroy(file_target);
+	unlink(path);
+}
+
 int main(int argc, char **argv)
 {
 	struct log_target *stderr_target;
@@ -72,5 +113,15 @@ int main(int argc, char **argv)
 	DEBUGP(DCC, "You should see this\n");
 	DEBUGP(DMM, "You should not see this\n");
 
+	/* written by the writer thread, flushed when the target goes away */
+	if (log_target_set_async(stderr_target, LOG_ASYNC_BLOCK) == 0) {
+		DEBUGP(DRLL, "You should see this async\n");
+		DEBUGP(DCC, "You should see this async\n");
+		DEBUGP(DMM, "You should not see this\n");
+	}
+	log_target_destroy(stderr_target);
+
+	test_reopen_async();
+
 	return 0;
 }
@@ -0,0 +1,109 @@
+/*
+ * Throughput of msgb allocation with and without the msgb pool
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/talloc.h>
+
+/* as layer2_read() in layer23 */
+#define GSM_L2_LENGTH	256
+#define GSM_L2_HEADROOM	32
+
+#define NUM_MSGS	1000000
+#define NUM_QUEUED	64
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct msgb *l1ctl_msg(void)
+{
+	struct msgb *msg;
+
+	msg = msgb_alloc_headroom(GSM_L2_LENGTH + GSM_L2_HEADROOM,
+				  GSM_L2_HEADROOM, "Layer2");
+	if (!msg) {
+		fprintf(stderr, "OOM\n");
+		exit(EXIT_FAILURE);
+	}
+	/* L1CTL header + DATA_IND with one 23 octet block */
+	memset(msgb_put(msg, 4 + 12 + 23), 0x2b, 4 + 12 + 23);
+	return msg;
+}
+
+static void run(const char *name)
+{
+	struct msgb *queue[NUM_QUEUED];
+	double start, t;
+	int i, j;
+
+	/* one frame at a time, as from l1ctl_recv() */
+	start = now_sec();
+	for (i = 0; i < NUM_MSGS; i++)
+		msgb_free(l1ctl_msg());
+	t = now_sec() - start;
+	printf("%-8s single   %10.0f msgs/s  (%5.1f ns/msg)\n",
+		name, NUM_MSGS / t, t * 1e9 / NUM_MSGS);
+
+	/* bursts of frames sitting in a write queue */
+	start = now_sec();
+	for (i = 0; i < NUM_MSGS / NUM_QUEUED; i++) {
+		for (j = 0; j < NUM_QUEUED; j++)
+			queue[j] = l1ctl_msg();
+		for (j = 0; j < NUM_QUEUED; j++)
+			msgb_free(queue[j]);
+	}
+	t = now_sec() - start;
+	printf("%-8s queued   %10.0f msgs/s  (%5.1f ns/msg)\n",
+		name, NUM_MSGS / t, t * 1e9 / NUM_MSGS);
+}
+
+int main(int argc, char **argv)
+{
+	struct msgb_pool_stats stats[MSGB_POOL_MAX_CLASSES];
+	unsigned long oversize;
+	int i, n;
+
+	msgb_set_talloc_ctx(talloc_named_const(NULL, 0, "msgb"));
+
+	run("talloc");
+
+	msgb_pool_enable(NULL, 0);
+	run("pool");
+
+	n = msgb_pool_get_stats(stats, MSGB_POOL_MAX_CLASSES, &oversize);
+	for (i = 0; i < n; i++)
+		printf("class %4u: hits=%lu misses=%lu in_use=%u "
+			"high_water=%u free=%u\n", stats[i].size,
+			stats[i].hits, stats[i].misses, stats[i].in_use,
+			stats[i].high_water, stats[i].free);
+	printf("oversize: %lu\n", oversize);
+
+	msgb_pool_disable();
+
+	return EXIT_SUCCESS;
+}
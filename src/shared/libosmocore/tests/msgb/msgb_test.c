@@ -0,0 +1,191 @@
+/* test for the msgb pool */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: " #cond " failed\n",		\
+				__func__, __LINE__);			\
+			exit(1);					\
+		}							\
+	} while (0)
+
+static void *msgb_ctx;
+
+static void print_stats(const char *what)
+{
+	struct msgb_pool_stats stats[MSGB_POOL_MAX_CLASSES];
+	unsigned long oversize;
+	int i, num;
+
+	num = msgb_pool_get_stats(stats, ARRAY_SIZE(stats), &oversize);
+	printf("%s: %d classes, %lu oversize\n", what, num, oversize);
+	for (i = 0; i < num; i++)
+		printf(" %4u: hits %lu misses %lu in use %u high water %u "
+			"free %u\n", stats[i].size, stats[i].hits,
+			stats[i].misses, stats[i].in_use, stats[i].high_water,
+			stats[i].free);
+}
+
+/* talloc blocks of the msgbs still allocated or on a free list */
+static size_t msgb_blocks(void)
+{
+	return talloc_total_blocks(msgb_ctx) - 1;
+}
+
+static void test_enable(void)
+{
+	static const uint16_t unsorted[] = { 256, 64 };
+	static const uint16_t too_many[MSGB_POOL_MAX_CLASSES + 1] = {
+		1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	static const uint16_t sizes[] = { 64, 256 };
+	struct msgb *msg;
+
+	printf("Testing enable\n");
+
+	/* without a pool, msgbs come from talloc */
+	msg = msgb_alloc(100, "test");
+	CHECK(msg && msg->pool_class == 0 && msg->data_len == 100);
+	msgb_free(msg);
+	CHECK(msgb_blocks() == 0);
+	print_stats("disabled");
+
+	CHECK(msgb_pool_enable(unsorted, ARRAY_SIZE(unsorted)) == -EINVAL);
+	CHECK(msgb_pool_enable(too_many, ARRAY_SIZE(too_many)) == -EINVAL);
+	CHECK(msgb_pool_enable(sizes, 0) == -EINVAL);
+	print_stats("invalid sizes");
+
+	CHECK(msgb_pool_enable(NULL, 0) == 0);
+	print_stats("default sizes");
+	msgb_pool_disable();
+}
+
+static void test_classes(void)
+{
+	static const uint16_t sizes[] = { 64, 256 };
+	struct msgb *msg[3], *big;
+	int i;
+
+	printf("Testing size classes\n");
+	CHECK(msgb_pool_enable(sizes, ARRAY_SIZE(sizes)) == 0);
+
+	/* rounded up to the class, but only the requested size is used */
+	msg[0] = msgb_alloc(10, "test");
+	msg[1] = msgb_alloc(64, "test");
+	msg[2] = msgb_alloc(65, "test");
+	CHECK(msg[0]->pool_class == 1 && msg[0]->data_len == 10);
+	CHECK(msg[1]->pool_class == 1 && msg[1]->data_len == 64);
+	CHECK(msg[2]->pool_class == 2 && msg[2]->data_len == 65);
+	CHECK(talloc_get_size(msg[0]) == sizeof(struct msgb) + 64);
+	CHECK(talloc_get_size(msg[2]) == sizeof(struct msgb) + 256);
+
+	/* too large for any class */
+	big = msgb_alloc(1000, "test");
+	CHECK(big->pool_class == 0 && big->data_len == 1000);
+	print_stats("allocated");
+
+	for (i = 0; i < ARRAY_SIZE(msg); i++)
+		msgb_free(msg[i]);
+	msgb_free(big);
+	print_stats("freed");
+	CHECK(msgb_blocks() == ARRAY_SIZE(msg));
+
+	msgb_pool_disable();
+	CHECK(msgb_blocks() == 0);
+}
+
+static void test_reuse(void)
+{
+	static const uint16_t sizes[] = { 64 };
+	struct msgb *msg, *again;
+
+	printf("Testing reuse\n");
+	CHECK(msgb_pool_enable(sizes, ARRAY_SIZE(sizes)) == 0);
+
+	msg = msgb_alloc(64, "test");
+	msgb_put(msg, 20);
+	msg->l2h = msg->data;
+	msg->cb[0] = 42;
+	memset(msg->data, 0xaa, 20);
+	msgb_free(msg);
+
+	/* the same buffer with a cleared header, the data is kept */
+	again = msgb_alloc(32, "again");
+	CHECK(again == msg);
+	CHECK(again->len == 0 && again->data_len == 32 && !again->l2h);
+	CHECK(again->cb[0] == 0 && again->pool_class == 1);
+	CHECK(again->data == again->_data && again->tail == again->data);
+	CHECK(!strcmp(talloc_get_name(again), "again"));
+	CHECK(again->data[0] == 0xaa);
+	print_stats("reused");
+
+	msgb_free(again);
+	msgb_pool_disable();
+	CHECK(msgb_blocks() == 0);
+}
+
+/* msgbs that are in use while the pool is disabled or changed go back
+ * to talloc when they are freed */
+static void test_disable(void)
+{
+	static const uint16_t sizes[] = { 64 };
+	static const uint16_t other_sizes[] = { 128 };
+	struct msgb *msg;
+
+	printf("Testing disable with msgbs in use\n");
+
+	CHECK(msgb_pool_enable(sizes, ARRAY_SIZE(sizes)) == 0);
+	msg = msgb_alloc(64, "test");
+	msgb_pool_disable();
+	msgb_free(msg);
+	CHECK(msgb_blocks() == 0);
+	print_stats("freed after disable");
+
+	CHECK(msgb_pool_enable(sizes, ARRAY_SIZE(sizes)) == 0);
+	msg = msgb_alloc(64, "test");
+	CHECK(msgb_pool_enable(other_sizes, ARRAY_SIZE(other_sizes)) == 0);
+	msgb_free(msg);
+	CHECK(msgb_blocks() == 0);
+	print_stats("freed after re-enable");
+
+	msgb_pool_disable();
+}
+
+int main(int argc, char **argv)
+{
+	msgb_ctx = talloc_named_const(NULL, 0, "msgb");
+	msgb_set_talloc_ctx(msgb_ctx);
+
+	test_enable();
+	test_classes();
+	test_reuse();
+	test_disable();
+
+	talloc_free(msgb_ctx);
+	printf("Done\n");
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Cost of rate counter interval tracking with 1M counters
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
+
+#define CTR_PER_GROUP	16
+#define NUM_GROUPS	65536
+#define NUM_CTR		(CTR_PER_GROUP * NUM_GROUPS)
+#define NUM_INC		(16 * 1024 * 1024)
+
+static const struct rate_ctr_desc bench_ctr_desc[CTR_PER_GROUP] = {
+	{ "ctr.0", "Counter 0" }, { "ctr.1", "Counter 1" },
+	{ "ctr.2", "Counter 2" }, { "ctr.3", "Counter 3" },
+	{ "ctr.4", "Counter 4" }, { "ctr.5", "Counter 5" },
+	{ "ctr.6", "Counter 6" }, { "ctr.7", "Counter 7" },
+	{ "ctr.8", "Counter 8" }, { "ctr.9", "Counter 9" },
+	{ "ctr.10", "Counter 10" }, { "ctr.11", "Counter 11" },
+	{ "ctr.12", "Counter 12" }, { "ctr.13", "Counter 13" },
+	{ "ctr.14", "Counter 14" }, { "ctr.15", "Counter 15" },
+};
+
+static const struct rate_ctr_group_desc bench_ctrg_desc = {
+	.group_name_prefix = "bench",
+	.group_description = "Benchmark counters",
+	.num_ctr = CTR_PER_GROUP,
+	.ctr_desc = bench_ctr_desc,
+};
+
+static struct rate_ctr_group *groups[NUM_GROUPS];
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* what the 1 Hz timer used to do for each counter every second */
+static void sweep_interval_expired(struct rate_ctr *ctr,
+				   enum rate_ctr_intv intv)
+{
+	ctr->intv[intv].rate = ctr->current - ctr->intv[intv].last;
+	ctr->intv[intv].last = ctr->current;
+	if (intv + 1 < ARRAY_SIZE(ctr->intv))
+		ctr->intv[intv+1].rate += ctr->intv[intv].rate;
+}
+
+static void sweep_all(uint64_t ticks)
+{
+	unsigned int g, i;
+
+	for (g = 0; g < NUM_GROUPS; g++) {
+		for (i = 0; i < CTR_PER_GROUP; i++) {
+			struct rate_ctr *ctr = &groups[g]->ctr[i];
+
+			sweep_interval_expired(ctr, RATE_CTR_INTV_SEC);
+			if ((ticks % 60) == 0)
+				sweep_interval_expired(ctr, RATE_CTR_INTV_MIN);
+		}
+	}
+}
+
+static void upd_all(void)
+{
+	unsigned int g;
+
+	for (g = 0; g < NUM_GROUPS; g++)
+		rate_ctr_group_upd_intv(groups[g]);
+}
+
+int main(int argc, char **argv)
+{
+	struct rate_ctr *ctr;
+	double start, t;
+	uint64_t ticks;
+	unsigned int g, i;
+
+	rate_ctr_init(NULL);
+	for (g = 0; g < NUM_GROUPS; g++)
+		groups[g] = rate_ctr_group_alloc(NULL, &bench_ctrg_desc, g);
+	printf("%u counters in %u groups\n", NUM_CTR, NUM_GROUPS);
+
+	srandom(42);
+	start = now_sec();
+	for (i = 0; i < NUM_INC; i++) {
+		g = random() % NUM_GROUPS;
+		rate_ctr_inc(&groups[g]->ctr[i % CTR_PER_GROUP]);
+	}
+	t = now_sec() - start;
+	printf("rate_ctr_inc, random:    %10.0f ops/s  (%5.1f ns/op, "
+		"including random())\n", NUM_INC / t, t * 1e9 / NUM_INC);
+
+	/* the timer sweep touched every counter every second, whether
+	 * idle or not */
+	start = now_sec();
+	for (ticks = 1; ticks <= 10; ticks++)
+		sweep_all(ticks);
+	t = (now_sec() - start) / 10;
+	printf("old 1 Hz sweep:          %10.3f ms per second, "
+		"%.1f%% of a CPU\n", t * 1e3, t * 100);
+
+	/* reading all groups costs about as much as a sweep, but only
+	 * happens when somebody asks for the rates */
+	usleep(1100000);
+	start = now_sec();
+	upd_all();
+	t = now_sec() - start;
+	printf("update all groups:       %10.3f ms\n", t * 1e3);
+
+	start = now_sec();
+	for (i = 0; i < NUM_GROUPS; i++)
+		rate_ctr_group_upd_intv(groups[i]);
+	t = now_sec() - start;
+	printf("update all, same second: %10.3f ms\n", t * 1e3);
+
+	start = now_sec();
+	for (i = 0; i < 1000000; i++)
+		rate_ctr_group_upd_intv(groups[0]);
+	t = now_sec() - start;
+	printf("update one group:        %10.1f ns\n", t * 1e9 / 1000000);
+
+	/* a counter at a steady 1000/s, updated once per second */
+	ctr = &groups[1]->ctr[0];
+	rate_ctr_group_upd_intv(groups[1]);
+	for (i = 0; i < 25; i++) {
+		rate_ctr_add(ctr, 100);
+		usleep(100000);
+		if (i % 10 == 9)
+			rate_ctr_group_upd_intv(groups[1]);
+	}
+	rate_ctr_group_upd_intv(groups[1]);
+	printf("steady 1000/s counter:   %" PRIu64 "/s\n",
+		ctr->intv[RATE_CTR_INTV_SEC].rate);
+
+	for (g = 0; g < NUM_GROUPS; g++)
+		rate_ctr_group_free(groups[g]);
+
+	return 0;
+}
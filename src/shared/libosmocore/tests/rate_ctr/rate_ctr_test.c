@@ -0,0 +1,204 @@
+/* test for the interval rates of rate counters */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/rate_ctr.h>
+
+/* the counters grow in steps of 10 ms */
+#define STEP		10
+#define MAX_STEPS	(10 * 60 * 1000 / STEP)
+
+#define SEC		1000
+#define MIN		(60 * SEC)
+
+static const struct rate_ctr_desc test_ctr_desc[] = {
+	{ "events", "Events" },
+};
+
+static const struct rate_ctr_group_desc test_ctrg_desc = {
+	.group_name_prefix = "test",
+	.group_description = "Test counters",
+	.num_ctr = ARRAY_SIZE(test_ctr_desc),
+	.ctr_desc = test_ctr_desc,
+};
+
+static const uint64_t intv_len[RATE_CTR_INTV_NUM] = {
+	[RATE_CTR_INTV_SEC]	= SEC,
+	[RATE_CTR_INTV_MIN]	= MIN,
+	[RATE_CTR_INTV_HOUR]	= 60 * MIN,
+	[RATE_CTR_INTV_DAY]	= 24 * 60 * MIN,
+};
+
+static const char *intv_name[RATE_CTR_INTV_NUM] = {
+	[RATE_CTR_INTV_SEC]	= "sec",
+	[RATE_CTR_INTV_MIN]	= "min",
+	[RATE_CTR_INTV_HOUR]	= "hour",
+	[RATE_CTR_INTV_DAY]	= "day",
+};
+
+static uint64_t now;
+
+static uint64_t test_clock(void)
+{
+	return now;
+}
+
+/* the value of the counter at each step since the group was allocated,
+ * to compare the rates with */
+static struct {
+	uint64_t t0;
+	uint64_t val[MAX_STEPS];
+} hist;
+
+static struct rate_ctr_group *alloc_group(void)
+{
+	hist.t0 = now;
+	hist.val[0] = 0;
+	return rate_ctr_group_alloc(NULL, &test_ctrg_desc, 0);
+}
+
+static uint64_t hist_at(uint64_t t)
+{
+	if (t <= hist.t0)
+		return 0;
+	return hist.val[(t - hist.t0) / STEP];
+}
+
+/* let the time run until t with the counter growing per_sec per second */
+static void run(struct rate_ctr_group *grp, uint64_t t, unsigned int per_sec)
+{
+	while (now < t) {
+		now += STEP;
+		rate_ctr_add(&grp->ctr[0], per_sec / (SEC / STEP));
+		hist.val[(now - hist.t0) / STEP] = grp->ctr[0].current;
+	}
+}
+
+/* the rate must match the events in the last complete interval */
+static void check(const char *what, struct rate_ctr_group *grp,
+		  enum rate_ctr_intv intv)
+{
+	uint64_t end = now / intv_len[intv] * intv_len[intv];
+	uint64_t expect = hist_at(end) - hist_at(end - intv_len[intv]);
+	uint64_t rate = grp->ctr[0].intv[intv].rate;
+
+	printf("%s: %" PRIu64 "/%s\n", what, rate, intv_name[intv]);
+	if (rate != expect) {
+		printf("%s: expected %" PRIu64 "/%s\n", what, expect,
+			intv_name[intv]);
+		exit(1);
+	}
+}
+
+static void read_group(struct rate_ctr_group *grp)
+{
+	rate_ctr_group_upd_intv(grp);
+}
+
+/* a group read every second, allocated on a minute boundary */
+static void test_every_second(void)
+{
+	struct rate_ctr_group *grp;
+	unsigned int i;
+	char what[32];
+
+	printf("Testing reads every second\n");
+
+	now = 10 * MIN;
+	grp = alloc_group();
+
+	for (i = 1; i <= 60; i++) {
+		run(grp, now + SEC, i <= 5 ? i * 100 : 100);
+		read_group(grp);
+		if (i <= 5 || i == 60) {
+			snprintf(what, sizeof(what), "second %u", i);
+			check(what, grp, RATE_CTR_INTV_SEC);
+		}
+	}
+	check("minute 10", grp, RATE_CTR_INTV_MIN);
+
+	/* nothing changes within the same second */
+	run(grp, now + 500, 1000);
+	read_group(grp);
+	printf("same second: %" PRIu64 "/sec\n",
+		grp->ctr[0].intv[RATE_CTR_INTV_SEC].rate);
+
+	rate_ctr_group_free(grp);
+}
+
+/* a group allocated in the middle of a second and read now and then */
+static void test_sparse(void)
+{
+	struct rate_ctr_group *grp;
+
+	printf("Testing sparse reads\n");
+
+	now = 20 * MIN + 500;
+	grp = alloc_group();
+
+	/* the first interval only counts since the allocation */
+	run(grp, 20 * MIN + 1500, 1000);
+	read_group(grp);
+	check("first read", grp, RATE_CTR_INTV_SEC);
+
+	/* the rates of the skipped seconds are interpolated */
+	run(grp, 20 * MIN + 5250, 1000);
+	read_group(grp);
+	check("after 3.75 s", grp, RATE_CTR_INTV_SEC);
+
+	run(grp, 20 * MIN + 7750, 2000);
+	read_group(grp);
+	check("rate doubled", grp, RATE_CTR_INTV_SEC);
+
+	/* reads every 10 s up to the end of the first minute */
+	while (now < 20 * MIN + 57750) {
+		run(grp, now + 10 * SEC, 2000);
+		read_group(grp);
+	}
+	check("minute 20 not over", grp, RATE_CTR_INTV_MIN);
+
+	/* the previous read saw the start of the minute */
+	run(grp, 21 * MIN + 2750, 2000);
+	read_group(grp);
+	check("across minute 21", grp, RATE_CTR_INTV_SEC);
+	check("across minute 21", grp, RATE_CTR_INTV_MIN);
+
+	/* the previous read was minutes before the one that ended */
+	run(grp, 24 * MIN + 5000, 3000);
+	read_group(grp);
+	check("across minute 24", grp, RATE_CTR_INTV_SEC);
+	check("across minute 24", grp, RATE_CTR_INTV_MIN);
+
+	rate_ctr_group_free(grp);
+}
+
+int main(int argc, char **argv)
+{
+	rate_ctr_set_clock(test_clock);
+	rate_ctr_init(NULL);
+
+	test_every_second();
+	test_sparse();
+
+	printf("Done\n");
+	return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * Wakeup latency of the select loop backends with many idle fds
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+
+#include <osmocom/core/select.h>
+
+#include "../../config.h"
+
+#define NUM_HOT		4
+#define NUM_ROUNDS	20000
+
+static struct osmo_fd *idle_fds;
+static int *idle_wr;
+static struct osmo_fd hot_fds[NUM_HOT];
+static int hot_wr[NUM_HOT];
+static int fired;
+
+static int idle_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	fprintf(stderr, "idle fd %d fired unexpectedly\n", ofd->fd);
+	exit(EXIT_FAILURE);
+}
+
+static int hot_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	char c;
+
+	if (read(ofd->fd, &c, 1) == 1)
+		fired++;
+	return 0;
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int setup_fds(int num_idle)
+{
+	int i, p[2];
+
+	idle_fds = calloc(num_idle, sizeof(*idle_fds));
+	idle_wr = calloc(num_idle, sizeof(*idle_wr));
+	for (i = 0; i < num_idle; i++) {
+		/* the write end is kept open, so the fd never becomes
+		 * readable */
+		if (pipe(p) < 0)
+			return i;
+		idle_fds[i].fd = p[0];
+		idle_wr[i] = p[1];
+		idle_fds[i].when = BSC_FD_READ;
+		idle_fds[i].cb = idle_cb;
+		osmo_fd_register(&idle_fds[i]);
+	}
+	return num_idle;
+}
+
+static void teardown_fds(int num_idle)
+{
+	int i;
+
+	for (i = 0; i < num_idle; i++) {
+		osmo_fd_unregister(&idle_fds[i]);
+		close(idle_fds[i].fd);
+		close(idle_wr[i]);
+	}
+	free(idle_fds);
+	free(idle_wr);
+}
+
+static void run(const char *name, enum osmo_select_backend backend,
+		unsigned int flags, int num_idle)
+{
+	double start, lat, sum = 0, max = 0;
+	int i, n, rc;
+
+	rc = osmo_select_init(backend, flags);
+	if (rc < 0) {
+		printf("%-12s not available (%s)\n", name, strerror(-rc));
+		return;
+	}
+
+	n = setup_fds(num_idle);
+
+	for (i = 0; i < NUM_ROUNDS; i++) {
+		fired = 0;
+		start = now_us();
+		if (write(hot_wr[i % NUM_HOT], "x", 1) != 1)
+			exit(EXIT_FAILURE);
+		while (!fired)
+			osmo_select_main(0);
+		lat = now_us() - start;
+		sum += lat;
+		if (lat > max)
+			max = lat;
+	}
+
+	printf("%-12s idle=%5d hot=%d: avg %8.2f us  max %8.2f us\n",
+		name, n, NUM_HOT, sum / NUM_ROUNDS, max);
+
+	teardown_fds(n);
+}
+
+int main(int argc, char **argv)
+{
+	struct rlimit rl;
+	int num_idle = 10000, select_idle;
+	int i, p[2];
+
+	if (argc > 1)
+		num_idle = atoi(argv[1]);
+
+	/* two fds per idle pipe plus some slack */
+	getrlimit(RLIMIT_NOFILE, &rl);
+	if (rl.rlim_cur < 2 * num_idle + 64) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		getrlimit(RLIMIT_NOFILE, &rl);
+		if (rl.rlim_cur < 2 * num_idle + 64) {
+			num_idle = (rl.rlim_cur - 64) / 2;
+			printf("RLIMIT_NOFILE too low, using %d idle fds\n",
+				num_idle);
+		}
+	}
+
+	for (i = 0; i < NUM_HOT; i++) {
+		if (pipe(p) < 0) {
+			perror("pipe");
+			exit(EXIT_FAILURE);
+		}
+		hot_fds[i].fd = p[0];
+		hot_fds[i].when = BSC_FD_READ;
+		hot_fds[i].cb = hot_cb;
+		hot_wr[i] = p[1];
+		osmo_fd_register(&hot_fds[i]);
+	}
+
+	/* select() cannot handle fds beyond FD_SETSIZE */
+	select_idle = num_idle;
+	if (2 * select_idle + 64 > FD_SETSIZE)
+		select_idle = (FD_SETSIZE - 64) / 2;
+
+	run("select", OSMO_SELECT_BACKEND_SELECT, 0, select_idle);
+	run("epoll", OSMO_SELECT_BACKEND_EPOLL, 0, select_idle);
+	run("epoll", OSMO_SELECT_BACKEND_EPOLL, 0, num_idle);
+	run("epoll-edge", OSMO_SELECT_BACKEND_EPOLL, OSMO_SELECT_F_EDGE,
+	    num_idle);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/*
+ * test for the select loop backends
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/timer.h>
+#include <osmocom/core/select.h>
+
+#include "../../config.h"
+
+/* a blocking osmo_select_main() may return a bit before the timer expired,
+ * a spinning loop returns thousands of times */
+#define MAX_WAKEUPS	3
+
+static int timer_fired;
+static int cb_count;
+
+static void timer_cb(void *data)
+{
+	timer_fired = 1;
+}
+
+static struct osmo_timer_list timer = {
+	.cb = timer_cb,
+};
+
+static int fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	char buf[16];
+	int rc;
+
+	cb_count++;
+	printf("call-back for%s%s%s\n", what & BSC_FD_READ ? " read" : "",
+		what & BSC_FD_WRITE ? " write" : "",
+		what & BSC_FD_EXCEPT ? " except" : "");
+
+	if (what & BSC_FD_READ) {
+		rc = recv(ofd->fd, buf, sizeof(buf), 0);
+		printf("recv: %d (%s)\n", rc, rc < 0 ? strerror(errno) : "eof");
+	}
+
+	/* stop waiting, a hangup stays pending */
+	osmo_fd_update_when(ofd, 0);
+	return 0;
+}
+
+/* run the loop for 100 ms, an fd with a pending error or hangup that is
+ * not waited for must neither be reported nor wake the loop up */
+static void run_idle(const char *what)
+{
+	unsigned int wakeups = 0;
+
+	cb_count = 0;
+	timer_fired = 0;
+	osmo_timer_schedule(&timer, 0, 100000);
+	while (!timer_fired) {
+		osmo_select_main(0);
+		wakeups++;
+	}
+
+	printf("%s: %d call-backs, %s\n", what, cb_count,
+		wakeups <= MAX_WAKEUPS ? "loop idle" : "loop spinning");
+	if (wakeups > MAX_WAKEUPS)
+		fprintf(stderr, "%u wakeups\n", wakeups);
+}
+
+static void test_closed_peer(void)
+{
+	struct osmo_fd ofd;
+	int sv[2];
+
+	printf("Testing a stream socket with a closed peer\n");
+
+	memset(&ofd, 0, sizeof(ofd));
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		perror("socketpair");
+		exit(1);
+	}
+	close(sv[1]);
+
+	ofd.fd = sv[0];
+	ofd.cb = fd_cb;
+	ofd.when = 0;
+	osmo_fd_register(&ofd);
+	run_idle("registered with when 0");
+
+	osmo_fd_update_when(&ofd, BSC_FD_READ);
+	run_idle("read once");
+
+	osmo_fd_unregister(&ofd);
+	close(ofd.fd);
+}
+
+static void test_closed_port(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	struct osmo_fd ofd;
+	int sink;
+
+	printf("Testing a datagram socket sending to a closed port\n");
+
+	/* find a free port */
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sink = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sink < 0 || bind(sink, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+	    getsockname(sink, (struct sockaddr *) &sin, &len) < 0) {
+		perror("sink");
+		exit(1);
+	}
+	close(sink);
+
+	memset(&ofd, 0, sizeof(ofd));
+	ofd.fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (ofd.fd < 0 ||
+	    connect(ofd.fd, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+		perror("connect");
+		exit(1);
+	}
+	ofd.cb = fd_cb;
+	ofd.when = 0;
+	osmo_fd_register(&ofd);
+
+	/* the port unreachable error is queued on the socket */
+	send(ofd.fd, "x", 1, 0);
+	run_idle("error pending with when 0");
+
+	osmo_fd_update_when(&ofd, BSC_FD_READ);
+	run_idle("read once");
+
+	osmo_fd_unregister(&ofd);
+	close(ofd.fd);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "e")) != -1) {
+		switch (c) {
+		case 'e':
+			if (osmo_select_init(OSMO_SELECT_BACKEND_EPOLL, 0)) {
+				fprintf(stderr, "%s: no epoll backend\n",
+					argv[0]);
+				exit(77);
+			}
+			break;
+		default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	test_closed_peer();
+	test_closed_port();
+
+	printf("Done\n");
+	return 0;
+}
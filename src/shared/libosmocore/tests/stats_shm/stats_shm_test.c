@@ -0,0 +1,234 @@
+/* test for the statistics shared memory segment */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/statistics.h>
+#include <osmocom/core/stats_shm.h>
+
+#define NUM_SLOTS	8
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: " #cond " failed\n",		\
+				__func__, __LINE__);			\
+			exit(1);					\
+		}							\
+	} while (0)
+
+static const struct rate_ctr_desc test_ctr_desc[] = {
+	{ "rx", "Received packets" },
+	{ "tx", "Sent packets" },
+	{ "drop", "Dropped packets" },
+};
+
+static const struct rate_ctr_group_desc test_ctrg_desc = {
+	.group_name_prefix = "test",
+	.group_description = "Test counters",
+	.num_ctr = ARRAY_SIZE(test_ctr_desc),
+	.ctr_desc = test_ctr_desc,
+};
+
+static char seg_name[32];
+static struct osmo_stats_shm_slot slots[NUM_SLOTS];
+
+static const char *type_str(uint32_t type)
+{
+	switch (type) {
+	case OSMO_STATS_SHM_FREE:
+		return "free";
+	case OSMO_STATS_SHM_COUNTER:
+		return "counter";
+	case OSMO_STATS_SHM_RATE_CTR:
+		return "rate_ctr";
+	}
+	return "?";
+}
+
+static void dump(const struct osmo_stats_shm_hdr *hdr)
+{
+	int i, num;
+
+	num = osmo_stats_shm_snapshot(hdr, slots, NUM_SLOTS);
+	printf("%d slots used\n", num);
+	for (i = 0; i < num; i++) {
+		if (slots[i].type == OSMO_STATS_SHM_FREE) {
+			printf(" %d: free\n", i);
+			continue;
+		}
+		if (slots[i].type == OSMO_STATS_SHM_RATE_CTR)
+			printf(" %d: %s %s.%u.%s", i, type_str(slots[i].type),
+				slots[i].group, slots[i].group_idx,
+				slots[i].name);
+		else
+			printf(" %d: %s %s", i, type_str(slots[i].type),
+				slots[i].name);
+		printf(" = %" PRIu64 " (%s)\n", slots[i].value,
+			slots[i].description);
+	}
+}
+
+static void test_export(void)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	struct rate_ctr_group *g0, *g1, *g2;
+	struct osmo_counter *ctr, *full;
+	int rc;
+
+	printf("Testing export of counters\n");
+
+	/* allocated before the segment exists */
+	g0 = rate_ctr_group_alloc(NULL, &test_ctrg_desc, 0);
+	rate_ctr_add(&g0->ctr[0], 10);
+
+	rc = osmo_stats_shm_init(seg_name, NUM_SLOTS, 0);
+	CHECK(rc == 0);
+	CHECK(osmo_stats_shm_init(seg_name, NUM_SLOTS, 0) == -EALREADY);
+
+	hdr = osmo_stats_shm_open(seg_name);
+	CHECK(hdr);
+	CHECK(hdr->pid == getpid());
+	CHECK(hdr->num_slots == NUM_SLOTS);
+	dump(hdr);
+
+	/* allocated afterwards, the description is set later */
+	ctr = osmo_counter_alloc("test.subscribers");
+	ctr->description = "Attached subscribers";
+	g1 = rate_ctr_group_alloc(NULL, &test_ctrg_desc, 1);
+	rate_ctr_inc(&g1->ctr[2]);
+	osmo_counter_inc(ctr);
+	osmo_counter_inc(ctr);
+	rate_ctr_add(&g0->ctr[1], 5);
+
+	/* values only change on update, the directory right away */
+	printf("before update:\n");
+	dump(hdr);
+	osmo_stats_shm_update();
+	printf("after update:\n");
+	dump(hdr);
+
+	/* the group doesn't fit, the counter does */
+	printf("segment full:\n");
+	g2 = rate_ctr_group_alloc(NULL, &test_ctrg_desc, 2);
+	CHECK(g2);
+	full = osmo_counter_alloc("test.full");
+	osmo_counter_inc(full);
+	osmo_stats_shm_update();
+	dump(hdr);
+
+	/* freed slots are reused */
+	printf("free group 0:\n");
+	osmo_counter_free(full);
+	rate_ctr_group_free(g0);
+	dump(hdr);
+	printf("free group 1:\n");
+	rate_ctr_group_free(g1);
+	dump(hdr);
+	printf("group 0 again:\n");
+	g0 = rate_ctr_group_alloc(NULL, &test_ctrg_desc, 0);
+	osmo_stats_shm_update();
+	dump(hdr);
+
+	osmo_stats_shm_close(hdr);
+	osmo_stats_shm_exit();
+	CHECK(!osmo_stats_shm_open(seg_name));
+
+	rate_ctr_group_free(g0);
+	rate_ctr_group_free(g2);
+	osmo_counter_free(ctr);
+}
+
+/* a writer process updates all counters to the same value over and over,
+ * a snapshot must never see two different values */
+static void test_consistency(void)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	struct rate_ctr_group *g0, *g1;
+	unsigned int i, n, torn = 0, snaps = 0;
+	uint64_t last = 0;
+	int num, status, done;
+	pid_t pid;
+
+	printf("Testing consistency of snapshots\n");
+
+	g0 = rate_ctr_group_alloc(NULL, &test_ctrg_desc, 0);
+	g1 = rate_ctr_group_alloc(NULL, &test_ctrg_desc, 1);
+	CHECK(osmo_stats_shm_init(seg_name, NUM_SLOTS, 0) == 0);
+	hdr = osmo_stats_shm_open(seg_name);
+	CHECK(hdr);
+
+	pid = fork();
+	CHECK(pid >= 0);
+	if (pid == 0) {
+		for (n = 0; n < 200000; n++) {
+			for (i = 0; i < test_ctrg_desc.num_ctr; i++) {
+				rate_ctr_inc(&g0->ctr[i]);
+				rate_ctr_inc(&g1->ctr[i]);
+			}
+			osmo_stats_shm_update();
+		}
+		_exit(0);
+	}
+
+	/* until the writer is done, and once more afterwards */
+	do {
+		done = waitpid(pid, &status, WNOHANG) == pid;
+		num = osmo_stats_shm_snapshot(hdr, slots, NUM_SLOTS);
+		if (num < 0)
+			continue;
+		CHECK(num == 2 * test_ctrg_desc.num_ctr);
+		for (i = 1; i < num; i++) {
+			if (slots[i].value != slots[0].value)
+				torn++;
+		}
+		CHECK(slots[0].value >= last);
+		last = slots[0].value;
+		snaps++;
+	} while (!done);
+
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	printf("final value %" PRIu64 ", %s\n", last,
+		torn ? "torn snapshots" : "all snapshots consistent");
+	fprintf(stderr, "%u snapshots\n", snaps);
+
+	osmo_stats_shm_close(hdr);
+	osmo_stats_shm_exit();
+	rate_ctr_group_free(g0);
+	rate_ctr_group_free(g1);
+}
+
+int main(int argc, char **argv)
+{
+	rate_ctr_init(NULL);
+	snprintf(seg_name, sizeof(seg_name), "stats_shm_test.%d", getpid());
+
+	test_export();
+	test_consistency();
+
+	printf("Done\n");
+	return 0;
+}
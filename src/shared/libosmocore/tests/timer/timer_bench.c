@@ -0,0 +1,115 @@
+/*
+ * Throughput of the timer engines with many concurrent timers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <osmocom/core/timer.h>
+
+#define NUM_TIMERS	100000
+
+static struct osmo_timer_list *timers;
+static unsigned int fired;
+
+static void timer_cb(void *data)
+{
+	fired++;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *what, double t, int n)
+{
+	printf("%-8s %-12s %10.0f ops/s  (%6.1f ns/op)\n",
+		name, what, n / t, t * 1e9 / n);
+}
+
+static void run(const char *name, enum osmo_timer_engine engine)
+{
+	double start;
+	int i;
+
+	if (osmo_timers_set_engine(engine) < 0) {
+		printf("%-8s not available\n", name);
+		return;
+	}
+
+	memset(timers, 0, NUM_TIMERS * sizeof(*timers));
+	for (i = 0; i < NUM_TIMERS; i++)
+		timers[i].cb = timer_cb;
+
+	/* LAPD/RR/MM like spread: from 100ms up to 10 minutes */
+	srandom(42);
+	start = now_sec();
+	for (i = 0; i < NUM_TIMERS; i++)
+		osmo_timer_schedule(&timers[i], random() % 600,
+				    100000 + random() % 900000);
+	report(name, "schedule", now_sec() - start, NUM_TIMERS);
+
+	/* T200 style restarts of running timers */
+	start = now_sec();
+	for (i = 0; i < NUM_TIMERS; i++)
+		osmo_timer_schedule(&timers[i], 1 + random() % 30, 0);
+	report(name, "reschedule", now_sec() - start, NUM_TIMERS);
+
+	start = now_sec();
+	for (i = 0; i < NUM_TIMERS; i++) {
+		osmo_timers_prepare();
+		osmo_timers_nearest();
+	}
+	report(name, "prepare", now_sec() - start, NUM_TIMERS);
+
+	start = now_sec();
+	for (i = 0; i < NUM_TIMERS; i++)
+		osmo_timer_del(&timers[i]);
+	report(name, "del", now_sec() - start, NUM_TIMERS);
+
+	/* let all of them expire within 50ms and fire them at once */
+	for (i = 0; i < NUM_TIMERS; i++)
+		osmo_timer_schedule(&timers[i], 0, random() % 50000);
+	usleep(60000);
+	fired = 0;
+	start = now_sec();
+	osmo_timers_update();
+	report(name, "expire", now_sec() - start, NUM_TIMERS);
+	if (fired != NUM_TIMERS)
+		printf("ERROR: only %u of %u timers fired\n", fired,
+			NUM_TIMERS);
+}
+
+int main(int argc, char **argv)
+{
+	timers = calloc(NUM_TIMERS, sizeof(*timers));
+
+	printf("%u concurrent timers\n", NUM_TIMERS);
+	run("rbtree", OSMO_TIMER_ENGINE_RBTREE);
+	run("wheel", OSMO_TIMER_ENGINE_WHEEL);
+
+	free(timers);
+	return EXIT_SUCCESS;
+}
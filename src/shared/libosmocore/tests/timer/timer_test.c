@@ -155,7 +155,7 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	while ((c = getopt_long(argc, argv, "s:", NULL, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "s:w", NULL, NULL)) != -1) {
 	switch(c) {
 		case 's':
 			timer_nsteps = atoi(optarg);
@@ -165,6 +165,13 @@ int main(int argc, char *argv[])
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'w':
+			if (osmo_timers_set_engine(OSMO_TIMER_ENGINE_WHEEL)) {
+				fprintf(stderr, "%s: no timer wheel\n",
+					argv[0]);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		default:
 			exit(EXIT_FAILURE);
 		}
@@ -0,0 +1,115 @@
+/*
+ * Throughput of tlv_parse() and the precompiled TLV parser
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <osmocom/gsm/tlv.h>
+#include <osmocom/gsm/rsl.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/gprs/protocol/gsm_08_18.h>
+
+#define NUM_PDUS	5000000
+
+/* IEs of a BSSGP UL-UNITDATA after TLLI and QoS profile */
+static const uint8_t bssgp_ul_ud[] = {
+	BSSGP_IE_CELL_ID, 0x88,
+		0x62, 0xf2, 0x20, 0x00, 0x01, 0x01, 0x00, 0x0a,
+	BSSGP_IE_ALIGNMENT, 0x81, 0x00,
+	BSSGP_IE_LLC_PDU, 0xa4,
+		0x01, 0xc0, 0x01, 0x08, 0x01, 0x02, 0xe5, 0xe0,
+		0x01, 0x0a, 0x00, 0x05, 0xf4, 0x7a, 0xd2, 0x43,
+		0x1e, 0x62, 0xf2, 0x20, 0x00, 0x01, 0x01, 0x19,
+		0x08, 0x04, 0x07, 0x60, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00,
+};
+
+/* IEs of an RSL MEASurement RESult */
+static const uint8_t rsl_meas_res[] = {
+	RSL_IE_CHAN_NR, 0x0a,
+	RSL_IE_MEAS_RES_NR, 0x2a,
+	RSL_IE_UPLINK_MEAS, 0x03, 0x1e, 0x1e, 0x00,
+	RSL_IE_BS_POWER, 0x00,
+	RSL_IE_L1_INFO, 0x00, 0x01,
+	RSL_IE_L3_INFO, 0x00, 0x12,
+		0x06, 0x15, 0x3a, 0x3a, 0x00, 0x5f, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00,
+};
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *what, double t)
+{
+	printf("%-6s %-20s %10.0f PDUs/s  (%5.1f ns/PDU)\n", name, what,
+		NUM_PDUS / t, t * 1e9 / NUM_PDUS);
+}
+
+static void run(const char *name, const struct tlv_definition *def,
+		const uint8_t *pdu, int len, uint8_t mand_tag)
+{
+	static struct tlv_compiled c;
+	static struct tlv_parsed_sparse sparse;
+	struct tlv_mandatory mand = { };
+	struct tlv_parsed tp;
+	double start;
+	int i, rc = 0;
+
+	start = now_sec();
+	for (i = 0; i < NUM_PDUS; i++)
+		rc |= tlv_parse(&tp, def, pdu, len, 0, 0);
+	report(name, "tlv_parse", now_sec() - start);
+
+	start = now_sec();
+	tlv_compile(&c, def);
+	printf("%-6s %-20s %10.1f us\n", name, "tlv_compile",
+		(now_sec() - start) * 1e6);
+
+	start = now_sec();
+	for (i = 0; i < NUM_PDUS; i++)
+		rc |= tlv_parse_compiled(&sparse, &c, NULL, pdu, len, 0, 0);
+	report(name, "tlv_parse_compiled", now_sec() - start);
+
+	tlv_mandatory_add(&mand, mand_tag);
+	start = now_sec();
+	for (i = 0; i < NUM_PDUS; i++)
+		rc |= tlv_parse_compiled(&sparse, &c, &mand, pdu, len, 0, 0);
+	report(name, "+ mandatory IEs", now_sec() - start);
+
+	if (rc < 0)
+		printf("ERROR: %s sample failed to parse\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	run("bssgp", &tvlv_att_def, bssgp_ul_ud, sizeof(bssgp_ul_ud),
+	    BSSGP_IE_LLC_PDU);
+	run("rsl", &rsl_att_tlvdef, rsl_meas_res, sizeof(rsl_meas_res),
+	    RSL_IE_UPLINK_MEAS);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/tlv.h>
+#include <osmocom/gsm/rsl.h>
+#include <osmocom/gsm/gsm48.h>
+#include <osmocom/gsm/gsm0808.h>
+
+#define NUM_PDUS	20000
+#define MAX_PDU		2048
+
+static enum tlv_type ie_type(const struct tlv_definition *def, uint8_t tag)
+{
+	if (def->def[tag & 0xf0].type == TLV_TYPE_SINGLE_TV)
+		return TLV_TYPE_SINGLE_TV;
+	return def->def[tag].type;
+}
+
+static int rand_len(void)
+{
+	/* mostly short IEs, sometimes ones with a two octet length */
+	if (random() % 8)
+		return random() % 40;
+	return random() % 400;
+}
+
+/* append one random but well-formed IE */
+static int put_ie(uint8_t *buf, const struct tlv_definition *def)
+{
+	uint8_t tag;
+	int i, len, n;
+
+	do {
+		tag = random();
+	} while (ie_type(def, tag) == TLV_TYPE_NONE);
+
+	buf[0] = tag;
+	switch (ie_type(def, tag)) {
+	case TLV_TYPE_SINGLE_TV:
+	case TLV_TYPE_T:
+		return 1;
+	case TLV_TYPE_TV:
+		len = 1;
+		n = 1;
+		break;
+	case TLV_TYPE_FIXED:
+		len = def->def[tag].fixed_len;
+		n = 1;
+		break;
+	case TLV_TYPE_TLV:
+		len = random() % 256;
+		buf[1] = len;
+		n = 2;
+		break;
+	case TLV_TYPE_TL16V:
+		len = rand_len();
+		buf[1] = len >> 8;
+		buf[2] = len;
+		n = 3;
+		break;
+	case TLV_TYPE_TvLV:
+		len = rand_len();
+		if (len <= TVLV_MAX_ONEBYTE && random() % 4) {
+			buf[1] = 0x80 | len;
+			n = 2;
+		} else {
+			buf[1] = len >> 8;
+			buf[2] = len;
+			n = 3;
+		}
+		break;
+	case TLV_TYPE_vTvLV_GAN:
+		len = rand_len();
+		if (len <= TVLV_MAX_ONEBYTE && random() % 4) {
+			buf[1] = len;
+			n = 2;
+		} else {
+			buf[1] = 0x80 | len >> 8;
+			buf[2] = len;
+			n = 3;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	for (i = 0; i < len; i++)
+		buf[n + i] = random();
+	return n + len;
+}
+
+static int compare(const struct tlv_parsed *a, const struct tlv_parsed *b)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(a->lv); i++) {
+		if (a->lv[i].val != b->lv[i].val)
+			return -1;
+		if (a->lv[i].val && a->lv[i].len != b->lv[i].len)
+			return -1;
+	}
+	return 0;
+}
+
+/* the compiled parser must decode exactly like tlv_parse() */
+static void test_def(const char *name, const struct tlv_definition *def)
+{
+	static struct tlv_compiled c;
+	static struct tlv_parsed_sparse sparse;
+	struct tlv_parsed ref;
+	uint8_t buf[MAX_PDU + 512];
+	int i, len, rc, rc_ref, valid = 0, mismatch = 0;
+
+	tlv_compile(&c, def);
+	memset(&sparse, 0, sizeof(sparse));
+
+	for (i = 0; i < NUM_PDUS; i++) {
+		len = 0;
+		while (len < MAX_PDU && random() % 8)
+			len += put_ie(buf + len, def);
+
+		rc_ref = tlv_parse(&ref, def, buf, len, 0, 0);
+		rc = tlv_parse_compiled(&sparse, &c, NULL, buf, len, 0, 0);
+		if (rc != rc_ref || compare(&ref, &sparse.tp))
+			mismatch++;
+
+		/* garbage: anything accepted must match tlv_parse() */
+		for (len = 0; len < 32; len++)
+			buf[len] = random();
+		len = random() % 32;
+		rc = tlv_parse_compiled(&sparse, &c, NULL, buf, len, 0, 0);
+		if (rc >= 0) {
+			valid++;
+			rc_ref = tlv_parse(&ref, def, buf, len, 0, 0);
+			if (rc != rc_ref || compare(&ref, &sparse.tp))
+				mismatch++;
+		}
+	}
+
+	printf("%s: %s (%s garbage accepted)\n", name,
+		mismatch ? "MISMATCH" : "ok", valid ? "some" : "no");
+}
+
+static void test_lv_mandatory(void)
+{
+	static struct tlv_compiled c;
+	static struct tlv_parsed_sparse dec;
+	struct tlv_mandatory mand = { };
+	/* LV, LV, Bearer Capability, Facility, Progress Indicator */
+	static const uint8_t pdu[] = {
+		0x01, 0xaa, 0x02, 0xbb, 0xcc,
+		0x04, 0x01, 0xa0, 0x1c, 0x02, 0x11, 0x22, 0x1e, 0x02, 0x82, 0x88,
+	};
+	int rc;
+
+	tlv_compile(&c, &gsm48_att_tlvdef);
+
+	tlv_mandatory_add(&mand, GSM48_IE_BEARER_CAP);
+	tlv_mandatory_add(&mand, GSM48_IE_FACILITY);
+	rc = tlv_parse_compiled(&dec, &c, &mand, pdu, sizeof(pdu), 1, 2);
+	printf("mandatory present: rc=%d lv=%u/%u bcap=%u fac=%u\n", rc,
+		TLVP_LEN(&dec.tp, 1), TLVP_LEN(&dec.tp, 2),
+		TLVP_LEN(&dec.tp, GSM48_IE_BEARER_CAP),
+		TLVP_LEN(&dec.tp, GSM48_IE_FACILITY));
+
+	tlv_mandatory_add(&mand, GSM48_IE_CAUSE);
+	rc = tlv_parse_compiled(&dec, &c, &mand, pdu, sizeof(pdu), 1, 2);
+	printf("mandatory missing: rc=%d\n", rc);
+
+	/* only the IEs of the previous PDU are reset */
+	rc = tlv_parse_compiled(&dec, &c, NULL, pdu + 5, 3, 0, 0);
+	printf("sparse reset: rc=%d lv=%s bcap=%s fac=%s\n", rc,
+		TLVP_PRESENT(&dec.tp, 1) ? "present" : "absent",
+		TLVP_PRESENT(&dec.tp, GSM48_IE_BEARER_CAP) ? "present" : "absent",
+		TLVP_PRESENT(&dec.tp, GSM48_IE_FACILITY) ? "present" : "absent");
+
+	/* truncated Facility IE */
+	rc = tlv_parse_compiled(&dec, &c, NULL, pdu + 5, 4, 0, 0);
+	printf("truncated: rc=%d\n", rc);
+
+	/* no pointers into the last buffer are left */
+	tlv_parsed_sparse_clear(&dec);
+	printf("clear: bcap=%s\n",
+		TLVP_PRESENT(&dec.tp, GSM48_IE_BEARER_CAP) ? "present" : "absent");
+}
+
+int main(int argc, char **argv)
+{
+	srandom(42);
+
+	test_def("rsl", &rsl_att_tlvdef);
+	test_def("gsm48", &gsm48_att_tlvdef);
+	test_def("gsm0808", gsm0808_att_tlvdef());
+	test_def("tvlv", &tvlv_att_def);
+	test_def("vtvlv_gan", &vtvlv_gan_att_def);
+	test_lv_mandatory();
+
+	return EXIT_SUCCESS;
+}
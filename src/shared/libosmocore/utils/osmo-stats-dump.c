@@ -0,0 +1,156 @@
+/* Utility program to dump the counters of a running process */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <osmocom/core/stats_shm.h>
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-h] [-d] [-s] [-i interval_ms] [-c count] name\n"
+		"  -d  include the descriptions\n"
+		"  -s  stream the counters instead of dumping them once\n"
+		"  -i  time between two dumps when streaming (default 1000)\n"
+		"  -c  stop after count dumps when streaming\n"
+		"The name is the one the process passed to "
+		"osmo_stats_shm_init().\n", progname);
+}
+
+static int dump(const struct osmo_stats_shm_hdr *hdr,
+		struct osmo_stats_shm_slot *slots, int descriptions)
+{
+	int i, num;
+
+	num = osmo_stats_shm_snapshot(hdr, slots, hdr->num_slots);
+	if (num < 0)
+		return num;
+
+	for (i = 0; i < num; i++) {
+		struct osmo_stats_shm_slot *slot = &slots[i];
+
+		switch (slot->type) {
+		case OSMO_STATS_SHM_RATE_CTR:
+			printf("%s.%u.%s %" PRIu64 " %" PRIu64 "/s %" PRIu64
+				"/m %" PRIu64 "/h %" PRIu64 "/d", slot->group,
+				slot->group_idx, slot->name, slot->value,
+				slot->rate[RATE_CTR_INTV_SEC],
+				slot->rate[RATE_CTR_INTV_MIN],
+				slot->rate[RATE_CTR_INTV_HOUR],
+				slot->rate[RATE_CTR_INTV_DAY]);
+			break;
+		case OSMO_STATS_SHM_COUNTER:
+			printf("%s %" PRIu64, slot->name, slot->value);
+			break;
+		default:
+			continue;
+		}
+		if (descriptions && slot->description[0])
+			printf(" # %s", slot->description);
+		printf("\n");
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	struct osmo_stats_shm_slot *slots;
+	unsigned int interval_ms = 1000;
+	int opt, stream = 0, descriptions = 0, count = -1, rc;
+
+	while ((opt = getopt(argc, argv, "hdsi:c:")) != -1) {
+		switch (opt) {
+		case 'd':
+			descriptions = 1;
+			break;
+		case 's':
+			stream = 1;
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			stream = 1;
+			break;
+		case 'c':
+			count = atoi(optarg);
+			stream = 1;
+			break;
+		case 'h':
+			help(argv[0]);
+			exit(0);
+			break;
+		default:
+			help(argv[0]);
+			exit(2);
+			break;
+		}
+	}
+
+	if (optind != argc - 1) {
+		help(argv[0]);
+		exit(2);
+	}
+
+	hdr = osmo_stats_shm_open(argv[optind]);
+	if (!hdr) {
+		fprintf(stderr, "Can't open statistics of %s: %s\n",
+			argv[optind], strerror(errno));
+		exit(1);
+	}
+
+	slots = calloc(hdr->num_slots, sizeof(*slots));
+	if (!slots) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	do {
+		/* the segment stays around if the process died */
+		if (kill(hdr->pid, 0) < 0 && errno == ESRCH) {
+			fprintf(stderr, "Process %u is gone\n", hdr->pid);
+			exit(1);
+		}
+		if (stream)
+			printf("# %" PRIu64 ".%03u\n",
+				hdr->update_time_ms / 1000,
+				(unsigned int) (hdr->update_time_ms % 1000));
+		rc = dump(hdr, slots, descriptions);
+		if (rc < 0) {
+			fprintf(stderr, "No consistent snapshot: %s\n",
+				strerror(-rc));
+			exit(1);
+		}
+		fflush(stdout);
+		if (count > 0)
+			count--;
+		if (stream && count)
+			usleep(interval_ms * 1000);
+	} while (stream && count);
+
+	free(slots);
+	osmo_stats_shm_close(hdr);
+
+	exit(0);
+}